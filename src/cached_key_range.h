@@ -0,0 +1,58 @@
+#ifndef CACHED_KEY_RANGE_H
+#define CACHED_KEY_RANGE_H
+
+#include <algorithm>
+
+#include "message_pack/pack.h"
+#include "message_pack/packed_value.h"
+#include "packed_key.h"
+
+// describes a range of rows that we've read and kept, given by the arguments that we read them with: the rows after
+// prev_key up to and including last_key, but no more than the number of rows we asked for.  we can't compare key
+// values in general, so ranges can only be looked up if they start and end on the keys of rows we have.
+struct CachedKeyRange {
+	CachedKeyRange(const ColumnValues &prev_key, const ColumnValues &last_key, bool complete): prev_key(prev_key), last_key(last_key), complete(complete) {}
+
+	// finds the rows that would be read for the given range, if they are all among the given rows (which must be the
+	// rows of this range, with key_count keys); first_row and row_count are indexes into keys
+	bool locate(const ColumnValues *keys, size_t key_count, const ColumnValues &range_prev_key, const ColumnValues &range_last_key, size_t rows_to_read, size_t &first_row, size_t &row_count) const {
+		size_t end_row;
+
+		// the range must start at the start of the cached range or after one of its rows
+		if (range_prev_key == prev_key) {
+			first_row = 0;
+		} else if (!find_key(keys, key_count, range_prev_key, 0, first_row)) {
+			return false;
+		} else {
+			first_row++;
+		}
+
+		// and must end at the end of the cached range, or at one of its rows
+		if (range_last_key == last_key) {
+			end_row = key_count;
+
+			// if we stopped reading rows because we hit the row count limit, there could be more rows
+			if (!complete && end_row - first_row < rows_to_read) return false;
+		} else if (!find_key(keys, key_count, range_last_key, first_row, end_row)) {
+			return false;
+		} else {
+			end_row++;
+		}
+
+		row_count = std::min(end_row - first_row, rows_to_read);
+		return true;
+	}
+
+	static bool find_key(const ColumnValues *keys, size_t key_count, const ColumnValues &key, size_t from_row, size_t &row) {
+		for (row = from_row; row < key_count; row++) {
+			if (keys[row] == key) return true;
+		}
+		return false;
+	}
+
+	ColumnValues prev_key;
+	ColumnValues last_key;
+	bool complete; // true if we read all the rows in the range, false if we stopped at the row count limit
+};
+
+#endif
@@ -92,6 +92,13 @@ namespace Commands {
 	const verb_t ROWS = 2;
 	const verb_t HASH = 7;
 	const verb_t RANGE = 8;
+	const verb_t SPLIT = 9;
+	const verb_t HASH_KEYS = 10;
+	const verb_t CHANGES = 11;
+	const verb_t CHANGED_KEYS = 12;
+	const verb_t CONFIRM_CHANGES = 13;
+	const verb_t DIGESTS = 14;
+	const verb_t STATISTICS = 15;
 	const verb_t IDLE = 31;
 
 	const verb_t PROTOCOL = 32;
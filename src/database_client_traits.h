@@ -19,4 +19,13 @@ struct SupportsAddNonNullableColumns {
 struct SupportsCustomTypes {
 };
 
+struct SupportsUpdateFrom {
+};
+
+struct SupportsArrays {
+};
+
+struct TransactionalDDL {
+};
+
 #endif
@@ -8,6 +8,29 @@ const size_t DEFAULT_MAXIMUM_BLOCK_SIZE = 64*1024*1024; // arbitrary, but needs
 
 const size_t DEFAULT_MAX_COMMANDS_TO_PIPELINE = 2;
 
-const char *DEFAULT_CIPHER = "aes256-gcm@openssh.com,aes256-ctr";
+const size_t DEFAULT_LOAD_CHUNKS_PER_WORKER = 4; // arbitrary, but gives workers that finish early something else to pick up
+const size_t DEFAULT_MINIMUM_ROWS_PER_LOAD_CHUNK = 10000; // arbitrary, but not worth the extra round trips for smaller chunks
+
+const size_t DEFAULT_LOCAL_ROW_CACHE_BYTES = 64*1024*1024; // arbitrary, but large enough to keep the rows of a range up to the maximum block size
+const size_t DEFAULT_ROW_DIGEST_CACHE_ROWS = 250000; // arbitrary, but bounds the memory used to around 100 bytes per row plus the key values
+
+const size_t DEFAULT_DIGEST_MAXIMUM_TABLE_SIZE = 1024*1024; // arbitrary, but small enough that hashing a whole table in one go doesn't hold up the batch
+const size_t DEFAULT_TABLES_PER_DIGESTS_COMMAND = 100; // arbitrary, but saves most of the round trips while still letting the workers share the batches
+
+const size_t DEFAULT_CATCH_UP_MAX_CHANGES = 100000; // arbitrary, but bounds the number of keys we hold in memory; rows beyond this are left for the next run
+
+const size_t DEFAULT_STRATEGY_SAMPLES = 16; // arbitrary, but enough to tell mostly-matching tables from mostly-different ones in a single round trip
+const double DEFAULT_RELOAD_MATCHING_FRACTION = 0.5; // arbitrary, but when fewer rows than this match, hashing and bisecting costs more than it saves
+
+const size_t DEFAULT_VERIFY_INTERVAL_HOURS = 24; // arbitrary, but tables skipped using the server statistics still get compared daily
+
+const size_t DEFAULT_ROWS_PER_SAMPLE = 100; // arbitrary, but small enough that a sample costs about the same as a round trip
+const size_t DEFAULT_SAMPLES_PER_ROUND = 16; // as for DEFAULT_STRATEGY_SAMPLES, all the responses are small so they can all be pipelined
+const size_t DEFAULT_MAXIMUM_SAMPLES = 100000; // arbitrary, but stops us hashing the same rows forever if the table is much smaller than its statistics say
+const double DEFAULT_SAMPLE_CONFIDENCE_Z = 1.96; // for 95% confidence
+
+const size_t MAXIMUM_ROW_VERSION_WATERMARK_AGE = 1000000000; // transactions; well short of the 2^31 at which PostgreSQL transaction IDs wrap around
+
+const char * const DEFAULT_CIPHER = "aes256-gcm@openssh.com,aes256-ctr";
 
 #endif
@@ -0,0 +1,121 @@
+#ifndef DIFF_REPORT_H
+#define DIFF_REPORT_H
+
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+
+// with --verify, we count the rows we would have inserted, updated, and deleted instead of changing them
+struct RowDifferences {
+	RowDifferences(): inserted(0), updated(0), deleted(0) {}
+
+	inline bool empty() const { return (!inserted && !updated && !deleted); }
+
+	inline RowDifferences operator -(const RowDifferences &other) const {
+		RowDifferences result;
+		result.inserted = inserted - other.inserted;
+		result.updated = updated - other.updated;
+		result.deleted = deleted - other.deleted;
+		return result;
+	}
+
+	inline RowDifferences &operator +=(const RowDifferences &other) {
+		inserted += other.inserted;
+		updated += other.updated;
+		deleted += other.deleted;
+		return *this;
+	}
+
+	size_t inserted;
+	size_t updated;
+	size_t deleted;
+};
+
+// the upper end of the Wilson score interval for the proportion of trials that were successes, which unlike the normal
+// approximation still gives a sensible bound when there are few trials or no successes at all
+inline double wilson_upper_bound(size_t successes, size_t trials, double z) {
+	if (!trials) return 1;
+	double n = trials;
+	double p = successes/n;
+	double denominator = 1 + z*z/n;
+	double centre = p + z*z/(2*n);
+	double margin = z*sqrt(p*(1 - p)/n + z*z/(4*n*n));
+	return min(1.0, (centre + margin)/denominator);
+}
+
+// with --verify-sample, we hash ranges of rows starting at random keys instead of comparing the whole table
+struct SampleResults {
+	SampleResults(): samples(0), rows_sampled(0), samples_differing(0) {}
+
+	inline double estimated_divergence() const { return (samples ? double(samples_differing)/samples : 0); }
+	inline double divergence_upper_bound(double z) const { return wilson_upper_bound(samples_differing, samples, z); }
+
+	size_t samples;
+	size_t rows_sampled;
+	size_t samples_differing;
+};
+
+inline string json_string(const string &value) {
+	static const char HEX_DIGITS[] = "0123456789abcdef";
+	string result("\"");
+	for (unsigned char c : value) {
+		switch (c) {
+			case '"':  result += "\\\""; break;
+			case '\\': result += "\\\\"; break;
+			case '\n': result += "\\n"; break;
+			case '\r': result += "\\r"; break;
+			case '\t': result += "\\t"; break;
+			default:
+				if (c < 0x20) {
+					result += "\\u00";
+					result += HEX_DIGITS[c >> 4];
+					result += HEX_DIGITS[c & 0x0f];
+				} else {
+					result += c;
+				}
+		}
+	}
+	result += '"';
+	return result;
+}
+
+inline string json_number(double value) {
+	char result[32];
+	snprintf(result, sizeof(result), "%.6g", value);
+	return result;
+}
+
+inline string json_counts(const RowDifferences &differences) {
+	return "\"inserted\":" + to_string(differences.inserted) + ",\"updated\":" + to_string(differences.updated) + ",\"deleted\":" + to_string(differences.deleted);
+}
+
+// the report has one JSON object per line, so it's easy to process a line at a time: one for each range of keys
+// found to differ, and one with the totals for each table compared.  keys are given as SQL value lists, as in the
+// --verbose output, or null for the start or end of the table.
+inline string diff_report_range_line(const string &table_id, const string &prev_key, const string &last_key, const RowDifferences &differences) {
+	return "{\"table\":" + json_string(table_id) +
+		",\"prev_key\":" + (prev_key.empty() ? string("null") : json_string(prev_key)) +
+		",\"last_key\":" + (last_key.empty() ? string("null") : json_string(last_key)) +
+		"," + json_counts(differences) + "}";
+}
+
+inline string diff_report_table_line(const string &table_id, const RowDifferences &differences) {
+	return "{\"table\":" + json_string(table_id) + "," + json_counts(differences) + "}";
+}
+
+// for tables that were sampled, the counts are just the rows we found outside their key range, so they're exact but
+// not the whole story; the estimated divergence is the proportion of the samples that differ, with the upper bound
+// of its confidence interval
+inline string diff_report_sample_line(const string &table_id, const RowDifferences &differences, const SampleResults &sample_results, double z) {
+	return "{\"table\":" + json_string(table_id) + "," + json_counts(differences) +
+		",\"samples\":" + to_string(sample_results.samples) +
+		",\"rows_sampled\":" + to_string(sample_results.rows_sampled) +
+		",\"samples_differing\":" + to_string(sample_results.samples_differing) +
+		",\"estimated_divergence\":" + json_number(sample_results.estimated_divergence()) +
+		",\"divergence_upper_bound\":" + json_number(sample_results.divergence_upper_bound(z)) + "}";
+}
+
+#endif
@@ -2,6 +2,25 @@
 #define ENCODE_PACKED
 
 #include "message_pack/copy_packed.h"
+#include "message_pack/packed_row_view.h"
+
+// equivalent to result += to_string(value), but without allocating a temporary string for every value
+inline string &append_integer_to(string &result, uint64_t value) {
+	char buf[20];
+	char *end = buf + sizeof(buf);
+	char *p = end;
+	do {
+		*--p = '0' + value % 10;
+		value /= 10;
+	} while (value);
+	return result.append(p, end - p);
+}
+
+inline string &append_integer_to(string &result, int64_t value) {
+	if (value >= 0) return append_integer_to(result, (uint64_t)value);
+	result += '-';
+	return append_integer_to(result, (uint64_t)0 - (uint64_t)value); // negate as unsigned so that INT64_MIN doesn't overflow
+}
 
 template <typename DatabaseClient>
 string &sql_encode_and_append_packed_value_to(string &result, DatabaseClient &client, const Column &column, PackedValueReadStream &stream) {
@@ -24,35 +43,35 @@ string &sql_encode_and_append_packed_value_to(string &result, DatabaseClient &cl
 	if ((leader >= MSGPACK_POSITIVE_FIXNUM_MIN && leader <= MSGPACK_POSITIVE_FIXNUM_MAX) ||
 		(leader >= MSGPACK_NEGATIVE_FIXNUM_MIN && leader <= MSGPACK_NEGATIVE_FIXNUM_MAX)) {
 		stream.next();
-		return result += to_string((int)(int8_t)leader); // up-cast to avoid int8_t being interpreted as char
+		return append_integer_to(result, (int64_t)(int8_t)leader);
 	}
 
 	Unpacker<PackedValueReadStream> unpacker(stream);
 
 	switch (leader) {
 		case MSGPACK_UINT8:
-			return result += to_string((unsigned int)unpacker.template next<uint8_t>()); // up-cast as above
+			return append_integer_to(result, (uint64_t)unpacker.template next<uint8_t>());
 
 		case MSGPACK_UINT16:
-			return result += to_string(unpacker.template next<uint16_t>());
+			return append_integer_to(result, (uint64_t)unpacker.template next<uint16_t>());
 
 		case MSGPACK_UINT32:
-			return result += to_string(unpacker.template next<uint32_t>());
+			return append_integer_to(result, (uint64_t)unpacker.template next<uint32_t>());
 
 		case MSGPACK_UINT64:
-			return result += to_string(unpacker.template next<uint64_t>());
+			return append_integer_to(result, (uint64_t)unpacker.template next<uint64_t>());
 
 		case MSGPACK_INT8:
-			return result += to_string((int)unpacker.template next<int8_t>()); // up-cast as above
+			return append_integer_to(result, (int64_t)unpacker.template next<int8_t>());
 
 		case MSGPACK_INT16:
-			return result += to_string(unpacker.template next<int16_t>());
+			return append_integer_to(result, (int64_t)unpacker.template next<int16_t>());
 
 		case MSGPACK_INT32:
-			return result += to_string(unpacker.template next<int32_t>());
+			return append_integer_to(result, (int64_t)unpacker.template next<int32_t>());
 
 		case MSGPACK_INT64:
-			return result += to_string(unpacker.template next<int64_t>());
+			return append_integer_to(result, (int64_t)unpacker.template next<int64_t>());
 
 		case MSGPACK_FLOAT: {
 			if (sizeof(float) != sizeof(uint32_t)) throw unpacker_error("Can't convert float to/from network byte order on this platform");
@@ -70,9 +89,13 @@ string &sql_encode_and_append_packed_value_to(string &result, DatabaseClient &cl
 			return result += to_string(dcopy);
 		}
 
-		default:
-			client.append_quoted_column_value_to(result, column, unpacker.template next<string>());
+		default: {
+			// quote straight from the packed bytes rather than unpacking them into a temporary string first
+			size_t length = unpacker.next_raw_length();
+			client.append_quoted_column_value_to(result, column, (const char *)stream.data, length);
+			stream.data += length;
 			return result;
+		}
 	}
 }
 
@@ -82,4 +105,10 @@ string &sql_encode_and_append_packed_value_to(string &result, DatabaseClient &cl
 	return sql_encode_and_append_packed_value_to(result, client, column, stream);
 }
 
+template <typename DatabaseClient>
+string &sql_encode_and_append_packed_value_to(string &result, DatabaseClient &client, const Column &column, const PackedValueView &value) {
+	PackedValueReadStream stream(value.data());
+	return sql_encode_and_append_packed_value_to(result, client, column, stream);
+}
+
 #endif
@@ -38,6 +38,7 @@ int endpoint_main(int argc, char *argv[]) {
 		string database_username(getenv_default("ENDPOINT_DATABASE_USERNAME", ""));
 		string database_password(getenv_default("ENDPOINT_DATABASE_PASSWORD", ""));
 		string set_variables(getenv_default("ENDPOINT_SET_VARIABLES", ""));
+		int hash_threads = getenv_default("ENDPOINT_HASH_THREADS", 1);
 
 		if (from) {
 			// for backwards compatibility, we currently support receiving positional arguments to the 'from'
@@ -63,7 +64,7 @@ int endpoint_main(int argc, char *argv[]) {
 			char *end_of_last_arg = last_arg + strlen(last_arg);
 			size_t status_size = end_of_last_arg - status_area;
 
-			sync_from<DatabaseClient>(database_host, database_port, database_username, database_password, database_name, database_schema, set_variables, STDIN_FILENO, STDOUT_FILENO, status_area, status_size);
+			sync_from<DatabaseClient>(database_host, database_port, database_username, database_password, database_name, database_schema, set_variables, hash_threads, STDIN_FILENO, STDOUT_FILENO, status_area, status_size);
 		} else {
 			// the 'to' endpoint has already been converted to pass options using environment variables -
 			// since it's always on the same system as the ks command, it doesn't need legacy support.
@@ -82,8 +83,22 @@ int endpoint_main(int argc, char *argv[]) {
 			size_t target_minimum_block_size = getenv_default("ENDPOINT_TARGET_MINIMUM_BLOCK_SIZE", DEFAULT_MINIMUM_BLOCK_SIZE); // only set by tests
 			size_t target_maximum_block_size = getenv_default("ENDPOINT_TARGET_MAXIMUM_BLOCK_SIZE", DEFAULT_MAXIMUM_BLOCK_SIZE); // not currently used except manual testing
 			bool structure_only = getenv_default("ENDPOINT_STRUCTURE_ONLY", false);
+			bool defer_indexes = getenv_default("ENDPOINT_DEFER_INDEXES", false);
+			bool hash_keys_first = getenv_default("ENDPOINT_HASH_KEYS_FIRST", false);
+			string state_file(getenv_default("ENDPOINT_STATE_FILE", ""));
+			string journal_file(getenv_default("ENDPOINT_JOURNAL_FILE", ""));
+			bool resume = getenv_default("ENDPOINT_RESUME", false);
+			string report_file(getenv_default("ENDPOINT_REPORT_FILE", "")); // only set by tests, since they use our stdout for the protocol
+			set <string> keys_only(split_list(getenv_default("ENDPOINT_KEYS_ONLY_TABLES", "")));
+			string catch_up_slot(getenv_default("ENDPOINT_CATCH_UP_SLOT", ""));
+			bool digest_small_tables = getenv_default("ENDPOINT_DIGEST_SMALL_TABLES", false);
+			bool skip_unchanged_tables = getenv_default("ENDPOINT_SKIP_UNCHANGED_TABLES", false);
+			time_t verify_interval = getenv_default("ENDPOINT_VERIFY_INTERVAL", DEFAULT_VERIFY_INTERVAL_HOURS)*60*60;
+			bool auto_reload = getenv_default("ENDPOINT_AUTO_RELOAD", false);
+			string verify_sample(getenv_default("ENDPOINT_VERIFY_SAMPLE", ""));
+			bool verify = getenv_default("ENDPOINT_VERIFY", false) || !verify_sample.empty();
 
-			sync_to<DatabaseClient>(workers, startfd, database_host, database_port, database_username, database_password, database_name, database_schema, set_variables, filters_file, ignore, only, verbose, progress, snapshot, alter, commit_level, hash_algorithm, target_minimum_block_size, target_maximum_block_size, structure_only);
+			sync_to<DatabaseClient>(workers, hash_threads, state_file, journal_file, resume, report_file, startfd, database_host, database_port, database_username, database_password, database_name, database_schema, set_variables, filters_file, ignore, only, verbose, progress, snapshot, alter, commit_level, hash_algorithm, target_minimum_block_size, target_maximum_block_size, structure_only, defer_indexes, hash_keys_first, keys_only, catch_up_slot, digest_small_tables, skip_unchanged_tables, verify_interval, auto_reload, verify, verify_sample);
 		}
 	} catch (const sync_error& e) {
 		// the worker thread has already output the error to cerr
@@ -2,7 +2,9 @@
 #define FDSTREAM_H
 
 #include <unistd.h>
+#include <stdlib.h>
 #include <stdexcept>
+#include <new>
 
 struct stream_error: public std::runtime_error {
 	stream_error(const std::string &error): runtime_error(error) {}
@@ -13,10 +15,16 @@ struct stream_closed_error: public stream_error {
 };
 
 struct FDReadStream {
-	FDReadStream(int fd): fd(fd), buf_pos(0), buf_avail(0) {}
+	static const size_t INITIAL_BUFFER_SIZE = 64*1024;
+
+	FDReadStream(int fd): fd(fd), buf_size(INITIAL_BUFFER_SIZE), buf_pos(0), buf_avail(0), pinned(false), pin_pos(0) {
+		buf = (uint8_t *)malloc(buf_size);
+		if (!buf) throw std::bad_alloc();
+	}
 
 	~FDReadStream() {
 		close();
+		free(buf);
 	}
 
 	void close() {
@@ -32,6 +40,8 @@ struct FDReadStream {
 			memcpy(dest, buf + buf_pos, buf_avail);
 			dest  += buf_avail;
 			bytes -= buf_avail;
+			buf_pos += buf_avail;
+			buf_avail = 0;
 			populate_buf();
 		}
 		memcpy(dest, buf + buf_pos, bytes);
@@ -42,21 +52,52 @@ struct FDReadStream {
 	inline void skip(size_t bytes) {
 		while (bytes > buf_avail) {
 			bytes -= buf_avail;
+			buf_pos += buf_avail;
+			buf_avail = 0;
 			populate_buf();
 		}
 		buf_pos   += bytes;
 		buf_avail -= bytes;
 	}
 
+	// while pinned, all the bytes read from the stream since the call to pin() are kept contiguous in our buffer
+	// (which grows if necessary), so that callers can refer to them in place rather than copying them out.  the
+	// pointer returned by pinned_data() is only valid until the next read or skip, since those may move the bytes.
+	inline void pin() {
+		pinned = true;
+		pin_pos = buf_pos;
+	}
+
+	inline void unpin() {
+		pinned = false;
+	}
+
+	inline const uint8_t *pinned_data() const { return buf + pin_pos; }
+	inline size_t pinned_bytes() const { return buf_pos - pin_pos; }
+
 protected:
-	// attempts to populate at least some bytes in buf, which is assumed to be completely empty.
-	// sets buf_pos to 0, and buf_avail to the number of bytes present in the buffer, even if an
-	// error occurs.
+	// attempts to populate at least some more bytes in buf, all of which is assumed to have been consumed.
+	// sets buf_avail to the number of bytes read, even if an error occurs.
 	void populate_buf() {
+		if (pinned) {
+			// move the pinned bytes to the start of the buffer, and make more room if it's already full of them
+			size_t bytes_to_keep = buf_pos - pin_pos;
+			if (bytes_to_keep == buf_size) {
+				resize_buf(buf_size*2);
+			} else if (pin_pos > 0) {
+				memmove(buf, buf + pin_pos, bytes_to_keep);
+			}
+			pin_pos = 0;
+			buf_pos = bytes_to_keep;
+		} else {
+			// don't hang on to an oversize buffer once we no longer need it for a pinned row
+			if (buf_size > INITIAL_BUFFER_SIZE) resize_buf(INITIAL_BUFFER_SIZE);
+			buf_pos = 0;
+		}
+
 		ssize_t bytes_read;
-		buf_pos = 0;
 		while (true) {
-			bytes_read = ::read(fd, buf, sizeof(buf));
+			bytes_read = ::read(fd, buf + buf_pos, buf_size - buf_pos);
 			if (bytes_read == 0) {
 				buf_avail = 0;
 				throw stream_closed_error();
@@ -71,9 +112,19 @@ protected:
 		}
 	}
 
+	void resize_buf(size_t new_size) {
+		uint8_t *new_buf = (uint8_t *)realloc(buf, new_size);
+		if (!new_buf) throw std::bad_alloc();
+		buf = new_buf;
+		buf_size = new_size;
+	}
+
 	int fd;
+	uint8_t *buf;
+	size_t buf_size;
 	size_t buf_pos, buf_avail;
-	uint8_t buf[16384];
+	bool pinned;
+	size_t pin_pos;
 };
 
 struct FDWriteStream {
@@ -45,10 +45,23 @@ void load_filter_map(const string &table_name, TableFilter &table_filter, const
 		} else if (action_it->first.as<string>() == "only") {
 			load_filter_rows(table_name, table_filter, action_it->second);
 
+		} else if (action_it->first.as<string>() == "changes_tracked_by") {
+			table_filter.changes_tracked_by = action_it->second.as<string>();
+
+		} else if (action_it->first.as<string>() == "strategy") {
+			table_filter.strategy = action_it->second.as<string>();
+			if (table_filter.strategy != "diff" && table_filter.strategy != "reload" && table_filter.strategy != "rebuild" && table_filter.strategy != "auto") {
+				throw filter_definition_error("Don't know how to sync table '" + table_name + "' using the '" + table_filter.strategy + "' strategy");
+			}
+
 		} else {
 			throw filter_definition_error("Don't how to filter table '" + table_name + "'; action given: " + to_string(action_it->first));
 		}
 	}
+
+	if (table_filter.filter_expressions.count(table_filter.changes_tracked_by)) {
+		throw filter_definition_error("Can't track changes to table '" + table_name + "' using column '" + table_filter.changes_tracked_by + "' because its values are replaced");
+	}
 }
 
 TableFilters load_filters(const string &filters_file) {
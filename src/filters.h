@@ -16,6 +16,8 @@ struct filter_definition_error: public runtime_error {
 struct TableFilter {
 	string where_conditions;
 	map<string, string> filter_expressions;
+	string changes_tracked_by; // only used at the 'to' end, so not sent to the 'from' end
+	string strategy; // likewise; empty if not given
 };
 
 typedef map<string, TableFilter> TableFilters;
@@ -7,6 +7,13 @@ enum class HashAlgorithm {
 	md5 = 0,
 	xxh64 = 1,
 	blake3 = 2,
+	xxh3_128 = 3,
+	xxh3_128_rows = 4,
 };
 
+// the HASH_KEYS command hashes the key values of a range in one go, even when rows are hashed one at a time
+inline HashAlgorithm key_hash_algorithm(HashAlgorithm hash_algorithm) {
+	return (hash_algorithm == HashAlgorithm::xxh3_128_rows ? HashAlgorithm::xxh3_128 : hash_algorithm);
+}
+
 #endif
@@ -0,0 +1,65 @@
+#include "hash_thread_pool.h"
+
+HashThreadPool::HashThreadPool(size_t size): stopping(false) {
+	for (size_t n = 1; n < size; n++) {
+		threads.emplace_back(&HashThreadPool::work, this);
+	}
+}
+
+HashThreadPool::~HashThreadPool() {
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		stopping = true;
+		work_available.notify_all();
+	}
+	for (std::thread &thread : threads) thread.join();
+}
+
+void HashThreadPool::run(size_t tasks, const std::function<void(size_t)> &task) {
+	if (tasks == 0) return;
+
+	Job job(tasks, task);
+	std::unique_lock<std::mutex> lock(mutex);
+	if (!threads.empty()) {
+		jobs.push_back(&job);
+		work_available.notify_all();
+	}
+
+	// do as many of the tasks as we can ourselves, then wait for the threads to finish any others they took
+	while (job.next_task < job.tasks) {
+		run_task(job, lock);
+	}
+	while (job.finished_tasks < job.tasks) {
+		work_finished.wait(lock);
+	}
+}
+
+void HashThreadPool::work() {
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		if (stopping) return;
+		if (jobs.empty()) {
+			work_available.wait(lock);
+		} else {
+			run_task(*jobs.front(), lock);
+		}
+	}
+}
+
+void HashThreadPool::run_task(Job &job, std::unique_lock<std::mutex> &lock) {
+	size_t task_number = job.next_task++;
+	if (job.next_task == job.tasks) {
+		// all the tasks have been taken, so other threads should move on to the next job
+		for (auto it = jobs.begin(); it != jobs.end(); ++it) {
+			if (*it == &job) { jobs.erase(it); break; }
+		}
+	}
+
+	lock.unlock();
+	job.task(task_number);
+	lock.lock();
+
+	if (++job.finished_tasks == job.tasks) {
+		work_finished.notify_all();
+	}
+}
@@ -0,0 +1,44 @@
+#ifndef HASH_THREAD_POOL_H
+#define HASH_THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// a fixed set of threads that hashers can hand independent pieces of work to, shared by all the workers in the
+// process.  the thread that asks for the work to be done also takes its share, so a pool of size 1 has no threads
+// of its own and simply runs everything on the caller's thread.
+struct HashThreadPool {
+	HashThreadPool(size_t size);
+	~HashThreadPool();
+
+	inline size_t size() const { return threads.size() + 1; }
+
+	// runs task(0) to task(tasks - 1), which must not throw, and returns once they have all finished
+	void run(size_t tasks, const std::function<void(size_t)> &task);
+
+protected:
+	struct Job {
+		Job(size_t tasks, const std::function<void(size_t)> &task): tasks(tasks), task(task), next_task(0), finished_tasks(0) {}
+
+		size_t tasks;
+		const std::function<void(size_t)> &task;
+		size_t next_task;
+		size_t finished_tasks;
+	};
+
+	void work();
+	void run_task(Job &job, std::unique_lock<std::mutex> &lock);
+
+	std::mutex mutex;
+	std::condition_variable work_available;
+	std::condition_variable work_finished;
+	std::deque<Job*> jobs;
+	std::vector<std::thread> threads;
+	bool stopping;
+};
+
+#endif
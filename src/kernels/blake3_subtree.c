@@ -0,0 +1,43 @@
+#include "kernels_impl.h"
+#include "../blake3/blake3_impl.h"
+
+void ks_blake3_subtree_cv(const blake3_hasher *hasher, const uint8_t *input, size_t chunks, uint64_t chunk_counter, uint8_t cv[BLAKE3_OUT_LEN]) {
+	const uint8_t *inputs[KS_BLAKE3_MAX_SUBTREE_CHUNKS];
+	uint8_t cvs[2][KS_BLAKE3_MAX_SUBTREE_CHUNKS*BLAKE3_OUT_LEN];
+	size_t level = 0;
+
+	// hash all the chunks, which uses the widest SIMD implementation available
+	for (size_t n = 0; n < chunks; n++) inputs[n] = input + n*BLAKE3_CHUNK_LEN;
+	blake3_hash_many(inputs, chunks, BLAKE3_CHUNK_LEN/BLAKE3_BLOCK_LEN, hasher->key, chunk_counter, true, hasher->chunk.flags, CHUNK_START, CHUNK_END, cvs[level]);
+
+	// then combine pairs of chaining values into parent nodes until we get to the top of the subtree, which isn't
+	// the root node of the whole tree since our caller always has more input to come
+	while (chunks > 1) {
+		chunks /= 2;
+		for (size_t n = 0; n < chunks; n++) inputs[n] = cvs[level] + n*BLAKE3_BLOCK_LEN;
+		blake3_hash_many(inputs, chunks, 1, hasher->key, 0, false, hasher->chunk.flags | PARENT, 0, 0, cvs[!level]);
+		level = !level;
+	}
+
+	memcpy(cv, cvs[level], BLAKE3_OUT_LEN);
+}
+
+void ks_blake3_push_subtree_cv(blake3_hasher *hasher, const uint8_t cv[BLAKE3_OUT_LEN], size_t chunks) {
+	// merge the stack the same way as hasher_push_cv and hasher_merge_cv_stack in blake3.c, which leave the chaining
+	// value added last unmerged so that the root node is never merged until the hasher is finalized
+	size_t post_merge_stack_len = (size_t)popcnt(hasher->chunk.chunk_counter);
+	while (hasher->cv_stack_len > post_merge_stack_len) {
+		uint8_t *parent_node = &hasher->cv_stack[(hasher->cv_stack_len - 2)*BLAKE3_OUT_LEN];
+		uint32_t parent_cv[8];
+		memcpy(parent_cv, hasher->key, sizeof(parent_cv));
+		blake3_compress_in_place(parent_cv, parent_node, BLAKE3_BLOCK_LEN, 0, hasher->chunk.flags | PARENT);
+		store_cv_words(parent_node, parent_cv);
+		hasher->cv_stack_len -= 1;
+	}
+
+	memcpy(&hasher->cv_stack[hasher->cv_stack_len*BLAKE3_OUT_LEN], cv, BLAKE3_OUT_LEN);
+	hasher->cv_stack_len += 1;
+
+	// the chunk state is empty, so it's ready to start on the chunk after the subtree
+	hasher->chunk.chunk_counter += chunks;
+}
@@ -0,0 +1,59 @@
+#ifndef KS_KERNELS_H
+#define KS_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../blake3/blake3.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// the kernels below are used on the hot paths that build up SQL statements and read result rows.  each has a portable version and
+// vectorised versions for the instruction sets supported by the compiler, and the best version supported by
+// the CPU is chosen at runtime.  all write to a caller-supplied buffer and return the number of bytes written.
+
+// escapes single quotes by doubling them, as per the SQL standard, and optionally also doubles backslashes (for
+// PostgreSQL when standard_conforming_strings is off).  dest must have room for length*2 bytes.  only suitable
+// for single-byte character encodings and multibyte encodings that never use ' or \ as a trailing byte.
+size_t ks_quote_escape(const char *src, size_t length, char *dest, int escape_backslashes);
+
+// escapes the characters that MySQL's mysql_real_escape_string escapes when NO_BACKSLASH_ESCAPES is not on and the
+// connection uses the binary character set, ie. NUL, \n, \r, \, ', " and ctrl-Z.  dest must have room for length*2.
+size_t ks_backslash_escape(const char *src, size_t length, char *dest);
+
+// encodes the bytes as lowercase hex.  dest must have room for length*2 bytes, which is always what is written.
+size_t ks_hex_encode(const uint8_t *src, size_t length, char *dest);
+
+// decodes the hex string, which must have an even length, into length/2 bytes; accepts both upper and lowercase.
+// returns 1 if successful, or 0 if any non-hex characters were found, in which case dest has undefined contents.
+int ks_hex_decode(const char *src, size_t length, uint8_t *dest);
+
+// add to and finish XXH3-128 hash states created and reset using xxHash's own API.  xxhash.c is built for the baseline
+// instruction set (SSE2 on x86-64), so these use a second build of its accumulation loop when the CPU has AVX2.  the
+// digest is written in xxHash's canonical (big-endian) form.
+struct XXH3_state_s;
+void ks_xxh3_128_update(struct XXH3_state_s *state, const void *input, size_t length);
+void ks_xxh3_128_digest(const struct XXH3_state_s *state, uint8_t dest[16]);
+
+// BLAKE3 hashes inputs as a binary tree of 1 KB chunks, so whole subtrees can be hashed independently on different
+// threads and their chaining values put back together in order without changing the digest.  ks_blake3_subtree_cv
+// hashes a power-of-2 number of chunks (at most KS_BLAKE3_MAX_SUBTREE_CHUNKS) starting at the given chunk number,
+// which must be a multiple of the number of chunks.  ks_blake3_push_subtree_cv then adds the result to the hasher
+// as if it had hashed the input itself, which is only valid if no input has been given to blake3_hasher_update
+// since the last subtree was pushed (so that it has no partial chunk), and more input is definitely still to come.
+#define KS_BLAKE3_MAX_SUBTREE_CHUNKS 256
+void ks_blake3_subtree_cv(const blake3_hasher *hasher, const uint8_t *input, size_t chunks, uint64_t chunk_counter, uint8_t cv[BLAKE3_OUT_LEN]);
+void ks_blake3_push_subtree_cv(blake3_hasher *hasher, const uint8_t cv[BLAKE3_OUT_LEN], size_t chunks);
+
+// for tests and benchmarks: selects the named implementation ("portable", "sse42", or "avx2"), returning 0 and
+// leaving the selection unchanged if that implementation isn't compiled in or isn't supported by this CPU
+int ks_kernels_select(const char *name);
+const char *ks_kernels_selected(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,115 @@
+#include "kernels_impl.h"
+#include <immintrin.h>
+
+// as for the SSE4.2 versions, but 32 bytes at a time
+
+size_t ks_quote_escape_avx2(const char *src, size_t length, char *dest, int escape_backslashes) {
+	const __m256i quotes = _mm256_set1_epi8('\'');
+	const __m256i backslashes = _mm256_set1_epi8(escape_backslashes ? '\\' : '\'');
+	char *start = dest;
+
+	while (length >= 32) {
+		__m256i block = _mm256_loadu_si256((const __m256i *)src);
+		__m256i matches = _mm256_or_si256(_mm256_cmpeq_epi8(block, quotes), _mm256_cmpeq_epi8(block, backslashes));
+		unsigned mask = _mm256_movemask_epi8(matches);
+		_mm256_storeu_si256((__m256i *)dest, block);
+		if (mask) {
+			// keep the bytes before the first character that needs escaping, and carry on straight after it
+			size_t clear = __builtin_ctz(mask);
+			dest += clear;
+			dest += ks_quote_escape_scalar(src + clear, 1, dest, escape_backslashes);
+			src += clear + 1;
+			length -= clear + 1;
+		} else {
+			dest += 32;
+			src += 32;
+			length -= 32;
+		}
+	}
+
+	dest += ks_quote_escape_scalar(src, length, dest, escape_backslashes);
+	return dest - start;
+}
+
+size_t ks_backslash_escape_avx2(const char *src, size_t length, char *dest) {
+	const __m256i nuls = _mm256_setzero_si256();
+	const __m256i newlines = _mm256_set1_epi8('\n');
+	const __m256i returns = _mm256_set1_epi8('\r');
+	const __m256i backslashes = _mm256_set1_epi8('\\');
+	const __m256i quotes = _mm256_set1_epi8('\'');
+	const __m256i double_quotes = _mm256_set1_epi8('"');
+	const __m256i ctrl_zs = _mm256_set1_epi8('\032');
+	char *start = dest;
+
+	while (length >= 32) {
+		__m256i block = _mm256_loadu_si256((const __m256i *)src);
+		__m256i matches = _mm256_or_si256(
+			_mm256_or_si256(
+				_mm256_or_si256(_mm256_cmpeq_epi8(block, nuls), _mm256_cmpeq_epi8(block, newlines)),
+				_mm256_or_si256(_mm256_cmpeq_epi8(block, returns), _mm256_cmpeq_epi8(block, backslashes))),
+			_mm256_or_si256(
+				_mm256_or_si256(_mm256_cmpeq_epi8(block, quotes), _mm256_cmpeq_epi8(block, double_quotes)),
+				_mm256_cmpeq_epi8(block, ctrl_zs)));
+		unsigned mask = _mm256_movemask_epi8(matches);
+		_mm256_storeu_si256((__m256i *)dest, block);
+		if (mask) {
+			size_t clear = __builtin_ctz(mask);
+			dest += clear;
+			dest += ks_backslash_escape_scalar(src + clear, 1, dest);
+			src += clear + 1;
+			length -= clear + 1;
+		} else {
+			dest += 32;
+			src += 32;
+			length -= 32;
+		}
+	}
+
+	dest += ks_backslash_escape_scalar(src, length, dest);
+	return dest - start;
+}
+
+size_t ks_hex_encode_avx2(const uint8_t *src, size_t length, char *dest) {
+	const __m256i digits = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)ks_hex_digits));
+	const __m256i low_nibbles = _mm256_set1_epi8(15);
+	size_t n = 0;
+
+	for (; n + 32 <= length; n += 32) {
+		__m256i block = _mm256_loadu_si256((const __m256i *)(src + n));
+		__m256i hi = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(block, 4), low_nibbles));
+		__m256i lo = _mm256_shuffle_epi8(digits, _mm256_and_si256(block, low_nibbles));
+
+		// the unpack instructions work within each 128-bit lane, so we have to put the lanes back in order
+		__m256i first  = _mm256_unpacklo_epi8(hi, lo); // bytes 0-7 and 16-23
+		__m256i second = _mm256_unpackhi_epi8(hi, lo); // bytes 8-15 and 24-31
+		_mm256_storeu_si256((__m256i *)(dest + 2*n),      _mm256_permute2x128_si256(first, second, 0x20));
+		_mm256_storeu_si256((__m256i *)(dest + 2*n + 32), _mm256_permute2x128_si256(first, second, 0x31));
+	}
+
+	ks_hex_encode_scalar(src + n, length - n, dest + 2*n);
+	return length*2;
+}
+
+static inline __m256i hex_nibbles_avx2(__m256i chars, int *valid) {
+	__m256i lower = _mm256_or_si256(chars, _mm256_set1_epi8(0x20));
+	__m256i is_digit = _mm256_andnot_si256(_mm256_cmpgt_epi8(chars, _mm256_set1_epi8('9')), _mm256_cmpgt_epi8(chars, _mm256_set1_epi8('0' - 1)));
+	__m256i is_letter = _mm256_andnot_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('f')), _mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)));
+	*valid &= (_mm256_movemask_epi8(_mm256_or_si256(is_digit, is_letter)) == -1);
+	return _mm256_blendv_epi8(_mm256_sub_epi8(lower, _mm256_set1_epi8('a' - 10)), _mm256_sub_epi8(chars, _mm256_set1_epi8('0')), is_digit);
+}
+
+int ks_hex_decode_avx2(const char *src, size_t length, uint8_t *dest) {
+	const __m256i weights = _mm256_set1_epi16(0x0110);
+	int valid = 1;
+	size_t n = 0;
+
+	for (; n + 64 <= length; n += 64) {
+		__m256i first  = _mm256_maddubs_epi16(hex_nibbles_avx2(_mm256_loadu_si256((const __m256i *)(src + n)),      &valid), weights);
+		__m256i second = _mm256_maddubs_epi16(hex_nibbles_avx2(_mm256_loadu_si256((const __m256i *)(src + n + 32)), &valid), weights);
+
+		// again the pack instruction works within each 128-bit lane, so we have to put the 64-bit quarters back in order
+		_mm256_storeu_si256((__m256i *)(dest + n/2), _mm256_permute4x64_epi64(_mm256_packus_epi16(first, second), 0xd8));
+	}
+
+	return ks_hex_decode_scalar(src + n, length - n, dest + n/2) && valid;
+}
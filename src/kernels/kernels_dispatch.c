@@ -0,0 +1,143 @@
+#include <stdatomic.h>
+
+#include "kernels_impl.h"
+
+#define XXH_STATIC_LINKING_ONLY
+#include "../xxHash/xxhash.h"
+
+enum ks_kernel_level {
+	KS_KERNELS_UNDETECTED = 0,
+	KS_KERNELS_PORTABLE,
+	KS_KERNELS_SSE42,
+	KS_KERNELS_AVX2,
+};
+
+// the worker threads may all call in before the level has been detected.  the detection is idempotent, so it doesn't
+// matter if more than one of them does it the first time, but the level must be atomic so that they don't race to use it.
+static _Atomic enum ks_kernel_level g_kernel_level = KS_KERNELS_UNDETECTED;
+
+static enum ks_kernel_level detect_kernel_level(void) {
+#if defined(KS_KERNELS_IS_X86) && defined(__GNUC__)
+	__builtin_cpu_init();
+#if !defined(KS_KERNELS_NO_AVX2)
+	if (__builtin_cpu_supports("avx2")) return KS_KERNELS_AVX2;
+#endif
+#if !defined(KS_KERNELS_NO_SSE42)
+	if (__builtin_cpu_supports("sse4.2")) return KS_KERNELS_SSE42;
+#endif
+#endif
+	return KS_KERNELS_PORTABLE;
+}
+
+static inline enum ks_kernel_level kernel_level(void) {
+	enum ks_kernel_level level = atomic_load_explicit(&g_kernel_level, memory_order_relaxed);
+	if (level == KS_KERNELS_UNDETECTED) {
+		level = detect_kernel_level();
+		atomic_store_explicit(&g_kernel_level, level, memory_order_relaxed);
+	}
+	return level;
+}
+
+int ks_hex_decode(const char *src, size_t length, uint8_t *dest) {
+	switch (kernel_level()) {
+#if defined(KS_KERNELS_IS_X86) && !defined(KS_KERNELS_NO_AVX2)
+		case KS_KERNELS_AVX2:
+			return ks_hex_decode_avx2(src, length, dest);
+#endif
+#if defined(KS_KERNELS_IS_X86) && !defined(KS_KERNELS_NO_SSE42)
+		case KS_KERNELS_SSE42:
+			return ks_hex_decode_sse42(src, length, dest);
+#endif
+		default:
+			return ks_hex_decode_portable(src, length, dest);
+	}
+}
+
+static const char *kernel_level_names[] = { "undetected", "portable", "sse42", "avx2" };
+
+int ks_kernels_select(const char *name) {
+	enum ks_kernel_level best = detect_kernel_level();
+	for (int level = KS_KERNELS_PORTABLE; level <= best; level++) {
+		if (strcmp(name, kernel_level_names[level]) == 0) {
+#if defined(KS_KERNELS_NO_SSE42)
+			if (level == KS_KERNELS_SSE42) return 0;
+#endif
+			atomic_store_explicit(&g_kernel_level, (enum ks_kernel_level)level, memory_order_relaxed);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+const char *ks_kernels_selected(void) {
+	return kernel_level_names[kernel_level()];
+}
+
+size_t ks_quote_escape(const char *src, size_t length, char *dest, int escape_backslashes) {
+	switch (kernel_level()) {
+#if defined(KS_KERNELS_IS_X86) && !defined(KS_KERNELS_NO_AVX2)
+		case KS_KERNELS_AVX2:
+			return ks_quote_escape_avx2(src, length, dest, escape_backslashes);
+#endif
+#if defined(KS_KERNELS_IS_X86) && !defined(KS_KERNELS_NO_SSE42)
+		case KS_KERNELS_SSE42:
+			return ks_quote_escape_sse42(src, length, dest, escape_backslashes);
+#endif
+		default:
+			return ks_quote_escape_portable(src, length, dest, escape_backslashes);
+	}
+}
+
+size_t ks_backslash_escape(const char *src, size_t length, char *dest) {
+	switch (kernel_level()) {
+#if defined(KS_KERNELS_IS_X86) && !defined(KS_KERNELS_NO_AVX2)
+		case KS_KERNELS_AVX2:
+			return ks_backslash_escape_avx2(src, length, dest);
+#endif
+#if defined(KS_KERNELS_IS_X86) && !defined(KS_KERNELS_NO_SSE42)
+		case KS_KERNELS_SSE42:
+			return ks_backslash_escape_sse42(src, length, dest);
+#endif
+		default:
+			return ks_backslash_escape_portable(src, length, dest);
+	}
+}
+
+size_t ks_hex_encode(const uint8_t *src, size_t length, char *dest) {
+	switch (kernel_level()) {
+#if defined(KS_KERNELS_IS_X86) && !defined(KS_KERNELS_NO_AVX2)
+		case KS_KERNELS_AVX2:
+			return ks_hex_encode_avx2(src, length, dest);
+#endif
+#if defined(KS_KERNELS_IS_X86) && !defined(KS_KERNELS_NO_SSE42)
+		case KS_KERNELS_SSE42:
+			return ks_hex_encode_sse42(src, length, dest);
+#endif
+		default:
+			return ks_hex_encode_portable(src, length, dest);
+	}
+}
+
+void ks_xxh3_128_update(struct XXH3_state_s *state, const void *input, size_t length) {
+	switch (kernel_level()) {
+#if defined(KS_KERNELS_IS_X86) && !defined(KS_KERNELS_NO_AVX2)
+		case KS_KERNELS_AVX2:
+			ks_xxh3_128_update_avx2(state, input, length);
+			break;
+#endif
+		default:
+			XXH3_128bits_update(state, input, length);
+	}
+}
+
+void ks_xxh3_128_digest(const struct XXH3_state_s *state, uint8_t dest[16]) {
+	switch (kernel_level()) {
+#if defined(KS_KERNELS_IS_X86) && !defined(KS_KERNELS_NO_AVX2)
+		case KS_KERNELS_AVX2:
+			ks_xxh3_128_digest_avx2(state, dest);
+			break;
+#endif
+		default:
+			XXH128_canonicalFromHash((XXH128_canonical_t *)dest, XXH3_128bits_digest(state));
+	}
+}
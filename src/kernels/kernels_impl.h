@@ -0,0 +1,94 @@
+#ifndef KS_KERNELS_IMPL_H
+#define KS_KERNELS_IMPL_H
+
+#include <string.h>
+#include "kernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define KS_KERNELS_IS_X86
+#endif
+
+static const char ks_hex_digits[] = "0123456789abcdef";
+
+// scalar versions of the kernels, used by the portable implementation and to finish off the tails and any blocks
+// with characters that need escaping in the vectorised implementations
+
+static inline size_t ks_quote_escape_scalar(const char *src, size_t length, char *dest, int escape_backslashes) {
+	char *start = dest;
+	for (const char *end = src + length; src < end; src++) {
+		char c = *src;
+		if (c == '\'' || (c == '\\' && escape_backslashes)) *dest++ = c;
+		*dest++ = c;
+	}
+	return dest - start;
+}
+
+static inline size_t ks_backslash_escape_scalar(const char *src, size_t length, char *dest) {
+	char *start = dest;
+	for (const char *end = src + length; src < end; src++) {
+		char c = *src;
+		switch (c) {
+			case '\0':   *dest++ = '\\'; *dest++ = '0';  break;
+			case '\n':   *dest++ = '\\'; *dest++ = 'n';  break;
+			case '\r':   *dest++ = '\\'; *dest++ = 'r';  break;
+			case '\\':   *dest++ = '\\'; *dest++ = '\\'; break;
+			case '\'':   *dest++ = '\\'; *dest++ = '\''; break;
+			case '"':    *dest++ = '\\'; *dest++ = '"';  break;
+			case '\032': *dest++ = '\\'; *dest++ = 'Z';  break;
+			default:     *dest++ = c;
+		}
+	}
+	return dest - start;
+}
+
+static inline size_t ks_hex_encode_scalar(const uint8_t *src, size_t length, char *dest) {
+	for (size_t n = 0; n < length; n++) {
+		dest[2*n]     = ks_hex_digits[src[n] >> 4];
+		dest[2*n + 1] = ks_hex_digits[src[n] & 15];
+	}
+	return length*2;
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static inline int ks_hex_decode_scalar(const char *src, size_t length, uint8_t *dest) {
+	int valid = 1;
+	for (size_t n = 0; n + 1 < length; n += 2) {
+		unsigned hi = (unsigned char)src[n], lo = (unsigned char)src[n + 1];
+		unsigned hi_digit = hi - '0', hi_letter = (hi | 0x20) - 'a';
+		unsigned lo_digit = lo - '0', lo_letter = (lo | 0x20) - 'a';
+		valid &= (hi_digit <= 9 || hi_letter <= 5) & (lo_digit <= 9 || lo_letter <= 5);
+		*dest++ = (uint8_t)(((hi_digit <= 9 ? hi_digit : hi_letter + 10) << 4) | (lo_digit <= 9 ? lo_digit : lo_letter + 10));
+	}
+	return valid && (length % 2 == 0);
+}
+
+size_t ks_quote_escape_portable(const char *src, size_t length, char *dest, int escape_backslashes);
+size_t ks_backslash_escape_portable(const char *src, size_t length, char *dest);
+size_t ks_hex_encode_portable(const uint8_t *src, size_t length, char *dest);
+int ks_hex_decode_portable(const char *src, size_t length, uint8_t *dest);
+
+#if defined(KS_KERNELS_IS_X86)
+#if !defined(KS_KERNELS_NO_SSE42)
+size_t ks_quote_escape_sse42(const char *src, size_t length, char *dest, int escape_backslashes);
+size_t ks_backslash_escape_sse42(const char *src, size_t length, char *dest);
+size_t ks_hex_encode_sse42(const uint8_t *src, size_t length, char *dest);
+int ks_hex_decode_sse42(const char *src, size_t length, uint8_t *dest);
+#endif
+#if !defined(KS_KERNELS_NO_AVX2)
+size_t ks_quote_escape_avx2(const char *src, size_t length, char *dest, int escape_backslashes);
+size_t ks_backslash_escape_avx2(const char *src, size_t length, char *dest);
+size_t ks_hex_encode_avx2(const uint8_t *src, size_t length, char *dest);
+int ks_hex_decode_avx2(const char *src, size_t length, uint8_t *dest);
+void ks_xxh3_128_update_avx2(struct XXH3_state_s *state, const void *input, size_t length);
+void ks_xxh3_128_digest_avx2(const struct XXH3_state_s *state, uint8_t dest[16]);
+#endif
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,17 @@
+#include "kernels_impl.h"
+
+size_t ks_quote_escape_portable(const char *src, size_t length, char *dest, int escape_backslashes) {
+	return ks_quote_escape_scalar(src, length, dest, escape_backslashes);
+}
+
+size_t ks_backslash_escape_portable(const char *src, size_t length, char *dest) {
+	return ks_backslash_escape_scalar(src, length, dest);
+}
+
+size_t ks_hex_encode_portable(const uint8_t *src, size_t length, char *dest) {
+	return ks_hex_encode_scalar(src, length, dest);
+}
+
+int ks_hex_decode_portable(const char *src, size_t length, uint8_t *dest) {
+	return ks_hex_decode_scalar(src, length, dest);
+}
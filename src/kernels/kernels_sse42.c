@@ -0,0 +1,101 @@
+#include "kernels_impl.h"
+#include <nmmintrin.h>
+
+// most values have few or no characters that need escaping, so we scan 16 bytes at a time and copy each block
+// straight through, then if there was a character needing escaping, rewind to just after it and carry on from there.
+// this never writes past the end of the output buffer, because each block has a corresponding block of spare output
+// space (the output buffer is twice the input size) that we haven't used yet.
+
+size_t ks_quote_escape_sse42(const char *src, size_t length, char *dest, int escape_backslashes) {
+	const __m128i quotes = _mm_set1_epi8('\'');
+	const __m128i backslashes = _mm_set1_epi8(escape_backslashes ? '\\' : '\'');
+	char *start = dest;
+
+	while (length >= 16) {
+		__m128i block = _mm_loadu_si128((const __m128i *)src);
+		__m128i matches = _mm_or_si128(_mm_cmpeq_epi8(block, quotes), _mm_cmpeq_epi8(block, backslashes));
+		unsigned mask = _mm_movemask_epi8(matches);
+		_mm_storeu_si128((__m128i *)dest, block);
+		if (mask) {
+			// keep the bytes before the first character that needs escaping, and carry on straight after it
+			size_t clear = __builtin_ctz(mask);
+			dest += clear;
+			dest += ks_quote_escape_scalar(src + clear, 1, dest, escape_backslashes);
+			src += clear + 1;
+			length -= clear + 1;
+		} else {
+			dest += 16;
+			src += 16;
+			length -= 16;
+		}
+	}
+
+	dest += ks_quote_escape_scalar(src, length, dest, escape_backslashes);
+	return dest - start;
+}
+
+size_t ks_backslash_escape_sse42(const char *src, size_t length, char *dest) {
+	// pcmpestri compares each byte against a set of up to 16 characters in one instruction
+	const __m128i specials = _mm_setr_epi8('\0', '\n', '\r', '\\', '\'', '"', '\032', 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	char *start = dest;
+
+	while (length >= 16) {
+		__m128i block = _mm_loadu_si128((const __m128i *)src);
+		size_t clear = _mm_cmpestri(specials, 7, block, 16, _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT);
+		_mm_storeu_si128((__m128i *)dest, block);
+		if (clear < 16) {
+			dest += clear;
+			dest += ks_backslash_escape_scalar(src + clear, 1, dest);
+			src += clear + 1;
+			length -= clear + 1;
+		} else {
+			dest += 16;
+			src += 16;
+			length -= 16;
+		}
+	}
+
+	dest += ks_backslash_escape_scalar(src, length, dest);
+	return dest - start;
+}
+
+size_t ks_hex_encode_sse42(const uint8_t *src, size_t length, char *dest) {
+	const __m128i digits = _mm_loadu_si128((const __m128i *)ks_hex_digits);
+	const __m128i low_nibbles = _mm_set1_epi8(15);
+	size_t n = 0;
+
+	for (; n + 16 <= length; n += 16) {
+		__m128i block = _mm_loadu_si128((const __m128i *)(src + n));
+		__m128i hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(block, 4), low_nibbles));
+		__m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(block, low_nibbles));
+		_mm_storeu_si128((__m128i *)(dest + 2*n),      _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i *)(dest + 2*n + 16), _mm_unpackhi_epi8(hi, lo));
+	}
+
+	ks_hex_encode_scalar(src + n, length - n, dest + 2*n);
+	return length*2;
+}
+
+// converts 16 hex characters to their nibble values, clearing *valid if any aren't hex digits
+static inline __m128i hex_nibbles_sse42(__m128i chars, int *valid) {
+	__m128i lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+	__m128i is_digit = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1)));
+	__m128i is_letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+	*valid &= (_mm_movemask_epi8(_mm_or_si128(is_digit, is_letter)) == 0xffff);
+	return _mm_blendv_epi8(_mm_sub_epi8(lower, _mm_set1_epi8('a' - 10)), _mm_sub_epi8(chars, _mm_set1_epi8('0')), is_digit);
+}
+
+int ks_hex_decode_sse42(const char *src, size_t length, uint8_t *dest) {
+	// maddubs multiplies the first nibble of each pair by 16 and the second by 1 and adds them
+	const __m128i weights = _mm_set1_epi16(0x0110);
+	int valid = 1;
+	size_t n = 0;
+
+	for (; n + 32 <= length; n += 32) {
+		__m128i first  = _mm_maddubs_epi16(hex_nibbles_sse42(_mm_loadu_si128((const __m128i *)(src + n)),      &valid), weights);
+		__m128i second = _mm_maddubs_epi16(hex_nibbles_sse42(_mm_loadu_si128((const __m128i *)(src + n + 16)), &valid), weights);
+		_mm_storeu_si128((__m128i *)(dest + n/2), _mm_packus_epi16(first, second));
+	}
+
+	return ks_hex_decode_scalar(src + n, length - n, dest + n/2) && valid;
+}
@@ -0,0 +1,76 @@
+#ifndef KS_PARSE_DECIMAL_H
+#define KS_PARSE_DECIMAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// database client libraries give us integers as decimal strings, and we know their lengths, so unlike strtoll we
+// don't need to scan for the end of the string, skip whitespace, or handle other bases.  we convert eight digits
+// at a time using SWAR arithmetic on little-endian platforms, and a digit at a time otherwise.
+
+// returns 1 and sets *result if all eight bytes are digits, or returns 0 otherwise
+static inline int ks_parse_eight_digits(const char *src, uint64_t *result) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	uint64_t val;
+	memcpy(&val, src, sizeof(val));
+	if (((val & 0xF0F0F0F0F0F0F0F0ULL) | (((val + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) != 0x3333333333333333ULL) return 0;
+	val -= 0x3030303030303030ULL;
+	val = (val*10) + (val >> 8); // pairs of digits
+	val = (((val & 0x000000FF000000FFULL)*(100 + (1000000ULL << 32))) +
+	       (((val >> 16) & 0x000000FF000000FFULL)*(1 + (10000ULL << 32)))) >> 32;
+	*result = val;
+	return 1;
+#else
+	uint64_t val = 0;
+	for (int n = 0; n < 8; n++) {
+		unsigned digit = (unsigned char)src[n] - '0';
+		if (digit > 9) return 0;
+		val = val*10 + digit;
+	}
+	*result = val;
+	return 1;
+#endif
+}
+
+// parses an unsigned decimal integer of up to 19 digits, which always fits in 64 bits; returns 0 for anything else
+static inline int ks_parse_digits(const char *src, size_t length, uint64_t *result) {
+	if (length == 0 || length > 19) return 0;
+
+	uint64_t val = 0;
+	while (length >= 8) {
+		uint64_t eight;
+		if (!ks_parse_eight_digits(src, &eight)) return 0;
+		val = val*100000000ULL + eight;
+		src += 8;
+		length -= 8;
+	}
+	while (length--) {
+		unsigned digit = (unsigned char)*src++ - '0';
+		if (digit > 9) return 0;
+		val = val*10 + digit;
+	}
+	*result = val;
+	return 1;
+}
+
+// returns 1 and sets *result if the string is a valid integer that we can convert without overflow checks, or
+// returns 0 if the caller needs to fall back to strtoull
+static inline int ks_parse_uint64(const char *src, size_t length, uint64_t *result) {
+	if (length && *src == '+') { src++; length--; }
+	return ks_parse_digits(src, length, result);
+}
+
+// as above, but signed; we limit ourselves to 18 digits so that the result always fits
+static inline int ks_parse_int64(const char *src, size_t length, int64_t *result) {
+	int negative = (length && *src == '-');
+	if (length && (*src == '-' || *src == '+')) { src++; length--; }
+	if (length > 18) return 0;
+
+	uint64_t val;
+	if (!ks_parse_digits(src, length, &val)) return 0;
+	*result = negative ? -(int64_t)val : (int64_t)val;
+	return 1;
+}
+
+#endif
@@ -0,0 +1,13 @@
+// a second build of xxHash's XXH3 implementation, compiled with -mavx2 so that it uses its AVX2 accumulation loop.
+// everything is inlined into this file so that none of its functions clash with the baseline build in xxhash.c.
+#define XXH_INLINE_ALL
+#include "../xxHash/xxhash.h"
+#include "kernels_impl.h"
+
+void ks_xxh3_128_update_avx2(struct XXH3_state_s *state, const void *input, size_t length) {
+	XXH3_128bits_update(state, input, length);
+}
+
+void ks_xxh3_128_digest_avx2(const struct XXH3_state_s *state, uint8_t dest[16]) {
+	XXH128_canonicalFromHash((XXH128_canonical_t *)dest, XXH3_128bits_digest(state));
+}
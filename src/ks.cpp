@@ -48,6 +48,13 @@ bool greet_remote_server(Options &options, vector<const char*>::const_iterator c
 	return true;
 }
 
+int from_hash_threads(const Options &options, int worker) {
+	// each 'from' worker process has its own hash thread pool, whereas the workers at the 'to' end share one, so we
+	// split the pool's extra threads between the 'from' workers to have the same number hashing at each end
+	int extra_threads = options.hash_threads - 1;
+	return 1 + extra_threads/options.workers + (worker < extra_threads % options.workers ? 1 : 0);
+}
+
 int main(int argc, char *argv[]) {
 	try
 	{
@@ -92,6 +99,7 @@ int main(int argc, char *argv[]) {
 		string database_arg("ENDPOINT_DATABASE_NAME=" + options.from.database);
 		string schema_arg("ENDPOINT_DATABASE_SCHEMA=" + options.from.schema);
 		string set_from_variables_arg("ENDPOINT_SET_VARIABLES=" + options.set_from_variables);
+		string hash_threads_arg("ENDPOINT_HASH_THREADS=" + to_string(from_hash_threads(options, 0)));
 
 		from_args.push_back("env");
 		from_args.push_back(host_arg.c_str());
@@ -101,6 +109,8 @@ int main(int argc, char *argv[]) {
 		from_args.push_back(database_arg.c_str());
 		from_args.push_back(schema_arg.c_str());
 		from_args.push_back(set_from_variables_arg.c_str());
+		size_t hash_threads_arg_index(from_args.size());
+		from_args.push_back(hash_threads_arg.c_str());
 		from_args.push_back(from_binary.c_str());
 		from_args.push_back("from");
 		from_args.push_back(nullptr);
@@ -119,6 +129,9 @@ int main(int argc, char *argv[]) {
 
 		vector<pid_t> child_pids;
 		for (int worker = 0; worker < options.workers; ++worker) {
+			hash_threads_arg = "ENDPOINT_HASH_THREADS=" + to_string(from_hash_threads(options, worker));
+			from_args[hash_threads_arg_index] = hash_threads_arg.c_str();
+
 			UnidirectionalPipe stdin_pipe;
 			UnidirectionalPipe stdout_pipe;
 			child_pids.push_back(Process::fork_and_exec(from_args.front(), from_args.data(), stdin_pipe, stdout_pipe));
@@ -136,6 +149,9 @@ int main(int argc, char *argv[]) {
 		setenv("ENDPOINT_SET_VARIABLES", options.set_to_variables);
 
 		setenv("ENDPOINT_FILTERS_FILE", options.filters);
+		setenv("ENDPOINT_STATE_FILE", options.state_file);
+		setenv("ENDPOINT_JOURNAL_FILE", options.journal_file);
+		setenv("ENDPOINT_RESUME", to_string(options.resume));
 		setenv("ENDPOINT_IGNORE_TABLES", options.ignore);
 		setenv("ENDPOINT_ONLY_TABLES", options.only);
 		setenv("ENDPOINT_WORKERS", to_string(options.workers));
@@ -146,7 +162,18 @@ int main(int argc, char *argv[]) {
 		setenv("ENDPOINT_ALTER", options.alter ? "1" : "0", 1);
 		setenv("ENDPOINT_COMMIT_LEVEL", to_string(options.commit_level));
 		setenv("ENDPOINT_HASH_ALGORITHM", to_string(static_cast<int>(options.hash_algorithm)));
+		setenv("ENDPOINT_HASH_THREADS", to_string(options.hash_threads));
 		setenv("ENDPOINT_STRUCTURE_ONLY", to_string(options.structure_only));
+		setenv("ENDPOINT_DEFER_INDEXES", to_string(options.defer_indexes));
+		setenv("ENDPOINT_HASH_KEYS_FIRST", to_string(options.hash_keys_first));
+		setenv("ENDPOINT_KEYS_ONLY_TABLES", options.keys_only);
+		setenv("ENDPOINT_CATCH_UP_SLOT", options.catch_up_slot);
+		setenv("ENDPOINT_DIGEST_SMALL_TABLES", to_string(options.digest_small_tables));
+		setenv("ENDPOINT_SKIP_UNCHANGED_TABLES", to_string(options.skip_unchanged_tables));
+		setenv("ENDPOINT_VERIFY_INTERVAL", to_string(options.verify_interval));
+		setenv("ENDPOINT_AUTO_RELOAD", to_string(options.auto_reload));
+		setenv("ENDPOINT_VERIFY", to_string(options.verify));
+		setenv("ENDPOINT_VERIFY_SAMPLE", options.verify_sample);
 
 		const char *to_args[] = { to_binary.c_str(), "to", nullptr };
 		child_pids.push_back(Process::fork_and_exec(to_binary, to_args));
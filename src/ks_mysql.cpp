@@ -7,10 +7,14 @@
 #include "schema.h"
 #include "database_client_traits.h"
 #include "sql_functions.h"
+#include "logical_decoding.h"
 #include "row_printer.h"
 #include "ewkb.h"
+#include "kernels/kernels.h"
+#include "kernels/parse_decimal.h"
 
 #define MYSQL_5_6_5 50605
+#define MYSQL_5_7_3 50703
 #define MYSQL_5_7_8 50708
 #define MYSQL_8_0_0 80000
 #define MARIADB_10_0_0 100000
@@ -35,7 +39,7 @@ public:
 	inline MYSQL_RES *res() { return _res; }
 	inline int n_tuples() const { return mysql_num_rows(_res); } // if buffer was false, this will only work after reading all the rows
 	inline int n_columns() const { return _n_columns; }
-	inline MySQLColumnConversion conversion_for(int column_number) { if (conversions.empty()) populate_conversions(); return conversions[column_number]; }
+	inline MySQLColumnConversion conversion_for(int column_number) const { return conversions[column_number]; }
 
 private:
 	void populate_conversions();
@@ -51,6 +55,7 @@ MySQLRes::MySQLRes(MYSQL &mysql, bool buffer) {
 	_res = buffer ? mysql_store_result(&mysql) : mysql_use_result(&mysql);
 	_n_columns = mysql_num_fields(_res);
 	_fields = mysql_fetch_fields(_res);
+	populate_conversions(); // up front, so that we don't need to check for each value we pack
 }
 
 MySQLRes::~MySQLRes() {
@@ -143,8 +148,8 @@ public:
 	inline const char *result_at(int column_number) const { return     _row[column_number]; }
 	inline         int length_of(int column_number) const { return _lengths[column_number]; }
 	inline      string string_at(int column_number) const { return string(result_at(column_number), length_of(column_number)); }
-	inline     int64_t    int_at(int column_number) const { return strtoll(result_at(column_number), nullptr, 10); }
-	inline    uint64_t   uint_at(int column_number) const { return strtoull(result_at(column_number), nullptr, 10); }
+	inline     int64_t    int_at(int column_number) const { int64_t result; return ks_parse_int64(result_at(column_number), length_of(column_number), &result) ? result : strtoll(result_at(column_number), nullptr, 10); }
+	inline    uint64_t   uint_at(int column_number) const { uint64_t result; return ks_parse_uint64(result_at(column_number), length_of(column_number), &result) ? result : strtoull(result_at(column_number), nullptr, 10); }
 
 	template <typename Packer>
 	inline void pack_column_into(Packer &packer, int column_number) const {
@@ -221,6 +226,17 @@ public:
 	~MySQLClient();
 
 	void disable_referential_integrity(bool leader);
+	bool table_can_be_truncated(const Table &table);
+	bool table_can_be_rebuilt(const Table &table);
+	bool table_exists(const Table &table);
+	string table_comment(const Table &table);
+	string table_comment_statement(const Table &table, const string &comment);
+	inline string row_versions_changed_since_expression(const string &watermark) { return "''"; } // not supported, so we only compare row counts
+	inline string row_version_watermark() { return ""; }
+	inline void read_changed_keys(const string &slot_name, size_t max_changes, const Tables &tables, ChangedKeys &changed_keys) { throw runtime_error("Catching up from the binary log isn't supported for MySQL"); }
+	inline void confirm_changes(const string &slot_name, const string &upto_lsn) { throw runtime_error("Catching up from the binary log isn't supported for MySQL"); }
+	void table_sizes(map<string, size_t> &table_sizes);
+	void table_statistics(map<string, string> &table_statistics);
 	string export_snapshot();
 	void import_snapshot(const string &snapshot);
 	void unhold_snapshot();
@@ -238,10 +254,11 @@ public:
 	inline string quote_identifier(const string &name) { return ::quote_identifier(name, '`'); };
 	inline string quote_table_name(const Table &table) { return ::quote_identifier(table.name, '`'); };
 	string escape_string_value(const string &value);
-	string &append_quoted_generic_value_to(string &result, const string &value);
-	string &append_quoted_spatial_value_to(string &result, const string &value);
-	string &append_quoted_json_value_to(string &result, const string &value);
-	string &append_quoted_column_value_to(string &result, const Column &column, const string &value);
+	string &append_quoted_generic_value_to(string &result, const char *value, size_t length);
+	string &append_quoted_spatial_value_to(string &result, const char *value, size_t length);
+	string &append_quoted_json_value_to(string &result, const char *value, size_t length);
+	string &append_quoted_column_value_to(string &result, const Column &column, const char *value, size_t length);
+	inline string &append_quoted_column_value_to(string &result, const Column &column, const string &value) { return append_quoted_column_value_to(result, column, value.data(), value.size()); }
 	string column_type_suffix(const Column &column, size_t default_size = 0);
 	tuple<string, string> column_type(const Column &column);
 	string column_default(const Table &table, const Column &column);
@@ -255,6 +272,7 @@ public:
 	inline bool supports_cast_to_float() const { return (server_is_mariadb || server_version >= MYSQL_8_0_0); }
 	inline bool supports_check_constraints() const { return check_constraints_table_exists; }
 	inline bool explicit_json_column_type() const { return (!server_is_mariadb && server_version >= MYSQL_5_7_8); }
+	inline bool supports_row_constructor_index_lookups() const { return (!server_is_mariadb && server_version >= MYSQL_5_7_3); } // see http://bugs.mysql.com/bug.php?id=31188
 	inline bool supports_json_column_type() const { return (explicit_json_column_type() || supports_check_constraints()); }
 	inline bool supports_generated_columns() const { return generation_expression_column_exists; }
 
@@ -467,6 +485,66 @@ void MySQLClient::disable_referential_integrity(bool leader) {
 	execute("SET foreign_key_checks = 0");
 }
 
+bool MySQLClient::table_can_be_truncated(const Table &table) {
+	// InnoDB refuses to TRUNCATE tables referenced by foreign keys from other tables
+	if (atoi(select_one(
+		"SELECT COUNT(*)" \
+		 " FROM information_schema.referential_constraints" \
+		" WHERE unique_constraint_schema = SCHEMA() AND" \
+		      " referenced_table_name = '" + escape_string_value(table.name) + "' AND" \
+		      " NOT (constraint_schema = SCHEMA() AND table_name = referenced_table_name)").c_str())) return false;
+
+	// TRUNCATE doesn't run DELETE triggers, which may be used for auditing or to maintain other tables
+	if (atoi(select_one(
+		"SELECT COUNT(*)" \
+		 " FROM information_schema.triggers" \
+		" WHERE event_object_schema = SCHEMA() AND" \
+		      " event_object_table = '" + escape_string_value(table.name) + "' AND" \
+		      " event_manipulation = 'DELETE'").c_str())) return false;
+
+	return true;
+}
+
+bool MySQLClient::table_can_be_rebuilt(const Table &table) {
+	// the rebuilt table is created from our definition of the table, so it wouldn't have foreign keys or triggers
+	if (atoi(select_one(
+		"SELECT COUNT(*)" \
+		 " FROM information_schema.referential_constraints" \
+		" WHERE (constraint_schema = SCHEMA() AND table_name = '" + escape_string_value(table.name) + "') OR" \
+		      " (unique_constraint_schema = SCHEMA() AND referenced_table_name = '" + escape_string_value(table.name) + "')").c_str())) return false;
+
+	if (atoi(select_one(
+		"SELECT COUNT(*)" \
+		 " FROM information_schema.triggers" \
+		" WHERE event_object_schema = SCHEMA() AND" \
+		      " event_object_table = '" + escape_string_value(table.name) + "'").c_str())) return false;
+
+	// nor would it have the table's comment
+	if (!table_comment(table).empty()) return false;
+
+	return true;
+}
+
+bool MySQLClient::table_exists(const Table &table) {
+	return atoi(select_one(
+		"SELECT COUNT(*)" \
+		 " FROM information_schema.tables" \
+		" WHERE table_schema = SCHEMA() AND" \
+		      " table_name = '" + escape_string_value(table.name) + "'").c_str());
+}
+
+string MySQLClient::table_comment(const Table &table) {
+	return select_one(
+		"SELECT table_comment" \
+		 " FROM information_schema.tables" \
+		" WHERE table_schema = SCHEMA() AND" \
+		      " table_name = '" + escape_string_value(table.name) + "'");
+}
+
+string MySQLClient::table_comment_statement(const Table &table, const string &comment) {
+	return "ALTER TABLE " + quote_table_name(table) + " COMMENT = '" + escape_string_value(comment) + "'";
+}
+
 string MySQLClient::escape_string_value(const string &value) {
 	string result;
 	result.resize(value.size()*2 + 1);
@@ -475,21 +553,26 @@ string MySQLClient::escape_string_value(const string &value) {
 	return result;
 }
 
-string &MySQLClient::append_quoted_generic_value_to(string &result, const string &value) {
-	string buffer;
-	buffer.resize(value.size()*2 + 1);
-	size_t result_length = mysql_real_escape_string(&mysql, (char*)buffer.data(), value.c_str(), value.size());
-	result += '\'';
-	result.append(buffer, 0, result_length);
-	result += '\'';
+string &MySQLClient::append_quoted_generic_value_to(string &result, const char *value, size_t length) {
+	// escape straight into the end of the result string, so that we don't need a temporary buffer for each value.
+	// we always use the binary character set, so this is equivalent to mysql_real_escape_string.
+	size_t start = result.size();
+	result.resize(start + length*2 + 2);
+	result[start] = '\'';
+	size_t result_length = (mysql.server_status & SERVER_STATUS_NO_BACKSLASH_ESCAPES) ?
+		ks_quote_escape(value, length, &result[start + 1], false) :
+		ks_backslash_escape(value, length, &result[start + 1]);
+	result[start + 1 + result_length] = '\'';
+	result.resize(start + 1 + result_length + 1);
 	return result;
 }
 
-string &MySQLClient::append_quoted_spatial_value_to(string &result, const string &value) {
-	return append_quoted_generic_value_to(result, ewkb_bin_to_mysql_bin(value));
+string &MySQLClient::append_quoted_spatial_value_to(string &result, const char *value, size_t length) {
+	string mysql_bin(ewkb_bin_to_mysql_bin(string(value, length)));
+	return append_quoted_generic_value_to(result, mysql_bin.data(), mysql_bin.size());
 }
 
-string &MySQLClient::append_quoted_json_value_to(string &result, const string &value) {
+string &MySQLClient::append_quoted_json_value_to(string &result, const char *value, size_t length) {
 	// normally you wouldn't have to do anything special to be able to insert into a JSON field.
 	// but we set the MYSQL_SET_CHARSET_NAME option to "binary" to avoid having to interpret
 	// character sets, and unfortunately they added an explicit check which causes
@@ -499,20 +582,20 @@ string &MySQLClient::append_quoted_json_value_to(string &result, const string &v
 	// convert anything.  note that mysql has defined the JSON type as always having encoding
 	// utf8mb4 - it isn't like varchar and text.
 	result += "CONVERT(";
-	append_quoted_generic_value_to(result, value);
+	append_quoted_generic_value_to(result, value, length);
 	result += " USING utf8mb4)";
 	return result;
 }
 
-string &MySQLClient::append_quoted_column_value_to(string &result, const Column &column, const string &value) {
+string &MySQLClient::append_quoted_column_value_to(string &result, const Column &column, const char *value, size_t length) {
 	if (!column.values_need_quoting()) {
-		return result += value;
+		return result.append(value, length);
 	} else if (column.column_type == ColumnType::spatial) {
-		return append_quoted_spatial_value_to(result, value);
+		return append_quoted_spatial_value_to(result, value, length);
 	} else if (column.column_type == ColumnType::json && explicit_json_column_type()) {
-		return append_quoted_json_value_to(result, value);
+		return append_quoted_json_value_to(result, value, length);
 	} else {
-		return append_quoted_generic_value_to(result, value);
+		return append_quoted_generic_value_to(result, value, length);
 	}
 }
 
@@ -1272,6 +1355,55 @@ void MySQLClient::populate_database_schema(Database &database, const ColumnTypeL
 		true /* buffer so we can make further queries during iteration */);
 }
 
+struct MySQLTableSizesCollector {
+	MySQLTableSizesCollector(map<string, size_t> &table_sizes): table_sizes(table_sizes) {}
+
+	inline void operator()(MySQLRow &row) {
+		if (row.null_at(1)) return; // not known for some storage engines, in which case we treat the table as large
+		Table table("" /* schema */, row.string_at(0));
+		table_sizes[table.id_from_name()] = strtoull(row.string_at(1).c_str(), nullptr, 10);
+	}
+
+	map<string, size_t> &table_sizes;
+};
+
+void MySQLClient::table_sizes(map<string, size_t> &table_sizes) {
+	// data_length is only an estimate for InnoDB tables, but that's all we need
+	MySQLTableSizesCollector table_sizes_collector(table_sizes);
+	query("SELECT table_name, data_length FROM information_schema.tables WHERE table_schema = schema() AND table_type = \"BASE TABLE\"", table_sizes_collector);
+}
+
+struct MySQLTableStatisticsCollector {
+	MySQLTableStatisticsCollector(map<string, string> &table_statistics): table_statistics(table_statistics) {}
+
+	inline void operator()(MySQLRow &row) {
+		if (row.null_at(1)) return; // can't tell for this table
+		Table table("" /* schema */, row.string_at(0));
+		table_statistics[table.id_from_name()] = row.string_at(1);
+	}
+
+	map<string, string> &table_statistics;
+};
+
+void MySQLClient::table_statistics(map<string, string> &table_statistics) {
+	// mysql 8 caches the table statistics, by default for a day, in which case they don't show recent changes
+	if (!server_is_mariadb && server_version >= MYSQL_8_0_0 && select_one("SELECT @@information_schema_stats_expiry") != "0") return;
+
+	// tables with a live checksum (MyISAM and Aria tables created with CHECKSUM=1) give it in the statistics.
+	// otherwise we use the last update time, where the storage engine keeps it (InnoDB forgets it on restart,
+	// when it's NULL); it's only to the second, so if it's the current second, another change could come along
+	// without changing it.  truncating or rebuilding the table gives it a new create time.
+	MySQLTableStatisticsCollector table_statistics_collector(table_statistics);
+	query(
+		"SELECT table_name, "
+		       "CASE WHEN checksum IS NOT NULL THEN CONCAT('checksum ', create_time, ' ', checksum) "
+		            "WHEN update_time < NOW() THEN CONCAT('update_time ', create_time, ' ', update_time) "
+		       "END "
+		  "FROM information_schema.tables "
+		 "WHERE table_schema = schema() AND table_type = \"BASE TABLE\"",
+		table_statistics_collector);
+}
+
 
 int main(int argc, char *argv[]) {
 	return endpoint_main<MySQLClient>(argc, argv);
@@ -8,11 +8,16 @@
 #include "schema.h"
 #include "database_client_traits.h"
 #include "sql_functions.h"
+#include "logical_decoding.h"
 #include "row_printer.h"
 #include "ewkb.h"
+#include "kernels/kernels.h"
+#include "kernels/parse_decimal.h"
 
 #define POSTGRESQL_9_4 90400
+#define POSTGRESQL_9_5 90500
 #define POSTGRESQL_10 100000
+#define POSTGRESQL_11 110000
 #define POSTGRESQL_12 120000
 
 struct TypeMap {
@@ -38,7 +43,7 @@ public:
 	inline size_t rows_affected() const { return atoi(PQcmdTuples(_res)); }
 	inline int n_tuples() const  { return _n_tuples; }
 	inline int n_columns() const { return _n_columns; }
-	inline PostgreSQLColumnConversion conversion_for(int column_number) { if (conversions.empty()) populate_conversions(); return conversions[column_number]; }
+	inline PostgreSQLColumnConversion conversion_for(int column_number) const { return conversions[column_number]; }
 
 private:
 	void populate_conversions();
@@ -54,6 +59,7 @@ private:
 PostgreSQLRes::PostgreSQLRes(PGresult *res, const TypeMap &type_map): _res(res), _type_map(type_map) {
 	_n_tuples = PQntuples(_res);
 	_n_columns = PQnfields(_res);
+	populate_conversions(); // up front, so that we don't need to check for each value we pack
 }
 
 PostgreSQLRes::~PostgreSQLRes() {
@@ -109,6 +115,25 @@ PostgreSQLColumnConversion PostgreSQLRes::conversion_for_type(Oid typid) {
 	}
 }
 
+// decodes hex text straight into the packer's stream in chunks, rather than into a temporary string for the whole value
+template <typename Packer>
+void pack_hex_as_bin(Packer &packer, const char *input, size_t length) {
+	uint8_t buf[4096];
+	pack_raw_length(packer, length/2);
+	while (length > 0) {
+		size_t chunk = min(length, sizeof(buf)*2);
+		if (!ks_hex_decode(input, chunk, buf)) throw runtime_error("Invalid hex value " + string(input, chunk));
+		packer.write_bytes(buf, chunk/2);
+		input += chunk;
+		length -= chunk;
+	}
+}
+
+inline void pack_hex_as_bin(PackedRow &row, const char *input, size_t length) {
+	row.resize(row.size() + 1);
+	Packer<PackedValue> packer(row.back());
+	pack_hex_as_bin(packer, input, length);
+}
 
 class PostgreSQLRow {
 public:
@@ -122,8 +147,8 @@ public:
 	inline         int length_of(int column_number) const { return PQgetlength(_res.res(), _row_number, column_number); }
 	inline      string string_at(int column_number) const { return string(result_at(column_number), length_of(column_number)); }
 	inline        bool   bool_at(int column_number) const { return (strcmp(result_at(column_number), "t") == 0); }
-	inline     int64_t    int_at(int column_number) const { return strtoll(result_at(column_number), nullptr, 10); }
-	inline    uint64_t   uint_at(int column_number) const { return strtoull(result_at(column_number), nullptr, 10); }
+	inline     int64_t    int_at(int column_number) const { int64_t result; return ks_parse_int64(result_at(column_number), length_of(column_number), &result) ? result : strtoll(result_at(column_number), nullptr, 10); }
+	inline    uint64_t   uint_at(int column_number) const { uint64_t result; return ks_parse_uint64(result_at(column_number), length_of(column_number), &result) ? result : strtoull(result_at(column_number), nullptr, 10); }
 
 	template <typename Packer>
 	inline void pack_column_into(Packer &packer, int column_number) const {
@@ -140,6 +165,13 @@ public:
 					break;
 
 				case encode_bytea: {
+					// bytea values are normally output in hex format, which we can decode ourselves without PQunescapeBytea's malloc
+					const char *value = result_at(column_number);
+					if (length_of(column_number) >= 2 && value[0] == '\\' && value[1] == 'x') {
+						pack_hex_as_bin(packer, value + 2, length_of(column_number) - 2);
+						break;
+					}
+
 					size_t decoded_length;
 					void *decoded = PQunescapeBytea((const unsigned char *)result_at(column_number), &decoded_length);
 					packer << uncopied_byte_string(decoded, decoded_length);
@@ -148,7 +180,7 @@ public:
 				}
 
 				case encode_geom:
-					packer << hex_to_bin_string(result_at(column_number), length_of(column_number));
+					pack_hex_as_bin(packer, result_at(column_number), length_of(column_number));
 					break;
 
 				case encode_raw:
@@ -164,7 +196,7 @@ private:
 };
 
 
-class PostgreSQLClient: public GlobalKeys, public SequenceColumns, public SetNullability, public SupportsCustomTypes {
+class PostgreSQLClient: public GlobalKeys, public SequenceColumns, public SetNullability, public SupportsCustomTypes, public SupportsUpdateFrom, public SupportsArrays, public TransactionalDDL {
 public:
 	typedef PostgreSQLRow RowType;
 
@@ -180,6 +212,18 @@ public:
 
 	bool foreign_key_constraints_present();
 	void disable_referential_integrity(bool leader);
+	bool table_can_be_truncated(const Table &table);
+	bool table_can_be_rebuilt(const Table &table);
+	bool table_exists(const Table &table);
+	string table_comment(const Table &table);
+	string table_comment_statement(const Table &table, const string &comment);
+	string primary_key_constraint_name(const Table &table);
+	string row_versions_changed_since_expression(const string &watermark);
+	string row_version_watermark();
+	void read_changed_keys(const string &slot_name, size_t max_changes, const Tables &tables, ChangedKeys &changed_keys);
+	void confirm_changes(const string &slot_name, const string &upto_lsn);
+	void table_sizes(map<string, size_t> &table_sizes);
+	void table_statistics(map<string, string> &table_statistics);
 	string export_snapshot();
 	void import_snapshot(const string &snapshot);
 	void unhold_snapshot();
@@ -196,10 +240,11 @@ public:
 	string add_unique_relation_name_suffix(string name, set<string> used_relation_names, size_t max_allowed_length);
 
 	string escape_string_value(const string &value);
-	string &append_quoted_string_value_to(string &result, const string &value);
-	string &append_quoted_bytea_value_to(string &result, const string &value);
-	string &append_quoted_spatial_value_to(string &result, const string &value);
-	string &append_quoted_column_value_to(string &result, const Column &column, const string &value);
+	string &append_quoted_string_value_to(string &result, const char *value, size_t length);
+	string &append_quoted_bytea_value_to(string &result, const char *value, size_t length);
+	string &append_quoted_spatial_value_to(string &result, const char *value, size_t length);
+	string &append_quoted_column_value_to(string &result, const Column &column, const char *value, size_t length);
+	inline string &append_quoted_column_value_to(string &result, const Column &column, const string &value) { return append_quoted_column_value_to(result, column, value.data(), value.size()); }
 	string column_type(const Column &column);
 	string column_default(const Table &table, const Column &column);
 	string column_definition(const Table &table, const Column &column);
@@ -242,6 +287,7 @@ protected:
 private:
 	PGconn *conn;
 	int server_version;
+	bool standard_conforming_strings;
 	TypeMap type_map;
 
 	// forbid copying
@@ -284,6 +330,10 @@ PostgreSQLClient::PostgreSQLClient(
 
 	server_version = PQserverVersion(conn);
 
+	// the variables above could have changed this, so we check it afterwards
+	const char *standard_conforming_strings_status = PQparameterStatus(conn, "standard_conforming_strings");
+	standard_conforming_strings = (standard_conforming_strings_status && strcmp(standard_conforming_strings_status, "on") == 0);
+
 	// we call this ourselves as all instances need to know the type OIDs that need special conversion,
 	// whereas populate_database_schema is only called for the leader at the 'to' end
 	populate_types();
@@ -382,6 +432,194 @@ void PostgreSQLClient::disable_referential_integrity(bool leader) {
 	}
 }
 
+bool PostgreSQLClient::table_can_be_truncated(const Table &table) {
+	string schema_name(table.schema_name.empty() ? default_schema : table.schema_name);
+	string table_oid("'" + escape_string_value(quote_table_name(table)) + "'::regclass");
+
+	// TRUNCATE refuses to run if other tables have foreign keys referencing the table, even if we've
+	// disabled the triggers that enforce them
+	if (atoi(select_one(
+		"SELECT COUNT(*)" \
+		 " FROM pg_constraint" \
+		" WHERE contype = 'f' AND" \
+		      " confrelid = " + table_oid + " AND" \
+		      " conrelid <> confrelid").c_str())) return false;
+
+	// TRUNCATE doesn't fire DELETE triggers, which trigger-based replication systems rely on (8 is TRIGGER_TYPE_DELETE)
+	if (atoi(select_one(
+		"SELECT COUNT(*)" \
+		 " FROM pg_trigger" \
+		" WHERE tgrelid = " + table_oid + " AND" \
+		      " NOT tgisinternal AND" \
+		      " tgenabled <> 'D' AND" \
+		      " (tgtype & 8) <> 0").c_str())) return false;
+
+	// logical replication didn't replicate TRUNCATE before v11, and since then publications may exclude it
+	if (server_version >= POSTGRESQL_10 && atoi(select_one(
+		"SELECT COUNT(*)" \
+		 " FROM pg_publication_tables" \
+		 " JOIN pg_publication ON pg_publication_tables.pubname = pg_publication.pubname" \
+		" WHERE schemaname = '" + escape_string_value(schema_name) + "' AND" \
+		      " tablename = '" + escape_string_value(table.name) + "'" +
+		      (server_version >= POSTGRESQL_11 ? " AND NOT pubtruncate" : "")).c_str())) return false;
+
+	return true;
+}
+
+bool PostgreSQLClient::table_can_be_rebuilt(const Table &table) {
+	string table_oid("'" + escape_string_value(quote_table_name(table)) + "'::regclass");
+
+	// the rebuilt table is created from our definition of the table, so it wouldn't have anything we don't track
+	// ourselves: foreign keys to or from it, check constraints, triggers, or grants
+	if (atoi(select_one(
+		"SELECT COUNT(*)" \
+		 " FROM pg_constraint" \
+		" WHERE (conrelid = " + table_oid + " AND contype NOT IN ('p', 'u')) OR" \
+		      " confrelid = " + table_oid).c_str())) return false;
+
+	if (atoi(select_one(
+		"SELECT COUNT(*)" \
+		 " FROM pg_trigger" \
+		" WHERE tgrelid = " + table_oid + " AND" \
+		      " NOT tgisinternal").c_str())) return false;
+
+	// nor would it have the same owner (as we create it), storage parameters, or row-level security settings
+	if (atoi(select_one(
+		"SELECT COUNT(*)" \
+		 " FROM pg_class" \
+		" WHERE oid = " + table_oid + " AND" \
+		      " (relacl IS NOT NULL OR relkind <> 'r' OR reloptions IS NOT NULL OR relowner <> (SELECT oid FROM pg_roles WHERE rolname = current_user)" +
+		       (server_version >= POSTGRESQL_9_5 ? " OR relrowsecurity OR relforcerowsecurity" : "") + ")").c_str())) return false;
+
+	if (server_version >= POSTGRESQL_9_5 && atoi(select_one(
+		"SELECT COUNT(*)" \
+		 " FROM pg_policy" \
+		" WHERE polrelid = " + table_oid).c_str())) return false;
+
+	// or comments on the table, its columns, or its keys
+	if (atoi(select_one(
+		"SELECT COUNT(*)" \
+		 " FROM pg_description" \
+		" WHERE (classoid = 'pg_class'::regclass AND (objoid = " + table_oid + " OR objoid IN (SELECT indexrelid FROM pg_index WHERE indrelid = " + table_oid + "))) OR" \
+		      " (classoid = 'pg_constraint'::regclass AND objoid IN (SELECT oid FROM pg_constraint WHERE conrelid = " + table_oid + "))").c_str())) return false;
+
+	// views that use the table, and inheritance, would stop us dropping it
+	if (atoi(select_one(
+		"SELECT COUNT(*)" \
+		 " FROM pg_depend" \
+		 " JOIN pg_rewrite ON pg_depend.classid = 'pg_rewrite'::regclass AND pg_depend.objid = pg_rewrite.oid" \
+		" WHERE pg_depend.refobjid = " + table_oid + " AND" \
+		      " pg_rewrite.ev_class <> " + table_oid).c_str())) return false;
+
+	if (atoi(select_one(
+		"SELECT COUNT(*)" \
+		 " FROM pg_inherits" \
+		" WHERE inhrelid = " + table_oid + " OR" \
+		      " inhparent = " + table_oid).c_str())) return false;
+
+	// and the new table wouldn't be in the same publications
+	if (server_version >= POSTGRESQL_10 && atoi(select_one(
+		"SELECT COUNT(*)" \
+		 " FROM pg_publication_tables" \
+		" WHERE schemaname = '" + escape_string_value(table.schema_name.empty() ? default_schema : table.schema_name) + "' AND" \
+		      " tablename = '" + escape_string_value(table.name) + "'").c_str())) return false;
+
+	return true;
+}
+
+bool PostgreSQLClient::table_exists(const Table &table) {
+	return atoi(select_one(
+		"SELECT COUNT(*)" \
+		 " FROM pg_class" \
+		 " JOIN pg_namespace ON pg_class.relnamespace = pg_namespace.oid" \
+		" WHERE nspname = '" + escape_string_value(table.schema_name.empty() ? default_schema : table.schema_name) + "' AND" \
+		      " relname = '" + escape_string_value(table.name) + "'").c_str());
+}
+
+string PostgreSQLClient::table_comment(const Table &table) {
+	return select_one("SELECT COALESCE(obj_description('" + escape_string_value(quote_table_name(table)) + "'::regclass, 'pg_class'), '')");
+}
+
+string PostgreSQLClient::table_comment_statement(const Table &table, const string &comment) {
+	return "COMMENT ON TABLE " + quote_table_name(table) + " IS " + (comment.empty() ? string("NULL") : "'" + escape_string_value(comment) + "'");
+}
+
+string PostgreSQLClient::primary_key_constraint_name(const Table &table) {
+	return select_one(
+		"SELECT conname" \
+		 " FROM pg_constraint" \
+		" WHERE conrelid = '" + escape_string_value(quote_table_name(table)) + "'::regclass AND" \
+		      " contype = 'p'");
+}
+
+string PostgreSQLClient::row_versions_changed_since_expression(const string &watermark) {
+	// the xmin system column holds the ID of the transaction which inserted (or last updated) each row.  transaction
+	// IDs are 32-bit and wrap around, so we can only compare them to recent IDs, which we do using their age; frozen
+	// rows have the maximum age.  watermarks are 64-bit transaction IDs as given by txid_current_snapshot, and we
+	// stop trusting them well before they could wrap around.  we return the same watermark if no rows in the table
+	// were written by transactions since it, and otherwise the watermark as of our snapshot.
+	string new_watermark("txid_snapshot_xmin(txid_current_snapshot())::text");
+	if (watermark.empty() || watermark.find_first_not_of("0123456789") != string::npos) return new_watermark;
+
+	return "CASE" \
+		" WHEN txid_snapshot_xmax(txid_current_snapshot()) - " + watermark + " < " + to_string(MAXIMUM_ROW_VERSION_WATERMARK_AGE) + " AND" \
+		     " NOT COALESCE(bool_or(age(xmin) <= age((" + watermark + " % 4294967296)::text::xid)), false)" \
+		" THEN '" + watermark + "'" \
+		" ELSE " + new_watermark + " END";
+}
+
+string PostgreSQLClient::row_version_watermark() {
+	// any transaction that could write rows after this point has an ID at least this high
+	return select_one("SELECT txid_snapshot_xmin(txid_current_snapshot())");
+}
+
+void PostgreSQLClient::read_changed_keys(const string &slot_name, size_t max_changes, const Tables &tables, ChangedKeys &changed_keys) {
+	string plugin(select_one("SELECT COALESCE((SELECT plugin FROM pg_replication_slots WHERE slot_name = '" + escape_string_value(slot_name) + "'), '')"));
+	if (plugin.empty()) {
+		throw runtime_error("There's no replication slot named " + slot_name);
+	} else if (plugin != "test_decoding") {
+		throw runtime_error("Replication slot " + slot_name + " uses the " + plugin + " output plugin, but only test_decoding is supported");
+	}
+
+	// decoded changes always give the schema name, even for tables in the default schema
+	map<DecodedTableName, const Table *> tables_by_name;
+	for (const Table &table : tables) {
+		tables_by_name[DecodedTableName(table.schema_name.empty() ? default_schema : table.schema_name, table.name)] = &table;
+	}
+
+	// we only peek at the changes, so that if the other end fails to apply them, they'll be read again next time;
+	// they're consumed by confirm_changes once they've been committed at the other end
+	TxidSnapshot snapshot(select_one("SELECT txid_current_snapshot()"));
+	LogicalChangesCollector collector(tables_by_name, snapshot);
+	query(
+		"SELECT lsn::text, xid::text, data"
+		 " FROM pg_logical_slot_peek_changes('" + escape_string_value(slot_name) + "', NULL, " + to_string(max_changes) + ", 'skip-empty-xacts', '1')",
+		collector);
+
+	changed_keys.upto_lsn = collector.upto_lsn;
+	changed_keys.more_changes = (collector.stopped || collector.changes_read >= max_changes);
+	changed_keys.tables_to_reload = collector.tables_to_reload;
+
+	for (auto const &it : collector.keys_by_table) {
+		if (changed_keys.tables_to_reload.count(it.first)) continue;
+		KeysCollector keys_collector;
+		query(changed_keys_sql(it.second), keys_collector);
+		changed_keys.keys_by_table[it.first] = keys_collector.keys;
+	}
+}
+
+void PostgreSQLClient::confirm_changes(const string &slot_name, const string &upto_lsn) {
+	// finish our read transaction first, since we're done with the snapshot
+	commit_transaction();
+
+	if (server_version >= POSTGRESQL_11) {
+		select_one("SELECT end_lsn FROM pg_replication_slot_advance('" + escape_string_value(slot_name) + "', '" + escape_string_value(upto_lsn) + "'::pg_lsn)");
+	} else {
+		// before v11 the only way to move the slot along is to consume the changes
+		select_one("SELECT COUNT(*) FROM pg_logical_slot_get_changes('" + escape_string_value(slot_name) + "', '" + escape_string_value(upto_lsn) + "'::pg_lsn, NULL)");
+	}
+}
+
 string PostgreSQLClient::escape_string_value(const string &value) {
 	string result;
 	result.resize(value.size()*2 + 1);
@@ -390,42 +628,55 @@ string PostgreSQLClient::escape_string_value(const string &value) {
 	return result;
 }
 
-string &PostgreSQLClient::append_quoted_string_value_to(string &result, const string &value) {
-	string buffer;
-	buffer.resize(value.size()*2 + 1);
-	size_t result_length = PQescapeStringConn(conn, (char*)buffer.data(), value.c_str(), value.size(), nullptr);
-	result += '\'';
-	result.append(buffer, 0, result_length);
-	result += '\'';
+string &PostgreSQLClient::append_quoted_string_value_to(string &result, const char *value, size_t length) {
+	// escape straight into the end of the result string, so that we don't need a temporary buffer for each value.
+	// we always use the SQL_ASCII client encoding, so this is equivalent to PQescapeStringConn.
+	size_t start = result.size();
+	result.resize(start + length*2 + 2);
+	result[start] = '\'';
+	size_t result_length = ks_quote_escape(value, length, &result[start + 1], !standard_conforming_strings);
+	result[start + 1 + result_length] = '\'';
+	result.resize(start + 1 + result_length + 1);
 	return result;
 }
 
-string &PostgreSQLClient::append_quoted_bytea_value_to(string &result, const string &value) {
-	size_t encoded_length;
-	const unsigned char *encoded = PQescapeByteaConn(conn, (const unsigned char *)value.c_str(), value.size(), &encoded_length);
-	result += '\'';
-	result.append(encoded, encoded + encoded_length - 1); // encoded_length includes the null terminator
+string &PostgreSQLClient::append_quoted_bytea_value_to(string &result, const char *value, size_t length) {
+	if (server_version < 90000) {
+		// the hex format isn't supported, so let libpq produce the old escape format
+		size_t encoded_length;
+		const unsigned char *encoded = PQescapeByteaConn(conn, (const unsigned char *)value, length, &encoded_length);
+		result += '\'';
+		result.append(encoded, encoded + encoded_length - 1); // encoded_length includes the null terminator
+		result += '\'';
+		PQfreemem((void *)encoded);
+		return result;
+	}
+
+	// produce the same hex format as PQescapeByteaConn does, but without it having to malloc a buffer for each value
+	result += (standard_conforming_strings ? "'\\x" : "'\\\\x");
+	size_t start = result.size();
+	result.resize(start + length*2);
+	ks_hex_encode((const uint8_t *)value, length, &result[start]);
 	result += '\'';
-	PQfreemem((void *)encoded);
 	return result;
 }
 
-string &PostgreSQLClient::append_quoted_spatial_value_to(string &result, const string &value) {
+string &PostgreSQLClient::append_quoted_spatial_value_to(string &result, const char *value, size_t length) {
 	result.append("ST_GeomFromEWKB(");
-	append_quoted_bytea_value_to(result, value);
+	append_quoted_bytea_value_to(result, value, length);
 	result.append(")");
 	return result;
 }
 
-string &PostgreSQLClient::append_quoted_column_value_to(string &result, const Column &column, const string &value) {
+string &PostgreSQLClient::append_quoted_column_value_to(string &result, const Column &column, const char *value, size_t length) {
 	if (!column.values_need_quoting()) {
-		return result += value;
+		return result.append(value, length);
 	} else if (column.column_type == ColumnType::binary) {
-		return append_quoted_bytea_value_to(result, value);
+		return append_quoted_bytea_value_to(result, value, length);
 	} else if (column.column_type == ColumnType::spatial) {
-		return append_quoted_spatial_value_to(result, value);
+		return append_quoted_spatial_value_to(result, value, length);
 	} else {
-		return append_quoted_string_value_to(result, value);
+		return append_quoted_string_value_to(result, value, length);
 	}
 }
 
@@ -1223,6 +1474,63 @@ void PostgreSQLClient::populate_database_schema(Database &database, const Column
 		table_lister);
 }
 
+struct PostgreSQLTableSizesCollector {
+	PostgreSQLTableSizesCollector(const string &default_schema, map<string, size_t> &table_sizes): default_schema(default_schema), table_sizes(table_sizes) {}
+
+	inline void operator()(PostgreSQLRow &row) {
+		string schema_name(row.string_at(0));
+		Table table(schema_name == default_schema ? "" : schema_name, row.string_at(1));
+		table_sizes[table.id_from_name()] = row.uint_at(2);
+	}
+
+	const string &default_schema;
+	map<string, size_t> &table_sizes;
+};
+
+void PostgreSQLClient::table_sizes(map<string, size_t> &table_sizes) {
+	PostgreSQLTableSizesCollector table_sizes_collector(default_schema, table_sizes);
+	query(
+		"SELECT pg_namespace.nspname, pg_class.relname, pg_relation_size(pg_class.oid) "
+		  "FROM pg_namespace, pg_class "
+		 "WHERE pg_namespace.nspname = ANY (current_schemas(false)) AND "
+		       "pg_class.relnamespace = pg_namespace.oid AND "
+		       "relkind = 'r'",
+		table_sizes_collector);
+}
+
+struct PostgreSQLTableStatisticsCollector {
+	PostgreSQLTableStatisticsCollector(const string &default_schema, map<string, string> &table_statistics): default_schema(default_schema), table_statistics(table_statistics) {}
+
+	inline void operator()(PostgreSQLRow &row) {
+		string schema_name(row.string_at(0));
+		Table table(schema_name == default_schema ? "" : schema_name, row.string_at(1));
+		table_statistics[table.id_from_name()] = row.string_at(2);
+	}
+
+	const string &default_schema;
+	map<string, string> &table_statistics;
+};
+
+void PostgreSQLClient::table_statistics(map<string, string> &table_statistics) {
+	// the counters of rows inserted, updated, and deleted only go up, unless the statistics are reset, which is
+	// recorded in the database's stats_reset time, or lost in a crash, in which case the server will have been
+	// restarted.  truncating or rewriting the table doesn't count the rows, but gives it a new file.  if the
+	// server isn't counting at all, we can't tell anything.
+	PostgreSQLTableStatisticsCollector table_statistics_collector(default_schema, table_statistics);
+	query(
+		"SELECT pg_namespace.nspname, pg_class.relname, "
+		       "pg_postmaster_start_time() || ' ' || COALESCE(pg_stat_database.stats_reset::text, '') || ' ' || "
+		       "pg_relation_filenode(pg_class.oid) || ' ' || "
+		       "n_tup_ins || ' ' || n_tup_upd || ' ' || n_tup_del "
+		  "FROM pg_stat_user_tables, pg_class, pg_namespace, pg_stat_database "
+		 "WHERE pg_stat_user_tables.relid = pg_class.oid AND "
+		       "pg_class.relnamespace = pg_namespace.oid AND "
+		       "pg_namespace.nspname = ANY (current_schemas(false)) AND "
+		       "pg_stat_database.datname = current_database() AND "
+		       "current_setting('track_counts')::boolean",
+		table_statistics_collector);
+}
+
 
 int main(int argc, char *argv[]) {
 	return endpoint_main<PostgreSQLClient>(argc, argv);
@@ -0,0 +1,239 @@
+#ifndef LOCAL_ROW_CACHE_H
+#define LOCAL_ROW_CACHE_H
+
+#include <limits>
+#include <list>
+#include <memory>
+#include <vector>
+
+#include "cached_key_range.h"
+#include "defaults.h"
+#include "message_pack/packed_row.h"
+
+const int ANY_WORKER = -1;
+
+// rows read from our end's database, kept in packed form with their primary keys.  the values are all kept in one
+// buffer rather than as individual PackedValues, so that keeping rows doesn't cost an allocation per value.
+struct LocalRows {
+	LocalRows(): key_bytes(0), read_by_worker(ANY_WORKER), packer(*this) {}
+
+	LocalRows(const LocalRows &) = delete;
+	LocalRows &operator=(const LocalRows &) = delete;
+
+	inline size_t size() const { return keys.size(); }
+	inline size_t n_columns(size_t row) const { return row_ends[row] - (row ? row_ends[row - 1] : 0); }
+
+	inline const uint8_t *value_data(size_t value) const { return data.data() + (value ? value_ends[value - 1] : 0); }
+	inline size_t value_size(size_t value) const { return value_ends[value] - (value ? value_ends[value - 1] : 0); }
+
+	// approximate, but good enough to budget by
+	inline size_t memory_used() const {
+		return data.size() + value_ends.size()*sizeof(size_t) + row_ends.size()*sizeof(size_t) + keys.size()*sizeof(ColumnValues) + key_bytes;
+	}
+
+	template <typename DatabaseRow>
+	void add(const DatabaseRow &row, const vector<size_t> &primary_key_columns) {
+		size_t first_value = value_ends.size();
+		for (size_t column_number = 0; column_number < row.n_columns(); column_number++) {
+			row.pack_column_into(packer, column_number);
+			value_ends.push_back(data.size());
+		}
+		row_ends.push_back(value_ends.size());
+
+		keys.resize(keys.size() + 1);
+		Packer<ColumnValues> key_packer(keys.back());
+		pack_array_length(key_packer, primary_key_columns.size());
+		for (size_t column_number : primary_key_columns) {
+			key_packer.write_bytes(value_data(first_value + column_number), value_size(first_value + column_number));
+		}
+		key_bytes += keys.back().encoded_size();
+	}
+
+	void copy_row_to(PackedRow &dest, size_t row) const {
+		size_t first_value = (row ? row_ends[row - 1] : 0);
+		dest.resize(n_columns(row));
+		for (size_t column_number = 0; column_number < dest.size(); column_number++) {
+			dest[column_number].clear();
+			dest[column_number].write(value_data(first_value + column_number), value_size(first_value + column_number));
+		}
+	}
+
+	// called by the packer
+	inline void write(const uint8_t *buf, size_t bytes) {
+		data.insert(data.end(), buf, buf + bytes);
+	}
+
+	vector<uint8_t> data;
+	vector<size_t> value_ends;
+	vector<size_t> row_ends;
+	vector<ColumnValues> keys;
+	size_t key_bytes;
+	int read_by_worker; // whose database connection we read them using, see LocalRowCache::take
+	Packer<LocalRows> packer;
+};
+
+// presents one of the kept rows in the same way as a database row, so that it can be given to the same row receivers
+struct LocalRow {
+	LocalRow(const LocalRows &rows, size_t row): rows(rows), first_value(row ? rows.row_ends[row - 1] : 0), columns(rows.n_columns(row)) {}
+
+	inline size_t n_columns() const { return columns; }
+
+	template <typename Packer>
+	inline void pack_column_into(Packer &packer, size_t column_number) const {
+		packer.write_bytes(rows.value_data(first_value + column_number), rows.value_size(first_value + column_number));
+	}
+
+	const LocalRows &rows;
+	size_t first_value;
+	size_t columns;
+};
+
+// row receiver that passes the rows on to another receiver, and keeps them too unless they add up to more than the
+// given number of bytes
+template <typename RowReceiver>
+struct LocalRowCollector {
+	LocalRowCollector(RowReceiver &receiver, const vector<size_t> &primary_key_columns, size_t max_bytes): receiver(receiver), primary_key_columns(primary_key_columns), max_bytes(max_bytes), collecting(max_bytes > 0), local_rows(make_shared<LocalRows>()) {}
+
+	template <typename DatabaseRow>
+	inline void operator()(const DatabaseRow &row) {
+		receiver(row);
+
+		if (collecting) {
+			local_rows->add(row, primary_key_columns);
+
+			if (local_rows->memory_used() > max_bytes) {
+				local_rows.reset(new LocalRows);
+				collecting = false;
+			}
+		}
+	}
+
+	RowReceiver &receiver;
+	const vector<size_t> &primary_key_columns;
+	size_t max_bytes;
+	bool collecting;
+	shared_ptr<LocalRows> local_rows;
+};
+
+// a run of kept rows; holds a reference to them, so they can be used after releasing the lock on the cache
+struct LocalRowsRange {
+	LocalRowsRange(): first_row(0), row_count(0) {}
+	LocalRowsRange(const shared_ptr<const LocalRows> &rows, size_t first_row, size_t row_count): rows(rows), first_row(first_row), row_count(row_count) {}
+
+	inline LocalRow operator[](size_t n) const { return LocalRow(*rows, first_row + n); }
+
+	shared_ptr<const LocalRows> rows;
+	size_t first_row;
+	size_t row_count;
+};
+
+struct LocalRowCacheStats {
+	LocalRowCacheStats(): hash_hits(0), hash_misses(0), apply_hits(0), apply_misses(0) {}
+
+	size_t hash_hits;
+	size_t hash_misses;
+	size_t apply_hits;
+	size_t apply_misses;
+};
+
+// keeps the rows of recently-hashed ranges of a table at our end, so that when a range doesn't match, we don't need
+// to read its rows again to hash the parts of it we check next, or to compare them to the rows the other end sends.
+// bounded by the approximate memory used by the rows, with the least recently used ranges discarded first.  not
+// thread-safe; callers that share a cache must lock it.
+struct LocalRowCache {
+	LocalRowCache(size_t max_bytes = DEFAULT_LOCAL_ROW_CACHE_BYTES): max_bytes(max_bytes), cached_bytes(0) {}
+
+	// the arguments are the same as for the HASH command; each range covers the rows after prev_key up to and
+	// including last_key, but no more than rows_to_hash rows
+	void add(const ColumnValues &prev_key, const ColumnValues &last_key, size_t rows_to_hash, const shared_ptr<const LocalRows> &rows) {
+		if (rows->size() == 0 || rows->memory_used() > max_bytes) return;
+
+		add_entry(entries.begin(), CachedKeyRange(prev_key, last_key, rows->size() < rows_to_hash), rows, 0, rows->size());
+		evict();
+	}
+
+	// finds the rows for a range that we're hashing again
+	bool find(const ColumnValues &prev_key, const ColumnValues &last_key, size_t rows_to_hash, LocalRowsRange &result) {
+		for (auto entry = entries.begin(); entry != entries.end(); ++entry) {
+			size_t first_row, row_count;
+			if (!entry->locate(prev_key, last_key, rows_to_hash, first_row, row_count)) continue;
+
+			result = LocalRowsRange(entry->rows, entry->first_row + first_row, row_count);
+			entries.splice(entries.begin(), entries, entry);
+			stats.hash_hits++;
+			return true;
+		}
+		stats.hash_misses++;
+		return false;
+	}
+
+	// finds all the rows for a range whose rows we're about to replace with the other end's, and discards them from
+	// the cache since they're about to change.  we can't tell if other cached ranges overlap the range, so we have to
+	// discard those too; we only keep the rows before and after the range in the cached range it came from.  other
+	// workers' connections don't see the changes the given worker has made, so we don't use or keep their rows.
+	bool take(const ColumnValues &prev_key, const ColumnValues &last_key, LocalRowsRange &result, int worker = ANY_WORKER) {
+		for (auto entry = entries.begin(); entry != entries.end(); ++entry) {
+			size_t first_row, row_count;
+			if (!entry->locate(prev_key, last_key, numeric_limits<size_t>::max(), first_row, row_count)) continue;
+
+			Entry taken(std::move(*entry));
+			clear();
+			if (worker != ANY_WORKER && taken.rows->read_by_worker != worker) break;
+			result = LocalRowsRange(taken.rows, taken.first_row + first_row, row_count);
+
+			if (first_row > 0) {
+				add_entry(entries.end(), CachedKeyRange(taken.key_range.prev_key, taken.rows->keys[taken.first_row + first_row - 1], true), taken.rows, taken.first_row, first_row);
+			}
+			if (first_row + row_count < taken.row_count) {
+				add_entry(entries.end(), CachedKeyRange(taken.rows->keys[result.first_row + row_count - 1], taken.key_range.last_key, taken.key_range.complete), taken.rows, result.first_row + row_count, taken.row_count - first_row - row_count);
+			}
+			stats.apply_hits++;
+			return true;
+		}
+		clear();
+		stats.apply_misses++;
+		return false;
+	}
+
+	void clear() {
+		entries.clear();
+		cached_bytes = 0;
+	}
+
+	size_t max_bytes;
+	size_t cached_bytes;
+	LocalRowCacheStats stats;
+
+protected:
+	struct Entry {
+		Entry(const CachedKeyRange &key_range, const shared_ptr<const LocalRows> &rows, size_t first_row, size_t row_count, size_t bytes):
+			key_range(key_range), rows(rows), first_row(first_row), row_count(row_count), bytes(bytes) {}
+
+		inline bool locate(const ColumnValues &prev_key, const ColumnValues &last_key, size_t rows_to_read, size_t &result_first_row, size_t &result_row_count) const {
+			return key_range.locate(rows->keys.data() + first_row, row_count, prev_key, last_key, rows_to_read, result_first_row, result_row_count);
+		}
+
+		CachedKeyRange key_range;
+		shared_ptr<const LocalRows> rows; // may be shared with other entries for other parts of the same rows
+		size_t first_row;
+		size_t row_count;
+		size_t bytes;
+	};
+
+	void add_entry(list<Entry>::iterator position, const CachedKeyRange &key_range, const shared_ptr<const LocalRows> &rows, size_t first_row, size_t row_count) {
+		size_t bytes = rows->memory_used()*row_count/rows->size(); // apportioned when the rows are split between entries
+		entries.emplace(position, key_range, rows, first_row, row_count, bytes);
+		cached_bytes += bytes;
+	}
+
+	void evict() {
+		while (cached_bytes > max_bytes) {
+			cached_bytes -= entries.back().bytes;
+			entries.pop_back();
+		}
+	}
+
+	list<Entry> entries;
+};
+
+#endif
@@ -0,0 +1,354 @@
+#ifndef LOGICAL_DECODING_H
+#define LOGICAL_DECODING_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include "schema.h"
+#include "row_serialization.h"
+
+using namespace std;
+
+struct logical_decoding_error: public runtime_error {
+	logical_decoding_error(const string &error): runtime_error(error) { }
+};
+
+// the changes we read from a logical replication slot, as sent from the 'from' end to the 'to' end in response to
+// the CHANGED_KEYS command.  upto_lsn is the position after the last transaction that we included, and is empty if
+// there weren't any; more_changes is set if we stopped before reading all the changes the slot currently has.
+struct ChangedKeys {
+	ChangedKeys(): more_changes(false) {}
+
+	string upto_lsn;
+	bool more_changes;
+	map<string, vector<ColumnValues>> keys_by_table; // by table ID, in key order
+	set<string> tables_to_reload; // tables where we couldn't tell which rows were changed, such as truncated tables
+};
+
+// postgresql's test_decoding output plugin gives us each change as a line of text, which we parse back into the
+// names and values of the columns.  values are left as SQL literals, quoted if they're not plain numbers or booleans.
+enum class DecodedChangeAction {
+	begin_transaction,
+	commit_transaction,
+	insert_row,
+	update_row,
+	delete_row,
+	truncate_tables,
+	other,
+};
+
+struct DecodedColumnValue {
+	DecodedColumnValue(): null(false), unchanged_toast(false) {}
+
+	string name;
+	string type;
+	string literal;
+	bool null;
+	bool unchanged_toast; // large values that weren't changed by an update aren't given
+};
+typedef vector<DecodedColumnValue> DecodedColumnValues;
+
+typedef pair<string, string> DecodedTableName; // schema name and table name
+
+struct DecodedChange {
+	DecodedChange(): action(DecodedChangeAction::other), no_tuple_data(false) {}
+
+	DecodedChangeAction action;
+	vector<DecodedTableName> tables; // only truncates can list more than one table
+	DecodedColumnValues old_key; // given for deletes, and for updates that changed the replica identity columns
+	DecodedColumnValues new_tuple; // given for inserts and updates
+	bool no_tuple_data; // set if the table's replica identity doesn't give us the row at all
+};
+
+struct TestDecodingParser {
+	TestDecodingParser(const string &data): data(data), pos(0) {}
+
+	void parse(DecodedChange &change) {
+		if (consume("BEGIN")) {
+			change.action = DecodedChangeAction::begin_transaction;
+		} else if (consume("COMMIT")) {
+			change.action = DecodedChangeAction::commit_transaction;
+		} else if (consume("table ")) {
+			do {
+				string schema_name(identifier());
+				expect(".");
+				change.tables.emplace_back(schema_name, identifier());
+			} while (consume(", "));
+			expect(": ");
+
+			if (consume("INSERT:")) {
+				change.action = DecodedChangeAction::insert_row;
+				parse_tuple(change.new_tuple, change.no_tuple_data);
+			} else if (consume("UPDATE:")) {
+				change.action = DecodedChangeAction::update_row;
+				if (consume(" old-key:")) {
+					parse_tuple(change.old_key, change.no_tuple_data);
+					expect(" new-tuple:");
+				}
+				parse_tuple(change.new_tuple, change.no_tuple_data);
+			} else if (consume("DELETE:")) {
+				change.action = DecodedChangeAction::delete_row;
+				parse_tuple(change.old_key, change.no_tuple_data);
+			} else if (consume("TRUNCATE:")) {
+				change.action = DecodedChangeAction::truncate_tables;
+			} else {
+				throw logical_decoding_error("Don't know how to parse decoded change: " + data);
+			}
+		} else {
+			change.action = DecodedChangeAction::other; // eg. logical decoding messages
+		}
+	}
+
+	void parse_tuple(DecodedColumnValues &values, bool &no_tuple_data) {
+		if (consume(" (no-tuple-data)")) {
+			no_tuple_data = true;
+			return;
+		}
+
+		// each column is given as a space followed by name[type]:value
+		while (pos < data.size() && data[pos] == ' ' && data.compare(pos, 11, " new-tuple:") != 0) {
+			pos++;
+			DecodedColumnValue value;
+			value.name = identifier();
+			expect("[");
+			size_t type_end = data.find("]:", pos); // array types end in [], so look for the colon too
+			if (type_end == string::npos) throw logical_decoding_error("Couldn't find the end of the type in decoded change: " + data);
+			value.type = data.substr(pos, type_end - pos);
+			pos = type_end + 2;
+			parse_value(value);
+			values.push_back(value);
+		}
+	}
+
+	void parse_value(DecodedColumnValue &value) {
+		size_t start = pos;
+		if (data[pos] == '\'' || data.compare(pos, 2, "B'") == 0) {
+			// quoted values have any embedded quotes doubled up
+			pos = data.find('\'', pos) + 1;
+			while (true) {
+				size_t quote = data.find('\'', pos);
+				if (quote == string::npos) throw logical_decoding_error("Couldn't find the end of a quoted value in decoded change: " + data);
+				pos = quote + 1;
+				if (pos >= data.size() || data[pos] != '\'') break;
+				pos++;
+			}
+		} else {
+			pos = min(data.find(' ', pos), data.size());
+		}
+		value.literal = data.substr(start, pos - start);
+		value.null = (value.literal == "null");
+		value.unchanged_toast = (value.literal == "unchanged-toast-datum");
+	}
+
+	string identifier() {
+		if (!consume("\"")) {
+			// identifiers are only quoted if they need to be, so unquoted identifiers only have these characters
+			size_t end = min(data.find_first_not_of("abcdefghijklmnopqrstuvwxyz0123456789_", pos), data.size());
+			if (end == pos) throw logical_decoding_error("Couldn't find an identifier at position " + to_string(pos) + " in decoded change: " + data);
+			string result(data.substr(pos, end - pos));
+			pos = end;
+			return result;
+		}
+
+		string result;
+		while (true) {
+			size_t quote = data.find('"', pos);
+			if (quote == string::npos) throw logical_decoding_error("Couldn't find the end of a quoted identifier in decoded change: " + data);
+			result += data.substr(pos, quote - pos);
+			pos = quote + 1;
+			if (!consume("\"")) return result;
+			result += '"';
+		}
+	}
+
+	inline bool consume(const char *str) {
+		size_t length = strlen(str);
+		if (data.compare(pos, length, str) != 0) return false;
+		pos += length;
+		return true;
+	}
+
+	inline void expect(const char *str) {
+		if (!consume(str)) throw logical_decoding_error("Expected '" + string(str) + "' at position " + to_string(pos) + " in decoded change: " + data);
+	}
+
+	const string &data;
+	size_t pos;
+};
+
+inline void parse_test_decoding_change(const string &data, DecodedChange &change) {
+	TestDecodingParser(data).parse(change);
+}
+
+// the text form of a transaction snapshot, as given by txid_current_snapshot(): xmin:xmax:xip1,xip2,...
+struct TxidSnapshot {
+	TxidSnapshot(const string &snapshot) {
+		const char *str = snapshot.c_str();
+		char *end;
+		xmin = strtoull(str, &end, 10);
+		if (*end != ':') throw logical_decoding_error("Couldn't parse transaction snapshot " + snapshot);
+		xmax = strtoull(end + 1, &end, 10);
+		if (*end != ':') throw logical_decoding_error("Couldn't parse transaction snapshot " + snapshot);
+		while (*end && *(end + 1)) {
+			in_progress.insert(strtoull(end + 1, &end, 10));
+		}
+	}
+
+	// the changes we read give the 32-bit transaction IDs, which wrap around, so we take the nearest 64-bit ID before
+	// xmax; transactions that started after our snapshot can't be visible to it, so we don't need to look past xmax.
+	inline bool visible(uint32_t xid) const {
+		int32_t offset = static_cast<int32_t>(xid - static_cast<uint32_t>(xmax));
+		if (offset >= 0) return false;
+		uint64_t txid = xmax + offset;
+		return (txid < xmin || !in_progress.count(txid));
+	}
+
+	uint64_t xmin;
+	uint64_t xmax;
+	set<uint64_t> in_progress;
+};
+
+// gives the values of the table's primary key columns as literals cast to their types, in order; returns false if any
+// of them weren't given, for example because they aren't part of the table's replica identity
+inline bool decoded_key_literals(const Table &table, const DecodedColumnValues &values, vector<string> &key) {
+	key.clear();
+	for (size_t column : table.primary_key_columns) {
+		const string &column_name(table.columns[column].name);
+		auto value = find_if(values.begin(), values.end(), [&](const DecodedColumnValue &value) { return value.name == column_name; });
+		if (value == values.end() || value->unchanged_toast) return false;
+
+		if (value->null) {
+			key.push_back("NULL::" + value->type);
+		} else if (value->literal[0] == '\'' || value->literal[0] == 'B') {
+			key.push_back(value->literal + "::" + value->type);
+		} else {
+			key.push_back("'" + value->literal + "'::" + value->type);
+		}
+	}
+	return true;
+}
+
+// reads the lsn, xid, and data columns returned by pg_logical_slot_peek_changes, and collects the keys of the rows
+// changed by each transaction visible in our snapshot.  we stop at the first transaction that isn't visible, since the
+// rows it changed may not be in our snapshot yet; its changes will be read again next time.
+struct LogicalChangesCollector {
+	LogicalChangesCollector(const map<DecodedTableName, const Table *> &tables_by_name, const TxidSnapshot &snapshot): tables_by_name(tables_by_name), snapshot(snapshot), changes_read(0), stopped(false) {}
+
+	template <typename DatabaseRow>
+	void operator()(const DatabaseRow &row) {
+		add(row.string_at(0), strtoul(row.string_at(1).c_str(), nullptr, 10), row.string_at(2));
+	}
+
+	void add(const string &lsn, uint32_t xid, const string &data) {
+		changes_read++;
+		if (stopped) return;
+
+		DecodedChange change;
+		parse_test_decoding_change(data, change);
+
+		switch (change.action) {
+			case DecodedChangeAction::begin_transaction:
+				if (!snapshot.visible(xid)) {
+					stopped = true;
+					return;
+				}
+				transaction_keys.clear();
+				transaction_tables_to_reload.clear();
+				break;
+
+			case DecodedChangeAction::commit_transaction:
+				for (auto const &it : transaction_keys) {
+					keys_by_table[it.first].insert(it.second.begin(), it.second.end());
+				}
+				tables_to_reload.insert(transaction_tables_to_reload.begin(), transaction_tables_to_reload.end());
+				upto_lsn = lsn;
+				break;
+
+			case DecodedChangeAction::insert_row:
+				row_changed(change.tables.front(), change.new_tuple, change.no_tuple_data);
+				break;
+
+			case DecodedChangeAction::update_row:
+				if (!change.old_key.empty()) row_changed(change.tables.front(), change.old_key, change.no_tuple_data);
+				row_changed(change.tables.front(), change.new_tuple, change.no_tuple_data);
+				break;
+
+			case DecodedChangeAction::delete_row:
+				row_changed(change.tables.front(), change.old_key, change.no_tuple_data);
+				break;
+
+			case DecodedChangeAction::truncate_tables:
+				for (const DecodedTableName &table_name : change.tables) {
+					auto table = tables_by_name.find(table_name);
+					if (table != tables_by_name.end()) transaction_tables_to_reload.insert(table->second->id_from_name());
+				}
+				break;
+
+			case DecodedChangeAction::other:
+				break;
+		}
+	}
+
+	void row_changed(const DecodedTableName &table_name, const DecodedColumnValues &values, bool no_tuple_data) {
+		auto table = tables_by_name.find(table_name);
+		if (table == tables_by_name.end()) return; // not a table we're syncing
+
+		vector<string> key;
+		if (no_tuple_data || !table->second->enforceable_primary_key() || !decoded_key_literals(*table->second, values, key)) {
+			transaction_tables_to_reload.insert(table->second->id_from_name());
+		} else {
+			transaction_keys[table->second->id_from_name()].insert(key);
+		}
+	}
+
+	const map<DecodedTableName, const Table *> &tables_by_name;
+	const TxidSnapshot &snapshot;
+	size_t changes_read;
+	bool stopped;
+	string upto_lsn;
+	map<string, set<vector<string>>> keys_by_table;
+	set<string> tables_to_reload;
+	map<string, set<vector<string>>> transaction_keys;
+	set<string> transaction_tables_to_reload;
+};
+
+// selects the given key literals back out of the database so that they're converted to values of the right types
+inline string changed_keys_sql(const set<vector<string>> &keys) {
+	string result("SELECT DISTINCT * FROM (VALUES ");
+	for (auto key = keys.begin(); key != keys.end(); ++key) {
+		if (key != keys.begin()) result += ", ";
+		result += '(';
+		for (auto value = key->begin(); value != key->end(); ++value) {
+			if (value != key->begin()) result += ", ";
+			result += *value;
+		}
+		result += ')';
+	}
+	result += ") AS changed_keys ORDER BY ";
+	for (size_t n = 1; n <= keys.begin()->size(); n++) {
+		if (n > 1) result += ", ";
+		result += to_string(n);
+	}
+	return result;
+}
+
+struct KeysCollector {
+	template <typename DatabaseRow>
+	inline void operator()(const DatabaseRow &row) {
+		ColumnValues values;
+		Packer<ColumnValues> packer(values);
+		pack_row_into(packer, row);
+		keys.push_back(values);
+	}
+
+	vector<ColumnValues> keys;
+};
+
+#endif
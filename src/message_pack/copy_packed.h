@@ -157,18 +157,29 @@ Packer<Stream> &operator <<(Packer<Stream> &packer, const PackedValue &obj) {
 }
 
 struct PackedValueReadStream {
-	inline PackedValueReadStream(const uint8_t *data): data(data) {}
-	inline PackedValueReadStream(const PackedValue &value): data(value.data()) {}
+	inline PackedValueReadStream(const uint8_t *data): data(data), pin_start(data) {}
+	inline PackedValueReadStream(const PackedValue &value): data(value.data()), pin_start(data) {}
 
 	inline void read(uint8_t *dest, size_t bytes) {
 		memcpy(dest, data, bytes);
 		data += bytes;
 	}
 
+	inline void skip(size_t bytes) {
+		data += bytes;
+	}
+
 	inline uint8_t peek() const { return (data ? *data : 0); }
 	inline uint8_t next() { return *data++; }
 
+	// the whole value is already in memory, so there's nothing to keep hold of; see FDReadStream
+	inline void pin() { pin_start = data; }
+	inline void unpin() {}
+	inline const uint8_t *pinned_data() const { return pin_start; }
+	inline size_t pinned_bytes() const { return data - pin_start; }
+
 	const uint8_t *data;
+	const uint8_t *pin_start;
 };
 
 #endif
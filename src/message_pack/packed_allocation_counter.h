@@ -0,0 +1,20 @@
+#ifndef PACKED_ALLOCATION_COUNTER_H
+#define PACKED_ALLOCATION_COUNTER_H
+
+#include <stddef.h>
+
+// allocation counting is only compiled in to the benchmark utility, so that it costs nothing in the real programs
+#ifdef COUNT_PACKED_ALLOCATIONS
+inline size_t &packed_allocations() {
+	static size_t allocations = 0;
+	return allocations;
+}
+
+inline void count_packed_allocation() {
+	packed_allocations()++;
+}
+#else
+inline void count_packed_allocation() {}
+#endif
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef PACKED_ARENA_H
+#define PACKED_ARENA_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <vector>
+#include <stdexcept>
+
+#include "packed_allocation_counter.h"
+
+// simple bump allocator for the buffers of PackedValues that are decoded and then discarded as a batch, such as
+// the source rows buffered by RowRangeApplier.  individual allocations are never freed; instead reset() releases
+// everything allocated so far in one go, so the caller must make sure no values using the arena are still alive.
+struct PackedArena {
+	static const size_t CHUNK_SIZE = 256*1024;
+	static const size_t MAX_SIZE_TO_BUMP_ALLOCATE = CHUNK_SIZE/8; // larger values get their own allocation so we don't waste the rest of a chunk
+
+	PackedArena(): chunks_used(0), next_byte(nullptr), remaining(0) {}
+
+	~PackedArena() {
+		reset();
+		for (uint8_t *chunk : chunks) free(chunk);
+	}
+
+	PackedArena(const PackedArena &from) = delete;
+	PackedArena &operator=(const PackedArena &from) = delete;
+
+	inline uint8_t *allocate(size_t bytes) {
+		if (bytes > MAX_SIZE_TO_BUMP_ALLOCATE) return allocate_separately(bytes);
+		if (bytes > remaining) next_chunk();
+		uint8_t *result = next_byte;
+		next_byte += bytes;
+		remaining -= bytes;
+		return result;
+	}
+
+	void reset() {
+		// we keep the chunks to reuse for the next batch, but not the separate allocations
+		for (uint8_t *allocation : separate_allocations) free(allocation);
+		separate_allocations.clear();
+		chunks_used = 0;
+		next_byte = nullptr;
+		remaining = 0;
+	}
+
+private:
+	void next_chunk() {
+		if (chunks_used == chunks.size()) {
+			uint8_t *chunk = (uint8_t *)malloc(CHUNK_SIZE);
+			if (!chunk) throw std::bad_alloc();
+			count_packed_allocation();
+			chunks.push_back(chunk);
+		}
+		next_byte = chunks[chunks_used++];
+		remaining = CHUNK_SIZE;
+	}
+
+	uint8_t *allocate_separately(size_t bytes) {
+		uint8_t *allocation = (uint8_t *)malloc(bytes);
+		if (!allocation) throw std::bad_alloc();
+		count_packed_allocation();
+		separate_allocations.push_back(allocation);
+		return allocation;
+	}
+
+	std::vector<uint8_t *> chunks;
+	std::vector<uint8_t *> separate_allocations;
+	size_t chunks_used;
+	uint8_t *next_byte;
+	size_t remaining;
+};
+
+#endif
@@ -6,47 +6,47 @@
 #include <stdlib.h>
 #include <stdexcept>
 
+#include "packed_arena.h"
+
 #define FIXED_PACKED_BUFFER_SIZE 16
 
 struct PackedBuffer {
-	PackedBuffer(): used(0) {}
+	PackedBuffer(): used(0), capacity(FIXED_PACKED_BUFFER_SIZE), arena(nullptr) {}
 
 	~PackedBuffer() {
-		if (heap_allocated()) free(_allocd);
+		release();
 	}
 
-	PackedBuffer(const PackedBuffer &from): used(0) {
+	// copies don't share the source's arena, since they may well outlive the batch it belongs to
+	PackedBuffer(const PackedBuffer &from): used(0), capacity(FIXED_PACKED_BUFFER_SIZE), arena(nullptr) {
 		*this = from;
 	}
 
-	PackedBuffer(PackedBuffer &&from): used(0) {
+	PackedBuffer(PackedBuffer &&from): used(0), capacity(FIXED_PACKED_BUFFER_SIZE), arena(from.arena) {
 		*this = std::move(from);
 	}
 
 	PackedBuffer &operator=(const PackedBuffer &from) {
 		if (&from != this) {
-			clear();
-			if (from.heap_allocated()) {
-				_allocd = (uint8_t *)malloc(from.used);
-				if (!_allocd) throw std::bad_alloc();
-				memcpy(_allocd, from._allocd, from.used);
-			} else if (from.used) {
-				memcpy(_inline, from._inline, from.used);
-			}
-			used = from.used;
+			used = 0;
+			if (from.used) memcpy(extend(from.used), from.buffer(), from.used);
 		}
 		return *this;
 	}
 
 	PackedBuffer &operator=(PackedBuffer &&from) {
 		if (this != &from) {
-			if (heap_allocated()) free(_allocd);
-			if (from.heap_allocated()) {
+			if (from.heap_allocated() && from.arena == arena) {
+				// we can take over their buffer
+				release();
 				_allocd = from._allocd;
+				capacity = from.capacity;
+				used = from.used;
+				from.capacity = FIXED_PACKED_BUFFER_SIZE;
 			} else {
-				memcpy(_inline, from._inline, from.used);
+				// their buffer is inline, or belongs to an arena that we don't, so copy it
+				*this = static_cast<const PackedBuffer &>(from);
 			}
-			used = from.used;
 			from.used = 0;
 		}
 		return *this;
@@ -54,25 +54,13 @@ struct PackedBuffer {
 
 	inline uint8_t *extend(size_t bytes) {
 		size_t used_before = used;
-
-		if (heap_allocated()) {
-			uint8_t *new_malloc = (uint8_t *)realloc(_allocd, used + bytes);
-			if (!new_malloc) throw std::bad_alloc();
-			_allocd = new_malloc;
-
-		} else if (used + bytes > FIXED_PACKED_BUFFER_SIZE) {
-			uint8_t *new_malloc = (uint8_t *)malloc(used + bytes);
-			if (!new_malloc) throw std::bad_alloc();
-			memcpy(new_malloc, _inline, used_before);
-			_allocd = new_malloc;
-		}
-
+		if (used + bytes > capacity) grow(used + bytes);
 		used += bytes;
 		return buffer() + used_before;
 	}
 
+	// note that we keep the buffer, since the commonest reason to clear a value is to reuse it for the next row
 	inline void clear() {
-		if (heap_allocated()) free(_allocd);
 		used = 0;
 	}
 
@@ -80,12 +68,52 @@ struct PackedBuffer {
 		memcpy(extend(bytes), src, bytes);
 	}
 
+	// subsequent allocations for this value will come from the given arena (or the heap, if null)
+	inline void use_arena(PackedArena *new_arena) {
+		if (arena != new_arena) {
+			release();
+			arena = new_arena;
+		}
+	}
+
 protected:
-	inline   bool heap_allocated() const { return (used > FIXED_PACKED_BUFFER_SIZE); }
+	inline   bool heap_allocated() const { return (capacity > FIXED_PACKED_BUFFER_SIZE); }
 	inline const uint8_t *buffer() const { return (heap_allocated() ? _allocd : _inline); }
 	inline       uint8_t *buffer()       { return (heap_allocated() ? _allocd : _inline); }
 
+	void grow(size_t required) {
+		// grow geometrically so that values built up a few bytes at a time don't reallocate on every extend()
+		size_t new_capacity = capacity*2;
+		if (new_capacity < required) new_capacity = required;
+
+		uint8_t *new_buffer;
+		if (arena) {
+			new_buffer = arena->allocate(new_capacity);
+			memcpy(new_buffer, buffer(), used);
+		} else if (heap_allocated()) {
+			new_buffer = (uint8_t *)realloc(_allocd, new_capacity);
+			if (!new_buffer) throw std::bad_alloc();
+			count_packed_allocation();
+		} else {
+			new_buffer = (uint8_t *)malloc(new_capacity);
+			if (!new_buffer) throw std::bad_alloc();
+			count_packed_allocation();
+			memcpy(new_buffer, _inline, used);
+		}
+
+		_allocd = new_buffer;
+		capacity = new_capacity;
+	}
+
+	inline void release() {
+		if (heap_allocated() && !arena) free(_allocd);
+		capacity = FIXED_PACKED_BUFFER_SIZE;
+		used = 0;
+	}
+
 	size_t used;
+	size_t capacity;
+	PackedArena *arena;
 	union {
 		uint8_t  _inline[FIXED_PACKED_BUFFER_SIZE];
 		uint8_t *_allocd;
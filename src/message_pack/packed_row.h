@@ -3,6 +3,7 @@
 
 #include <vector>
 #include "packed_value.h"
+#include "copy_packed.h"
 
 typedef vector<PackedValue> PackedRow;
 
@@ -19,4 +20,25 @@ static void pack_array_length(PackedRow &row, size_t size) {
 	row.reserve(size);
 }
 
-#endif
\ No newline at end of file
+// more specific than the generic vector overload; when the same row object is used to read each row in turn, we
+// keep the existing values and their buffers instead of destroying them and allocating new ones for every row
+template <typename Stream>
+Unpacker<Stream> &operator >>(Unpacker<Stream> &unpacker, PackedRow &row) {
+	size_t array_length = unpacker.next_array_length();
+	row.resize(array_length);
+	for (PackedValue &value : row) {
+		unpacker >> value;
+	}
+	return unpacker;
+}
+
+// copies the row's values into buffers allocated from the arena, rather than individually on the heap
+inline void copy_row_using_arena(PackedRow &dest, const PackedRow &src, PackedArena &arena) {
+	dest.resize(src.size());
+	for (size_t n = 0; n < src.size(); n++) {
+		dest[n].use_arena(&arena);
+		dest[n] = src[n];
+	}
+}
+
+#endif
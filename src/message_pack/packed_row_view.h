@@ -0,0 +1,71 @@
+#ifndef PACKED_ROW_VIEW_H
+#define PACKED_ROW_VIEW_H
+
+#include <vector>
+#include "packed_row.h"
+
+// non-owning equivalent of PackedValue, referring to the encoded bytes where they already are - normally in the
+// receive buffer of the stream that the row was read from.  only valid until the next read from that stream.
+struct PackedValueView {
+	PackedValueView(): _data(nullptr), _size(0) {}
+	PackedValueView(const uint8_t *data, size_t size): _data(data), _size(size) {}
+
+	inline size_t encoded_size() const { return _size; }
+	inline uint8_t leader() const { return (_size ? *_data : 0); }
+	inline const uint8_t *data() const { return _data; }
+
+	inline bool is_nil() const { return (leader() == MSGPACK_NIL); }
+
+	const uint8_t *_data;
+	size_t _size;
+};
+
+// non-owning equivalent of PackedRow.  rows are read by pinning the stream's buffer and skipping over each value,
+// so that the values can be encoded into SQL straight from the bytes we received without copying them out first.
+// rows that need to outlive the next read from the stream must be copied into a PackedRow.
+struct PackedRowView {
+	inline size_t size() const { return values.size(); }
+	inline const PackedValueView &operator[](size_t n) const { return values[n]; }
+	inline const PackedValueView &back() const { return values.back(); }
+	inline std::vector<PackedValueView>::const_iterator begin() const { return values.begin(); }
+	inline std::vector<PackedValueView>::const_iterator end() const { return values.end(); }
+
+	std::vector<PackedValueView> values;
+	std::vector<size_t> offsets; // kept only so that we don't reallocate for every row
+};
+
+template <typename Stream>
+Unpacker<Stream> &operator >>(Unpacker<Stream> &unpacker, PackedRowView &row) {
+	Stream &stream(unpacker.stream());
+	stream.pin();
+
+	size_t array_length = unpacker.next_array_length();
+	row.offsets.resize(array_length + 1);
+	for (size_t n = 0; n < array_length; n++) {
+		row.offsets[n] = stream.pinned_bytes();
+		unpacker.skip();
+	}
+	row.offsets[array_length] = stream.pinned_bytes();
+
+	// the buffer may have moved while we were reading, so we can only resolve the pointers once we're done
+	const uint8_t *data = stream.pinned_data();
+	row.values.resize(array_length);
+	for (size_t n = 0; n < array_length; n++) {
+		row.values[n] = PackedValueView(data + row.offsets[n], row.offsets[n + 1] - row.offsets[n]);
+	}
+
+	stream.unpin();
+	return unpacker;
+}
+
+// copies the row's values into buffers allocated from the arena, taking ownership of them
+inline void copy_row_using_arena(PackedRow &dest, const PackedRowView &src, PackedArena &arena) {
+	dest.resize(src.size());
+	for (size_t n = 0; n < src.size(); n++) {
+		dest[n].use_arena(&arena);
+		dest[n].clear();
+		dest[n].write(src[n].data(), src[n].encoded_size());
+	}
+}
+
+#endif
@@ -24,7 +24,7 @@ template <typename Stream>
 class Unpacker {
 public:
 	inline Unpacker(Stream &stream): st(stream) {}
-	inline const Stream &stream() { return st; }
+	inline Stream &stream() { return st; }
 
 	// reads the next value of the selected type from the data stream, detecting the encoding format and converting
 	// to the type, applying byte order conversion if necessary.
@@ -55,6 +55,33 @@ public:
 		}
 	}
 
+	// reads the header of a raw or bin value, returning the number of bytes of data that follow it
+	size_t next_raw_length() {
+		uint8_t leader = read_bytes<uint8_t>();
+
+		if (leader >= MSGPACK_FIXRAW_MIN && leader <= MSGPACK_FIXRAW_MAX) {
+			return (leader & 31);
+		}
+
+		switch (leader) {
+			case MSGPACK_RAW8:
+			case MSGPACK_BIN8:
+				return read_bytes<uint8_t>();
+
+			case MSGPACK_RAW16:
+			case MSGPACK_BIN16:
+				return ntohs(read_bytes<uint16_t>());
+
+			case MSGPACK_RAW32:
+			case MSGPACK_BIN32:
+				return ntohl(read_bytes<uint32_t>());
+
+			default:
+				backtrace();
+				throw unpacker_error("Don't know how to convert MessagePack type " + to_string((int)leader) + " to string");
+		}
+	}
+
 	size_t next_map_length() {
 		uint8_t leader = read_bytes<uint8_t>();
 
@@ -269,33 +296,7 @@ Unpacker<Stream> &operator >>(Unpacker<Stream> &unpacker, T &obj) {
 
 template <typename Stream>
 Unpacker<Stream> &operator >>(Unpacker<Stream> &unpacker, std::string &obj) {
-	uint8_t leader = unpacker.template read_bytes<uint8_t>();
-
-	if (leader >= MSGPACK_FIXRAW_MIN && leader <= MSGPACK_FIXRAW_MAX) {
-		obj.resize(leader & 31);
-	} else {
-		switch(leader) {
-			case MSGPACK_RAW8:
-			case MSGPACK_BIN8:
-				obj.resize(unpacker.template read_bytes<uint8_t>());
-				break;
-
-			case MSGPACK_RAW16:
-			case MSGPACK_BIN16:
-				obj.resize(ntohs(unpacker.template read_bytes<uint16_t>()));
-				break;
-
-			case MSGPACK_RAW32:
-			case MSGPACK_BIN32:
-				obj.resize(ntohl(unpacker.template read_bytes<uint32_t>()));
-				break;
-
-			default:
-				backtrace();
-				throw unpacker_error("Don't know how to convert MessagePack type " + to_string((int)leader) + " to string");
-		}
-	}
-
+	obj.resize(unpacker.next_raw_length());
 	unpacker.read_bytes((uint8_t *)obj.data(), obj.size());
 	return unpacker;
 }
@@ -9,10 +9,12 @@
 #include "defaults.h"
 #include "db_url.h"
 #include "version.h"
+#include "sample_budget.h"
 
 struct Options {
-	inline Options(): workers(1), verbose(0), progress(false), snapshot(true), alter(false), structure_only(false),
-    commit_level(CommitLevel::often), hash_algorithm(HashAlgorithm::auto_select) {}
+	inline Options(): workers(1), verbose(0), progress(false), snapshot(true), alter(false), structure_only(false), defer_indexes(false),
+    commit_level(CommitLevel::often), hash_algorithm(HashAlgorithm::auto_select), hash_threads(1), hash_keys_first(false), resume(false), digest_small_tables(false),
+    skip_unchanged_tables(false), verify_interval(DEFAULT_VERIFY_INTERVAL_HOURS), auto_reload(false), verify(false) {}
 
 	void help() {
 		cerr <<
@@ -48,6 +50,26 @@ struct Options {
 			"  --filters file.yml         Local YAML file to read table/column filtering \n"
 			"                             information from.\n"
 			"\n"
+			"  --state-file file.yml      Local YAML file in which to record the state of the\n"
+			"                             tables that have a changes_tracked_by column given\n"
+			"                             in the filters file, such as an indexed updated_at\n"
+			"                             column.  Tables whose row count and greatest value\n"
+			"                             for that column haven't changed at either end since\n"
+			"                             the last successful run are skipped.  Use a separate\n"
+			"                             file for each target database.\n"
+			"\n"
+			"  --journal file             Local file in which to record the key ranges that\n"
+			"                             have been synced as the run goes, so that if it is\n"
+			"                             interrupted, it can be resumed using --resume.\n"
+			"                             Needs --commit often.  Removed when the run\n"
+			"                             completes.\n"
+			"\n"
+			"  --resume                   Skip the tables and key ranges recorded in the\n"
+			"                             --journal file by an interrupted run with the same\n"
+			"                             options.  Changes made at the 'from' end in those\n"
+			"                             ranges since they were synced are not picked up\n"
+			"                             until the next full run.\n"
+			"\n"
 			"  --set-from-variables var   SET variables to apply at the 'from' end (eg. \n"
 			"                             --set-from-variables=\"sql_log_off=0, \n"
 			"                             time_zone='UTC'\")\n"
@@ -86,12 +108,101 @@ struct Options {
 			"                             and if it doesn't match the statements --alter\n"
 			"                             would use are printed as suggestions.)"
 			"\n"
+			"  --defer-indexes            When --alter creates tables, create only their\n"
+			"                             primary and unique keys at first, and build their\n"
+			"                             other indexes using all the workers once the data\n"
+			"                             has been loaded.  Only used with --commit often.\n"
+			"\n"
 			"  --hash arg                 Use the specified checksum algorithm.  The default\n"
 			"                             is BLAKE3, falling back to MD5 for older versions.\n"
 			"                             You can downgrade to XXH64 if you prioritize maximum\n"
 			"                             performance and can tolerate a small risk of error.\n"
 			"                             This is not considered appropriate for production\n"
 			"                             use, but may be useful for dev/test machines.\n"
+			"                             XXH3 (128-bit) is faster still and has a much lower\n"
+			"                             risk of error than XXH64; it needs both ends to be\n"
+			"                             running version 2.22 or later.  XXH3_ROWS hashes\n"
+			"                             each row with XXH3 and then hashes the row hashes,\n"
+			"                             which lets both ends remember the row hashes and\n"
+			"                             avoid re-reading rows when narrowing down changes.\n"
+			"\n"
+			"  --hash-threads num         The number of threads each end may use to hash each\n"
+			"                             large range of rows when using BLAKE3.  Defaults to\n"
+			"                             1.  The threads are shared by all the workers at\n"
+			"                             each end (at the 'from' end, the extra threads are\n"
+			"                             split between the workers' processes), so this is\n"
+			"                             useful when there are more cores than workers and\n"
+			"                             hashing is the bottleneck.\n"
+			"\n"
+			"  --hash-keys-first          Compare just the primary key values of each range\n"
+			"                             first, which the database can normally read from\n"
+			"                             the index, to find inserted and deleted rows, and\n"
+			"                             then compare the whole rows only where the keys\n"
+			"                             match.  Useful when most changes are inserts and\n"
+			"                             deletes and the rows are wide.  Needs both ends to\n"
+			"                             be running version 2.22 or later.\n"
+			"\n"
+			"  --keys-only tables         Comma-separated list of tables whose rows are never\n"
+			"                             updated, only inserted or deleted.  These tables\n"
+			"                             are compared using just their primary key values,\n"
+			"                             as for --hash-keys-first, and their rows are\n"
+			"                             assumed to match if their keys do.\n"
+			"\n"
+			"  --catch-up slot            Instead of comparing the tables, apply just the rows\n"
+			"                             changed since the last run, as given by the named\n"
+			"                             PostgreSQL logical replication slot, which must use\n"
+			"                             the test_decoding plugin.  Run a normal sync first;\n"
+			"                             changes are only consumed from the slot once they\n"
+			"                             have been committed at the 'to' end.  Needs both\n"
+			"                             ends to be running version 2.22 or later.\n"
+			"\n"
+			"  --digest-small-tables      Compare the tables that the database statistics\n"
+			"                             show are small (up to 1MB) by hashing each of them\n"
+			"                             in full, in batches of up to 100 tables per round\n"
+			"                             trip, and then sync just those that differ as usual.\n"
+			"                             Useful when there are many small tables that\n"
+			"                             rarely change.  Needs both ends to be running\n"
+			"                             version 2.22 or later.\n"
+			"\n"
+			"  --skip-unchanged-tables    Skip the tables whose server statistics at the\n"
+			"                             'from' end show no writes since they were last\n"
+			"                             synced, as recorded in the --state-file.  Uses\n"
+			"                             the row counters on PostgreSQL, and live checksums\n"
+			"                             or update times on MySQL where the server keeps\n"
+			"                             them reliably; other tables are compared as usual.\n"
+			"                             Changes made at the 'to' end aren't noticed until\n"
+			"                             the --verify-interval passes.  Needs both ends to\n"
+			"                             be running version 2.22 or later.\n"
+			"\n"
+			"  --verify-interval hours    Compare the tables skipped by --skip-unchanged-tables\n"
+			"                             anyway if they were last compared this many hours\n"
+			"                             ago.  Defaults to " << DEFAULT_VERIFY_INTERVAL_HOURS << ".\n"
+			"\n"
+			"  --auto-reload              Before comparing each table, hash a sample of its\n"
+			"                             rows at both ends, and if fewer than half match,\n"
+			"                             clear the table and reload all its rows instead.\n"
+			"                             The strategy for individual tables can be set in\n"
+			"                             the --filters file.\n"
+			"\n"
+			"  --verify                   Compare the tables but don't change them; instead,\n"
+			"                             print a line of JSON to stdout for each range of\n"
+			"                             keys that differs, giving the number of rows that\n"
+			"                             would be inserted, updated, and deleted, and a\n"
+			"                             line with the totals for each table.  Only read\n"
+			"                             transactions are used at the 'to' end, so all the\n"
+			"                             workers can retrieve and compare rows.\n"
+			"\n"
+			"  --verify-sample budget     As for --verify, but instead of comparing all the\n"
+			"                             rows, hash ranges of rows starting at random keys\n"
+			"                             until the budget for the table is used up, and\n"
+			"                             print the estimated proportion of the ranges that\n"
+			"                             differ, with the upper bound of its 95% confidence\n"
+			"                             interval.  The budget may be a percentage of the\n"
+			"                             table's size (eg. 1%), a number of seconds (eg.\n"
+			"                             30s), or a number of bytes (eg. 100MB).  Each run\n"
+			"                             picks different ranges.  Only used for tables with\n"
+			"                             a single integer or UUID primary key column; other\n"
+			"                             tables are compared in full.\n"
 			"\n"
 			"  --from-path                Directory in which to find the Kitchen Sync binaries\n"
 			"                             on the source end.  Normally you should not need this\n"
@@ -129,12 +240,26 @@ struct Options {
 					{ "only",						required_argument,	NULL,	'o' },
 					{ "structure-only",				no_argument,		NULL,	's' },
 					{ "filters",					required_argument,	NULL,	'l' },
+					{ "state-file",					required_argument,	NULL,	'S' },
+					{ "journal",					required_argument,	NULL,	'J' },
+					{ "resume",						no_argument,		NULL,	'R' },
 					{ "set-from-variables",			required_argument,	NULL,	'F' },
 					{ "set-to-variables",			required_argument,	NULL,	'T' },
 					{ "without-snapshot-export",	no_argument,		NULL,	'W' },
 					{ "commit",						required_argument,	NULL,	'c' },
 					{ "alter",						no_argument,		NULL,	'a' },
+					{ "defer-indexes",				no_argument,		NULL,	'D' },
 					{ "hash",					    required_argument,	NULL,	'h' },
+					{ "hash-threads",				required_argument,	NULL,	'H' },
+					{ "hash-keys-first",			no_argument,		NULL,	'K' },
+					{ "keys-only",					required_argument,	NULL,	'k' },
+					{ "catch-up",					required_argument,	NULL,	'U' },
+					{ "digest-small-tables",		no_argument,		NULL,	'G' },
+					{ "skip-unchanged-tables",		no_argument,		NULL,	'X' },
+					{ "verify-interval",			required_argument,	NULL,	'I' },
+					{ "auto-reload",				no_argument,		NULL,	'A' },
+					{ "verify",						no_argument,		NULL,	'Y' },
+					{ "verify-sample",				required_argument,	NULL,	'E' },
 					{ "verbose",					no_argument,		NULL,	'V' },
 					{ "progress",					no_argument,		NULL,	'p' },
 					{ "debug",						no_argument,		NULL,	'd' },
@@ -193,6 +318,18 @@ struct Options {
 						filters = optarg;
 						break;
 
+					case 'S':
+						state_file = optarg;
+						break;
+
+					case 'J':
+						journal_file = optarg;
+						break;
+
+					case 'R':
+						resume = true;
+						break;
+
 					case 'F':
 						set_from_variables = optarg;
 						break;
@@ -225,6 +362,10 @@ struct Options {
 						alter = true;
 						break;
 
+					case 'D':
+						defer_indexes = true;
+						break;
+
 					case 'h':
 						if (!strcmp(optarg, "MD5")) {
 							hash_algorithm = HashAlgorithm::md5;
@@ -232,11 +373,60 @@ struct Options {
 							hash_algorithm = HashAlgorithm::xxh64;
 						} else if (!strcmp(optarg, "BLAKE3")) {
 							hash_algorithm = HashAlgorithm::blake3;
+						} else if (!strcmp(optarg, "XXH3") || !strcmp(optarg, "XXH3_128")) {
+							hash_algorithm = HashAlgorithm::xxh3_128;
+						} else if (!strcmp(optarg, "XXH3_ROWS")) {
+							hash_algorithm = HashAlgorithm::xxh3_128_rows;
 						} else if (!strcmp(optarg, "auto")) {
 							hash_algorithm = HashAlgorithm::auto_select;
 						} else {
 							throw invalid_argument("Unknown hash algorithm: " + string(optarg));
 						}
+						break;
+
+					case 'H':
+						hash_threads = atoi(optarg);
+						if (hash_threads < 1) throw invalid_argument("Must have at least one hash thread");
+						break;
+
+					case 'K':
+						hash_keys_first = true;
+						break;
+
+					case 'k':
+						keys_only = optarg;
+						break;
+
+					case 'U':
+						catch_up_slot = optarg;
+						break;
+
+					case 'G':
+						digest_small_tables = true;
+						break;
+
+					case 'X':
+						skip_unchanged_tables = true;
+						break;
+
+					case 'I':
+						verify_interval = atoi(optarg);
+						if (verify_interval < 1) throw invalid_argument("The verify interval must be at least one hour");
+						break;
+
+					case 'A':
+						auto_reload = true;
+						break;
+
+					case 'Y':
+						verify = true;
+						break;
+
+					case 'E':
+						parse_sample_budget(optarg); // checks it's valid; the 'to' end parses it again
+						verify_sample = optarg;
+						verify = true;
+						break;
 
 					case 'V':
 						verbose = 1;
@@ -265,6 +455,12 @@ struct Options {
 				return false;
 			}
 
+			// ranges are only journaled once committed, and if we don't commit as we go, an interrupted run has nothing to resume
+			if (!journal_file.empty() && commit_level != CommitLevel::often) throw invalid_argument("--journal needs --commit often");
+			if (resume && journal_file.empty()) throw invalid_argument("--resume needs a --journal file");
+			if (skip_unchanged_tables && state_file.empty()) throw invalid_argument("--skip-unchanged-tables needs a --state-file");
+			if (verify && (alter || structure_only || !catch_up_slot.empty() || !journal_file.empty() || !state_file.empty())) throw invalid_argument("--verify can't be used with --alter, --structure-only, --catch-up, --journal, or --state-file");
+
 			return true;
 		} catch (const exception &e) {
 			cerr << e.what() << endl;
@@ -279,6 +475,8 @@ struct Options {
 	string cipher;
 	string from_path;
 	string filters;
+	string state_file;
+	string journal_file;
 	string set_from_variables;
 	string set_to_variables;
 	int workers;
@@ -288,8 +486,20 @@ struct Options {
 	bool alter;
 	CommitLevel commit_level;
 	HashAlgorithm hash_algorithm;
+	int hash_threads;
+	bool hash_keys_first;
+	bool resume;
+	bool digest_small_tables;
+	bool skip_unchanged_tables;
+	int verify_interval;
+	bool auto_reload;
+	bool verify;
+	string verify_sample;
 	bool structure_only;
+	bool defer_indexes;
 	string ignore, only;
+	string keys_only;
+	string catch_up_slot;
 };
 
 #endif
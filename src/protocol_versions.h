@@ -2,11 +2,19 @@
 #define PROTOCOL_VERSIONS_H
 
 const int EARLIEST_PROTOCOL_VERSION_SUPPORTED = 7;
-const int LATEST_PROTOCOL_VERSION_SUPPORTED = 9;
+const int LATEST_PROTOCOL_VERSION_SUPPORTED = 11;
 
 const int LAST_FILTERS_AFTER_SNAPSHOT_PROTOCOL_VERSION = 7;
 const int LAST_LEGACY_SCHEMA_FORMAT_VERSION = 7;
 const int FIRST_IDLE_COMMAND_VERSION = 8;
 const int FIRST_BLAKE3_VERSION = 9;
+const int FIRST_SPLIT_COMMAND_VERSION = 10;
+const int FIRST_XXH3_VERSION = 11;
+const int FIRST_ROW_DIGESTS_VERSION = 11;
+const int FIRST_HASH_KEYS_COMMAND_VERSION = 11;
+const int FIRST_CHANGES_COMMAND_VERSION = 11;
+const int FIRST_CATCH_UP_VERSION = 11;
+const int FIRST_DIGESTS_COMMAND_VERSION = 11;
+const int FIRST_STATISTICS_COMMAND_VERSION = 11;
 
 #endif
@@ -3,12 +3,63 @@
 
 #include "sql_functions.h"
 #include "row_serialization.h" /* for ValueCollector */
+#include "sync_state.h"
 
 template <typename DatabaseClient>
 size_t count_rows(DatabaseClient &client, const Table &table, const ColumnValues &prev_key, const ColumnValues &last_key) {
 	return atoi(client.select_one(count_rows_sql(client, table, prev_key, last_key)).c_str());
 }
 
+struct TableChangesCollector {
+	template <typename DatabaseRow>
+	inline void operator()(const DatabaseRow &row) {
+		table_changes.row_count = strtoull(row.string_at(0).c_str(), nullptr, 10);
+		table_changes.last_change = row.null_at(1) ? string() : row.string_at(1);
+	}
+
+	TableChanges table_changes;
+};
+
+// since is only used when tracking changes by row versions, and is the watermark recorded at the end of the last sync
+template <typename DatabaseClient>
+TableChanges table_changes(DatabaseClient &client, const Table &table, const string &changes_tracked_by, const string &since) {
+	TableChangesCollector receiver;
+	client.query(table_changes_sql(client, table, changes_tracked_by, since), receiver);
+	return receiver.table_changes;
+}
+
+struct KeyIndexCollector {
+	template <typename DatabaseRow>
+	inline void operator()(const DatabaseRow &row) {
+		key_indices.push_back(strtoull(row.string_at(0).c_str(), nullptr, 10));
+	}
+
+	vector<size_t> key_indices;
+};
+
+// the order of the keys depends on the column types and collations, so we have the database sort them, all in one
+// query, and return their positions in that order.  an empty key comes before all others, as for prev_key arguments.
+template <typename DatabaseClient>
+map<ColumnValues, size_t> key_positions(DatabaseClient &client, const Table &table, const set<ColumnValues> &keys) {
+	map<ColumnValues, size_t> result;
+	vector<ColumnValues> keys_to_sort;
+	for (const ColumnValues &key : keys) {
+		if (key.empty()) {
+			result[key] = 0;
+		} else {
+			keys_to_sort.push_back(key);
+		}
+	}
+	if (keys_to_sort.empty()) return result;
+
+	KeyIndexCollector receiver;
+	client.query(select_key_order_sql(client, table, keys_to_sort), receiver);
+	for (size_t position = 0; position < receiver.key_indices.size(); position++) {
+		result[keys_to_sort.at(receiver.key_indices[position])] = position + 1;
+	}
+	return result;
+}
+
 template <typename DatabaseClient>
 ColumnValues first_key(DatabaseClient &client, const Table &table) {
 	ValueCollector receiver;
@@ -23,6 +74,14 @@ ColumnValues last_key(DatabaseClient &client, const Table &table) {
 	return receiver.values;
 }
 
+// the greatest key after prev_key (if given) and before next_key, or an empty value if there are no rows in between
+template <typename DatabaseClient>
+ColumnValues last_key_between(DatabaseClient &client, const Table &table, const ColumnValues &prev_key, const ColumnValues &next_key) {
+	ValueCollector receiver;
+	client.query(select_last_key_between_sql(client, table, prev_key, next_key), receiver);
+	return receiver.values;
+}
+
 template <typename DatabaseClient>
 ColumnValues not_earlier_key(DatabaseClient &client, const Table &table, const ColumnValues &key, const ColumnValues &prev_key, const ColumnValues &last_key) {
 	ValueCollector receiver;
@@ -30,9 +89,22 @@ ColumnValues not_earlier_key(DatabaseClient &client, const Table &table, const C
 	return receiver.values;
 }
 
+template <typename DatabaseClient>
+ColumnValues nth_key(DatabaseClient &client, const Table &table, const ColumnValues &prev_key, const char *upper_op, const ColumnValues &upper_key, size_t n) {
+	ValueCollector receiver;
+	client.query(select_nth_key_sql(client, table, prev_key, upper_op, upper_key, n), receiver);
+	return receiver.values;
+}
+
 template <typename DatabaseClient, typename RowReceiver>
 size_t retrieve_rows(DatabaseClient &client, RowReceiver &row_receiver, const Table &table, const ColumnValues &prev_key, const ColumnValues &last_key, ssize_t row_count = NO_ROW_COUNT_LIMIT) {
 	return client.query(retrieve_rows_sql(client, table, prev_key, last_key, row_count), row_receiver);
 }
 
+// as for retrieve_rows, but the rows given to the receiver have only the primary key columns, in order
+template <typename DatabaseClient, typename RowReceiver>
+size_t retrieve_keys(DatabaseClient &client, RowReceiver &row_receiver, const Table &table, const ColumnValues &prev_key, const ColumnValues &last_key, ssize_t row_count = NO_ROW_COUNT_LIMIT) {
+	return client.query(retrieve_keys_sql(client, table, prev_key, last_key, row_count), row_receiver);
+}
+
 #endif
@@ -0,0 +1,128 @@
+#ifndef ROW_DIGESTS_H
+#define ROW_DIGESTS_H
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include "cached_key_range.h"
+#include "defaults.h"
+#include "row_serialization.h"
+
+// the xxh3_128_rows hash algorithm hashes each row on its own, and then hashes the list of those row digests to get
+// the hash of the range.  this is a bit slower than hashing the rows in one go, but means that the hash of any run of
+// the rows can be worked out again from their digests, without having to re-read the rows from the database.
+#define ROW_DIGEST_LENGTH sizeof(XXH128_canonical_t)
+
+struct RowDigests {
+	inline size_t rows() const { return keys.size(); }
+
+	inline size_t size_of(size_t first_row, size_t row_count) const {
+		if (!row_count) return 0;
+		return cumulative_sizes[first_row + row_count - 1] - (first_row ? cumulative_sizes[first_row - 1] : 0);
+	}
+
+	Hash hash_of(size_t first_row, size_t row_count) const {
+		XXH128_canonical_t canonical;
+		XXH128_canonicalFromHash(&canonical, XXH3_128bits(digests.data() + first_row*ROW_DIGEST_LENGTH, row_count*ROW_DIGEST_LENGTH));
+
+		Hash hash;
+		hash.md_len = sizeof(canonical.digest);
+		memcpy(hash.md_value, canonical.digest, sizeof(canonical.digest));
+		return hash;
+	}
+
+	vector<ColumnValues> keys;
+	string digests; // ROW_DIGEST_LENGTH bytes for each row
+	vector<size_t> cumulative_sizes;
+};
+
+// the results of hashing a range of rows, whether worked out from the rows themselves or from cached row digests
+struct RowDigestsRange {
+	RowDigestsRange(): row_count(0), size(0) {}
+
+	RowDigestsRange(const RowDigests &row_digests, size_t first_row, size_t row_count):
+		row_count(row_count),
+		size(row_digests.size_of(first_row, row_count)),
+		hash(row_digests.hash_of(first_row, row_count)),
+		last_key(row_count ? row_digests.keys[first_row + row_count - 1] : ColumnValues()) {}
+
+	size_t row_count;
+	size_t size;
+	Hash hash;
+	ColumnValues last_key;
+};
+
+// row receiver that digests each row and keeps its primary key
+struct RowDigester: RowLastKey {
+	RowDigester(const vector<size_t> &primary_key_columns): RowLastKey(primary_key_columns), packer(row_data), size(0) {}
+
+	template <typename DatabaseRow>
+	inline void operator()(const DatabaseRow &row) {
+		row_data.clear();
+		pack_row_into(packer, row);
+		size += row_data.encoded_size();
+
+		XXH128_canonical_t canonical;
+		XXH128_canonicalFromHash(&canonical, XXH3_128bits(row_data.data(), row_data.encoded_size()));
+		row_digests.digests.append((const char *)canonical.digest, sizeof(canonical.digest));
+		row_digests.cumulative_sizes.push_back(size);
+
+		RowLastKey::operator()(row);
+		row_digests.keys.push_back(last_key);
+	}
+
+	PackedValue row_data;
+	Packer<PackedValue> packer;
+	size_t size;
+	RowDigests row_digests;
+};
+
+// keeps the row digests of recently-hashed ranges, so that when a range doesn't match, the hashes of the parts of it
+// that we check next can be worked out without re-reading the rows.  bounded by the total number of rows kept, with
+// the least recently used ranges discarded first.  not thread-safe; callers that share a cache must lock it.
+struct RowDigestCache {
+	RowDigestCache(size_t max_rows = DEFAULT_ROW_DIGEST_CACHE_ROWS): max_rows(max_rows), cached_rows(0) {}
+
+	// the arguments are the same as for the HASH command; each range covers the rows after prev_key up to and
+	// including last_key, but no more than rows_to_hash rows
+	void add(const string &table_id, const ColumnValues &prev_key, const ColumnValues &last_key, size_t rows_to_hash, RowDigests &&row_digests) {
+		if (row_digests.rows() == 0 || row_digests.rows() > max_rows) return;
+
+		cached_rows += row_digests.rows();
+		entries.emplace_front(table_id, prev_key, last_key, row_digests.rows() < rows_to_hash, std::move(row_digests));
+
+		while (cached_rows > max_rows) {
+			cached_rows -= entries.back().row_digests.rows();
+			entries.pop_back();
+		}
+	}
+
+	bool find(const string &table_id, const ColumnValues &prev_key, const ColumnValues &last_key, size_t rows_to_hash, RowDigestsRange &result) {
+		for (auto entry = entries.begin(); entry != entries.end(); ++entry) {
+			size_t first_row, row_count;
+			if (entry->table_id != table_id || !entry->key_range.locate(entry->row_digests.keys.data(), entry->row_digests.rows(), prev_key, last_key, rows_to_hash, first_row, row_count)) continue;
+
+			result = RowDigestsRange(entry->row_digests, first_row, row_count);
+			entries.splice(entries.begin(), entries, entry);
+			return true;
+		}
+		return false;
+	}
+
+protected:
+	struct Entry {
+		Entry(const string &table_id, const ColumnValues &prev_key, const ColumnValues &last_key, bool complete, RowDigests &&row_digests):
+			table_id(table_id), key_range(prev_key, last_key, complete), row_digests(std::move(row_digests)) {}
+
+		string table_id;
+		CachedKeyRange key_range;
+		RowDigests row_digests;
+	};
+
+	size_t max_rows;
+	size_t cached_rows;
+	list<Entry> entries;
+};
+
+#endif
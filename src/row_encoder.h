@@ -0,0 +1,71 @@
+#ifndef ROW_ENCODER_H
+#define ROW_ENCODER_H
+
+#include <vector>
+#include "schema.h"
+#include "encode_packed.h"
+
+// encodes the values of integer columns, falling back to the general case for NULLs and anything unexpected
+template <typename DatabaseClient>
+string &sql_encode_and_append_integer_value_to(string &result, DatabaseClient &client, const Column &column, PackedValueReadStream &stream) {
+	uint8_t leader = stream.peek();
+
+	if (leader <= MSGPACK_POSITIVE_FIXNUM_MAX) {
+		stream.next();
+		return append_integer_to(result, (uint64_t)leader);
+	}
+
+	return sql_encode_and_append_packed_value_to(result, client, column, stream);
+}
+
+// encodes the values of columns that need quoting, going straight to the client's quoting function for strings
+template <typename DatabaseClient>
+string &sql_encode_and_append_quoted_value_to(string &result, DatabaseClient &client, const Column &column, PackedValueReadStream &stream) {
+	uint8_t leader = stream.peek();
+
+	if (leader >= MSGPACK_FIXRAW_MIN && leader <= MSGPACK_FIXRAW_MAX) {
+		size_t length = (leader & 31);
+		stream.next();
+		client.append_quoted_column_value_to(result, column, (const char *)stream.data, length);
+		stream.data += length;
+		return result;
+	}
+
+	return sql_encode_and_append_packed_value_to(result, client, column, stream);
+}
+
+// holds an encoding function for each column of a table, chosen once from the column types, so that the common
+// cases don't need to work out what kind of value they're expecting for every value in every row
+template <typename DatabaseClient>
+struct RowEncoder {
+	typedef string &(*ColumnEncoder)(string &result, DatabaseClient &client, const Column &column, PackedValueReadStream &stream);
+
+	RowEncoder(DatabaseClient &client, const Columns &columns): client(client), columns(columns) {
+		encoders.reserve(columns.size());
+		for (const Column &column : columns) {
+			encoders.push_back(encoder_for(column));
+		}
+	}
+
+	static ColumnEncoder encoder_for(const Column &column) {
+		if (column.column_type >= ColumnType::integer_min && column.column_type <= ColumnType::integer_max) {
+			return &sql_encode_and_append_integer_value_to<DatabaseClient>;
+		} else if (column.values_need_quoting()) {
+			return &sql_encode_and_append_quoted_value_to<DatabaseClient>;
+		} else {
+			return &sql_encode_and_append_packed_value_to<DatabaseClient>;
+		}
+	}
+
+	template <typename Value>
+	inline string &append_value_to(string &result, size_t column_number, const Value &value) {
+		PackedValueReadStream stream(value.data());
+		return encoders[column_number](result, client, columns[column_number], stream);
+	}
+
+	DatabaseClient &client;
+	const Columns &columns;
+	vector<ColumnEncoder> encoders;
+};
+
+#endif
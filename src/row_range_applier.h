@@ -2,6 +2,7 @@
 #define ROW_RANGE_APPLIER_H
 
 #include "row_replacer.h"
+#include "local_row_cache.h"
 
 template <typename DatabaseClient>
 struct RowRangeApplier {
@@ -9,6 +10,8 @@ struct RowRangeApplier {
 	static const size_t MAX_ROWS_TO_SELECT = 10000; // also somewhat arbitrary, but because we can't send DELETE statements while we are still receiving the results of a SELECT query on the same connection, this can effectively determine how many IDs we list in a single DELETE statement
 	static const size_t MAX_SENSIBLE_INSERT_STATEMENT_SIZE = 4*1024*1024;
 	static const size_t MAX_SENSIBLE_DELETE_STATEMENT_SIZE =     16*1024;
+	static const size_t MAX_SENSIBLE_UPDATE_STATEMENT_SIZE = 4*1024*1024;
+	static const size_t MAX_CHANGED_COLUMN_SETS_TO_BUFFER = 64; // each distinct set of changed columns needs its own UPDATE statement
 
 	typedef map<ColumnValues, PackedRow> RowsByPrimaryKey;
 
@@ -19,14 +22,15 @@ struct RowRangeApplier {
 		prev_key(prev_key),
 		curr_key(prev_key),
 		last_key(last_key),
-		approx_buffered_bytes(0) {
+		approx_buffered_bytes(0),
+		extra_rows_in_run(0) {
 		// RowInserter below can be used without keys if we completely clear and reload the table, but RowRangeApplier can't do anything useful
 		if (table.primary_key_columns.empty()) throw runtime_error("Can't stream and detect differences without a primary key");
 	}
 
 	template <typename InputStream>
 	void stream_from_input(Unpacker<InputStream> &input) {
-		PackedRow row;
+		PackedRowView row;
 
 		while (true) {
 			// in the KS protocol command responses are a series of arrays, terminated by an empty array.
@@ -41,20 +45,22 @@ struct RowRangeApplier {
 		received_all_source_rows();
 	}
 
-	ColumnValues primary_key_of(const PackedRow &row) {
+	template <typename Row>
+	ColumnValues primary_key_of(const Row &row) {
 		ColumnValues primary_key;
 		Packer<ColumnValues> packer(primary_key);
 		pack_array_length(packer, table.primary_key_columns.size());
 		for (size_t column_number : table.primary_key_columns) {
-			const PackedValue &val(row[column_number]);
+			const auto &val(row[column_number]);
 			packer.write_bytes(val.data(), val.encoded_size());
 		}
 		return primary_key;
 	}
 
-	void received_source_row(const PackedRow &row) {
+	void received_source_row(const PackedRowView &row) {
+		// the view only refers to the input stream's buffer, so this is where we take ownership of the row data
 		curr_key = primary_key_of(row);
-		source_rows[curr_key] = row;
+		copy_row_using_arena(source_rows[curr_key], row, arena);
 
 		// if the other end is sending a large set of data (for example, the entire remainder of the
 		// table), we need to periodically apply the data received so far rather than buffering up
@@ -62,16 +68,37 @@ struct RowRangeApplier {
 		// mostly avoided this particular problem, but we still had trouble in the case where the
 		// source dataset had deleted a large range that was still present on the local end; this
 		// way around requires fewer special cases.
-		for (const PackedValue &value : row) {
+		for (const PackedValueView &value : row) {
 			approx_buffered_bytes += value.encoded_size();
 		}
 		if (approx_buffered_bytes > MAX_BYTES_TO_BUFFER) {
+			local_rows = LocalRowsRange(); // we can't tell which of our rows come before curr_key, so we need to select them
 			check_rows_to_curr_key();
 			insert_remaining_rows();
 		}
 	}
 
+	// gives us the rows that we have in the range, if we kept them when we hashed it, so we don't need to select them
+	void use_local_rows(LocalRowsRange &&rows) {
+		local_rows = std::move(rows);
+	}
+
 	void received_all_source_rows() {
+		if (local_rows.rows) {
+			// compare all the rows we have in the range against the source rows; any that the source doesn't have
+			// are extra rows, which we remove.  since we aren't running a query, we can apply statements whenever.
+			PackedRow row;
+			for (size_t n = 0; n < local_rows.row_count; n++) {
+				local_rows.rows->copy_row_to(row, local_rows.first_row + n);
+				compare_row(row);
+				if (need_to_apply()) replacer.apply();
+			}
+			end_extra_row_run();
+			if (need_to_apply()) replacer.apply();
+			insert_remaining_rows();
+			return;
+		}
+
 		// clear any rows after the last entry we should have in the table (within the range we are
 		// processing, which may or may not go to the end of the table); this is an optimisation, as
 		// the retrieve_rows callback would do the same thing for each extra row found.
@@ -84,6 +111,11 @@ struct RowRangeApplier {
 	}
 
 	void delete_range(const ColumnValues &matched_up_to_key, const ColumnValues &last_not_matching_key) {
+		if (replacer.verify_only) {
+			replacer.count_rows_removed(matched_up_to_key, " <= ", last_not_matching_key);
+			return;
+		}
+
 		client.execute("DELETE FROM " + client.quote_table_name(table) + where_sql(client, table, matched_up_to_key, last_not_matching_key));
 	}
 
@@ -91,8 +123,10 @@ struct RowRangeApplier {
 		// we select in batches to avoid large buffering in clients that can't turn buffering off; and in those
 		// that can, we also need to execute DML periodically (but can't do that while SELECT is returning results)
 		while (retrieve_rows(client, *this, table, prev_key, curr_key, MAX_ROWS_TO_SELECT) == MAX_ROWS_TO_SELECT) {
+			end_extra_row_run();
 			if (need_to_apply()) replacer.apply();
 		}
+		end_extra_row_run();
 		if (need_to_apply()) replacer.apply();
 		prev_key = curr_key; // prev_key is iteratively updated in operator() to serve the loop above, but we may not have had the curr_key row locally
 	}
@@ -100,25 +134,68 @@ struct RowRangeApplier {
 	void operator()(const typename DatabaseClient::RowType &database_row) {
 		PackedRow row;
 		pack_row_into(row, database_row);
-		prev_key = primary_key_of(row);
+		compare_row(row);
+	}
+
+	void compare_row(const PackedRow &row) {
+		ColumnValues key(primary_key_of(row));
 
-		RowsByPrimaryKey::iterator source_row = source_rows.find(prev_key);
+		RowsByPrimaryKey::iterator source_row = source_rows.find(key);
 
 		if (source_row == source_rows.end()) {
 			// we have a row that we shouldn't have, so we need to remove it
-			replacer.remove_row(row);
+			extra_row(row, key);
 
 		} else if (source_row->second != row) {
-			// we do have the row at both ends, but it's changed, so we need to replace it
-			replacer.replace_row(source_row->second);
+			// we do have the row at both ends, but it's changed, so we need to update it; when we can, we
+			// send only the changed columns, otherwise we delete and reinsert the whole row
+			end_extra_row_run();
+			changed_columns.clear();
+			for (size_t column = 0; column < row.size(); column++) {
+				if (source_row->second[column] != row[column]) changed_columns.push_back(column);
+			}
+			if (replacer.can_update(changed_columns)) {
+				replacer.update_row(source_row->second, changed_columns);
+			} else {
+				replacer.replace_row(source_row->second);
+			}
 
 			// done with this row, don't need to insert it in insert_remaining_rows
 			source_rows.erase(source_row);
 
 		} else {
 			// the row matches; done with this row, don't need to insert it in insert_remaining_rows
+			end_extra_row_run();
 			source_rows.erase(source_row);
 		}
+
+		prev_key = key;
+	}
+
+	void extra_row(const PackedRow &row, const ColumnValues &key) {
+		// when the source has deleted a large number of rows, we're likely to see long runs of consecutive rows
+		// that we need to remove, which we can do much more efficiently using a range condition than by listing
+		// each key.  we can only do that if the key values uniquely identify the rows, though.
+		if (!table.enforceable_primary_key()) {
+			replacer.remove_row(row);
+			return;
+		}
+
+		if (extra_rows_in_run == 0) {
+			extra_run_prev_key = prev_key;
+			extra_run_first_row = row;
+		}
+		extra_run_last_key = key;
+		extra_rows_in_run++;
+	}
+
+	void end_extra_row_run() {
+		if (extra_rows_in_run == 1) {
+			replacer.remove_row(extra_run_first_row);
+		} else if (extra_rows_in_run > 1) {
+			replacer.remove_range(extra_run_prev_key, extra_run_last_key, extra_rows_in_run);
+		}
+		extra_rows_in_run = 0;
 	}
 
 	void insert_remaining_rows() {
@@ -127,6 +204,7 @@ struct RowRangeApplier {
 			if (need_to_apply()) replacer.apply();
 		}
 		source_rows.clear();
+		arena.reset(); // must come after clearing the rows using it
 		approx_buffered_bytes = 0;
 	}
 
@@ -139,10 +217,18 @@ struct RowRangeApplier {
 
 		if (replacer.insert_sql.curr.size() > MAX_SENSIBLE_INSERT_STATEMENT_SIZE) return true;
 
+		if (replacer.range_delete_sql.curr.size() > MAX_SENSIBLE_DELETE_STATEMENT_SIZE) return true;
+
 		for (auto unique_key_clearer : replacer.unique_key_clearers) {
 			if (unique_key_clearer.delete_sql.curr.size() > MAX_SENSIBLE_DELETE_STATEMENT_SIZE) return true;
 		}
 
+		if (replacer.row_updaters.size() > MAX_CHANGED_COLUMN_SETS_TO_BUFFER) return true;
+
+		for (const auto &row_updater : replacer.row_updaters) {
+			if (row_updater.second.update_sql.curr.size() > MAX_SENSIBLE_UPDATE_STATEMENT_SIZE) return true;
+		}
+
 		return false;
 	}
 
@@ -152,8 +238,15 @@ struct RowRangeApplier {
 	ColumnValues prev_key;
 	ColumnValues curr_key;
 	ColumnValues last_key;
+	PackedArena arena; // must be declared before source_rows so that it's destroyed after them
 	RowsByPrimaryKey source_rows;
 	size_t approx_buffered_bytes;
+	ColumnIndices changed_columns;
+	ColumnValues extra_run_prev_key;
+	ColumnValues extra_run_last_key;
+	PackedRow extra_run_first_row;
+	size_t extra_rows_in_run;
+	LocalRowsRange local_rows;
 };
 
 // special-case version of RowRangeApplier that simply inserts all the received rows without comparing
@@ -169,12 +262,12 @@ struct RowInserter {
 
 	template <typename InputStream>
 	void stream_from_input(Unpacker<InputStream> &input) {
-		PackedRow row;
+		PackedRowView row;
 
 		while (true) {
 			// in the KS protocol command responses are a series of arrays, terminated by an empty array.
 			// this avoids having to determine the number of results in advance; an empty array is not a
-			// valid database row, so it's unambiguous.
+			// valid database row, so it's unambiguous.  we encode the SQL straight from the input buffer.
 			input >> row;
 			if (row.size() == 0) break;
 
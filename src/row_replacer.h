@@ -5,30 +5,34 @@
 
 #include "database_client_traits.h"
 #include "sql_functions.h"
+#include "query_functions.h"
 #include "unique_key_clearer.h"
+#include "row_encoder.h"
+#include "row_updater.h"
+#include "diff_report.h"
 
-template <typename DatabaseClient>
-void append_row_tuple(DatabaseClient &client, const Columns &columns, BaseSQL &sql, const PackedRow &row, size_t columns_to_ignore = 0) {
+template <typename DatabaseClient, typename Row>
+void append_row_tuple(RowEncoder<DatabaseClient> &encoder, BaseSQL &sql, const Row &row, size_t columns_to_ignore = 0) {
 	if (sql.have_content()) sql += "),\n(";
 	for (size_t n = 0; n < row.size() - columns_to_ignore; n++) {
 		if (n > 0) {
 			sql += ',';
 		}
-		sql_encode_and_append_packed_value_to(sql.curr, client, columns[n], row[n]);
+		encoder.append_value_to(sql.curr, n, row[n]);
 	}
 }
 
-template <typename DatabaseClient>
-void append_row_tuples(DatabaseClient &client, const Columns &columns, BaseSQL &sql, const PackedRow &row) {
+template <typename DatabaseClient, typename Row>
+void append_row_tuples(RowEncoder<DatabaseClient> &encoder, BaseSQL &sql, const Row &row) {
 	// retrieve_rows_sql adds an extra COUNT(*) column on to the end of the SELECT statements in the entire_row_as_key case
-	PackedValueReadStream stream(row.back());
+	PackedValueReadStream stream(row.back().data());
 	Unpacker<PackedValueReadStream> unpacker(stream);
 
 	size_t count_to_insert = unpacker.next<size_t>();
 	if (!count_to_insert) throw range_error("Saw a zero row count!");
 
 	while (count_to_insert--) {
-		append_row_tuple(client, columns, sql, row, 1);
+		append_row_tuple(encoder, sql, row, 1);
 	}
 }
 
@@ -74,19 +78,56 @@ struct RowReplacerBuilder<DatabaseClient, true> {
 
 template <typename DatabaseClient>
 struct RowReplacer {
-	RowReplacer(DatabaseClient &client, const Table &table, bool commit_often, ProgressCallback progress_callback):
+	static const size_t ROWS_TO_CLEAR_PER_CHUNK = 10000;
+
+	RowReplacer(DatabaseClient &client, const Table &table, bool commit_often, ProgressCallback progress_callback, bool verify_only = false):
 		client(client),
 		table(table),
+		encoder(client, table.columns),
 		insert_sql(RowReplacerBuilder<DatabaseClient>::insert_sql_base(client, table), ")"),
+		range_delete_sql("DELETE FROM " + client.quote_table_name(table) + " WHERE (", ")"),
 		commit_often(commit_often),
 		progress_callback(progress_callback),
+		verify_only(verify_only),
 		rows_changed(0) {
 		// set up the clearers we'll need to insert rows - these clear any conflicting values from elsewhere in the same table
 		unique_key_clearers.emplace_back(client, table, table.primary_key_columns);
 		RowReplacerBuilder<DatabaseClient>::construct_clearers(*this);
+
+		// changes to unique key columns may conflict with other rows, which we'd need to clear first, so we only use
+		// UPDATE statements for rows where none of the changed columns are in a unique key; identity columns that are
+		// generated always can't be given values by UPDATE statements at all, so we replace those rows too
+		columns_needing_replace.resize(table.columns.size());
+		for (const Key &key : table.keys) {
+			if (key.unique()) {
+				for (size_t column : key.columns) columns_needing_replace[column] = true;
+			}
+		}
+		for (size_t column : table.primary_key_columns) columns_needing_replace[column] = true;
+		for (size_t column = 0; column < table.columns.size(); column++) {
+			if (table.columns[column].default_type == DefaultType::generated_always_as_identity) columns_needing_replace[column] = true;
+		}
+	}
+
+	inline bool can_update(const ColumnIndices &changed_columns) {
+		if (!table.enforceable_primary_key()) return false;
+
+		for (size_t column : changed_columns) {
+			if (columns_needing_replace[column]) return false;
+		}
+
+		return true;
 	}
 
-	inline void insert_row(const PackedRow &row) {
+	// used both for PackedRows and for PackedRowViews straight off the input stream
+	template <typename Row>
+	inline void insert_row(const Row &row) {
+		if (verify_only) {
+			differences.inserted++;
+			rows_changed++;
+			return;
+		}
+
 		// before we can insert our rows we will also have to first clear any other rows with the
 		// same unique key values.
 		for (auto unique_key_clearer = insert_clearers_start; unique_key_clearer != unique_key_clearers.end(); ++unique_key_clearer) {
@@ -95,15 +136,21 @@ struct RowReplacer {
 
 		// we can then batch up a big INSERT statement
 		if (table.group_and_count_entire_row()) {
-			append_row_tuples(client, table.columns, insert_sql, row);
+			append_row_tuples(encoder, insert_sql, row);
 		} else {
-			append_row_tuple(client, table.columns, insert_sql, row);
+			append_row_tuple(encoder, insert_sql, row);
 		}
 
 		rows_changed++;
 	}
 
 	inline void replace_row(const PackedRow &row) {
+		if (verify_only) {
+			differences.updated++;
+			rows_changed++;
+			return;
+		}
+
 		// when we apply(), first we will delete existing rows - we do that rather than use UPDATE
 		// statements because you can't really batch UPDATE, whereas you can batch DELETE & INSERT.
 		for (auto unique_key_clearer = replace_clearers_start; unique_key_clearer != unique_key_clearers.end(); ++unique_key_clearer) {
@@ -111,25 +158,76 @@ struct RowReplacer {
 		}
 
 		if (table.group_and_count_entire_row()) {
-			append_row_tuples(client, table.columns, insert_sql, row);
+			append_row_tuples(encoder, insert_sql, row);
 		} else {
-			append_row_tuple(client, table.columns, insert_sql, row);
+			append_row_tuple(encoder, insert_sql, row);
+		}
+
+		rows_changed++;
+	}
+
+	inline void update_row(const PackedRow &row, const ColumnIndices &changed_columns) {
+		if (verify_only) {
+			differences.updated++;
+			rows_changed++;
+			return;
 		}
 
+		// rows with the same set of changed columns can be batched together into one UPDATE statement
+		auto row_updater = row_updaters.find(changed_columns);
+		if (row_updater == row_updaters.end()) {
+			row_updater = row_updaters.emplace(piecewise_construct, forward_as_tuple(changed_columns), forward_as_tuple(client, table, changed_columns)).first;
+		}
+		row_updater->second.row(row);
+
 		rows_changed++;
 	}
 
 	inline void remove_row(const PackedRow &row) {
+		if (verify_only) {
+			differences.deleted++;
+			rows_changed++;
+			return;
+		}
+
 		unique_key_clearers.front().row(row);
 
 		rows_changed++;
 	}
 
+	inline void remove_range(const ColumnValues &prev_key, const ColumnValues &last_key, size_t rows_in_range) {
+		// used for runs of consecutive rows that all need to be removed; the caller must know that there are no other
+		// rows in the range, and that the table has an enforceable primary key
+		if (verify_only) {
+			differences.deleted += rows_in_range;
+			rows_changed += rows_in_range;
+			return;
+		}
+
+		if (range_delete_sql.have_content()) range_delete_sql += ")\nOR (";
+		range_delete_sql += key_range_sql(client, table, prev_key, last_key);
+
+		rows_changed += rows_in_range;
+	}
+
 	void apply() {
+		if (verify_only) {
+			// nothing was buffered, and we're only in a read transaction
+			if (progress_callback) progress_callback();
+			return;
+		}
+
+		range_delete_sql.apply(client);
+
 		for (UniqueKeyClearer<DatabaseClient> &unique_key_clearer : unique_key_clearers) {
 			unique_key_clearer.apply();
 		}
 
+		for (auto &row_updater : row_updaters) {
+			row_updater.second.apply();
+		}
+		row_updaters.clear();
+
 		insert_sql.apply(client);
 
 		if (commit_often) {
@@ -143,19 +241,67 @@ struct RowReplacer {
 	}
 
 	void clear_range(const ColumnValues &prev_key, const ColumnValues &last_key) {
+		clear_key_range(prev_key, " <= ", last_key);
+	}
+
+	void clear_range_before(const ColumnValues &first_key) {
+		clear_key_range(ColumnValues(), " < ", first_key);
+	}
+
+	void clear_key_range(const ColumnValues &prev_key, const char *upper_op, const ColumnValues &upper_key) {
+		if (verify_only) {
+			count_rows_removed(prev_key, upper_op, upper_key);
+			return;
+		}
+
 		apply();
-		rows_changed += client.execute("DELETE FROM " + client.quote_table_name(table) + where_sql(client, table, prev_key, last_key));
+
+		// clearing the whole table is much faster using TRUNCATE, but that can't be rolled back on some
+		// databases, so we only do it if we're committing as we go anyway
+		if (prev_key.empty() && upper_key.empty() && table.where_conditions.empty() && commit_often && client.table_can_be_truncated(table)) {
+			client.execute("TRUNCATE " + client.quote_table_name(table));
+			apply();
+			return;
+		}
+
+		// otherwise, if we're committing as we go, delete in bounded chunks so that we don't hold
+		// locks or build up huge amounts of undo/WAL for the whole range; the chunks are found using
+		// the same conditions as the DELETE statements, so that each chunk really is bounded
+		ColumnValues chunk_prev_key(prev_key);
+		if (commit_often && !table.primary_key_columns.empty()) {
+			while (true) {
+				ColumnValues chunk_last_key(nth_key(client, table, chunk_prev_key, upper_op, upper_key, ROWS_TO_CLEAR_PER_CHUNK));
+				if (chunk_last_key.empty()) break;
+				rows_changed += client.execute("DELETE FROM " + client.quote_table_name(table) + where_sql(client, table, chunk_prev_key, chunk_last_key, table.where_conditions));
+				apply();
+				chunk_prev_key = chunk_last_key;
+			}
+		}
+
+		rows_changed += client.execute("DELETE FROM " + client.quote_table_name(table) + where_sql(client, table, " > ", chunk_prev_key, upper_op, upper_key, "", ColumnValues(), table.where_conditions));
+	}
+
+	void count_rows_removed(const ColumnValues &prev_key, const char *upper_op, const ColumnValues &upper_key) {
+		size_t rows_in_range = atoi(client.select_one("SELECT COUNT(*) FROM " + client.quote_table_name(table) + where_sql(client, table, " > ", prev_key, upper_op, upper_key, "", ColumnValues(), table.where_conditions)).c_str());
+		differences.deleted += rows_in_range;
+		rows_changed += rows_in_range;
 	}
 
 	DatabaseClient &client;
 	const Table &table;
+	RowEncoder<DatabaseClient> encoder;
 	BaseSQL insert_sql;
+	BaseSQL range_delete_sql;
 	vector< UniqueKeyClearer<DatabaseClient> > unique_key_clearers;
 	typename vector< UniqueKeyClearer<DatabaseClient> >::iterator insert_clearers_start;
 	typename vector< UniqueKeyClearer<DatabaseClient> >::iterator replace_clearers_start;
+	vector<bool> columns_needing_replace;
+	map<ColumnIndices, RowUpdater<DatabaseClient>> row_updaters;
 	bool commit_often;
 	ProgressCallback progress_callback;
+	bool verify_only; // with --verify, we count the changes in differences instead of making them
 	size_t rows_changed;
+	RowDifferences differences;
 };
 
 #endif
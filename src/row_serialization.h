@@ -7,8 +7,10 @@
 #include "xxHash/xxhash.h"
 
 #include "blake3/blake3.h"
+#include "kernels/kernels.h"
 
 #include "hash_algorithm.h"
+#include "hash_thread_pool.h"
 #include "message_pack/pack.h"
 #include "message_pack/packed_value.h"
 #include "packed_key.h"
@@ -35,6 +37,20 @@ struct ValueCollector {
 	ColumnValues values;
 };
 
+// as for ValueCollector, but keeps the values of every row, for example the keys from retrieve_keys
+struct ValuesCollector {
+	ValuesCollector() {}
+
+	template <typename DatabaseRow>
+	inline void operator()(const DatabaseRow &row) {
+		values.emplace_back();
+		Packer<ColumnValues> packer(values.back());
+		pack_row_into(packer, row);
+	}
+
+	vector<ColumnValues> values;
+};
+
 template <typename OutputStream>
 struct RowPacker {
 	RowPacker(Packer<OutputStream> &packer): packer(packer) {}
@@ -81,8 +97,13 @@ inline bool operator != (const string &str, const Hash &hash) {
 	return !(hash == str);
 }
 
+#define XXH3_STATE_ALIGNMENT 64
+#define XXH3_PENDING_SIZE 256
+#define BLAKE3_PENDING_SIZE 65536
+#define BLAKE3_SUBTREE_SIZE (KS_BLAKE3_MAX_SUBTREE_CHUNKS*BLAKE3_CHUNK_LEN)
+
 struct RowHasher {
-	RowHasher(HashAlgorithm hash_algorithm): hash_algorithm(hash_algorithm), size(0), finished(false), packer(*this) {
+	RowHasher(HashAlgorithm hash_algorithm, HashThreadPool *thread_pool = nullptr): hash_algorithm(hash_algorithm), thread_pool(thread_pool), size(0), finished(false), packer(*this) {
 		switch (hash_algorithm) {
 			case HashAlgorithm::md5:
 				MD5_Init(&mdctx);
@@ -94,6 +115,17 @@ struct RowHasher {
 
 			case HashAlgorithm::blake3:
 				blake3_hasher_init(&blake3_state);
+				// when we have threads to spare, we wait until we have enough whole subtrees for each of them to hash
+				blake3_batch_size = (thread_pool && thread_pool->size() > 1 ? thread_pool->size()*BLAKE3_SUBTREE_SIZE : BLAKE3_PENDING_SIZE);
+				break;
+
+			case HashAlgorithm::xxh3_128:
+				// the state is over-aligned for the SIMD loads, which operator new doesn't respect before C++17, so we
+				// align it ourselves within our own storage rather than allocating it separately for every hasher
+				xxh3_state = (XXH3_state_t *)(((uintptr_t)xxh3.storage + XXH3_STATE_ALIGNMENT - 1) & ~(uintptr_t)(XXH3_STATE_ALIGNMENT - 1));
+				xxh3_pending = 0;
+				XXH3_INITSTATE(xxh3_state);
+				XXH3_128bits_reset(xxh3_state);
 				break;
 
 			default:
@@ -102,6 +134,9 @@ struct RowHasher {
 		}
 	}
 
+	RowHasher(const RowHasher &) = delete;
+	RowHasher &operator=(const RowHasher &) = delete;
+
 	template <typename DatabaseRow>
 	inline void operator()(const DatabaseRow &row) {
 		pack_row_into(packer, row);
@@ -120,7 +155,20 @@ struct RowHasher {
 				break;
 
 			case HashAlgorithm::blake3:
-				blake3_hasher_update(&blake3_state, buf, bytes);
+				// as for XXH3, but also so that BLAKE3 can use its SIMD implementations, which hash many chunks at once
+				blake3_pending.insert(blake3_pending.end(), buf, buf + bytes);
+				if (blake3_pending.size() > blake3_batch_size) hash_blake3_pending();
+				break;
+
+			case HashAlgorithm::xxh3_128:
+				// values are packed a few bytes at a time, so we batch them up rather than making a call for each
+				if (xxh3_pending + bytes <= XXH3_PENDING_SIZE) {
+					memcpy(xxh3.pending + xxh3_pending, buf, bytes);
+					xxh3_pending += bytes;
+				} else {
+					flush_xxh3_pending();
+					ks_xxh3_128_update(xxh3_state, buf, bytes);
+				}
 				break;
 
 			default:
@@ -147,21 +195,67 @@ struct RowHasher {
 
 			case HashAlgorithm::blake3:
 				hash.md_len = BLAKE3_OUT_LEN;
+				blake3_hasher_update(&blake3_state, blake3_pending.data(), blake3_pending.size());
 				blake3_hasher_finalize(&blake3_state, hash.md_value, BLAKE3_OUT_LEN);
 				return hash;
 
+			case HashAlgorithm::xxh3_128:
+				hash.md_len = sizeof(XXH128_canonical_t);
+				flush_xxh3_pending();
+				ks_xxh3_128_digest(xxh3_state, hash.md_value);
+				return hash;
+
 			default:
 				// never hit, but silence compiler warning
 				throw runtime_error("invalid hash algorithm");
 		}
 	}
 
+	inline void flush_xxh3_pending() {
+		if (xxh3_pending) {
+			ks_xxh3_128_update(xxh3_state, xxh3.pending, xxh3_pending);
+			xxh3_pending = 0;
+		}
+	}
+
+	void hash_blake3_pending() {
+		if (blake3_batch_size == BLAKE3_PENDING_SIZE) {
+			blake3_hasher_update(&blake3_state, blake3_pending.data(), blake3_pending.size());
+			blake3_pending.clear();
+			return;
+		}
+
+		// hash whole subtrees on the pool's threads, always leaving some input behind so that none of them can be
+		// the root node, then add their chaining values to the hasher in order
+		size_t subtrees = (blake3_pending.size() - 1)/BLAKE3_SUBTREE_SIZE;
+		uint64_t chunk_counter = blake3_state.chunk.chunk_counter;
+		blake3_subtree_cvs.resize(subtrees*BLAKE3_OUT_LEN);
+		thread_pool->run(subtrees, [&](size_t subtree) {
+			ks_blake3_subtree_cv(&blake3_state, blake3_pending.data() + subtree*BLAKE3_SUBTREE_SIZE, KS_BLAKE3_MAX_SUBTREE_CHUNKS,
+				chunk_counter + subtree*KS_BLAKE3_MAX_SUBTREE_CHUNKS, blake3_subtree_cvs.data() + subtree*BLAKE3_OUT_LEN);
+		});
+		for (size_t subtree = 0; subtree < subtrees; subtree++) {
+			ks_blake3_push_subtree_cv(&blake3_state, blake3_subtree_cvs.data() + subtree*BLAKE3_OUT_LEN, KS_BLAKE3_MAX_SUBTREE_CHUNKS);
+		}
+		blake3_pending.erase(blake3_pending.begin(), blake3_pending.begin() + subtrees*BLAKE3_SUBTREE_SIZE);
+	}
+
 	HashAlgorithm hash_algorithm;
+	HashThreadPool *thread_pool;
 	union {
 		MD5_CTX mdctx;
 		XXH64_state_t xxh64_state;
 		blake3_hasher blake3_state;
+		struct {
+			uint8_t storage[sizeof(XXH3_state_t) + XXH3_STATE_ALIGNMENT - 1];
+			uint8_t pending[XXH3_PENDING_SIZE];
+		} xxh3;
 	};
+	XXH3_state_t *xxh3_state;
+	size_t xxh3_pending;
+	vector<uint8_t> blake3_pending;
+	vector<uint8_t> blake3_subtree_cvs;
+	size_t blake3_batch_size;
 	size_t size;
 	Packer<RowHasher> packer;
 	Hash hash;
@@ -188,7 +282,7 @@ struct RowLastKey {
 };
 
 struct RowHasherAndLastKey: RowHasher, RowLastKey {
-	RowHasherAndLastKey(HashAlgorithm hash_algorithm, const vector<size_t> &primary_key_columns): RowHasher(hash_algorithm), RowLastKey(primary_key_columns) {
+	RowHasherAndLastKey(HashAlgorithm hash_algorithm, const vector<size_t> &primary_key_columns, HashThreadPool *thread_pool = nullptr): RowHasher(hash_algorithm, thread_pool), RowLastKey(primary_key_columns) {
 	}
 
 	template <typename DatabaseRow>
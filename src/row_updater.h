@@ -0,0 +1,116 @@
+#ifndef ROW_UPDATER_H
+#define ROW_UPDATER_H
+
+#include "base_sql.h"
+#include "database_client_traits.h"
+#include "encode_packed.h"
+#include "sql_functions.h"
+#include "message_pack/packed_row.h"
+
+const string UPDATE_VALUES_ALIAS("ks_values");
+
+template <typename DatabaseClient, bool = is_base_of<SupportsUpdateFrom, DatabaseClient>::value>
+struct RowUpdaterBuilder {
+	// databases that don't support UPDATE ... FROM (VALUES ...) can generally join to a derived table instead,
+	// which we build using UNION ALL so that we don't depend on newer table value constructor syntax
+	static string prefix(DatabaseClient &client, const Table &table, const ColumnIndices &changed_columns) {
+		return "UPDATE " + client.quote_table_name(table) + " JOIN (";
+	}
+
+	static string suffix(DatabaseClient &client, const Table &table, const ColumnIndices &changed_columns) {
+		string result(") AS " + UPDATE_VALUES_ALIAS + " ON ");
+		for (size_t n = 0; n < table.primary_key_columns.size(); n++) {
+			if (n > 0) result += " AND ";
+			string column_name(client.quote_identifier(table.columns[table.primary_key_columns[n]].name));
+			result += client.quote_table_name(table) + '.' + column_name + " = " + UPDATE_VALUES_ALIAS + '.' + column_name;
+		}
+		result += " SET ";
+		for (size_t n = 0; n < changed_columns.size(); n++) {
+			if (n > 0) result += ", ";
+			string column_name(client.quote_identifier(table.columns[changed_columns[n]].name));
+			result += client.quote_table_name(table) + '.' + column_name + " = " + UPDATE_VALUES_ALIAS + '.' + column_name;
+		}
+		return result;
+	}
+
+	static void append_row(DatabaseClient &client, const Table &table, const ColumnIndices &columns_to_list, BaseSQL &sql, const PackedRow &row) {
+		if (sql.have_content()) sql += " UNION ALL ";
+		sql += "SELECT ";
+		for (size_t n = 0; n < columns_to_list.size(); n++) {
+			if (n > 0) sql += ", ";
+			const Column &column(table.columns[columns_to_list[n]]);
+			sql_encode_and_append_packed_value_to(sql.curr, client, column, row[columns_to_list[n]]);
+			sql += " AS ";
+			sql += client.quote_identifier(column.name);
+		}
+	}
+};
+
+template <typename DatabaseClient>
+struct RowUpdaterBuilder<DatabaseClient, true> {
+	// the literals in a VALUES list don't know the types of the columns they will be compared to or assigned to, so
+	// we cast each of them explicitly; it's simplest to do that in the SET and WHERE clauses rather than in the list
+	static string prefix(DatabaseClient &client, const Table &table, const ColumnIndices &changed_columns) {
+		string result("UPDATE " + client.quote_table_name(table) + " SET ");
+		for (size_t n = 0; n < changed_columns.size(); n++) {
+			if (n > 0) result += ", ";
+			const Column &column(table.columns[changed_columns[n]]);
+			result += client.quote_identifier(column.name) + " = " + UPDATE_VALUES_ALIAS + '.' + client.quote_identifier(column.name) + "::" + client.column_type(column);
+		}
+		result += " FROM (VALUES\n(";
+		return result;
+	}
+
+	static string suffix(DatabaseClient &client, const Table &table, const ColumnIndices &changed_columns) {
+		string result(")) AS " + UPDATE_VALUES_ALIAS + " (");
+		result += columns_list(client, table.columns, table.primary_key_columns);
+		result += ", ";
+		result += columns_list(client, table.columns, changed_columns);
+		result += ") WHERE ";
+		for (size_t n = 0; n < table.primary_key_columns.size(); n++) {
+			if (n > 0) result += " AND ";
+			const Column &column(table.columns[table.primary_key_columns[n]]);
+			result += client.quote_table_name(table) + '.' + client.quote_identifier(column.name) + " = " + UPDATE_VALUES_ALIAS + '.' + client.quote_identifier(column.name) + "::" + client.column_type(column);
+		}
+		return result;
+	}
+
+	static void append_row(DatabaseClient &client, const Table &table, const ColumnIndices &columns_to_list, BaseSQL &sql, const PackedRow &row) {
+		if (sql.have_content()) sql += "),\n(";
+		for (size_t n = 0; n < columns_to_list.size(); n++) {
+			if (n > 0) sql += ',';
+			sql_encode_and_append_packed_value_to(sql.curr, client, table.columns[columns_to_list[n]], row[columns_to_list[n]]);
+		}
+	}
+};
+
+// batches up UPDATE statements for rows that have the same set of changed columns, so that we only need to send the
+// primary key and the changed column values rather than deleting and reinserting the whole row
+template <typename DatabaseClient>
+struct RowUpdater {
+	RowUpdater(DatabaseClient &client, const Table &table, const ColumnIndices &changed_columns):
+		client(&client),
+		table(&table),
+		update_sql(
+			RowUpdaterBuilder<DatabaseClient>::prefix(client, table, changed_columns),
+			RowUpdaterBuilder<DatabaseClient>::suffix(client, table, changed_columns)) {
+		columns_to_list = table.primary_key_columns;
+		columns_to_list.insert(columns_to_list.end(), changed_columns.begin(), changed_columns.end());
+	}
+
+	void row(const PackedRow &row) {
+		RowUpdaterBuilder<DatabaseClient>::append_row(*client, *table, columns_to_list, update_sql, row);
+	}
+
+	inline void apply() {
+		update_sql.apply(*client);
+	}
+
+	// as for UniqueKeyClearer, these would be references if it weren't for the STL's requirements
+	DatabaseClient *client;
+	const Table *table;
+	ColumnIndices columns_to_list;
+	BaseSQL update_sql;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef SAMPLE_BUDGET_H
+#define SAMPLE_BUDGET_H
+
+#include <string>
+#include <stdexcept>
+#include <cstdlib>
+
+using namespace std;
+
+// how much of each table --verify-sample should hash, given as a percentage of the table's size according to the
+// database statistics, a number of seconds, or a number of bytes
+struct SampleBudget {
+	enum Unit {
+		none,
+		fraction,
+		seconds,
+		bytes,
+	};
+
+	SampleBudget(): unit(none), amount(0) {}
+	SampleBudget(Unit unit, double amount): unit(unit), amount(amount) {}
+
+	inline bool given() const { return (unit != none); }
+
+	inline bool operator ==(const SampleBudget &other) const { return (unit == other.unit && amount == other.amount); }
+
+	Unit unit;
+	double amount;
+};
+
+inline SampleBudget parse_sample_budget(const string &budget) {
+	if (budget.empty()) return SampleBudget();
+
+	char *end;
+	double amount = strtod(budget.c_str(), &end);
+	string suffix(end);
+	if (end == budget.c_str() || !(amount > 0)) throw invalid_argument("The sample budget must be a positive number followed by %, s, B, KB, MB, or GB");
+
+	if (suffix == "%") {
+		if (amount > 100) throw invalid_argument("The sample budget can't be more than 100%");
+		return SampleBudget(SampleBudget::fraction, amount/100);
+	} else if (suffix == "s") {
+		return SampleBudget(SampleBudget::seconds, amount);
+	} else if (suffix == "B") {
+		return SampleBudget(SampleBudget::bytes, amount);
+	} else if (suffix == "KB") {
+		return SampleBudget(SampleBudget::bytes, amount*1024);
+	} else if (suffix == "MB") {
+		return SampleBudget(SampleBudget::bytes, amount*1024*1024);
+	} else if (suffix == "GB") {
+		return SampleBudget(SampleBudget::bytes, amount*1024*1024*1024);
+	} else {
+		throw invalid_argument("Unknown sample budget: " + budget + ", must be a number followed by %, s, B, KB, MB, or GB");
+	}
+}
+
+#endif
@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <functional>
 #include <list>
+#include <set>
 
 #include "database_client_traits.h"
 #include "schema.h"
@@ -110,6 +111,10 @@ struct DropTableStatements {
 template <typename DatabaseClient>
 struct CreateTableStatements {
 	static void generate(DatabaseClient &client, const Table &table, StatementFunction f) {
+		generate(client, table, f, f);
+	}
+
+	static void generate(DatabaseClient &client, const Table &table, StatementFunction f, StatementFunction non_unique_key_f) {
 		CreateTableSequencesStatements<DatabaseClient>::generate(client, table, f);
 
 		string result("CREATE TABLE ");
@@ -126,7 +131,8 @@ struct CreateTableStatements {
 		f(result);
 
 		for (const Key &key : table.keys) {
-			CreateKeyStatements<DatabaseClient>::generate(client, table, key, f);
+			// unique keys are always created straight away, since they're needed to clear conflicting rows efficiently
+			CreateKeyStatements<DatabaseClient>::generate(client, table, key, key.unique() ? f : non_unique_key_f);
 		}
 
 		OwnTableSequencesStatements<DatabaseClient>::generate(client, table, f);
@@ -382,7 +388,18 @@ struct CustomTypeMatcher<DatabaseClient, true> {
 
 template <typename DatabaseClient>
 struct TableMatcher {
-	TableMatcher(DatabaseClient &client, Statements &statements): client(client), statements(statements) {}
+	TableMatcher(DatabaseClient &client, Statements &statements, Statements *deferred_key_statements = nullptr): client(client), statements(statements), deferred_key_statements(deferred_key_statements) {}
+
+	void create_table(const Table &table) {
+		tables_created.insert(table.id_from_name());
+
+		// new tables start empty, so if requested we leave their non-unique keys until after the data has been loaded
+		if (deferred_key_statements) {
+			CreateTableStatements<DatabaseClient>::generate(client, table, append_to(statements), append_to(*deferred_key_statements));
+		} else {
+			CreateTableStatements<DatabaseClient>::generate(client, table, append_to(statements));
+		}
+	}
 
 	void match_tables(Tables from_tables, Tables &to_tables) { // copies from_tables so we can sort it, mutates to_tables
 		// sort the table lists so they have the same order - they typically are already,
@@ -401,7 +418,7 @@ struct TableMatcher {
 				// keep the current from_table and re-evaluate on the next iteration
 
 			} else if (to_table->name > from_table->name) {
-				CreateTableStatements<DatabaseClient>::generate(client, *from_table, append_to(statements));
+				create_table(*from_table);
 				to_table = ++to_tables.insert(to_table, *from_table);
 				++from_table;
 
@@ -412,7 +429,7 @@ struct TableMatcher {
 			}
 		}
 		while (from_table != from_tables.end()) {
-			CreateTableStatements<DatabaseClient>::generate(client, *from_table, append_to(statements));
+			create_table(*from_table);
 			to_tables.push_back(*from_table);
 			++from_table;
 		}
@@ -439,7 +456,7 @@ struct TableMatcher {
 			// nope, throw away those ALTER statements, and recreate the table
 			comment_on_table_differences(statements, from_table, to_table);
 			DropTableStatements<DatabaseClient>::generate(client, to_table, append_to(statements));
-			CreateTableStatements<DatabaseClient>::generate(client, from_table, append_to(statements));
+			create_table(from_table);
 			to_table = from_table;
 		}
 	}
@@ -565,22 +582,28 @@ struct TableMatcher {
 
 	DatabaseClient &client;
 	Statements &statements;
+	Statements *deferred_key_statements;
+	set<string> tables_created; // or recreated, by table ID
 };
 
 template <typename DatabaseClient>
 struct SchemaMatcher {
-	SchemaMatcher(DatabaseClient &client): client(client) {}
+	SchemaMatcher(DatabaseClient &client, bool defer_keys = false): client(client), defer_keys(defer_keys) {}
 
 	void match_schemas(const Database &from_database, Database to_database) {
 		CustomTypeMatcher<DatabaseClient> custom_type_matcher(client, statements);
 		custom_type_matcher.match_types_used(from_database.tables, to_database.tables);
 
-		TableMatcher<DatabaseClient> table_matcher(client, statements);
+		TableMatcher<DatabaseClient> table_matcher(client, statements, defer_keys ? &deferred_key_statements : nullptr);
 		table_matcher.match_tables(from_database.tables, to_database.tables);
+		tables_created = table_matcher.tables_created;
 	}
 
 	DatabaseClient &client;
+	bool defer_keys;
 	Statements statements;
+	Statements deferred_key_statements;
+	set<string> tables_created; // or recreated, by table ID
 };
 
 #endif
@@ -0,0 +1,198 @@
+#ifndef SHADOW_TABLE_H
+#define SHADOW_TABLE_H
+
+#include "database_client_traits.h"
+#include "schema_matcher.h"
+
+const string SHADOW_TABLE_SUFFIX("_ks_shadow");
+const string REPLACED_TABLE_SUFFIX("_ks_replaced");
+const string SHADOW_TABLE_COMMENT("Kitchen Sync shadow table");
+
+inline string shadow_relation_name(const string &name, const string &suffix) {
+	// postgresql truncates names longer than 63 characters, and mysql refuses names longer than 64
+	return name.substr(0, 63 - suffix.length()) + suffix;
+}
+
+// postgresql index names are unique to the schema rather than the table, so the shadow table's keys need their own
+// names until the original table (and its keys) are dropped, whereas mysql key names don't need changing
+template <typename DatabaseClient, bool = is_base_of<GlobalKeys, DatabaseClient>::value>
+struct ShadowKeyNames {
+	static string key_name(const string &name) {
+		return name;
+	}
+
+	static string primary_key_name(DatabaseClient &client, const Table &table) {
+		return ""; // always PRIMARY
+	}
+
+	static string primary_key_clause(DatabaseClient &client, const Table &table, const string &primary_key_name) {
+		return ",\n  PRIMARY KEY" + columns_tuple(client, table.columns, table.primary_key_columns);
+	}
+
+	static void rename_keys(DatabaseClient &client, const Table &shadow_table, const Table &table, const string &primary_key_name, StatementFunction f) {
+		/* nothing required */
+	}
+};
+
+template <typename DatabaseClient>
+struct ShadowKeyNames<DatabaseClient, true> {
+	static string key_name(const string &name) {
+		return shadow_relation_name(name, SHADOW_TABLE_SUFFIX);
+	}
+
+	static string primary_key_name(DatabaseClient &client, const Table &table) {
+		// we don't track the name, which may not be the <table>_pkey that postgresql gives it by default
+		return client.primary_key_constraint_name(table);
+	}
+
+	static string primary_key_clause(DatabaseClient &client, const Table &table, const string &primary_key_name) {
+		return ",\n  CONSTRAINT " + client.quote_identifier(key_name(primary_key_name)) + " PRIMARY KEY" + columns_tuple(client, table.columns, table.primary_key_columns);
+	}
+
+	static void rename_keys(DatabaseClient &client, const Table &shadow_table, const Table &table, const string &primary_key_name, StatementFunction f) {
+		string schema_prefix(client.quote_schema_name(table.schema_name) + '.');
+		if (table.primary_key_type == PrimaryKeyType::explicit_primary_key) {
+			f("ALTER INDEX " + schema_prefix + client.quote_identifier(key_name(primary_key_name)) + " RENAME TO " + client.quote_identifier(primary_key_name));
+		}
+		for (const Key &key : table.keys) {
+			f("ALTER INDEX " + schema_prefix + client.quote_identifier(key_name(key.name)) + " RENAME TO " + client.quote_identifier(key.name));
+		}
+	}
+};
+
+// the shadow table's identity columns get their own sequences, which start from the beginning again; columns using
+// sequences share the original table's sequences, so those need to belong to the shadow table before it's dropped
+template <typename DatabaseClient, bool = is_base_of<SequenceColumns, DatabaseClient>::value>
+struct ShadowTableSequences {
+	static void reset_identity_sequences(DatabaseClient &client, const Table &shadow_table, StatementFunction f) {
+		/* nothing required */
+	}
+};
+
+template <typename DatabaseClient>
+struct ShadowTableSequences<DatabaseClient, true> {
+	static void reset_identity_sequences(DatabaseClient &client, const Table &shadow_table, StatementFunction f) {
+		for (const Column &column : shadow_table.columns) {
+			if (column.default_type == DefaultType::generated_by_default_as_identity || column.default_type == DefaultType::generated_always_as_identity) {
+				string statement("SELECT setval(pg_get_serial_sequence('");
+				statement += client.escape_string_value(client.quote_table_name(shadow_table));
+				statement += "', '";
+				statement += client.escape_string_value(column.name);
+				statement += "'), COALESCE(MAX(";
+				statement += client.quote_identifier(column.name);
+				statement += "), 0) + 1, false) FROM ";
+				statement += client.quote_table_name(shadow_table);
+				f(statement);
+			}
+		}
+	}
+};
+
+// on postgresql, we can drop the original table and rename the shadow table inside one transaction, whereas mysql
+// commits after each statement, but can swap the two tables in one RENAME TABLE statement
+template <typename DatabaseClient, bool = is_base_of<TransactionalDDL, DatabaseClient>::value>
+struct SwapShadowTableStatements {
+	static Table replaced_table(const Table &table) {
+		return Table(table.schema_name, shadow_relation_name(table.name, REPLACED_TABLE_SUFFIX));
+	}
+
+	static bool can_swap(DatabaseClient &client, const Table &table) {
+		// if an interrupted run left the table it replaced, or some other table has that name, it's not ours to drop
+		return !client.table_exists(replaced_table(table));
+	}
+
+	static void generate(DatabaseClient &client, const Table &shadow_table, const Table &table, const string &primary_key_name, StatementFunction f) {
+		f("RENAME TABLE " + client.quote_table_name(table) + " TO " + client.quote_table_name(replaced_table(table)) + ", " + client.quote_table_name(shadow_table) + " TO " + client.quote_table_name(table));
+		f("DROP TABLE " + client.quote_table_name(replaced_table(table)));
+		f(client.table_comment_statement(table, ""));
+	}
+};
+
+template <typename DatabaseClient>
+struct SwapShadowTableStatements<DatabaseClient, true> {
+	static bool can_swap(DatabaseClient &client, const Table &table) {
+		return true;
+	}
+
+	static void generate(DatabaseClient &client, const Table &shadow_table, const Table &table, const string &primary_key_name, StatementFunction f) {
+		OwnTableSequencesStatements<DatabaseClient>::generate(client, shadow_table, f);
+		f("DROP TABLE " + client.quote_table_name(table));
+		f("ALTER TABLE " + client.quote_table_name(shadow_table) + " RENAME TO " + client.quote_identifier(table.name));
+		f(client.table_comment_statement(table, ""));
+		ShadowKeyNames<DatabaseClient>::rename_keys(client, shadow_table, table, primary_key_name, f);
+	}
+};
+
+// a copy of a table under another name, which we load with rows and then swap in for the original table, so that
+// the original table is only locked for the duration of the swap, and the new table and its keys are compact
+template <typename DatabaseClient>
+struct ShadowTable {
+	ShadowTable(DatabaseClient &client, const Table &table): client(client), original_table(table), table(shadow_table_for(table)) {
+		if (table.primary_key_type == PrimaryKeyType::explicit_primary_key) {
+			primary_key_name = ShadowKeyNames<DatabaseClient>::primary_key_name(client, table);
+		}
+
+		// the keys other than the primary key are created after the rows have been loaded, so the table we load into
+		// doesn't have any, which also means we don't try to clear conflicting rows (there can't be any, as it starts empty)
+		keys = std::move(this->table.keys);
+		this->table.keys.clear();
+		for (Key &key : keys) key.name = ShadowKeyNames<DatabaseClient>::key_name(key.name);
+	}
+
+	static Table shadow_table_for(const Table &table) {
+		Table shadow_table(table);
+		shadow_table.name = shadow_relation_name(table.name, SHADOW_TABLE_SUFFIX);
+		return shadow_table;
+	}
+
+	static bool names_available(DatabaseClient &client, const Table &table) {
+		// a previous run may have been interrupted before swapping in its shadow table, which we mark with a comment
+		// so that we know we can drop it; any other table with that name must be left alone
+		Table shadow_table(shadow_table_for(table));
+		return ((!client.table_exists(shadow_table) || client.table_comment(shadow_table) == SHADOW_TABLE_COMMENT) &&
+		        SwapShadowTableStatements<DatabaseClient>::can_swap(client, table));
+	}
+
+	void create() {
+		client.execute("DROP TABLE IF EXISTS " + client.quote_table_name(table));
+
+		string result("CREATE TABLE ");
+		result += client.quote_table_name(table);
+		for (Columns::const_iterator column = table.columns.begin(); column != table.columns.end(); ++column) {
+			result += (column == table.columns.begin() ? " (\n  " : ",\n  ");
+			result += client.column_definition(table, *column);
+		}
+		if (table.primary_key_type == PrimaryKeyType::explicit_primary_key) {
+			// the rows arrive in primary key order, so it's cheap to build the primary key as we go, and on mysql,
+			// which stores the rows in the primary key, adding it afterwards would rewrite the whole table
+			result += ShadowKeyNames<DatabaseClient>::primary_key_clause(client, original_table, primary_key_name);
+		}
+		result += ")";
+		client.execute(result);
+		client.execute(client.table_comment_statement(table, SHADOW_TABLE_COMMENT));
+	}
+
+	void create_keys() {
+		StatementFunction execute([&](const string &statement) { client.execute(statement); });
+
+		Table table_with_keys(table);
+		table_with_keys.keys = keys;
+		for (const Key &key : keys) {
+			CreateKeyStatements<DatabaseClient>::generate(client, table_with_keys, key, execute);
+		}
+
+		ShadowTableSequences<DatabaseClient>::reset_identity_sequences(client, table, execute);
+	}
+
+	void swap() {
+		SwapShadowTableStatements<DatabaseClient>::generate(client, table, original_table, primary_key_name, [&](const string &statement) { client.execute(statement); });
+	}
+
+	DatabaseClient &client;
+	const Table &original_table;
+	Table table;
+	Keys keys;
+	string primary_key_name; // looked up before the original table is dropped
+};
+
+#endif
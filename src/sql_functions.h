@@ -1,12 +1,14 @@
 #ifndef SQL_FUNCTIONS_H
 #define SQL_FUNCTIONS_H
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
 #include "schema.h"
 #include "encode_packed.h"
 #include "packed_key.h"
+#include "sync_state.h"
 
 using namespace std;
 
@@ -74,11 +76,7 @@ string columns_tuple(DatabaseClient &client, const Columns &columns, const Colum
 }
 
 template <typename DatabaseClient>
-string values_list(DatabaseClient &client, const Table &table, const ColumnValues &values) {
-	if (values.empty()) {
-		return "(NULL)";
-	}
-
+void append_key_values_to(string &result, DatabaseClient &client, const Table &table, const ColumnValues &values) {
 	PackedValueReadStream stream(values.data());
 	Unpacker<PackedValueReadStream> unpacker(stream);
 
@@ -88,13 +86,22 @@ string values_list(DatabaseClient &client, const Table &table, const ColumnValue
 		throw runtime_error("read incorrect element count from key: " + to_string(size) + " vs " + to_string(table.primary_key_columns.size()));
 	}
 
-	string result("(");
 	for (size_t n = 0; n < size; n++) {
 		if (n > 0) {
 			result += ',';
 		}
 		sql_encode_and_append_packed_value_to(result, client, table.columns[table.primary_key_columns[n]], stream);
 	}
+}
+
+template <typename DatabaseClient>
+string values_list(DatabaseClient &client, const Table &table, const ColumnValues &values) {
+	if (values.empty()) {
+		return "(NULL)";
+	}
+
+	string result("(");
+	append_key_values_to(result, client, table, values);
 	result += ")";
 	return result;
 }
@@ -117,8 +124,7 @@ string values_list(DatabaseClient &client, const vector<string> &values) {
 }
 
 template <typename DatabaseClient>
-string where_sql(DatabaseClient &client, const Table &table, const char *op1, const ColumnValues &key1, const char *op2, const ColumnValues &key2, const char *op3, const ColumnValues &key3, const string &extra_where_conditions = "") {
-	const char *prefix = " WHERE ";
+string key_conditions_sql(DatabaseClient &client, const Table &table, const char *prefix, const char *op1, const ColumnValues &key1, const char *op2, const ColumnValues &key2, const char *op3, const ColumnValues &key3, const string &extra_where_conditions = "") {
 	string key_columns(columns_tuple(client, table.columns, table.primary_key_columns));
 	string result;
 	if (!key1.empty()) {
@@ -151,6 +157,17 @@ string where_sql(DatabaseClient &client, const Table &table, const char *op1, co
 	return result;
 }
 
+template <typename DatabaseClient>
+inline string where_sql(DatabaseClient &client, const Table &table, const char *op1, const ColumnValues &key1, const char *op2, const ColumnValues &key2, const char *op3, const ColumnValues &key3, const string &extra_where_conditions = "") {
+	return key_conditions_sql(client, table, " WHERE ", op1, key1, op2, key2, op3, key3, extra_where_conditions);
+}
+
+template <typename DatabaseClient>
+inline string key_range_sql(DatabaseClient &client, const Table &table, const ColumnValues &prev_key, const ColumnValues &last_key) {
+	// as per where_sql, but without the WHERE, for use in compound conditions; at least one key must be given
+	return key_conditions_sql(client, table, "", " > ", prev_key, " <= ", last_key, "", ColumnValues());
+}
+
 template <typename DatabaseClient>
 inline string where_sql(DatabaseClient &client, const Table &table, const ColumnValues &prev_key, const ColumnValues &last_key, const string &extra_where_conditions = "") {
 	return where_sql(client, table, " > ", prev_key, " <= ", last_key, "", ColumnValues(), extra_where_conditions);
@@ -195,6 +212,31 @@ string retrieve_rows_sql(DatabaseClient &client, const Table &table, const Colum
 	return result;
 }
 
+template <typename DatabaseClient>
+string retrieve_keys_sql(DatabaseClient &client, const Table &table, const ColumnValues &prev_key, const ColumnValues &last_key, ssize_t row_count = NO_ROW_COUNT_LIMIT) {
+	// as for retrieve_rows_sql, but selecting only the primary key columns, which the database can normally answer from the index
+	string result("SELECT ");
+	for (ColumnIndices::const_iterator column_index = table.primary_key_columns.begin(); column_index != table.primary_key_columns.end(); ++column_index) {
+		const Column &column(table.columns[*column_index]);
+		if (column_index != table.primary_key_columns.begin()) result += ", ";
+		if (!column.filter_expression.empty()) {
+			result += column.filter_expression;
+			result += " AS ";
+		}
+		result += client.quote_identifier(column.name);
+	}
+
+	result += " FROM ";
+	result += client.quote_table_name(table);
+	result += where_sql(client, table, prev_key, last_key, table.where_conditions);
+	result += column_orders_list(client, table);
+
+	if (row_count != NO_ROW_COUNT_LIMIT) {
+		result += " LIMIT " + to_string(row_count);
+	}
+	return result;
+}
+
 template <typename DatabaseClient>
 string count_rows_sql(DatabaseClient &client, const Table &table, const ColumnValues &prev_key, const ColumnValues &last_key) {
 	string result("SELECT COUNT(*) FROM ");
@@ -203,6 +245,44 @@ string count_rows_sql(DatabaseClient &client, const Table &table, const ColumnVa
 	return result;
 }
 
+template <typename DatabaseClient>
+string table_changes_sql(DatabaseClient &client, const Table &table, const string &changes_tracked_by, const string &since) {
+	string result("SELECT COUNT(*), ");
+	if (any_of(table.columns.begin(), table.columns.end(), [&](const Column &column) { return column.name == changes_tracked_by; })) {
+		result += "MAX(";
+		result += client.quote_identifier(changes_tracked_by);
+		result += ")";
+	} else if (changes_tracked_by == ROW_VERSIONS_COLUMN_NAME) {
+		result += client.row_versions_changed_since_expression(since);
+	} else {
+		throw out_of_range("Unknown column " + changes_tracked_by);
+	}
+	result += " FROM ";
+	result += client.quote_table_name(table);
+	result += where_sql(client, table, ColumnValues(), ColumnValues(), table.where_conditions);
+	return result;
+}
+
+// the first, empty, branch of the union gives the literals after it the types and collations of the key columns, so
+// the keys sort as the table's rows would; the rest are numbered so we can tell which key is which
+template <typename DatabaseClient>
+string select_key_order_sql(DatabaseClient &client, const Table &table, const vector<ColumnValues> &keys) {
+	string result("SELECT ks_key_index FROM (SELECT NULL AS ks_key_index, ");
+	result += columns_list(client, table.columns, table.primary_key_columns);
+	result += " FROM ";
+	result += client.quote_table_name(table);
+	result += " WHERE 1=0";
+	for (size_t n = 0; n < keys.size(); n++) {
+		result += " UNION ALL SELECT ";
+		result += to_string(n);
+		result += ',';
+		append_key_values_to(result, client, table, keys[n]);
+	}
+	result += ") AS ks_keys";
+	result += column_orders_list(client, table);
+	return result;
+}
+
 template <typename DatabaseClient>
 string select_first_key_sql(DatabaseClient &client, const Table &table) {
 	string result("SELECT ");
@@ -227,6 +307,18 @@ string select_last_key_sql(DatabaseClient &client, const Table &table) {
 	return result;
 }
 
+template <typename DatabaseClient>
+string select_last_key_between_sql(DatabaseClient &client, const Table &table, const ColumnValues &prev_key, const ColumnValues &next_key) {
+	string result("SELECT ");
+	result += columns_list(client, table.columns, table.primary_key_columns);
+	result += " FROM ";
+	result += client.quote_table_name(table);
+	result += where_sql(client, table, " > ", prev_key, " < ", next_key, "", ColumnValues(), table.where_conditions);
+	result += column_orders_list(client, table, DESCENDING);
+	result += " LIMIT 1";
+	return result;
+}
+
 template <typename DatabaseClient>
 string select_not_earlier_key_sql(DatabaseClient &client, const Table &table, const ColumnValues &key, const ColumnValues &prev_key, const ColumnValues &last_key) {
 	string result("SELECT ");
@@ -239,4 +331,17 @@ string select_not_earlier_key_sql(DatabaseClient &client, const Table &table, co
 	return result;
 }
 
+template <typename DatabaseClient>
+string select_nth_key_sql(DatabaseClient &client, const Table &table, const ColumnValues &prev_key, const char *upper_op, const ColumnValues &upper_key, size_t n) {
+	string result("SELECT ");
+	result += columns_list(client, table.columns, table.primary_key_columns);
+	result += " FROM ";
+	result += client.quote_table_name(table);
+	result += where_sql(client, table, " > ", prev_key, upper_op, upper_key, "", ColumnValues(), table.where_conditions);
+	result += column_orders_list(client, table, ASCENDING);
+	result += " LIMIT 1 OFFSET ";
+	result += to_string(n - 1);
+	return result;
+}
+
 #endif
@@ -5,10 +5,14 @@
 #include "schema.h"
 #include "schema_serialization.h"
 #include "row_serialization.h"
+#include "row_digests.h"
+#include "table_digest.h"
 #include "filter_serialization.h"
 #include "filters.h"
 #include "query_functions.h"
+#include "logical_decoding.h"
 #include "hash_algorithm.h"
+#include "hash_thread_pool.h"
 #include "sync_error.h"
 #include "substitute_primary_key.h"
 
@@ -16,9 +20,10 @@ template<class DatabaseClient>
 struct SyncFromWorker {
 	SyncFromWorker(
 		const string &database_host, const string &database_port, const string &database_username, const string &database_password, const string &database_name, const string &database_schema,
-		const string &set_variables,
+		const string &set_variables, int hash_threads,
 		int read_from_descriptor, int write_to_descriptor, char *status_area, size_t status_size):
 			client(database_host, database_port, database_username, database_password, database_name, database_schema, set_variables),
+			hash_thread_pool(hash_threads),
 			input_stream(read_from_descriptor),
 			input(input_stream),
 			output_stream(write_to_descriptor),
@@ -50,10 +55,38 @@ struct SyncFromWorker {
 					handle_range_command();
 					break;
 
+				case Commands::SPLIT:
+					handle_split_command();
+					break;
+
 				case Commands::HASH:
 					handle_hash_command();
 					break;
 
+				case Commands::HASH_KEYS:
+					handle_hash_keys_command();
+					break;
+
+				case Commands::DIGESTS:
+					handle_digests_command();
+					break;
+
+				case Commands::CHANGES:
+					handle_changes_command();
+					break;
+
+				case Commands::STATISTICS:
+					handle_statistics_command();
+					break;
+
+				case Commands::CHANGED_KEYS:
+					handle_changed_keys_command();
+					break;
+
+				case Commands::CONFIRM_CHANGES:
+					handle_confirm_changes_command();
+					break;
+
 				case Commands::ROWS:
 					handle_rows_command();
 					break;
@@ -214,6 +247,31 @@ struct SyncFromWorker {
 		send_command(output, Commands::RANGE, table_id, first_key(client, table), last_key(client, table));
 	}
 
+	void handle_split_command() {
+		string table_id;
+		ColumnValues prev_key, last_key;
+		size_t chunks, minimum_rows_per_chunk;
+		read_all_arguments(input, table_id, prev_key, last_key, chunks, minimum_rows_per_chunk);
+		show_status("syncing " + table_id);
+
+		// find the keys that divide the range into chunks with roughly equal numbers of rows, so that the other
+		// end can retrieve them in parallel; the range itself is not included, and the list is empty if it's
+		// not worth splitting
+		const Table &table(*tables_by_id.at(table_id));
+		size_t row_count = count_rows(client, table, prev_key, last_key);
+		size_t rows_per_chunk = max<size_t>((row_count + chunks - 1)/max<size_t>(chunks, 1), max<size_t>(minimum_rows_per_chunk, 1));
+		vector<ColumnValues> split_keys;
+
+		ColumnValues split_key(prev_key);
+		for (size_t rows_remaining = row_count; rows_remaining > rows_per_chunk; rows_remaining -= rows_per_chunk) {
+			split_key = nth_key(client, table, split_key, " <= ", last_key, rows_per_chunk);
+			if (split_key.empty() || split_key == last_key) break;
+			split_keys.push_back(split_key);
+		}
+
+		send_command(output, Commands::SPLIT, table_id, prev_key, last_key, split_keys);
+	}
+
 	void handle_hash_command() {
 		string table_id;
 		ColumnValues prev_key, last_key;
@@ -221,12 +279,112 @@ struct SyncFromWorker {
 		read_all_arguments(input, table_id, prev_key, last_key, rows_to_hash);
 		show_status("syncing " + table_id);
 
-		RowHasher hasher(hash_algorithm);
+		if (hash_algorithm == HashAlgorithm::xxh3_128_rows) {
+			RowDigestsRange range(hash_using_row_digests(table_id, prev_key, last_key, rows_to_hash));
+			send_command(output, Commands::HASH, table_id, prev_key, last_key, rows_to_hash, range.row_count, range.hash);
+			return;
+		}
+
+		RowHasher hasher(hash_algorithm, &hash_thread_pool);
 		size_t row_count = retrieve_rows(client, hasher, *tables_by_id.at(table_id), prev_key, last_key, rows_to_hash);
 
 		send_command(output, Commands::HASH, table_id, prev_key, last_key, rows_to_hash, row_count, hasher.finish());
 	}
 
+	void handle_hash_keys_command() {
+		string table_id;
+		ColumnValues prev_key, last_key;
+		size_t rows_to_hash;
+		read_all_arguments(input, table_id, prev_key, last_key, rows_to_hash);
+		show_status("syncing " + table_id);
+
+		RowHasher hasher(key_hash_algorithm(hash_algorithm), &hash_thread_pool);
+		size_t row_count = retrieve_keys(client, hasher, *tables_by_id.at(table_id), prev_key, last_key, rows_to_hash);
+
+		send_command(output, Commands::HASH_KEYS, table_id, prev_key, last_key, rows_to_hash, row_count, hasher.finish());
+	}
+
+	void handle_digests_command() {
+		vector<string> table_ids;
+		size_t maximum_table_size;
+		read_all_arguments(input, table_ids, maximum_table_size);
+		show_status("digesting " + to_string(table_ids.size()) + " tables");
+
+		// the other end picks the tables that are small at its end, but we only digest those that are small at our
+		// end too, so we don't read a large table in one go; the other end compares the tables we leave out as usual.
+		// the sizes are for the whole schema, so we only look them up for the first batch of tables.
+		if (!have_table_sizes) {
+			client.table_sizes(table_sizes);
+			have_table_sizes = true;
+		}
+
+		map<string, TableDigest> digests;
+		for (const string &table_id : table_ids) {
+			auto table_size = table_sizes.find(table_id);
+			if (table_size == table_sizes.end() || table_size->second > maximum_table_size) continue;
+			digests[table_id] = table_digest(client, *tables_by_id.at(table_id), hash_algorithm, &hash_thread_pool);
+		}
+
+		send_command(output, Commands::DIGESTS, digests);
+	}
+
+	void handle_changes_command() {
+		string table_id, column_name, since;
+		read_all_arguments(input, table_id, column_name, since);
+		show_status("syncing " + table_id);
+
+		const Table &table(*tables_by_id.at(table_id));
+		TableChanges changes(table_changes(client, table, column_name, since));
+
+		send_command(output, Commands::CHANGES, table_id, column_name, changes.row_count, changes.last_change);
+	}
+
+	void handle_statistics_command() {
+		read_all_arguments(input);
+		show_status("reading statistics");
+
+		// sent before the snapshot is taken, so that any change counted in the statistics is in the snapshot
+		map<string, string> table_statistics;
+		client.table_statistics(table_statistics);
+
+		send_command(output, Commands::STATISTICS, table_statistics);
+	}
+
+	void handle_changed_keys_command() {
+		string slot_name;
+		size_t max_changes;
+		read_all_arguments(input, slot_name, max_changes);
+		show_status("reading changes from " + slot_name);
+
+		ChangedKeys changed_keys;
+		client.read_changed_keys(slot_name, max_changes, database.tables, changed_keys);
+
+		send_command(output, Commands::CHANGED_KEYS, slot_name, changed_keys.upto_lsn, changed_keys.more_changes, changed_keys.keys_by_table, changed_keys.tables_to_reload);
+	}
+
+	void handle_confirm_changes_command() {
+		string slot_name, upto_lsn;
+		read_all_arguments(input, slot_name, upto_lsn);
+		show_status("confirming changes from " + slot_name);
+
+		client.confirm_changes(slot_name, upto_lsn);
+		send_command(output, Commands::CONFIRM_CHANGES); // just to indicate that we have completed the command
+	}
+
+	RowDigestsRange hash_using_row_digests(const string &table_id, const ColumnValues &prev_key, const ColumnValues &last_key, size_t rows_to_hash) {
+		// the 'to' end narrows down mismatches by hashing parts of ranges that it has hashed before, so we can
+		// often work the hash out from the row digests we kept rather than reading the rows again
+		RowDigestsRange range;
+		if (row_digest_cache.find(table_id, prev_key, last_key, rows_to_hash, range)) return range;
+
+		const Table &table(*tables_by_id.at(table_id));
+		RowDigester digester(table.primary_key_columns);
+		retrieve_rows(client, digester, table, prev_key, last_key, rows_to_hash);
+		range = RowDigestsRange(digester.row_digests, 0, digester.row_digests.rows());
+		row_digest_cache.add(table_id, prev_key, last_key, rows_to_hash, std::move(digester.row_digests));
+		return range;
+	}
+
 	void handle_rows_command() {
 		string table_id;
 		ColumnValues prev_key, last_key;
@@ -261,7 +419,9 @@ struct SyncFromWorker {
 		HashAlgorithm requested_hash_algorithm;
 		read_all_arguments(input, requested_hash_algorithm);
 
-		if (hash_algorithm == HashAlgorithm::md5 || hash_algorithm == HashAlgorithm::xxh64 || hash_algorithm == HashAlgorithm::blake3) {
+		if (requested_hash_algorithm == HashAlgorithm::md5 || requested_hash_algorithm == HashAlgorithm::xxh64 || requested_hash_algorithm == HashAlgorithm::blake3 ||
+			(requested_hash_algorithm == HashAlgorithm::xxh3_128 && output_stream.protocol_version >= FIRST_XXH3_VERSION) ||
+			(requested_hash_algorithm == HashAlgorithm::xxh3_128_rows && output_stream.protocol_version >= FIRST_ROW_DIGESTS_VERSION)) {
 			hash_algorithm = requested_hash_algorithm;
 		}
 
@@ -281,6 +441,7 @@ struct SyncFromWorker {
 	}
 
 	DatabaseClient client;
+	HashThreadPool hash_thread_pool;
 	Database database;
 	map<string, Table*> tables_by_id;
 	VersionedFDReadStream input_stream;
@@ -288,6 +449,9 @@ struct SyncFromWorker {
 	VersionedFDWriteStream output_stream;
 	Packer<VersionedFDWriteStream> output;
 	HashAlgorithm hash_algorithm;
+	RowDigestCache row_digest_cache;
+	map<string, size_t> table_sizes; // only looked up if asked for digests
+	bool have_table_sizes = false;
 	TableFilters table_filters;
 	ColumnTypeList accepted_types;
 	char *status_area;
@@ -0,0 +1,91 @@
+#include "sync_journal.h"
+
+#include <cstdio>
+#include <sstream>
+
+using namespace std;
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+static string hex_of(const ColumnValues &key) {
+	string result;
+	result.reserve(key.encoded_size()*2);
+	for (size_t n = 0; n < key.encoded_size(); n++) {
+		result += HEX_DIGITS[key.data()[n] >> 4];
+		result += HEX_DIGITS[key.data()[n] & 0x0f];
+	}
+	return result;
+}
+
+static bool key_from_hex(const string &hex, ColumnValues &key) {
+	if (hex.empty() || hex.size() % 2 || hex.find_first_not_of(HEX_DIGITS) != string::npos) return false;
+	key.clear();
+	for (size_t n = 0; n < hex.size(); n += 2) {
+		uint8_t byte = static_cast<uint8_t>(stoi(hex.substr(n, 2), nullptr, 16));
+		key.write(&byte, 1);
+	}
+	return true;
+}
+
+void SyncJournal::open(const string &journal_file, bool resume) {
+	this->journal_file = journal_file;
+
+	if (resume) {
+		// each line records a finished range or table; the last line may be incomplete if we were killed while
+		// writing it, in which case we ignore it
+		ifstream in(journal_file);
+		string line;
+		while (getline(in, line)) {
+			istringstream fields(line);
+			string type, table_id, prev_key_hex, last_key_hex, state;
+			getline(fields, type, '\t');
+			getline(fields, table_id, '\t');
+
+			if (type == "table") {
+				getline(fields, state, '\t');
+				if (state == "finished") resumed_tables.insert(table_id);
+
+			} else if (type == "range") {
+				getline(fields, prev_key_hex, '\t');
+				getline(fields, last_key_hex, '\t');
+				getline(fields, state, '\t');
+				ColumnValues prev_key, last_key;
+				if ((state == "matched" || state == "applied") && key_from_hex(prev_key_hex, prev_key) && key_from_hex(last_key_hex, last_key)) {
+					resumed_ranges[table_id].emplace_back(prev_key, last_key);
+				}
+			}
+		}
+	}
+
+	out.open(journal_file, resume ? ios::app : ios::trunc);
+	if (!out.good()) throw sync_journal_error("Couldn't open journal file " + journal_file);
+}
+
+void SyncJournal::record_range(const string &table_id, const KeyRange &range, bool applied) {
+	unique_lock<std::mutex> lock(mutex);
+	out << "range\t" << table_id << '\t' << hex_of(get<0>(range)) << '\t' << hex_of(get<1>(range)) << '\t' << (applied ? "applied" : "matched") << endl;
+	if (!out.good()) throw sync_journal_error("Couldn't write to journal file " + journal_file);
+}
+
+void SyncJournal::record_table_finished(const string &table_id) {
+	unique_lock<std::mutex> lock(mutex);
+	out << "table\t" << table_id << "\tfinished" << endl;
+	if (!out.good()) throw sync_journal_error("Couldn't write to journal file " + journal_file);
+}
+
+void SyncJournal::remove() {
+	unique_lock<std::mutex> lock(mutex);
+	out.close();
+	if (::remove(journal_file.c_str()) != 0) throw sync_journal_error("Couldn't remove journal file " + journal_file);
+}
+
+bool SyncJournal::table_finished(const string &table_id) {
+	unique_lock<std::mutex> lock(mutex);
+	return (resumed_tables.count(table_id) > 0);
+}
+
+vector<KeyRange> SyncJournal::ranges_finished(const string &table_id) {
+	unique_lock<std::mutex> lock(mutex);
+	auto it = resumed_ranges.find(table_id);
+	return (it == resumed_ranges.end() ? vector<KeyRange>() : it->second);
+}
@@ -0,0 +1,72 @@
+#ifndef SYNC_JOURNAL_H
+#define SYNC_JOURNAL_H
+
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+#include <tuple>
+#include <mutex>
+#include <fstream>
+#include <stdexcept>
+
+#include "message_pack/pack.h"
+#include "message_pack/packed_value.h"
+#include "packed_key.h"
+
+using namespace std;
+
+typedef tuple<ColumnValues, ColumnValues> KeyRange;
+
+struct sync_journal_error: public runtime_error {
+	sync_journal_error(const string &error): runtime_error(error) { }
+};
+
+// records the key ranges that the 'to' end has finished with as it goes, so that if the run is interrupted, a rerun
+// with --resume only needs to check the rest.  ranges are recorded once their rows are known to match, or once the
+// rows we applied to them have been committed, which needs --commit often.  kept by the 'to' end in the --journal
+// file, which is removed when a run completes.  shared by the workers, so use the methods, which lock the mutex.
+struct SyncJournal {
+	void open(const string &journal_file, bool resume);
+	void record_range(const string &table_id, const KeyRange &range, bool applied);
+	void record_table_finished(const string &table_id);
+	void remove();
+
+	inline bool enabled() const { return !journal_file.empty(); }
+
+	// as recorded by the interrupted run(s), if resuming
+	bool table_finished(const string &table_id);
+	vector<KeyRange> ranges_finished(const string &table_id);
+
+	std::mutex mutex;
+	string journal_file;
+	ofstream out;
+	map<string, vector<KeyRange>> resumed_ranges; // by table ID
+	set<string> resumed_tables;
+};
+
+// joins up ranges that carry on from each other, which is all we can do without the database to compare the keys
+inline vector<KeyRange> join_key_ranges(const vector<KeyRange> &ranges) {
+	map<ColumnValues, ColumnValues> last_key_by_prev_key;
+	set<ColumnValues> last_keys;
+	for (const KeyRange &range : ranges) {
+		last_key_by_prev_key.emplace(get<0>(range), get<1>(range));
+		last_keys.insert(get<1>(range));
+	}
+
+	vector<KeyRange> result;
+	for (auto const &it : last_key_by_prev_key) {
+		if (last_keys.count(it.first)) continue; // carries on from another range, so included below
+
+		ColumnValues last_key(it.second);
+		for (size_t n = 0; n < last_key_by_prev_key.size(); n++) {
+			auto next = last_key_by_prev_key.find(last_key);
+			if (next == last_key_by_prev_key.end()) break;
+			last_key = next->second;
+		}
+		result.emplace_back(it.first, last_key);
+	}
+	return result;
+}
+
+#endif
@@ -9,19 +9,25 @@
 #include "abortable_barrier.h"
 #include "schema.h"
 #include "subdivision.h"
+#include "local_row_cache.h"
+#include "row_digests.h"
+#include "sync_state.h"
+#include "sync_journal.h"
+#include "logical_decoding.h"
+#include "diff_report.h"
 
 using namespace std;
 
-typedef tuple<ColumnValues, ColumnValues> KeyRange;
 struct KeyRangeToCheck {
-	KeyRangeToCheck(const ColumnValues &prev_key, const ColumnValues &last_key, size_t estimated_rows_in_range, size_t rows_to_hash, size_t priority):
-		key_range(prev_key, last_key), estimated_rows_in_range(estimated_rows_in_range), rows_to_hash(rows_to_hash), priority(priority) {
+	KeyRangeToCheck(const ColumnValues &prev_key, const ColumnValues &last_key, size_t estimated_rows_in_range, size_t rows_to_hash, size_t priority, bool hash_keys):
+		key_range(prev_key, last_key), estimated_rows_in_range(estimated_rows_in_range), rows_to_hash(rows_to_hash), priority(priority), hash_keys(hash_keys) {
 	}
 
 	KeyRange key_range;
 	size_t estimated_rows_in_range;
 	size_t rows_to_hash;
 	size_t priority;
+	bool hash_keys; // if true, compare only the primary key values in the range, to find inserted and deleted rows
 };
 const size_t UNKNOWN_ROW_COUNT = numeric_limits<size_t>::max();
 
@@ -32,9 +38,9 @@ struct lower_priority {
 };
 
 struct TableJob {
-	TableJob(const Table &table): table(table), table_id(table.id_from_name()), subdividable(primary_key_subdividable(table)), notify_when_work_could_be_shared(false), time_started(0), time_finished(0), hash_commands(0), hash_commands_completed(0), rows_commands(0) {}
+	TableJob(const Table &table): table(table), table_id(table.id_from_name()), subdividable(primary_key_subdividable(table)), notify_when_work_could_be_shared(false), any_worker_may_retrieve(false), digests_matched(false), time_started(0), time_finished(0), hash_commands(0), hash_commands_completed(0), rows_commands(0), rows_commands_completed(0), load_commands(0), load_commands_completed(0), rows_loaded_by_helpers(0) {}
 
-	inline bool have_work_to_share() { return (!ranges_to_check.empty()); }
+	inline bool have_work_to_share() { return (!ranges_to_check.empty() || !ranges_to_load.empty() || (any_worker_may_retrieve && !ranges_to_retrieve.empty())); }
 
 	const Table &table;
 	const string table_id; // cached
@@ -44,8 +50,11 @@ struct TableJob {
 	std::condition_variable borrowed_task_completed;
 
 	deque<KeyRange> ranges_to_retrieve;
+	deque<KeyRange> ranges_to_load; // only used when loading into an empty table, in which case any worker may insert rows
 	priority_queue<KeyRangeToCheck, deque<KeyRangeToCheck>, lower_priority> ranges_to_check;
 	bool notify_when_work_could_be_shared;
+	bool any_worker_may_retrieve; // with --verify, nothing is written, so there are no locks to fight over
+	bool digests_matched; // the whole table matched when small tables were digested, so there's nothing to compare
 
 	time_t time_started;
 	time_t time_finished;
@@ -53,6 +62,19 @@ struct TableJob {
 	size_t hash_commands;
 	size_t hash_commands_completed;
 	size_t rows_commands;
+	size_t rows_commands_completed; // only counted with --verify
+	size_t load_commands;
+	size_t load_commands_completed;
+	size_t rows_loaded_by_helpers;
+
+	string changes_tracked_by; // only set if we're tracking changes to the table in the state file
+	TableChanges their_changes; // as at the start of the sync
+	string their_statistics; // only set if we're skipping unchanged tables using the server statistics, and didn't skip this one
+	RowDifferences differences; // only counted with --verify; totals of the ranges found by all the workers
+	SampleResults sample_results; // only used with --verify-sample, and only by the writer
+
+	LocalRowCache local_row_cache; // shared by the workers, so lock the mutex to use it
+	RowDigestCache row_digest_cache; // only used with the xxh3_128_rows hash algorithm; shared by the workers, so lock the mutex to use it
 };
 
 template <typename DatabaseClient>
@@ -67,6 +89,36 @@ struct SyncQueue: public AbortableBarrier {
 		}
 	}
 
+	void enqueue_tables_to_process(const Tables &tables, const set<string> &table_ids, bool digests_matched = false) {
+		unique_lock<std::mutex> lock(mutex);
+
+		for (const Table &from_table : tables) {
+			if (table_ids.count(from_table.id_from_name())) {
+				tables_to_process.push_back(make_shared<TableJob>(from_table));
+				tables_to_process.back()->digests_matched = digests_matched;
+			}
+		}
+	}
+
+	void enqueue_tables_to_digest(const vector<string> &table_ids, size_t tables_per_batch) {
+		unique_lock<std::mutex> lock(mutex);
+
+		for (size_t n = 0; n < table_ids.size(); n += tables_per_batch) {
+			tables_to_digest.emplace_back(table_ids.begin() + n, table_ids.begin() + min(n + tables_per_batch, table_ids.size()));
+		}
+	}
+
+	bool next_tables_to_digest(vector<string> &table_ids) {
+		unique_lock<std::mutex> lock(mutex);
+
+		if (aborted) throw aborted_error();
+		if (tables_to_digest.empty()) return false;
+
+		table_ids = std::move(tables_to_digest.front());
+		tables_to_digest.pop_front();
+		return true;
+	}
+
 	shared_ptr<TableJob> find_table_job() {
 		unique_lock<std::mutex> lock(mutex);
 
@@ -104,6 +156,30 @@ struct SyncQueue: public AbortableBarrier {
 		cond.notify_all();
 	}
 
+	void enqueue_deferred_statements(const list<string> &statements) {
+		unique_lock<std::mutex> lock(mutex);
+
+		deferred_statements.insert(deferred_statements.end(), statements.begin(), statements.end());
+	}
+
+	bool have_deferred_statements() {
+		unique_lock<std::mutex> lock(mutex);
+
+		return !deferred_statements.empty();
+	}
+
+	bool next_deferred_statement(string &statement, size_t &statements_remaining) {
+		unique_lock<std::mutex> lock(mutex);
+
+		if (aborted) throw aborted_error();
+		if (deferred_statements.empty()) return false;
+
+		statement = std::move(deferred_statements.front());
+		deferred_statements.pop_front();
+		statements_remaining = deferred_statements.size();
+		return true;
+	}
+
 	bool abort() {
 		bool result = AbortableBarrier::abort();
 
@@ -118,6 +194,9 @@ struct SyncQueue: public AbortableBarrier {
 	}
 
 	string snapshot;
+	ChangedKeys changed_keys; // only used with --catch-up; set by the leader before the tables are queued, and not changed after that
+	map<string, string> their_statistics; // only used with --skip-unchanged-tables; set by the leader before the snapshot is taken, and not changed after that
+	map<string, size_t> table_sizes; // only used with --verify-sample; set by the leader before the tables are queued, and not changed after that
 
 private:
 	inline bool finished() {
@@ -163,6 +242,8 @@ private:
 	list<shared_ptr<TableJob>> tables_to_process;
 	set<shared_ptr<TableJob>> tables_being_processed;
 	set<shared_ptr<TableJob>> tables_with_work_to_share;
+	list<string> deferred_statements;
+	list<vector<string>> tables_to_digest; // only used with --digest-small-tables, in batches of table IDs
 };
 
 #endif
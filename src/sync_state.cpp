@@ -0,0 +1,109 @@
+#include "sync_state.h"
+
+#include <cstdio>
+#include <fstream>
+
+#include "yaml-cpp/yaml.h"
+#include "to_string.h"
+
+using namespace std;
+
+void load_table_changes(const string &table_name, TableChanges &table_changes, const YAML::Node &node) {
+	if (!node.IsMap() || !node["row_count"]) {
+		throw sync_state_error("Don't know how to read the state for table '" + table_name + "': " + to_string(node));
+	}
+
+	table_changes.row_count = node["row_count"].as<size_t>();
+	if (node["last_change"] && !node["last_change"].IsNull()) {
+		table_changes.last_change = node["last_change"].as<string>();
+	}
+}
+
+void load_table_statistics(const string &table_name, TableStatisticsState &table_statistics, const YAML::Node &node) {
+	if (!node.IsMap() || !node["from"] || !node["verified_at"]) {
+		throw sync_state_error("Don't know how to read the statistics for table '" + table_name + "': " + to_string(node));
+	}
+
+	table_statistics.from = node["from"].as<string>();
+	table_statistics.verified_at = node["verified_at"].as<time_t>();
+}
+
+void load_sync_state(const string &state_file, SyncState &sync_state) {
+	// there's no state to load the first time we run
+	if (state_file.empty() || !ifstream(state_file).good()) return;
+
+	YAML::Node config(YAML::LoadFile(state_file));
+
+	for (YAML::const_iterator table_it = config.begin(); table_it != config.end(); ++table_it) {
+		string table_name(table_it->first.as<string>());
+		const YAML::Node &node(table_it->second);
+
+		// each table has the state for its change-tracking column, or its server statistics, or both
+		if (!node.IsMap() || (!node["changes_tracked_by"] && !node["statistics"]) || (node["changes_tracked_by"] && (!node["from"] || !node["to"]))) {
+			throw sync_state_error("Don't know how to read the state for table '" + table_name + "': " + to_string(node));
+		}
+
+		if (node["changes_tracked_by"]) {
+			TableSyncState &table_state(sync_state.tables[table_name]);
+			table_state.changes_tracked_by = node["changes_tracked_by"].as<string>();
+			load_table_changes(table_name, table_state.from, node["from"]);
+			load_table_changes(table_name, table_state.to, node["to"]);
+		}
+
+		if (node["statistics"]) {
+			load_table_statistics(table_name, sync_state.table_statistics[table_name], node["statistics"]);
+		}
+	}
+}
+
+void save_table_changes(YAML::Emitter &emitter, const TableChanges &table_changes) {
+	emitter << YAML::BeginMap;
+	emitter << YAML::Key << "row_count" << YAML::Value << table_changes.row_count;
+	emitter << YAML::Key << "last_change" << YAML::Value << YAML::DoubleQuoted << table_changes.last_change;
+	emitter << YAML::EndMap;
+}
+
+void save_table_statistics(YAML::Emitter &emitter, const TableStatisticsState &table_statistics) {
+	emitter << YAML::BeginMap;
+	emitter << YAML::Key << "from" << YAML::Value << YAML::DoubleQuoted << table_statistics.from;
+	emitter << YAML::Key << "verified_at" << YAML::Value << table_statistics.verified_at;
+	emitter << YAML::EndMap;
+}
+
+void save_sync_state(const string &state_file, const SyncState &sync_state) {
+	YAML::Emitter emitter;
+	set<string> table_names;
+	for (auto const &it : sync_state.tables) table_names.insert(it.first);
+	for (auto const &it : sync_state.table_statistics) table_names.insert(it.first);
+
+	emitter << YAML::BeginMap;
+	for (const string &table_name : table_names) {
+		emitter << YAML::Key << table_name << YAML::Value << YAML::BeginMap;
+		auto table_state = sync_state.tables.find(table_name);
+		if (table_state != sync_state.tables.end()) {
+			emitter << YAML::Key << "changes_tracked_by" << YAML::Value << table_state->second.changes_tracked_by;
+			emitter << YAML::Key << "from" << YAML::Value;
+			save_table_changes(emitter, table_state->second.from);
+			emitter << YAML::Key << "to" << YAML::Value;
+			save_table_changes(emitter, table_state->second.to);
+		}
+		auto table_statistics = sync_state.table_statistics.find(table_name);
+		if (table_statistics != sync_state.table_statistics.end()) {
+			emitter << YAML::Key << "statistics" << YAML::Value;
+			save_table_statistics(emitter, table_statistics->second);
+		}
+		emitter << YAML::EndMap;
+	}
+	emitter << YAML::EndMap;
+
+	// write it out to a new file and then rename it over the old one, so we never leave a partially-written file
+	string temporary_file(state_file + ".tmp");
+	{
+		ofstream out(temporary_file);
+		out << emitter.c_str() << endl;
+		if (!out.good()) throw sync_state_error("Couldn't write to state file " + temporary_file);
+	}
+	if (rename(temporary_file.c_str(), state_file.c_str()) != 0) {
+		throw sync_state_error("Couldn't replace state file " + state_file);
+	}
+}
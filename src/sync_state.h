@@ -0,0 +1,128 @@
+#ifndef SYNC_STATE_H
+#define SYNC_STATE_H
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <ctime>
+
+using namespace std;
+
+struct sync_state_error: public runtime_error {
+	sync_state_error(const string &error): runtime_error(error) { }
+};
+
+// the row count and greatest value of a table's change-tracking column (such as an updated_at timestamp or version
+// column), which we expect to change if any rows are inserted, updated, or deleted.  the value is kept as text in
+// whatever format the database returns it, since we only ever compare it to values from the same database; NULL is
+// kept as an empty string.
+struct TableChanges {
+	TableChanges(): row_count(0) {}
+	TableChanges(size_t row_count, const string &last_change): row_count(row_count), last_change(last_change) {}
+
+	inline bool operator ==(const TableChanges &other) const { return (row_count == other.row_count && last_change == other.last_change); }
+	inline bool operator !=(const TableChanges &other) const { return !(*this == other); }
+
+	size_t row_count;
+	string last_change;
+};
+
+// on databases that support it (currently PostgreSQL), tables can be tracked using the transaction IDs that last
+// wrote each row, given as this column name; the value we record is then a watermark rather than the greatest value
+const char * const ROW_VERSIONS_COLUMN_NAME = "xmin";
+
+struct TableSyncState {
+	string changes_tracked_by;
+	TableChanges from;
+	TableChanges to;
+};
+
+// with --skip-unchanged-tables, what the 'from' end's server statistics showed for the table (an opaque string made
+// from its write counters or last update time, which changes whenever the table is written to) when we last synced
+// it, and when we last actually compared it rather than skipping it
+struct TableStatisticsState {
+	TableStatisticsState(): verified_at(0) {}
+
+	string from;
+	time_t verified_at;
+};
+
+// what the tables with change-tracking columns looked like at each end after the last successful sync, so that the
+// next run can skip tables which haven't changed since at either end.  kept by the 'to' end in the --state-file, which
+// should be used for only one target database.  shared by the workers, so use the methods, which lock the mutex.
+struct SyncState {
+	SyncState(): changed(false) {}
+
+	TableSyncState recorded(const string &table_id, const string &changes_tracked_by) {
+		unique_lock<std::mutex> lock(mutex);
+		auto it = tables.find(table_id);
+		return (it != tables.end() && it->second.changes_tracked_by == changes_tracked_by ? it->second : TableSyncState());
+	}
+
+	bool unchanged(const string &table_id, const string &changes_tracked_by, const TableChanges &from, const TableChanges &to) {
+		unique_lock<std::mutex> lock(mutex);
+		auto it = tables.find(table_id);
+		return (it != tables.end() && it->second.changes_tracked_by == changes_tracked_by && it->second.from == from && it->second.to == to);
+	}
+
+	// if watermark_pending is true, to.last_change is filled in by set_pending_watermarks once our changes are committed
+	void record(const string &table_id, const string &changes_tracked_by, const TableChanges &from, const TableChanges &to, bool watermark_pending = false) {
+		unique_lock<std::mutex> lock(mutex);
+		TableSyncState &table_state(tables[table_id]);
+		table_state.changes_tracked_by = changes_tracked_by;
+		table_state.from = from;
+		table_state.to = to;
+		if (watermark_pending) {
+			pending_watermarks.insert(table_id);
+		} else {
+			pending_watermarks.erase(table_id);
+		}
+		changed = true;
+	}
+
+	bool statistics_unchanged(const string &table_id, const string &from, time_t now, time_t verify_interval) {
+		unique_lock<std::mutex> lock(mutex);
+		auto it = table_statistics.find(table_id);
+		return (it != table_statistics.end() && it->second.from == from && now < it->second.verified_at + verify_interval);
+	}
+
+	void record_statistics(const string &table_id, const string &from, time_t verified_at) {
+		unique_lock<std::mutex> lock(mutex);
+		TableStatisticsState &table_state(table_statistics[table_id]);
+		table_state.from = from;
+		table_state.verified_at = verified_at;
+		changed = true;
+	}
+
+	void forget_statistics(const string &table_id) {
+		unique_lock<std::mutex> lock(mutex);
+		if (table_statistics.erase(table_id)) changed = true;
+	}
+
+	bool have_pending_watermarks() {
+		unique_lock<std::mutex> lock(mutex);
+		return !pending_watermarks.empty();
+	}
+
+	void set_pending_watermarks(const string &watermark) {
+		unique_lock<std::mutex> lock(mutex);
+		for (const string &table_id : pending_watermarks) {
+			tables[table_id].to.last_change = watermark;
+		}
+		pending_watermarks.clear();
+	}
+
+	std::mutex mutex;
+	map<string, TableSyncState> tables; // by table ID, as for filters
+	set<string> pending_watermarks;
+	map<string, TableStatisticsState> table_statistics; // by table ID, only used with --skip-unchanged-tables
+	bool changed;
+};
+
+void load_sync_state(const string &state_file, SyncState &sync_state);
+
+void save_sync_state(const string &state_file, const SyncState &sync_state);
+
+#endif
@@ -10,8 +10,11 @@
 #include "schema_functions.h"
 #include "schema_matcher.h"
 #include "sync_queue.h"
+#include "table_digest.h"
 #include "row_range_applier.h"
 #include "reset_table_sequences.h"
+#include "shadow_table.h"
+#include "sample_budget.h"
 #include "sync_to_algorithm.h"
 
 using namespace std;
@@ -19,14 +22,19 @@ using namespace std;
 template <typename DatabaseClient>
 struct SyncToWorker {
 	SyncToWorker(
-		Database &database, SyncQueue<DatabaseClient> &sync_queue, bool leader, int worker_number, int read_from_descriptor, int write_to_descriptor,
+		Database &database, SyncQueue<DatabaseClient> &sync_queue, HashThreadPool &hash_thread_pool, SyncState &sync_state, SyncJournal &sync_journal, ostream &report, bool leader, int worker_number, int read_from_descriptor, int write_to_descriptor,
 		const string &database_host, const string &database_port, const string &database_username, const string &database_password, const string &database_name, const string &database_schema,
 		const string &set_variables, const string &filter_file, const set<string> &ignore_tables, const set<string> &only_tables,
 		int verbose, bool progress, bool snapshot, bool alter, CommitLevel commit_level,
 		HashAlgorithm hash_algorithm, size_t target_minimum_block_size, size_t target_maximum_block_size,
-		bool structure_only):
+		bool structure_only, bool defer_indexes, bool hash_keys_first, const set<string> &keys_only_tables, const string &catch_up_slot, bool digest_small_tables,
+		bool skip_unchanged_tables, time_t verify_interval, bool auto_reload, bool verify, const string &verify_sample):
 			database(database),
 			sync_queue(sync_queue),
+			hash_thread_pool(hash_thread_pool),
+			sync_state(sync_state),
+			sync_journal(sync_journal),
+			report(report),
 			leader(leader),
 			worker_number(worker_number),
 			input_stream(read_from_descriptor),
@@ -40,12 +48,22 @@ struct SyncToWorker {
 			verbose(verbose),
 			progress(progress),
 			snapshot(snapshot),
-			alter(alter),
+			alter(alter && !verify), // --verify leaves the schema alone too
 			commit_level(commit_level),
 			hash_algorithm(hash_algorithm),
 			target_minimum_block_size(target_minimum_block_size),
 			target_maximum_block_size(target_maximum_block_size),
 			structure_only(structure_only),
+			defer_indexes(defer_indexes),
+			hash_keys_first(hash_keys_first),
+			keys_only_tables(keys_only_tables),
+			catch_up_slot(catch_up_slot),
+			digest_small_tables(digest_small_tables),
+			skip_unchanged_tables(skip_unchanged_tables),
+			verify_interval(verify_interval),
+			auto_reload(auto_reload),
+			verify(verify),
+			sample_budget(parse_sample_budget(verify_sample)),
 			worker_thread(std::ref(*this)) {
 	}
 
@@ -72,10 +90,12 @@ struct SyncToWorker {
 			negotiate_hash_algorithm();
 			if (output_stream.protocol_version > LAST_FILTERS_AFTER_SNAPSHOT_PROTOCOL_VERSION) send_filters(); // send early so they can be factored into substitute PK decisions
 			negotiate_types();
+			retrieve_table_statistics();
 			share_snapshot();
 			retrieve_database_schema();
 			compare_schema();
 			if (output_stream.protocol_version <= LAST_FILTERS_AFTER_SNAPSHOT_PROTOCOL_VERSION) send_filters(); // we used to send them later after checking the rest of the schema
+			retrieve_changed_keys();
 			sync_queue.wait_at_barrier();
 
 			return true;
@@ -93,19 +113,32 @@ struct SyncToWorker {
 		try {
 			enqueue_tables();
 
-			client.start_write_transaction();
-			client.disable_referential_integrity(leader);
+			if (verify) {
+				// we only count the changes we would make, so we never need to lock anything
+				client.start_read_transaction();
+			} else {
+				client.start_write_transaction();
+				client.disable_referential_integrity(leader);
+			}
 
 			SyncToAlgorithm<SyncToWorker<DatabaseClient>, DatabaseClient> sync_to_protocol(*this);
 			sync_to_protocol.sync_tables();
 
+			create_deferred_keys();
+
 			wait_for_finish();
 
-			if (commit_level >= CommitLevel::success) {
+			if (verify) {
+				client.rollback_transaction();
+			} else if (commit_level >= CommitLevel::success) {
 				commit();
+				record_row_version_watermark();
+				confirm_changes();
 			} else {
 				rollback();
 			}
+
+			if (leader && catching_up()) send_quit_command(); // see wait_for_finish()
 		} catch (const exception &e) {
 			// make sure all other workers terminate promptly, and if we are the first to fail, output the error
 			if (sync_queue.abort()) {
@@ -137,11 +170,15 @@ struct SyncToWorker {
 	void negotiate_hash_algorithm() {
 		if (hash_algorithm == HashAlgorithm::auto_select) {
 			hash_algorithm = output_stream.protocol_version < FIRST_BLAKE3_VERSION ? HashAlgorithm::md5 : HashAlgorithm::blake3;
+		} else if ((hash_algorithm == HashAlgorithm::xxh3_128 && output_stream.protocol_version < FIRST_XXH3_VERSION) ||
+		           (hash_algorithm == HashAlgorithm::xxh3_128_rows && output_stream.protocol_version < FIRST_ROW_DIGESTS_VERSION)) {
+			// earlier versions would accept the command but not be able to hash with it
+			throw runtime_error("The other end doesn't support XXH3 hashing, please upgrade it or choose another hash algorithm");
 		}
 
 		send_command(output, Commands::HASH_ALGORITHM, static_cast<int>(hash_algorithm));
 		read_expected_command(input, Commands::HASH_ALGORITHM, hash_algorithm);
-		if (hash_algorithm != HashAlgorithm::md5 && hash_algorithm != HashAlgorithm::xxh64 && hash_algorithm != HashAlgorithm::blake3) {
+		if (hash_algorithm != HashAlgorithm::md5 && hash_algorithm != HashAlgorithm::xxh64 && hash_algorithm != HashAlgorithm::blake3 && hash_algorithm != HashAlgorithm::xxh3_128 && hash_algorithm != HashAlgorithm::xxh3_128_rows) {
 			throw runtime_error("Couldn't find a compatible hash algorithm");
 		}
 	}
@@ -183,6 +220,16 @@ struct SyncToWorker {
 		}
 	}
 
+	void retrieve_table_statistics() {
+		// any change counted in the statistics needs to be in the data we compare, so we get them before the snapshot
+		if (!skip_unchanged_tables || catching_up() || structure_only || output_stream.protocol_version < FIRST_STATISTICS_COMMAND_VERSION) return;
+
+		if (leader) {
+			send_command(output, Commands::STATISTICS);
+			read_expected_command(input, Commands::STATISTICS, sync_queue.their_statistics);
+		}
+	}
+
 	void retrieve_database_schema() {
 		// we could do this in all workers, but there's no need, and it'd waste a bit of traffic/time
 		if (leader) {
@@ -202,7 +249,9 @@ struct SyncToWorker {
 			restrict_tables(to_database.tables);
 
 			// check they match, and if not, figure out what DDL we would need to run to fix the 'to' end's schema
-			SchemaMatcher<DatabaseClient> matcher(client);
+			// we only defer creating keys when we're committing as we go, since they're created outside the data
+			// transactions; if the run fails before they're created, the next run will add them as for any missing key
+			SchemaMatcher<DatabaseClient> matcher(client, defer_indexes && alter && !structure_only && commit_level >= CommitLevel::often);
 
 			matcher.match_schemas(database, to_database);
 
@@ -215,6 +264,10 @@ struct SyncToWorker {
 						client.execute(statement);
 					}
 				}
+				sync_queue.enqueue_deferred_statements(matcher.deferred_key_statements);
+
+				// the tables we created are empty, whatever their end's server statistics say, so must be compared
+				for (const string &table_id : matcher.tables_created) sync_state.forget_statistics(table_id);
 			} else {
 				cerr << "The database schema doesn't match.  Use the --alter option if you would like to automatically apply the following schema changes:" << endl << endl;
 				for (const string &statement : matcher.statements) {
@@ -226,6 +279,27 @@ struct SyncToWorker {
 		}
 	}
 
+	inline bool catching_up() const { return !catch_up_slot.empty(); }
+
+	void retrieve_changed_keys() {
+		if (!catching_up() || structure_only) return;
+
+		if (output_stream.protocol_version < FIRST_CATCH_UP_VERSION) {
+			throw runtime_error("The other end doesn't support --catch-up, please upgrade it");
+		}
+
+		// the changes are read in the leader's snapshot, so the other workers must share it to see the same rows
+		if (sync_queue.workers > 1 && !snapshot) {
+			throw runtime_error("--catch-up can't be used with --without-snapshot-export when using multiple workers");
+		}
+
+		if (leader) {
+			string slot_name;
+			send_command(output, Commands::CHANGED_KEYS, catch_up_slot, DEFAULT_CATCH_UP_MAX_CHANGES);
+			read_expected_command(input, Commands::CHANGED_KEYS, slot_name, sync_queue.changed_keys.upto_lsn, sync_queue.changed_keys.more_changes, sync_queue.changed_keys.keys_by_table, sync_queue.changed_keys.tables_to_reload);
+		}
+	}
+
 	void restrict_tables(Tables &tables) {
 		Tables::iterator table = tables.begin();
 		while (table != tables.end()) {
@@ -290,19 +364,135 @@ struct SyncToWorker {
 	}
 
 	void enqueue_tables() {
-		// queue up all the tables
-		if (leader) {
+		// queue up all the tables, or when catching up, just those with changes, or when digesting small tables, just
+		// the large tables for now
+		if (leader && sample_budget.given()) client.table_sizes(sync_queue.table_sizes);
+
+		if (leader && catching_up()) {
+			set<string> table_ids(sync_queue.changed_keys.tables_to_reload);
+			for (auto const &it : sync_queue.changed_keys.keys_by_table) table_ids.insert(it.first);
+			sync_queue.enqueue_tables_to_process(database.tables, table_ids);
+		} else if (leader && digesting_small_tables()) {
+			enqueue_tables_by_size();
+		} else if (leader) {
 			sync_queue.enqueue_tables_to_process(database.tables);
 		}
 
 		// wait for the leader to do that (a barrier here is slightly excessive as we don't care if the other
 		// workers are ready to start work, but it's not worth having another synchronisation mechanism for this)
 		sync_queue.wait_at_barrier();
+
+		if (digesting_small_tables()) {
+			// then share out the batches of small tables, and queue up those that don't match as usual; wait for
+			// all the workers to do that, so that none of them think there's nothing left to do in the meantime
+			check_table_digests();
+			sync_queue.wait_at_barrier();
+		}
+	}
+
+	inline bool digesting_small_tables() {
+		return (digest_small_tables && !catching_up() && output_stream.protocol_version >= FIRST_DIGESTS_COMMAND_VERSION);
+	}
+
+	void enqueue_tables_by_size() {
+		// we go by our database's statistics, so tables that are small here but large at the other end are
+		// digested only here, and then compared as usual; see handle_digests_command
+		map<string, size_t> table_sizes;
+		client.table_sizes(table_sizes);
+
+		vector<string> small_table_ids;
+		set<string> large_table_ids;
+		for (const Table &table : database.tables) {
+			string table_id(table.id_from_name());
+			auto table_size = table_sizes.find(table_id);
+			if (table_size != table_sizes.end() && table_size->second <= DEFAULT_DIGEST_MAXIMUM_TABLE_SIZE &&
+				table.primary_key_type != PrimaryKeyType::no_available_key && // the rows can come back in any order
+				!sync_journal.table_finished(table_id)) { // already skipped
+				small_table_ids.push_back(table_id);
+			} else {
+				large_table_ids.insert(table_id);
+			}
+		}
+
+		sync_queue.enqueue_tables_to_process(database.tables, large_table_ids);
+		sync_queue.enqueue_tables_to_digest(small_table_ids, DEFAULT_TABLES_PER_DIGESTS_COMMAND);
+	}
+
+	void check_table_digests() {
+		map<string, const Table*> tables_by_id;
+		for (const Table &table : database.tables) tables_by_id[table.id_from_name()] = &table;
+
+		vector<string> table_ids;
+		set<string> tables_to_sync, tables_matched;
+		while (sync_queue.next_tables_to_digest(table_ids)) {
+			// ask the other end to digest the whole of each table
+			if (verbose > 1) cout << timestamp() << " worker " << worker_number << " <- digests " << table_ids.size() << " tables" << endl;
+			send_command(output, Commands::DIGESTS, table_ids, DEFAULT_DIGEST_MAXIMUM_TABLE_SIZE);
+
+			// while that end is working, do the same at our end
+			map<string, TableDigest> our_digests;
+			for (const string &table_id : table_ids) {
+				our_digests[table_id] = table_digest(client, *tables_by_id.at(table_id), hash_algorithm, &hash_thread_pool);
+			}
+
+			map<string, TableDigest> their_digests;
+			read_expected_command(input, Commands::DIGESTS, their_digests);
+
+			// the tables they didn't digest are too large at their end, and get compared as usual
+			size_t batch_matched = 0;
+			for (const string &table_id : table_ids) {
+				auto their_digest = their_digests.find(table_id);
+				if (their_digest != their_digests.end() && their_digest->second == our_digests[table_id]) {
+					tables_matched.insert(table_id);
+					batch_matched++;
+				} else {
+					tables_to_sync.insert(table_id);
+				}
+			}
+
+			if (verbose) {
+				unique_lock<mutex> lock(sync_queue.mutex);
+				if (verbose > 1) cout << timestamp() << " worker " << worker_number << ' ';
+				cout << "skipping " << batch_matched << " of " << table_ids.size() << " small tables, their digests match" << endl << flush;
+			}
+		}
+
+		// the tables that matched still need finishing off, for example to reset their sequences, but not comparing
+		sync_queue.enqueue_tables_to_process(database.tables, tables_to_sync);
+		sync_queue.enqueue_tables_to_process(database.tables, tables_matched, true);
+	}
+
+	void create_deferred_keys() {
+		// the deferred statements are queued by the leader before the end of prepare(), so all workers agree on this
+		if (!sync_queue.have_deferred_statements()) return;
+
+		// all tables have finished loading by the time sync_tables() returns, but other workers may still have their
+		// last transactions open; make sure none of us hold locks that the index builds would have to wait for
+		client.commit_transaction();
+		sync_queue.wait_at_barrier();
+
+		string statement;
+		size_t statements_remaining;
+		while (sync_queue.next_deferred_statement(statement, statements_remaining)) {
+			if (verbose > 1) cout << timestamp() << " worker " << worker_number << " <- " << statement << endl;
+			time_t started = time(nullptr);
+			client.execute(statement);
+
+			if (verbose) {
+				time_t now = time(nullptr);
+				unique_lock<mutex> lock(sync_queue.mutex);
+				if (verbose > 1) cout << timestamp() << " worker " << worker_number << ' ';
+				cout << "finished " << statement << " in " << (now - started) << "s, " << statements_remaining << " remaining" << endl << flush;
+			}
+		}
+
+		client.start_write_transaction();
 	}
 
 	void wait_for_finish() {
-		// send a quit so the other end closes its output and terminates gracefully
-		send_quit_command();
+		// send a quit so the other end closes its output and terminates gracefully; but when catching up, the leader's
+		// peer confirms the changes we applied once we've committed, so the leader sends its quit after that
+		if (!leader || !catching_up()) send_quit_command();
 
 		// wait for all workers to finish their tables
 		sync_queue.wait_at_barrier();
@@ -320,6 +510,36 @@ struct SyncToWorker {
 		}
 	}
 
+	void record_row_version_watermark() {
+		// all the workers recorded their tables before the barrier in wait_for_finish, so they agree on this
+		if (!sync_state.have_pending_watermarks()) return;
+
+		// wait for all the workers to commit, so that none of the rows we wrote are newer than the watermark
+		sync_queue.wait_at_barrier();
+
+		if (leader) {
+			sync_state.set_pending_watermarks(client.row_version_watermark());
+		}
+	}
+
+	void confirm_changes() {
+		if (!catching_up()) return;
+
+		// wait for all the workers to commit, so that the changes aren't dropped from the slot until they've all been applied
+		sync_queue.wait_at_barrier();
+
+		if (leader) {
+			if (!sync_queue.changed_keys.upto_lsn.empty()) {
+				send_command(output, Commands::CONFIRM_CHANGES, catch_up_slot, sync_queue.changed_keys.upto_lsn);
+				read_expected_command(input, Commands::CONFIRM_CHANGES);
+			}
+
+			if (sync_queue.changed_keys.more_changes) {
+				cout << "There are more changes to catch up on, run again to apply them." << endl << flush;
+			}
+		}
+	}
+
 	void rollback() {
 		time_t started = time(nullptr);
 
@@ -342,6 +562,10 @@ struct SyncToWorker {
 
 	Database &database;
 	SyncQueue<DatabaseClient> &sync_queue;
+	HashThreadPool &hash_thread_pool;
+	SyncState &sync_state;
+	SyncJournal &sync_journal;
+	ostream &report; // for --verify
 	bool leader;
 	int worker_number;
 	VersionedFDWriteStream output_stream;
@@ -359,6 +583,16 @@ struct SyncToWorker {
 	bool alter;
 	CommitLevel commit_level;
 	bool structure_only;
+	bool defer_indexes;
+	bool hash_keys_first;
+	const set<string> keys_only_tables;
+	const string catch_up_slot;
+	bool digest_small_tables;
+	bool skip_unchanged_tables;
+	time_t verify_interval;
+	bool auto_reload;
+	bool verify;
+	SampleBudget sample_budget;
 
 	HashAlgorithm hash_algorithm;
 	size_t target_minimum_block_size;
@@ -367,21 +601,38 @@ struct SyncToWorker {
 };
 
 template <typename DatabaseClient, typename... Options>
-void sync_to(int num_workers, int startfd, const Options &...options) {
+void sync_to(int num_workers, int hash_threads, const string &state_file, const string &journal_file, bool resume, const string &report_file, int startfd, const Options &...options) {
 	Database database;
 	SyncQueue<DatabaseClient> sync_queue(num_workers);
+	HashThreadPool hash_thread_pool(hash_threads);
+	SyncState sync_state;
+	SyncJournal sync_journal;
 	vector<SyncToWorker<DatabaseClient>*> workers;
 
+	load_sync_state(state_file, sync_state);
+	if (!journal_file.empty()) sync_journal.open(journal_file, resume);
+
+	// the --verify report normally goes to stdout along with the rest of our output
+	ofstream report_file_stream;
+	if (!report_file.empty()) report_file_stream.open(report_file);
+	ostream &report(report_file.empty() ? cout : report_file_stream);
+
 	workers.resize(num_workers);
 
 	for (int worker = 0; worker < num_workers; worker++) {
 		bool leader = (worker == 0);
 		int read_from_descriptor = startfd + worker;
 		int write_to_descriptor = startfd + worker + num_workers;
-		workers[worker] = new SyncToWorker<DatabaseClient>(database, sync_queue, leader, worker, read_from_descriptor, write_to_descriptor, options...);
+		workers[worker] = new SyncToWorker<DatabaseClient>(database, sync_queue, hash_thread_pool, sync_state, sync_journal, report, leader, worker, read_from_descriptor, write_to_descriptor, options...);
 	}
 
 	for (SyncToWorker<DatabaseClient>* worker : workers) delete worker;
 
 	if (sync_queue.aborted) throw sync_error();
+
+	// only saved once everything has been committed, since we don't know which tables' changes were kept otherwise
+	if (!state_file.empty() && sync_state.changed) save_sync_state(state_file, sync_state);
+
+	// the next run has to start from scratch, so the journal is no longer useful
+	if (sync_journal.enabled()) sync_journal.remove();
 }
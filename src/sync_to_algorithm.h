@@ -1,13 +1,17 @@
+#include <numeric>
+#include <random>
+
 #include "timestamp.h"
 
 struct HashResult {
-	HashResult(const ColumnValues &prev_key, const ColumnValues &last_key, size_t estimated_rows_in_range, size_t priority, size_t our_row_count, size_t our_size, string our_hash, const ColumnValues &our_last_key, const ColumnValues &next_midpoint):
-		prev_key(prev_key), last_key(last_key), estimated_rows_in_range(estimated_rows_in_range), priority(priority), our_row_count(our_row_count), our_size(our_size), our_hash(our_hash), our_last_key(our_last_key), next_midpoint(next_midpoint) {}
+	HashResult(const ColumnValues &prev_key, const ColumnValues &last_key, size_t estimated_rows_in_range, size_t priority, bool hash_keys, size_t our_row_count, size_t our_size, string our_hash, const ColumnValues &our_last_key, const ColumnValues &next_midpoint):
+		prev_key(prev_key), last_key(last_key), estimated_rows_in_range(estimated_rows_in_range), priority(priority), hash_keys(hash_keys), our_row_count(our_row_count), our_size(our_size), our_hash(our_hash), our_last_key(our_last_key), next_midpoint(next_midpoint) {}
 
 	ColumnValues prev_key;
 	ColumnValues last_key;
 	size_t estimated_rows_in_range;
 	size_t priority;
+	bool hash_keys;
 
 	size_t our_row_count;
 	size_t our_size;
@@ -16,6 +20,18 @@ struct HashResult {
 	ColumnValues next_midpoint;
 };
 
+// our hash of a block of rows picked as a sample, and theirs, see hash_samples
+struct SampleHash {
+	SampleHash(const ColumnValues &prev_key, RowDigestsRange &&ours): prev_key(prev_key), ours(std::move(ours)), their_row_count(0) {}
+
+	inline bool matches() const { return (ours.row_count == their_row_count && ours.hash.to_string() == their_hash); }
+
+	ColumnValues prev_key;
+	RowDigestsRange ours;
+	size_t their_row_count;
+	string their_hash;
+};
+
 template <class Worker, class DatabaseClient>
 struct SyncToAlgorithm {
 	SyncToAlgorithm(Worker &worker):
@@ -26,7 +42,8 @@ struct SyncToAlgorithm {
 		output(worker.output),
 		hash_algorithm(worker.hash_algorithm),
 		target_minimum_block_size(worker.target_minimum_block_size),
-		target_maximum_block_size(worker.target_maximum_block_size) {
+		target_maximum_block_size(worker.target_maximum_block_size),
+		random_engine(random_device()()) {
 	}
 
 	void sync_tables() {
@@ -41,6 +58,11 @@ struct SyncToAlgorithm {
 	void start_sync_table(const shared_ptr<TableJob> &table_job, RowReplacer<DatabaseClient> &row_replacer) {
 		table_job->time_started = time(nullptr);
 
+		if (worker.verify) {
+			std::unique_lock<std::mutex> lock(table_job->mutex);
+			table_job->any_worker_may_retrieve = true;
+		}
+
 		if (worker.verbose) {
 			unique_lock<mutex> lock(sync_queue.mutex);
 			cout << fixed << setw(5);
@@ -48,12 +70,36 @@ struct SyncToAlgorithm {
 			cout << "starting " << table_job->table.name << endl << flush;
 		}
 
+		// when catching up, we only need to retrieve the rows whose keys were changed, unless we couldn't tell which
+		if (worker.catching_up() && !sync_queue.changed_keys.tables_to_reload.count(table_job->table_id)) {
+			queue_changed_key_ranges(table_job);
+			return;
+		}
+
+		// if an interrupted run finished this table, there's nothing to do
+		if (worker.sync_journal.table_finished(table_job->table_id)) {
+			if (worker.verbose) cout << "Skipping " << table_job->table.name << ", finished by the interrupted run." << endl;
+			return;
+		}
+
+		// if the table has a change-tracking column and it shows no changes at either end since the last sync, we're done
+		if (unchanged_since_last_sync(table_job)) return;
+
+		// likewise if the server statistics at their end show no writes to the table since we last compared it
+		if (unchanged_according_to_statistics(table_job)) return;
+
+		// or if the whole table matched when we compared the small tables' digests, see check_table_digests
+		if (table_job->digests_matched) return;
+
 		if (table_job->table.primary_key_type != PrimaryKeyType::no_available_key) {
 			// start by scoping out the table
 			if (worker.verbose > 1) cout << timestamp() << " worker " << worker.worker_number << " <- range " << table_job->table.name << endl;
 			send_command(output, Commands::RANGE, table_job->table_id);
 			if (input.next<verb_t>() != Commands::RANGE) throw command_error("Didn't receive response to RANGE command");
 			handle_range_response(table_job, row_replacer);
+		} else if (worker.verify) {
+			// we'd have to clear and reload the table to sync it, so we can't tell which rows differ
+			cerr << "Can't verify " << table_job->table.name << ", it has no primary key and no other suitable keys." << endl;
 		} else {
 			// if the table has no usable keys, all we can do is retrieve and apply the rows
 			if (worker.verbose) cout << "Clearing and reloading " << table_job->table.name << ", can't efficiently detect differences because it has no primary key and no other suitable keys." << endl;
@@ -62,22 +108,148 @@ struct SyncToAlgorithm {
 		}
 	}
 
+	void queue_changed_key_ranges(const shared_ptr<TableJob> &table_job) {
+		// the rows with the changed keys may have been inserted, updated, or deleted at their end, so for each key we
+		// retrieve the range from the last row we have before it, which also clears out any rows we have that they
+		// don't.  the keys are in order, so if we have no rows between two keys, they can go in the same range.
+		const Table &table(table_job->table);
+		const vector<ColumnValues> &keys(sync_queue.changed_keys.keys_by_table.at(table_job->table_id));
+		deque<KeyRange> ranges;
+		ColumnValues prev_key;
+
+		for (const ColumnValues &key : keys) {
+			ColumnValues our_key_before(last_key_between(client, table, prev_key, key));
+			if (!ranges.empty() && our_key_before.empty()) {
+				get<1>(ranges.back()) = key;
+			} else {
+				ranges.emplace_back(our_key_before.empty() ? prev_key : our_key_before, key);
+			}
+			prev_key = key;
+		}
+
+		if (worker.verbose > 1) cout << timestamp() << " worker " << worker.worker_number << " catching up " << keys.size() << " changed keys in " << ranges.size() << " ranges of " << table.name << endl;
+
+		std::unique_lock<std::mutex> lock(table_job->mutex);
+		for (KeyRange &range : ranges) {
+			table_job->ranges_to_retrieve.push_back(std::move(range));
+		}
+	}
+
+	bool unchanged_since_last_sync(const shared_ptr<TableJob> &table_job) {
+		const Table &table(table_job->table);
+		auto table_filter = worker.table_filters.find(table_job->table_id);
+		if (table_filter == worker.table_filters.end() || table_filter->second.changes_tracked_by.empty() || output.stream().protocol_version < FIRST_CHANGES_COMMAND_VERSION) return false;
+		table_job->changes_tracked_by = table_filter->second.changes_tracked_by;
+		TableSyncState recorded(worker.sync_state.recorded(table_job->table_id, table_job->changes_tracked_by));
+
+		// when tracking row versions, we send the watermark we recorded last time, and they send it back if nothing has changed
+		if (worker.verbose > 1) cout << timestamp() << " worker " << worker.worker_number << " <- changes " << table.name << ' ' << table_job->changes_tracked_by << ' ' << recorded.from.last_change << endl;
+		send_command(output, Commands::CHANGES, table_job->table_id, table_job->changes_tracked_by, recorded.from.last_change);
+
+		// while that end is working, do the same at our end
+		TableChanges our_changes(table_changes(client, table, table_job->changes_tracked_by, recorded.to.last_change));
+
+		string _table_name, _column_name;
+		read_expected_command(input, Commands::CHANGES, _table_name, _column_name, table_job->their_changes.row_count, table_job->their_changes.last_change);
+		if (worker.verbose > 1) cout << timestamp() << " worker " << worker.worker_number << " -> changes " << table.name << ' ' << table_job->their_changes.row_count << ' ' << table_job->their_changes.last_change << endl;
+
+		// if their database can't track row versions, it sends an empty watermark, and we can't tell if rows were updated
+		if (tracked_by_row_versions(table, table_job->changes_tracked_by) && table_job->their_changes.last_change.empty()) return false;
+
+		if (!worker.sync_state.unchanged(table_job->table_id, table_job->changes_tracked_by, table_job->their_changes, our_changes)) return false;
+
+		if (worker.verbose) cout << "Skipping " << table.name << ", " << table_job->changes_tracked_by << " shows no changes at either end since the last sync." << endl;
+		table_job->changes_tracked_by.clear(); // nothing to record, the state is the same
+		return true;
+	}
+
+	bool unchanged_according_to_statistics(const shared_ptr<TableJob> &table_job) {
+		// tables with change-tracking columns are checked using those instead
+		if (!table_job->changes_tracked_by.empty()) return false;
+
+		// if we didn't get statistics for the table, their end can't tell if it's changed (or we're not using them)
+		auto their_statistics = sync_queue.their_statistics.find(table_job->table_id);
+		if (their_statistics == sync_queue.their_statistics.end()) return false;
+		table_job->their_statistics = their_statistics->second;
+
+		// we compare the table anyway once the verify interval has passed, in case it's been changed at our end
+		if (!worker.sync_state.statistics_unchanged(table_job->table_id, table_job->their_statistics, table_job->time_started, worker.verify_interval)) return false;
+
+		if (worker.verbose) cout << "Skipping " << table_job->table.name << ", the server statistics show no changes since the last sync." << endl;
+		table_job->their_statistics.clear(); // nothing to record, and we haven't verified the table this time
+		return true;
+	}
+
+	inline bool tracked_by_row_versions(const Table &table, const string &changes_tracked_by) {
+		return (changes_tracked_by == ROW_VERSIONS_COLUMN_NAME && none_of(table.columns.begin(), table.columns.end(), [&](const Column &column) { return column.name == changes_tracked_by; }));
+	}
+
+	void record_changes_synced(const shared_ptr<TableJob> &table_job) {
+		// the rows at our end now match their rows as they were when we started, but our values may be formatted
+		// differently, so we look them up again (seeing our own uncommitted changes).  if we're tracking row versions,
+		// our own changes will be newer than any watermark we could get now, so the leader gets one after committing.
+		const Table &table(table_job->table);
+		bool row_versions = tracked_by_row_versions(table, table_job->changes_tracked_by);
+		TableChanges our_changes(table_changes(client, table, table_job->changes_tracked_by, ""));
+		worker.sync_state.record(table_job->table_id, table_job->changes_tracked_by, table_job->their_changes, our_changes, row_versions);
+	}
+
 	void finish_sync_table(const shared_ptr<TableJob> &table_job, size_t rows_changed) {
 		// reset sequences on those databases that don't automatically bump the high-water mark for inserts
-		ResetTableSequences<DatabaseClient>::execute(client, table_job->table);
+		if (!worker.verify) ResetTableSequences<DatabaseClient>::execute(client, table_job->table);
+
+		// if we're not going to commit, the next run will still need to sync the table
+		if (!table_job->changes_tracked_by.empty() && worker.commit_level >= CommitLevel::success) {
+			record_changes_synced(table_job);
+		}
+
+		// the statistics were read before the snapshot was taken, so the table now has at least the changes they count
+		if (!table_job->their_statistics.empty() && worker.commit_level >= CommitLevel::success) {
+			worker.sync_state.record_statistics(table_job->table_id, table_job->their_statistics, table_job->time_started);
+		}
+
+		// the writer applied and committed the last of its changes before calling us, and the other workers' loads are committed too
+		if (worker.sync_journal.enabled()) {
+			worker.sync_journal.record_table_finished(table_job->table_id);
+		}
+
+		// all the other workers have reported their ranges by now, so we can give the totals
+		if (worker.verify && table_job->table.primary_key_type != PrimaryKeyType::no_available_key) {
+			RowDifferences differences;
+			{
+				unique_lock<mutex> lock(table_job->mutex);
+				differences = table_job->differences;
+			}
+			unique_lock<mutex> lock(sync_queue.mutex);
+			if (table_job->sample_results.samples) {
+				worker.report << diff_report_sample_line(table_job->table_id, differences, table_job->sample_results, DEFAULT_SAMPLE_CONFIDENCE_Z) << endl << flush;
+			} else {
+				worker.report << diff_report_table_line(table_job->table_id, differences) << endl << flush;
+			}
+		}
 
 		if (worker.verbose) {
 			table_job->time_finished = time(nullptr);
+			LocalRowCacheStats local_row_cache_stats;
+			{
+				unique_lock<mutex> lock(table_job->mutex);
+				local_row_cache_stats = table_job->local_row_cache.stats;
+			}
 			unique_lock<mutex> lock(sync_queue.mutex);
 			if (worker.verbose > 1) cout << timestamp() << " worker " << worker.worker_number << ' ';
-			cout << "finished " << table_job->table.name << " in " << (table_job->time_finished - table_job->time_started) << "s using " << table_job->hash_commands << " hash commands and " << table_job->rows_commands << " rows commands changing " << rows_changed << " rows" << endl << flush;
+			cout << "finished " << table_job->table.name << " in " << (table_job->time_finished - table_job->time_started) << "s using " << table_job->hash_commands << " hash commands and " << table_job->rows_commands << " rows commands changing " << rows_changed << " rows";
+			if (local_row_cache_stats.hash_hits + local_row_cache_stats.hash_misses) {
+				cout << ", reusing rows for " << local_row_cache_stats.hash_hits << " of " << local_row_cache_stats.hash_hits + local_row_cache_stats.hash_misses << " hashes and " << local_row_cache_stats.apply_hits << " of " << local_row_cache_stats.apply_hits + local_row_cache_stats.apply_misses << " rows commands";
+			}
+			cout << endl << flush;
 		}
 	}
 
 	inline void sync_table(const shared_ptr<TableJob> &table_job) {
 		const Table &table(table_job->table);
 		RowReplacer<DatabaseClient> row_replacer(client, table, worker.commit_level >= CommitLevel::often,
-			[&] { if (worker.progress) { cout << "." << flush; } });
+			[&] { journal_ranges_applied(table_job); if (worker.progress) { cout << "." << flush; } }, worker.verify);
+		ranges_applied.clear();
 
 		// if the table hasn't been started, become the writer worker for it; otherwise just help out with range checks
 		bool writer = !table_job->time_started;
@@ -93,7 +265,7 @@ struct SyncToAlgorithm {
 
 			std::unique_lock<std::mutex> lock(table_job->mutex);
 
-			if (writer && outstanding_commands < max_outstanding_commands && !table_job->ranges_to_retrieve.empty()) {
+			if ((writer || table_job->any_worker_may_retrieve) && outstanding_commands < max_outstanding_commands && !table_job->ranges_to_retrieve.empty()) {
 				KeyRange range_to_retrieve(std::move(table_job->ranges_to_retrieve.front()));
 				table_job->ranges_to_retrieve.pop_front();
 				table_job->rows_commands++;
@@ -116,21 +288,34 @@ struct SyncToAlgorithm {
 				handle_response(table_job, ranges_hashed, row_replacer);
 				outstanding_commands--;
 
-			} else if (writer && table_job->hash_commands_completed < table_job->hash_commands) {
+			} else if (!table_job->ranges_to_load.empty()) {
+				// the table was empty, so any worker can insert rows without fighting for locks
+				KeyRange range_to_load(std::move(table_job->ranges_to_load.front()));
+				table_job->ranges_to_load.pop_front();
+				table_job->load_commands++;
+				table_job->rows_commands++;
+				lock.unlock(); // don't hold the mutex while doing IO
+
+				load_rows(table_job, row_replacer, range_to_load, writer);
+
+			} else if (writer && (table_job->hash_commands_completed < table_job->hash_commands || table_job->load_commands_completed < table_job->load_commands ||
+			                      (table_job->any_worker_may_retrieve && table_job->rows_commands_completed < table_job->rows_commands))) {
 				// wait for the other worker(s) to complete their task, then wake up to see if there is anything for us to do
 				// note that they have to send back any mutation tasks (ie. ranges_to_retrieve) since only one database
-				// connection may mutate a table, to avoid fighting for locks; we can also compete for ranges_to_check ourselves
+				// connection may mutate a table, to avoid fighting for locks; we can also compete for ranges_to_check ourselves.
+				// with --verify, nothing is mutated, so the other workers retrieve and compare rows too.
 				table_job->borrowed_task_completed.wait(lock);
 
 			} else if (writer) {
 				// nothing left to do on this table
+				size_t rows_loaded_by_helpers = table_job->rows_loaded_by_helpers;
 				lock.unlock(); // don't hold the mutex while doing IO
 
 				// make sure all pending updates have been applied
 				row_replacer.apply();
 
 				// wrap up, log it, and potentially commit it
-				finish_sync_table(table_job, row_replacer.rows_changed);
+				finish_sync_table(table_job, row_replacer.rows_changed + rows_loaded_by_helpers);
 
 				// remove it from the list of tables being worked on
 				sync_queue.completed_table(table_job);
@@ -163,12 +348,14 @@ struct SyncToAlgorithm {
 		if (range_to_check.rows_to_hash == 0) throw logic_error("Can't hash 0 rows");
 
 		// tell the other end to hash this range
-		if (worker.verbose > 1) cout << timestamp() << " worker " << worker.worker_number << " <- hash " << table.name << ' ' << values_list(client, table, prev_key) << ' ' << values_list(client, table, last_key) << ' ' << range_to_check.rows_to_hash << endl;
-		send_command(output, Commands::HASH, table_job->table_id, prev_key, last_key, range_to_check.rows_to_hash);
+		if (worker.verbose > 1) cout << timestamp() << " worker " << worker.worker_number << (range_to_check.hash_keys ? " <- hash keys " : " <- hash ") << table.name << ' ' << values_list(client, table, prev_key) << ' ' << values_list(client, table, last_key) << ' ' << range_to_check.rows_to_hash << endl;
+		send_command(output, range_to_check.hash_keys ? Commands::HASH_KEYS : Commands::HASH, table_job->table_id, prev_key, last_key, range_to_check.rows_to_hash);
 
 		// while that end is working, do the same at our end
-		RowHasherAndLastKey hasher(hash_algorithm, table.primary_key_columns);
-		size_t row_count = retrieve_rows(client, hasher, table, prev_key, last_key, range_to_check.rows_to_hash);
+		RowDigestsRange range(
+			range_to_check.hash_keys ? hash_keys(table_job, prev_key, last_key, range_to_check.rows_to_hash) :
+			hash_algorithm == HashAlgorithm::xxh3_128_rows ? hash_using_row_digests(table_job, prev_key, last_key, range_to_check.rows_to_hash) :
+			hash_rows(table_job, prev_key, last_key, range_to_check.rows_to_hash));
 
 		// when the table has a subdividable primary key, we try to break the remaining range into two, so that if
 		// there's another worker free it can start checking the second half.  we don't actually queue either half
@@ -178,13 +365,13 @@ struct SyncToAlgorithm {
 
 		if (table_job->subdividable && // subdividable is immutable, don't need to lock to access it
 			range_to_check.estimated_rows_in_range == UNKNOWN_ROW_COUNT && // only subdivide when scanning forward, not recursing for errors
-			row_count == range_to_check.rows_to_hash && // don't subdivide if we're at the end of the table
-			hasher.last_key != last_key) { // don't subdivide if we're at the end of the table
+			range.row_count == range_to_check.rows_to_hash && // don't subdivide if we're at the end of the table
+			range.last_key != last_key) { // don't subdivide if we're at the end of the table
 			// find the key about halfway through the range.  we could find the key more exactly using count queries
 			// and limit/offset queries, but this would be incredibly expensive for a large table, so we estimate by
 			// interpolating the actual key range values, and then do a query to find the next actual key.  finding
 			// an actual key is not required for correctness, but makes testing easier.
-			next_midpoint = std::move(first_key_not_earlier_than(client, table, subdivide_primary_key_range(table, hasher.last_key, last_key), hasher.last_key, last_key));
+			next_midpoint = std::move(first_key_not_earlier_than(client, table, subdivide_primary_key_range(table, range.last_key, last_key), range.last_key, last_key));
 		}
 
 		// and store the hash away temporarily for us to check when the corresponding response comes back
@@ -194,24 +381,98 @@ struct SyncToAlgorithm {
 			last_key,
 			range_to_check.estimated_rows_in_range,
 			range_to_check.priority,
-			row_count,
-			hasher.size,
-			hasher.finish().to_string(),
-			hasher.last_key,
+			range_to_check.hash_keys,
+			range.row_count,
+			range.size,
+			range.hash.to_string(),
+			range.last_key,
 			std::move(next_midpoint));
 	}
 
+	RowDigestsRange hash_rows(const shared_ptr<TableJob> &table_job, const ColumnValues &prev_key, const ColumnValues &last_key, size_t rows_to_hash) {
+		RowHasherAndLastKey hasher(hash_algorithm, table_job->table.primary_key_columns, &worker.hash_thread_pool);
+		RowDigestsRange range;
+		range.row_count = read_local_rows(table_job, hasher, prev_key, last_key, rows_to_hash);
+		range.size = hasher.size;
+		range.hash = hasher.finish();
+		range.last_key = std::move(hasher.last_key);
+		return range;
+	}
+
+	RowDigestsRange hash_keys(const shared_ptr<TableJob> &table_job, const ColumnValues &prev_key, const ColumnValues &last_key, size_t rows_to_hash) {
+		// the rows we get back have only the key columns
+		vector<size_t> key_columns(table_job->table.primary_key_columns.size());
+		iota(key_columns.begin(), key_columns.end(), 0);
+
+		RowHasherAndLastKey hasher(key_hash_algorithm(hash_algorithm), key_columns, &worker.hash_thread_pool);
+		RowDigestsRange range;
+		range.row_count = retrieve_keys(client, hasher, table_job->table, prev_key, last_key, rows_to_hash);
+		range.size = hasher.size;
+		range.hash = hasher.finish();
+		range.last_key = std::move(hasher.last_key);
+		return range;
+	}
+
+	RowDigestsRange hash_using_row_digests(const shared_ptr<TableJob> &table_job, const ColumnValues &prev_key, const ColumnValues &last_key, size_t rows_to_hash) {
+		// when we're narrowing down a mismatch, we've normally hashed the rows before, so we can work out the hash of
+		// the part we're checking from their digests, without re-reading the rows
+		RowDigestsRange range;
+		{
+			std::unique_lock<std::mutex> lock(table_job->mutex);
+			if (table_job->row_digest_cache.find(table_job->table_id, prev_key, last_key, rows_to_hash, range)) return range;
+		}
+
+		RowDigester digester(table_job->table.primary_key_columns);
+		read_local_rows(table_job, digester, prev_key, last_key, rows_to_hash);
+		range = RowDigestsRange(digester.row_digests, 0, digester.row_digests.rows());
+
+		std::unique_lock<std::mutex> lock(table_job->mutex);
+		table_job->row_digest_cache.add(table_job->table_id, prev_key, last_key, rows_to_hash, std::move(digester.row_digests));
+		return range;
+	}
+
+	template <typename RowReceiver>
+	size_t read_local_rows(const shared_ptr<TableJob> &table_job, RowReceiver &receiver, const ColumnValues &prev_key, const ColumnValues &last_key, size_t rows_to_read) {
+		// if we've read these rows before, and kept them, we don't need to read them again
+		LocalRowsRange local_rows;
+		size_t max_bytes = 0;
+		{
+			std::unique_lock<std::mutex> lock(table_job->mutex);
+			if (!table_job->local_row_cache.find(prev_key, last_key, rows_to_read, local_rows)) max_bytes = table_job->local_row_cache.max_bytes;
+		}
+
+		if (local_rows.rows) {
+			for (size_t n = 0; n < local_rows.row_count; n++) {
+				receiver(local_rows[n]);
+			}
+			return local_rows.row_count;
+		}
+
+		// otherwise read them, and keep them in case the range doesn't match and we need them again
+		LocalRowCollector<RowReceiver> collector(receiver, table_job->table.primary_key_columns, max_bytes);
+		size_t row_count = retrieve_rows(client, collector, table_job->table, prev_key, last_key, rows_to_read);
+		collector.local_rows->read_by_worker = worker.worker_number;
+
+		std::unique_lock<std::mutex> lock(table_job->mutex);
+		table_job->local_row_cache.add(prev_key, last_key, rows_to_read, collector.local_rows);
+		return row_count;
+	}
+
 	inline void handle_response(const shared_ptr<TableJob> &table_job, list<HashResult> &ranges_hashed, RowReplacer<DatabaseClient> &row_replacer) {
 		verb_t verb;
 		input >> verb;
 
 		switch (verb) {
 			case Commands::HASH:
-				handle_hash_response(table_job, ranges_hashed);
+				handle_hash_response(table_job, ranges_hashed, false);
+				break;
+
+			case Commands::HASH_KEYS:
+				handle_hash_response(table_job, ranges_hashed, true);
 				break;
 
 			case Commands::ROWS:
-				handle_rows_response(table_job->table, row_replacer);
+				handle_rows_response(table_job, row_replacer);
 				break;
 
 			default:
@@ -226,22 +487,52 @@ struct SyncToAlgorithm {
 		if (worker.verbose > 1) cout << timestamp() << " worker " << worker.worker_number << " -> range " << table_job->table.name << ' ' << values_list(client, table_job->table, their_first_key) << ' ' << values_list(client, table_job->table, their_last_key) << endl;
 
 		if (their_first_key.empty()) {
-			client.execute("DELETE FROM " + client.quote_table_name(table_job->table));
+			RowDifferences differences_before(row_replacer.differences);
+			row_replacer.clear_range(ColumnValues(), ColumnValues());
+			if (worker.verify) record_differences(table_job, row_replacer.differences - differences_before, ColumnValues(), ColumnValues());
+			return;
+		}
+
+		if (worker.verify) {
+			verify_range(table_job, row_replacer, their_first_key, their_last_key);
+			return;
+		}
+
+		// when rebuilding, we load their rows into a new copy of the table, and leave ours alone until we swap them
+		if (rebuild_instead_of_diffing(table_job)) {
+			rebuild_table(table_job, row_replacer, their_last_key);
 			return;
 		}
 
 		// we immediately know that we need to clear everything < their_first_key or > their_last_key; do that now
-		string key_columns(columns_list(client, table_job->table.columns, table_job->table.primary_key_columns));
-		string delete_from("DELETE FROM " + client.quote_table_name(table_job->table) + " WHERE (" + key_columns + ")");
-		client.execute(delete_from + " < " + values_list(client, table_job->table, their_first_key));
-		client.execute(delete_from + " > " + values_list(client, table_job->table, their_last_key));
+		row_replacer.clear_range_before(their_first_key);
+		row_replacer.clear_range(their_last_key, ColumnValues());
 
 		// having done that, find our last key, which must now be no greater than their_last_key
 		ColumnValues our_last_key(last_key(client, table_job->table));
 
+		// if most of our rows are different, finding the differences costs more than loading the whole table, so
+		// we may clear it out and start from empty instead
+		if (!our_last_key.empty() && reload_instead_of_diffing(table_job, their_first_key, their_last_key)) {
+			row_replacer.clear_range(ColumnValues(), ColumnValues());
+			our_last_key.clear();
+		}
+
+		// if we have no rows left there's nothing to hash, and we can skip straight to loading their rows; when we
+		// have other workers to help, we split the range up so that they can retrieve and insert chunks in parallel
+		if (our_last_key.empty() && can_load_in_parallel()) {
+			queue_ranges_to_load(table_job, row_replacer, their_last_key);
+			return;
+		}
+
 		if (!our_last_key.empty()) {
-			// queue up a sync of everything up to our_last_key
-			queue_initial_ranges(table_job, our_last_key, their_first_key, their_last_key);
+			// queue up a sync of everything up to our_last_key, or if resuming, just the parts not already done
+			vector<KeyRange> ranges_finished(worker.sync_journal.ranges_finished(table_job->table_id));
+			if (ranges_finished.empty()) {
+				queue_initial_ranges(table_job, our_last_key, their_first_key, their_last_key);
+			} else {
+				queue_unfinished_ranges(table_job, our_last_key, ranges_finished);
+			}
 
 			if (table_job->notify_when_work_could_be_shared) {
 				sync_queue.have_work_to_share(table_job);
@@ -258,6 +549,251 @@ struct SyncToAlgorithm {
 		}
 	}
 
+	void verify_range(const shared_ptr<TableJob> &table_job, RowReplacer<DatabaseClient> &row_replacer, const ColumnValues &their_first_key, const ColumnValues &their_last_key) {
+		// as for handle_range_response, but we don't clear anything, so we count our rows after their_last_key here,
+		// and leave any before their_first_key to be found by checking the first range as usual
+		const Table &table(table_job->table);
+		RowDifferences differences_before(row_replacer.differences);
+		row_replacer.clear_range(their_last_key, ColumnValues());
+		record_differences(table_job, row_replacer.differences - differences_before, their_last_key, ColumnValues());
+
+		size_t table_size;
+		if (sample_instead_of_comparing(table_job, table_size)) {
+			// the samples are all taken after their_first_key, so in this case we count our rows before it here too
+			differences_before = row_replacer.differences;
+			row_replacer.clear_range_before(their_first_key);
+			record_differences(table_job, row_replacer.differences - differences_before, ColumnValues(), their_first_key);
+
+			sample_table(table_job, table_size, their_first_key, their_last_key);
+			return;
+		}
+
+		ColumnValues our_last_key(last_key_between(client, table, ColumnValues(), their_last_key));
+		if (count_rows(client, table, our_last_key, their_last_key) > 0) our_last_key = their_last_key;
+
+		if (!our_last_key.empty()) {
+			queue_initial_ranges(table_job, our_last_key, their_first_key, their_last_key);
+
+			if (table_job->notify_when_work_could_be_shared) {
+				sync_queue.have_work_to_share(table_job);
+			}
+		}
+
+		if (our_last_key != their_last_key) {
+			request_rows_without_pipelining(table_job, row_replacer, KeyRange(our_last_key, their_last_key));
+		}
+	}
+
+	bool sample_instead_of_comparing(const shared_ptr<TableJob> &table_job, size_t &table_size) {
+		const Table &table(table_job->table);
+		const SampleBudget &budget(worker.sample_budget);
+		if (!budget.given()) return false;
+
+		// we pick the samples by interpolating between keys, as we do to subdivide ranges
+		if (!table_job->subdividable) {
+			if (worker.verbose) cout << "Comparing " << table.name << " in full, its primary key can't be used to pick samples." << endl;
+			return false;
+		}
+
+		// if the budget would cover the whole table, we might as well compare it properly
+		auto table_size_it = sync_queue.table_sizes.find(table_job->table_id);
+		table_size = (table_size_it == sync_queue.table_sizes.end() ? 0 : table_size_it->second);
+		if ((budget.unit == SampleBudget::fraction && (budget.amount >= 1 || !table_size)) ||
+			(budget.unit == SampleBudget::bytes && table_size && budget.amount >= table_size)) {
+			if (worker.verbose) cout << "Comparing " << table.name << " in full, the sample budget covers the whole table." << endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	void sample_table(const shared_ptr<TableJob> &table_job, size_t table_size, const ColumnValues &their_first_key, const ColumnValues &their_last_key) {
+		// hash a block of rows after each of a series of random keys at both ends, until we've used up the budget; the
+		// proportion of the blocks that differ estimates the proportion of the table that does.  with a time budget,
+		// we still stop once we've hashed as much as the whole table, since we'd only be hashing the same rows again.
+		const Table &table(table_job->table);
+		const SampleBudget &budget(worker.sample_budget);
+		double bytes_to_sample = (budget.unit == SampleBudget::fraction ? budget.amount*table_size : budget.unit == SampleBudget::bytes ? budget.amount : table_size);
+		time_t started = time(nullptr);
+		size_t bytes_sampled = 0, our_bytes_sampled = 0, our_rows_sampled = 0;
+		SampleResults &results(table_job->sample_results);
+
+		while (results.samples < DEFAULT_MAXIMUM_SAMPLES &&
+			   (budget.unit != SampleBudget::seconds || time(nullptr) - started < budget.amount) &&
+			   (!bytes_to_sample || bytes_sampled < bytes_to_sample)) {
+			sync_queue.check_aborted();
+
+			vector<ColumnValues> prev_keys(sample_keys_between(table, their_first_key, their_last_key, DEFAULT_SAMPLES_PER_ROUND, true));
+			for (const SampleHash &sample : hash_samples(table_job, prev_keys, their_last_key, DEFAULT_ROWS_PER_SAMPLE)) {
+				results.samples++;
+				results.rows_sampled += max(sample.ours.row_count, sample.their_row_count);
+				if (!sample.matches()) results.samples_differing++;
+
+				// count their rows too, taking them to be the same size as ours on average, so that we don't keep
+				// sampling much more than the budget if we're missing most of their rows
+				our_bytes_sampled += sample.ours.size;
+				our_rows_sampled += sample.ours.row_count;
+				size_t their_size = (our_rows_sampled ? sample.their_row_count*our_bytes_sampled/our_rows_sampled : 0);
+				bytes_sampled += max(sample.ours.size, their_size);
+			}
+
+			// if we haven't found any rows at our end, we can't tell how much of the budget their rows use up, but
+			// every sample will differ anyway
+			if (!our_rows_sampled) break;
+		}
+
+		if (worker.verbose) {
+			cout << "Sampled " << table.name << ", " << results.samples_differing << " of " << results.samples << " ranges differ, estimated divergence "
+				 << results.estimated_divergence()*100 << "% (up to " << results.divergence_upper_bound(DEFAULT_SAMPLE_CONFIDENCE_Z)*100 << "% at 95% confidence)." << endl;
+		}
+	}
+
+	list<SampleHash> hash_samples(const shared_ptr<TableJob> &table_job, const vector<ColumnValues> &prev_keys, const ColumnValues &last_key, size_t rows_to_hash) {
+		// hash a block of rows after each of the keys at both ends; all the responses are small, so we can pipeline
+		// all the commands without risk of deadlock
+		list<SampleHash> samples;
+		for (const ColumnValues &prev_key : prev_keys) {
+			send_command(output, Commands::HASH, table_job->table_id, prev_key, last_key, rows_to_hash);
+			samples.emplace_back(prev_key,
+				hash_algorithm == HashAlgorithm::xxh3_128_rows ? hash_using_row_digests(table_job, prev_key, last_key, rows_to_hash) :
+				hash_rows(table_job, prev_key, last_key, rows_to_hash));
+		}
+
+		for (SampleHash &sample : samples) {
+			size_t _rows_to_hash;
+			string _table_name;
+			ColumnValues sample_prev_key, _last_key;
+			read_expected_command(input, Commands::HASH, _table_name, sample_prev_key, _last_key, _rows_to_hash, sample.their_row_count, sample.their_hash);
+			if (sample_prev_key != sample.prev_key) throw command_error("Didn't issue hash command for " + table_job->table.name + " " + values_list(client, table_job->table, sample_prev_key));
+		}
+
+		return samples;
+	}
+
+	vector<ColumnValues> sample_keys_between(const Table &table, const ColumnValues &first_key, const ColumnValues &last_key, size_t keys_wanted, bool at_random) {
+		// descend through the halves of the key range that subdivide_primary_key_range would give.  normally we take
+		// the midpoints breadth-first, so they're spread evenly, and if we run out of keys to interpolate part way, we
+		// still have a spread.  at random, each key descends through randomly-picked halves until they can't be
+		// divided any further; the keys are then spread evenly on average, and each run picks different ones.
+		vector<ColumnValues> sample_keys;
+		deque<KeyRange> ranges{KeyRange(first_key, last_key)};
+		while (!ranges.empty() && sample_keys.size() < keys_wanted) {
+			KeyRange range(std::move(ranges.front()));
+			ranges.pop_front();
+			ColumnValues midpoint(subdivide_primary_key_range(table, get<0>(range), get<1>(range)));
+			bool divisible = !(midpoint.empty() || midpoint == get<0>(range) || midpoint == get<1>(range));
+
+			if (!at_random) {
+				if (!divisible) continue;
+				sample_keys.push_back(midpoint);
+				ranges.emplace_back(get<0>(range), midpoint);
+				ranges.emplace_back(std::move(midpoint), get<1>(range));
+			} else if (!divisible) {
+				sample_keys.push_back(get<0>(range));
+				ranges.emplace_back(first_key, last_key); // start again from the top for the next key
+			} else if (random_engine() & 1) {
+				ranges.emplace_back(std::move(midpoint), get<1>(range));
+			} else {
+				ranges.emplace_back(get<0>(range), std::move(midpoint));
+			}
+		}
+		return sample_keys;
+	}
+
+	void record_differences(const shared_ptr<TableJob> &table_job, const RowDifferences &differences, const ColumnValues &prev_key, const ColumnValues &last_key) {
+		if (differences.empty()) return;
+
+		const Table &table(table_job->table);
+		string line(diff_report_range_line(table_job->table_id,
+			prev_key.empty() ? string() : values_list(client, table, prev_key),
+			last_key.empty() ? string() : values_list(client, table, last_key),
+			differences));
+
+		{
+			std::unique_lock<std::mutex> lock(table_job->mutex);
+			table_job->differences += differences;
+		}
+
+		unique_lock<mutex> lock(sync_queue.mutex);
+		worker.report << line << endl << flush;
+	}
+
+	bool reload_instead_of_diffing(const shared_ptr<TableJob> &table_job, const ColumnValues &their_first_key, const ColumnValues &their_last_key) {
+		const Table &table(table_job->table);
+		auto table_filter = worker.table_filters.find(table_job->table_id);
+		string strategy(table_filter == worker.table_filters.end() ? "" : table_filter->second.strategy);
+
+		// we don't throw away ranges that an interrupted run has already finished
+		if (!worker.sync_journal.ranges_finished(table_job->table_id).empty()) return false;
+
+		if (strategy == "reload" || strategy == "rebuild") {
+			if (worker.verbose) cout << "Reloading " << table.name << ", as given in the filters file." << endl;
+			return true;
+		}
+		if (strategy == "diff" || (strategy.empty() && !worker.auto_reload)) return false;
+
+		// hash single rows at a spread of points through the key space at both ends, or if we can't interpolate
+		// between keys, the first few rows; the fraction that match estimates the fraction of the table that does
+		vector<ColumnValues> prev_keys{ColumnValues()};
+		if (table_job->subdividable) {
+			vector<ColumnValues> sample_keys(sample_keys_between(table, their_first_key, their_last_key, DEFAULT_STRATEGY_SAMPLES - 1, false));
+			prev_keys.insert(prev_keys.end(), sample_keys.begin(), sample_keys.end());
+		} else {
+			ValuesCollector first_keys;
+			retrieve_keys(client, first_keys, table, ColumnValues(), their_last_key, DEFAULT_STRATEGY_SAMPLES - 1);
+			prev_keys.insert(prev_keys.end(), first_keys.values.begin(), first_keys.values.end());
+		}
+
+		list<SampleHash> samples(hash_samples(table_job, prev_keys, their_last_key, 1));
+		size_t samples_matched = count_if(samples.begin(), samples.end(), [](const SampleHash &sample) { return sample.matches(); });
+
+		bool reload = (samples_matched < samples.size()*DEFAULT_RELOAD_MATCHING_FRACTION);
+		if (worker.verbose) cout << (reload ? "Reloading " : "Comparing ") << table.name << ", " << samples_matched << " of " << samples.size() << " sampled rows match." << endl;
+		return reload;
+	}
+
+	bool rebuild_instead_of_diffing(const shared_ptr<TableJob> &table_job) {
+		const Table &table(table_job->table);
+		auto table_filter = worker.table_filters.find(table_job->table_id);
+		if (table_filter == worker.table_filters.end() || table_filter->second.strategy != "rebuild") return false;
+
+		// the swap has to be committed straight away, and we don't throw away ranges that an interrupted run has
+		// already finished; tables that have things we wouldn't recreate are reloaded in place instead
+		if (worker.commit_level < CommitLevel::often || !worker.sync_journal.ranges_finished(table_job->table_id).empty() || !client.table_can_be_rebuilt(table)) {
+			if (worker.verbose) cout << "Can't rebuild " << table.name << " because it has foreign keys, triggers, grants, policies, comments, or dependent views, or we're not committing often or are resuming." << endl;
+			return false;
+		}
+
+		if (!ShadowTable<DatabaseClient>::names_available(client, table)) {
+			if (worker.verbose) cout << "Can't rebuild " << table.name << " because there's already another table with the name we'd use for the new table." << endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	void rebuild_table(const shared_ptr<TableJob> &table_job, RowReplacer<DatabaseClient> &row_replacer, const ColumnValues &their_last_key) {
+		const Table &table(table_job->table);
+		ShadowTable<DatabaseClient> shadow_table(client, table);
+		if (worker.verbose) cout << "Rebuilding " << table.name << " as " << shadow_table.table.name << ", as given in the filters file." << endl;
+
+		// nothing reads the shadow table, so we can commit as we load it
+		shadow_table.create();
+		RowReplacer<DatabaseClient> shadow_row_replacer(client, shadow_table.table, true, [&] { if (worker.progress) { cout << "." << flush; } });
+		request_rows_without_pipelining(table_job, shadow_row_replacer, KeyRange(ColumnValues(), their_last_key));
+		shadow_row_replacer.apply();
+		row_replacer.rows_changed += shadow_row_replacer.rows_changed;
+
+		shadow_table.create_keys();
+		client.commit_transaction();
+		client.start_write_transaction();
+
+		// readers of the original table only have to wait for this short transaction
+		shadow_table.swap();
+		client.commit_transaction();
+		client.start_write_transaction();
+	}
+
 	void queue_initial_ranges(const shared_ptr<TableJob> &table_job, const ColumnValues &our_last_key, const ColumnValues &their_first_key, const ColumnValues &their_last_key) {
 		std::unique_lock<std::mutex> lock(table_job->mutex);
 
@@ -265,44 +801,179 @@ struct SyncToAlgorithm {
 		// methods, so we queue a sync from the start (empty key value) up to the last key - but this results in no
 		// actual inefficiency because they'd see the same rows anyway.  we attempt to  do one subdivision straight
 		// away, to facilitate parallelism; if we can't subdivide, \midpoint stays empty so we only queue one range.
+		bool hash_keys = hash_keys_first(table_job->table);
 		ColumnValues midpoint;
 		if (table_job->subdividable) {
 			midpoint = std::move(first_key_not_earlier_than(client, table_job->table, subdivide_primary_key_range(table_job->table, their_first_key /* ideally for consistency we'd use this value minus one, but it doesn't actually matter */, their_last_key /* our_last_key would be better but might be < their_first_key and that is unsupported */), ColumnValues(), our_last_key));
 		}
 		if (!midpoint.empty()) {
-			table_job->ranges_to_check.emplace(ColumnValues(), midpoint, UNKNOWN_ROW_COUNT, 1 /* start with 1 row and build up */, 0);
+			table_job->ranges_to_check.emplace(ColumnValues(), midpoint, UNKNOWN_ROW_COUNT, 1 /* start with 1 row and build up */, 0, hash_keys);
 		}
 		if (midpoint != our_last_key) {
-			table_job->ranges_to_check.emplace(midpoint, our_last_key, UNKNOWN_ROW_COUNT, 1 /* start with 1 row and build up */, 0);
+			table_job->ranges_to_check.emplace(midpoint, our_last_key, UNKNOWN_ROW_COUNT, 1 /* start with 1 row and build up */, 0, hash_keys);
 		}
 	}
 
+	void queue_unfinished_ranges(const shared_ptr<TableJob> &table_job, const ColumnValues &our_last_key, const vector<KeyRange> &ranges_finished) {
+		// the ranges finished by the interrupted run join up into a few stretches of the key space; put those in
+		// order and queue the gaps between them, up to our_last_key.  if the journal has ranges that overlap, we
+		// may check some parts again, but we won't miss any.
+		const Table &table(table_job->table);
+		vector<KeyRange> stretches(join_key_ranges(ranges_finished));
+		set<ColumnValues> keys{ColumnValues(), our_last_key};
+		for (const KeyRange &stretch : stretches) {
+			keys.insert(get<0>(stretch));
+			keys.insert(get<1>(stretch));
+		}
+		map<ColumnValues, size_t> positions(key_positions(client, table, keys));
+		auto key_less_than = [&](const ColumnValues &key1, const ColumnValues &key2) { return positions.at(key1) < positions.at(key2); };
+		sort(stretches.begin(), stretches.end(), [&](const KeyRange &a, const KeyRange &b) { return key_less_than(get<0>(a), get<0>(b)); });
+
+		bool hash_keys = hash_keys_first(table);
+		vector<KeyRange> gaps;
+		ColumnValues prev_key;
+		for (const KeyRange &stretch : stretches) {
+			if (!key_less_than(get<0>(stretch), our_last_key)) break;
+			if (get<0>(stretch) != prev_key) gaps.emplace_back(prev_key, get<0>(stretch));
+			prev_key = get<1>(stretch);
+			if (!key_less_than(prev_key, our_last_key)) break;
+		}
+		if (key_less_than(prev_key, our_last_key)) gaps.emplace_back(prev_key, our_last_key);
+
+		if (worker.verbose) cout << "Resuming " << table.name << ", " << gaps.size() << " range(s) left to check." << endl;
+
+		std::unique_lock<std::mutex> lock(table_job->mutex);
+		for (const KeyRange &gap : gaps) {
+			table_job->ranges_to_check.emplace(get<0>(gap), get<1>(gap), UNKNOWN_ROW_COUNT, 1 /* start with 1 row and build up */, 0, hash_keys);
+		}
+	}
+
+	void journal_ranges_applied(const shared_ptr<TableJob> &table_job) {
+		// called each time the row replacer applies its changes, which commits them when we're committing often, as
+		// we must be if we're journaling; so all the ranges we finished applying before now are safe
+		for (const KeyRange &range : ranges_applied) {
+			worker.sync_journal.record_range(table_job->table_id, range, true);
+		}
+		ranges_applied.clear();
+	}
+
+	inline bool hash_keys_first(const Table &table) {
+		// comparing the keys first only helps if the key isn't the whole row, and needs the other end to support it
+		return ((worker.hash_keys_first || keys_only(table)) &&
+			(table.primary_key_type == PrimaryKeyType::explicit_primary_key || table.primary_key_type == PrimaryKeyType::suitable_unique_key) &&
+			output.stream().protocol_version >= FIRST_HASH_KEYS_COMMAND_VERSION);
+	}
+
+	inline bool keys_only(const Table &table) {
+		// the user has told us that rows in this table are never updated, so if the keys match, the rows do too
+		return (worker.keys_only_tables.count(table.name) > 0);
+	}
+
+	inline bool can_load_in_parallel() {
+		// each worker inserts rows in its own transaction, so the writer can only see the other workers' rows
+		// (which it needs to, for example to reset sequences) if they commit as they go
+		return (sync_queue.workers > 1 &&
+			!worker.verify &&
+			worker.commit_level >= CommitLevel::often &&
+			output.stream().protocol_version >= FIRST_SPLIT_COMMAND_VERSION);
+	}
+
+	void queue_ranges_to_load(const shared_ptr<TableJob> &table_job, RowReplacer<DatabaseClient> &row_replacer, const ColumnValues &their_last_key) {
+		// commit the deletes we made while clearing the table, otherwise the other workers' inserts could block on them
+		row_replacer.apply();
+
+		const Table &table(table_job->table);
+		size_t chunks = sync_queue.workers*DEFAULT_LOAD_CHUNKS_PER_WORKER;
+		if (worker.verbose > 1) cout << timestamp() << " worker " << worker.worker_number << " <- split " << table.name << ' ' << values_list(client, table, ColumnValues()) << ' ' << values_list(client, table, their_last_key) << ' ' << chunks << endl;
+		send_command(output, Commands::SPLIT, table_job->table_id, ColumnValues(), their_last_key, chunks, DEFAULT_MINIMUM_ROWS_PER_LOAD_CHUNK);
+
+		string _table_name;
+		ColumnValues prev_key, last_key;
+		vector<ColumnValues> split_keys;
+		read_expected_command(input, Commands::SPLIT, _table_name, prev_key, last_key, split_keys);
+		if (worker.verbose > 1) cout << timestamp() << " worker " << worker.worker_number << " -> split " << table.name << ' ' << values_list(client, table, prev_key) << ' ' << values_list(client, table, last_key) << ' ' << split_keys.size() + 1 << " chunks" << endl;
+
+		std::unique_lock<std::mutex> lock(table_job->mutex);
+		for (const ColumnValues &split_key : split_keys) {
+			table_job->ranges_to_load.emplace_back(prev_key, split_key);
+			prev_key = split_key;
+		}
+		table_job->ranges_to_load.emplace_back(prev_key, last_key);
+
+		if (table_job->notify_when_work_could_be_shared) {
+			lock.unlock();
+			sync_queue.have_work_to_share(table_job);
+		}
+	}
+
+	void load_rows(const shared_ptr<TableJob> &table_job, RowReplacer<DatabaseClient> &row_replacer, const KeyRange &range_to_load, bool writer) {
+		size_t rows_changed_before = row_replacer.rows_changed;
+
+		send_rows_command(table_job, range_to_load);
+		if (input.next<verb_t>() != Commands::ROWS) throw command_error("Didn't receive response to ROWS command");
+		handle_rows_response(table_job, row_replacer, true);
+
+		// apply and commit now so that the writer can see our rows when it finishes off the table
+		row_replacer.apply();
+
+		std::unique_lock<std::mutex> lock(table_job->mutex);
+		if (!writer) table_job->rows_loaded_by_helpers += row_replacer.rows_changed - rows_changed_before;
+		table_job->load_commands_completed++;
+		table_job->borrowed_task_completed.notify_all();
+	}
+
 	void request_rows_without_pipelining(const shared_ptr<TableJob> &table_job, RowReplacer<DatabaseClient> &row_replacer, const KeyRange &range_to_retrieve) {
 		send_rows_command(table_job, range_to_retrieve);
 		if (input.next<verb_t>() != Commands::ROWS) throw command_error("Didn't receive response to ROWS command");
-		handle_rows_response(table_job->table, row_replacer, true);
+		handle_rows_response(table_job, row_replacer, true);
 
 		std::unique_lock<std::mutex> lock(table_job->mutex);
 		table_job->rows_commands++;
 	}
 
-	void handle_rows_response(const Table &table, RowReplacer<DatabaseClient> &row_replacer, bool final_rows = false) {
+	void handle_rows_response(const shared_ptr<TableJob> &table_job, RowReplacer<DatabaseClient> &row_replacer, bool final_rows = false) {
 		// we're being sent a range of rows; apply them to our end.  we do this in-context to
 		// provide flow control - if we buffered and used a separate apply thread, we would
 		// bloat up if this end couldn't write to disk as quickly as the other end sent data.
+		const Table &table(table_job->table);
 		string table_name;
 		ColumnValues prev_key, last_key;
 		read_array(input, table_name, prev_key, last_key); // the first array gives the range arguments, which is followed by one array for each row
 		if (worker.verbose > 1) cout << timestamp() << " worker " << worker.worker_number << " -> rows " << table.name << ' ' << values_list(client, table, prev_key) << ' ' << values_list(client, table, last_key) << endl;
+		RowDifferences differences_before(row_replacer.differences);
 
 		if (final_rows) {
 			RowInserter<DatabaseClient>(row_replacer, table).stream_from_input(input);
 		} else {
-			RowRangeApplier<DatabaseClient>(row_replacer, table, prev_key, last_key).stream_from_input(input);
+			// we've normally hashed the rows in the range at our end to find that it didn't match, so we may still
+			// have them; either way, our rows in the range are about to change, so we mustn't keep them any longer.
+			// the other workers read using their own connections, so once we've changed any rows (for example when
+			// clearing rows with conflicting unique key values), the rows they read may be out of date.
+			LocalRowsRange local_rows;
+			{
+				std::unique_lock<std::mutex> lock(table_job->mutex);
+				table_job->local_row_cache.take(prev_key, last_key, local_rows, (worker.verify || !row_replacer.rows_changed) ? ANY_WORKER : worker.worker_number);
+			}
+
+			RowRangeApplier<DatabaseClient> row_range_applier(row_replacer, table, prev_key, last_key);
+			if (local_rows.rows) row_range_applier.use_local_rows(std::move(local_rows));
+			row_range_applier.stream_from_input(input);
+		}
+
+		// the range is only finished once the changes are committed, see journal_ranges_applied
+		if (worker.sync_journal.enabled() && !last_key.empty()) ranges_applied.emplace_back(prev_key, last_key);
+
+		if (worker.verify) {
+			record_differences(table_job, row_replacer.differences - differences_before, prev_key, last_key);
+
+			// the writer may be waiting for us to finish retrieving rows before it finishes off the table
+			std::unique_lock<std::mutex> lock(table_job->mutex);
+			table_job->rows_commands_completed++;
+			table_job->borrowed_task_completed.notify_all();
 		}
 	}
 
-	void handle_hash_response(const shared_ptr<TableJob> &table_job, list<HashResult> &ranges_hashed) {
+	void handle_hash_response(const shared_ptr<TableJob> &table_job, list<HashResult> &ranges_hashed, bool hash_keys) {
 		size_t rows_to_hash, their_row_count;
 		string their_hash;
 		string table_name;
@@ -313,10 +984,15 @@ struct SyncToAlgorithm {
 		if (ranges_hashed.empty()) throw command_error("Haven't issued a hash command for " + table.name + ", received " + values_list(client, table, prev_key) + " " + values_list(client, table, last_key));
 		HashResult hash_result(std::move(ranges_hashed.front()));
 		ranges_hashed.pop_front();
-		if (table_name != table.name || prev_key != hash_result.prev_key || last_key != hash_result.last_key) throw command_error("Didn't issue hash command for " + table.name + " " + values_list(client, table, prev_key) + " " + values_list(client, table, last_key));
+		if (table_name != table.name || prev_key != hash_result.prev_key || last_key != hash_result.last_key || hash_keys != hash_result.hash_keys) throw command_error("Didn't issue hash command for " + table.name + " " + values_list(client, table, prev_key) + " " + values_list(client, table, last_key));
 
 		bool match = (hash_result.our_hash == their_hash && hash_result.our_row_count == their_row_count);
-		if (worker.verbose > 1) cout << timestamp() << " worker " << worker.worker_number << " -> hash " << table.name << ' ' << values_list(client, table, prev_key) << ' ' << values_list(client, table, last_key) << ' ' << their_row_count << (match ? " matches" : " doesn't match") << endl;
+		if (worker.verbose > 1) cout << timestamp() << " worker " << worker.worker_number << (hash_keys ? " -> hash keys " : " -> hash ") << table.name << ' ' << values_list(client, table, prev_key) << ' ' << values_list(client, table, last_key) << ' ' << their_row_count << (match ? " matches" : " doesn't match") << endl;
+
+		// when the whole rows match (or just the keys, for keys-only tables), we're done with that part of the range
+		if (worker.sync_journal.enabled() && match && hash_result.our_row_count > 0 && (!hash_keys || keys_only(table))) {
+			worker.sync_journal.record_range(table_job->table_id, KeyRange(prev_key, hash_result.our_last_key), false);
+		}
 
 		std::unique_lock<std::mutex> lock(table_job->mutex);
 
@@ -336,13 +1012,13 @@ struct SyncToAlgorithm {
 				// are the result of more subdivisions before ranges that are the result of fewer.
 				if (!hash_result.next_midpoint.empty()) {
 					if (hash_result.next_midpoint != hash_result.our_last_key) {
-						table_job->ranges_to_check.emplace(hash_result.our_last_key, hash_result.next_midpoint, UNKNOWN_ROW_COUNT, rows_to_hash_next, hash_result.priority + 1);
+						table_job->ranges_to_check.emplace(hash_result.our_last_key, hash_result.next_midpoint, UNKNOWN_ROW_COUNT, rows_to_hash_next, hash_result.priority + 1, hash_result.hash_keys);
 					}
 					if (last_key != hash_result.next_midpoint) {
-						table_job->ranges_to_check.emplace(hash_result.next_midpoint, last_key, UNKNOWN_ROW_COUNT, rows_to_hash_next, hash_result.priority + 1);
+						table_job->ranges_to_check.emplace(hash_result.next_midpoint, last_key, UNKNOWN_ROW_COUNT, rows_to_hash_next, hash_result.priority + 1, hash_result.hash_keys);
 					}
 				} else {
-					table_job->ranges_to_check.emplace(hash_result.our_last_key, last_key, UNKNOWN_ROW_COUNT, rows_to_hash_next, hash_result.priority);
+					table_job->ranges_to_check.emplace(hash_result.our_last_key, last_key, UNKNOWN_ROW_COUNT, rows_to_hash_next, hash_result.priority, hash_result.hash_keys);
 				}
 			} else {
 				// we're hunting errors, do that first.  if the part just checked matched, then the
@@ -352,7 +1028,7 @@ struct SyncToAlgorithm {
 				size_t rows_remaining = hash_result.estimated_rows_in_range > hash_result.our_row_count ? hash_result.estimated_rows_in_range - hash_result.our_row_count : 1; // conditional to protect against underflow
 				size_t rows_to_hash_next = match && rows_remaining > 1 && hash_result.our_size > target_minimum_block_size ? rows_remaining/2 : rows_remaining;
 
-				table_job->ranges_to_check.emplace(hash_result.our_last_key, last_key, rows_remaining, rows_to_hash_next, hash_result.priority + 1);
+				table_job->ranges_to_check.emplace(hash_result.our_last_key, last_key, rows_remaining, rows_to_hash_next, hash_result.priority + 1, hash_result.hash_keys);
 			}
 		}
 
@@ -360,11 +1036,18 @@ struct SyncToAlgorithm {
 			// the part that we checked has an error; decide whether it's large enough to bother locating it more precisely
 			if (hash_result.our_row_count > 1 && hash_result.our_size > target_minimum_block_size) {
 				// yup, queue it up for another iteration of hashing, checking half the rows at a time
-				table_job->ranges_to_check.emplace(prev_key, hash_result.our_last_key, hash_result.our_row_count, hash_result.our_row_count/2, hash_result.priority + 1);
+				table_job->ranges_to_check.emplace(prev_key, hash_result.our_last_key, hash_result.our_row_count, hash_result.our_row_count/2, hash_result.priority + 1, hash_result.hash_keys);
+			} else if (hash_keys && hash_result.our_row_count > 1) {
+				// the key values are much smaller than the rows, so before retrieving the rows, narrow the range
+				// down further by comparing the whole rows, which will work out whether it's worth going further
+				table_job->ranges_to_check.emplace(prev_key, hash_result.our_last_key, hash_result.our_row_count, hash_result.our_row_count/2, hash_result.priority + 1, false);
 			} else {
 				// not worth reducing the affected row range any further, queue it to be retrieved
 				table_job->ranges_to_retrieve.emplace_back(prev_key, hash_result.our_last_key);
 			}
+		} else if (hash_keys && hash_result.our_row_count > 0 && !keys_only(table)) {
+			// the same rows are present at both ends, but they may have been updated, so now compare the whole rows
+			table_job->ranges_to_check.emplace(prev_key, hash_result.our_last_key, hash_result.our_row_count, hash_result.our_row_count, hash_result.priority + 1, false);
 		}
 
 		table_job->hash_commands_completed++;
@@ -413,4 +1096,6 @@ struct SyncToAlgorithm {
 	HashAlgorithm hash_algorithm;
 	size_t target_minimum_block_size;
 	size_t target_maximum_block_size;
+	vector<KeyRange> ranges_applied; // but not yet committed; only used when journaling
+	mt19937_64 random_engine; // only used with --verify-sample
 };
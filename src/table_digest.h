@@ -0,0 +1,45 @@
+#ifndef TABLE_DIGEST_H
+#define TABLE_DIGEST_H
+
+#include "query_functions.h"
+#include "hash_algorithm.h"
+#include "hash_thread_pool.h"
+#include "message_pack/unpack.h"
+
+// the row count and hash of an entire table, used to check small tables in batches rather than one range at a time
+struct TableDigest {
+	TableDigest(): row_count(0) {}
+
+	inline bool operator ==(const TableDigest &other) const { return (row_count == other.row_count && hash == other.hash); }
+	inline bool operator !=(const TableDigest &other) const { return !(*this == other); }
+
+	size_t row_count;
+	string hash;
+};
+
+template <typename OutputStream>
+void operator << (Packer<OutputStream> &packer, const TableDigest &table_digest) {
+	pack_array_length(packer, 2);
+	packer << table_digest.row_count;
+	packer << table_digest.hash;
+}
+
+template <typename InputStream>
+void operator >> (Unpacker<InputStream> &unpacker, TableDigest &table_digest) {
+	size_t array_length = unpacker.next_array_length(); // checks type
+	if (array_length != 2) throw unpacker_error("Expected a row count and hash for the table digest, got " + to_string(array_length) + " values");
+	unpacker >> table_digest.row_count;
+	unpacker >> table_digest.hash;
+}
+
+// the whole table is hashed in one go, so there are no row digests worth keeping even with xxh3_128_rows
+template <typename DatabaseClient>
+TableDigest table_digest(DatabaseClient &client, const Table &table, HashAlgorithm hash_algorithm, HashThreadPool *hash_thread_pool) {
+	RowHasher hasher(key_hash_algorithm(hash_algorithm), hash_thread_pool);
+	TableDigest result;
+	result.row_count = retrieve_rows(client, hasher, table, ColumnValues(), ColumnValues());
+	result.hash = hasher.finish().to_string();
+	return result;
+}
+
+#endif
@@ -2,38 +2,95 @@
 #define UNIQUE_KEY_CLEARER_H
 
 #include "base_sql.h"
+#include "database_client_traits.h"
 #include "encode_packed.h"
+#include "sql_functions.h"
 #include "message_pack/packed_row.h"
 
+template <typename DatabaseClient, bool = is_base_of<SupportsArrays, DatabaseClient>::value>
+struct UniqueKeyClearerBuilder {
+	static string single_column_prefix(DatabaseClient &client, const Column &column) {
+		return client.quote_identifier(column.name) + " IN (";
+	}
+
+	static string single_column_suffix(DatabaseClient &client, const Column &column) {
+		return ")";
+	}
+
+	static bool supports_row_constructor_lists(DatabaseClient &client) {
+		// frustratingly http://bugs.mysql.com/bug.php?id=31188 was not fixed until 5.7.3, so on earlier versions a
+		// WHERE (key columns) IN (tuples) query won't use the index, and we have to use AND/OR repetition instead
+		return client.supports_row_constructor_index_lookups();
+	}
+};
+
+template <typename DatabaseClient>
+struct UniqueKeyClearerBuilder<DatabaseClient, true> {
+	static string single_column_prefix(DatabaseClient &client, const Column &column) {
+		return client.quote_identifier(column.name) + " = ANY(ARRAY[";
+	}
+
+	static string single_column_suffix(DatabaseClient &client, const Column &column) {
+		// the array literal won't otherwise know what type its elements are
+		return "]::" + client.column_type(column) + "[])";
+	}
+
+	static bool supports_row_constructor_lists(DatabaseClient &client) {
+		return true;
+	}
+};
+
 template <typename DatabaseClient>
 struct UniqueKeyClearer {
 	UniqueKeyClearer(DatabaseClient &client, const Table &table, const ColumnIndices &key_columns):
 		client(&client),
 		table(&table),
 		key_columns(&key_columns),
-		delete_sql("DELETE FROM " + client.quote_table_name(table) + " WHERE (", ")") {
+		delete_sql("DELETE FROM " + client.quote_table_name(table) + " WHERE ", "") {
+		if (key_columns.size() == 1) {
+			// single-column keys can simply use a list of values
+			const Column &column(table.columns[key_columns.front()]);
+			list_form = true;
+			delete_sql.prefix += UniqueKeyClearerBuilder<DatabaseClient>::single_column_prefix(client, column);
+			delete_sql.suffix = UniqueKeyClearerBuilder<DatabaseClient>::single_column_suffix(client, column);
+			separator = ", ";
+		} else if (UniqueKeyClearerBuilder<DatabaseClient>::supports_row_constructor_lists(client)) {
+			list_form = true;
+			delete_sql.prefix += "(" + columns_list(client, table.columns, key_columns) + ") IN ((";
+			delete_sql.suffix = "))";
+			separator = "),\n(";
+		} else {
+			list_form = false;
+			delete_sql.prefix += "(";
+			delete_sql.suffix = ")";
+			separator = ")\nOR (";
+		}
+		delete_sql.reset();
 	}
 
-	bool key_enforceable(const PackedRow &row) {
+	template <typename Row>
+	bool key_enforceable(const Row &row) {
 		for (size_t n = 0; n < key_columns->size(); n++) {
 			if (row[(*key_columns)[n]].is_nil()) return false;
 		}
 		return true;
 	}
 
-	void row(const PackedRow &row) {
+	template <typename Row>
+	void row(const Row &row) {
 		// rows with any NULL values won't enforce a uniqueness constraint, so we don't need to clear them
 		if (!key_enforceable(row)) return;
 
-		if (delete_sql.have_content()) delete_sql += ")\nOR (";
+		if (delete_sql.have_content()) delete_sql += separator;
 		for (size_t n = 0; n < key_columns->size(); n++) {
-			// frustratingly http://bugs.mysql.com/bug.php?id=31188 was not fixed until 5.7.3 so we can't simply make a big WHERE (key columns) IN (tuples) here, and have to use AND/OR repetition instead
-			if (n > 0) {
-				delete_sql += " AND ";
-			}
 			size_t column = (*key_columns)[n];
-			delete_sql += table->columns[column].name;
-			delete_sql += '=';
+			if (list_form) {
+				if (n > 0) delete_sql += ',';
+			} else {
+				if (n > 0) delete_sql += " AND ";
+				delete_sql += client->quote_identifier(table->columns[column].name);
+				delete_sql += '=';
+			}
 			sql_encode_and_append_packed_value_to(delete_sql.curr, *client, table->columns[column], row[column]);
 		}
 	}
@@ -48,6 +105,8 @@ struct UniqueKeyClearer {
 	const Table *table;
 	const ColumnIndices *key_columns;
 	BaseSQL delete_sql;
+	bool list_form;
+	string separator;
 };
 
 #endif
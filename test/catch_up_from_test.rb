@@ -0,0 +1,65 @@
+require File.expand_path(File.join(File.dirname(__FILE__), 'test_helper'))
+
+class CatchUpFromTest < KitchenSync::EndpointTestCase
+  include TestTableSchemas
+
+  def from_or_to
+    :from
+  end
+
+  def before
+    create_some_tables
+    execute "SELECT pg_drop_replication_slot(slot_name) FROM pg_replication_slots WHERE slot_name = 'ks_test_slot'"
+    execute "SELECT pg_create_logical_replication_slot('ks_test_slot', 'test_decoding')"
+  end
+
+  def after
+    execute "SELECT pg_drop_replication_slot(slot_name) FROM pg_replication_slots WHERE slot_name = 'ks_test_slot'" rescue nil
+  end
+
+  test_each "returns no keys and an empty position if nothing has changed", only: :postgresql do
+    send_handshake_commands
+
+    send_command   Commands::CHANGED_KEYS, ["ks_test_slot", 1000]
+    expect_command Commands::CHANGED_KEYS,
+                   ["ks_test_slot", "", false, {}, []]
+  end
+
+  test_each "returns the keys of the rows inserted, updated, and deleted, in order", only: :postgresql do
+    execute "INSERT INTO footbl VALUES (2, 10, 'test'), (4, NULL, 'foo'), (5, NULL, NULL), (8, -1, 'longer str')"
+    execute "UPDATE footbl SET col3 = 'changed' WHERE col1 = 4"
+    execute "UPDATE footbl SET col1 = 9 WHERE col1 = 5"
+    execute "DELETE FROM footbl WHERE col1 = 2"
+    execute "INSERT INTO secondtbl VALUES (100, 2, 'aa', 9), (200, 1, 'bb', 8)"
+    send_handshake_commands
+
+    send_command Commands::CHANGED_KEYS, ["ks_test_slot", 1000]
+    verb, (slot_name, upto_lsn, more_changes, keys_by_table, tables_to_reload) = read_command
+    assert_equal [Commands::CHANGED_KEYS, "ks_test_slot", false, []], [verb, slot_name, more_changes, tables_to_reload]
+    assert_match %r{\A[0-9A-F]+/[0-9A-F]+\z}, upto_lsn
+    assert_equal({"footbl" => [[2], [4], [5], [8], [9]], "secondtbl" => [["aa", 2], ["bb", 1]]}, keys_by_table)
+  end
+
+  test_each "asks for truncated tables to be reloaded", only: :postgresql do
+    execute "INSERT INTO footbl VALUES (2, 10, 'test')"
+    execute "TRUNCATE footbl"
+    send_handshake_commands
+
+    send_command Commands::CHANGED_KEYS, ["ks_test_slot", 1000]
+    verb, (slot_name, upto_lsn, more_changes, keys_by_table, tables_to_reload) = read_command
+    assert_equal [{}, ["footbl"]], [keys_by_table, tables_to_reload]
+  end
+
+  test_each "consumes the changes up to the given position once confirmed", only: :postgresql do
+    execute "INSERT INTO footbl VALUES (2, 10, 'test')"
+    send_handshake_commands
+
+    send_command Commands::CHANGED_KEYS, ["ks_test_slot", 1000]
+    verb, (slot_name, upto_lsn, more_changes, keys_by_table, tables_to_reload) = read_command
+    assert_equal({"footbl" => [[2]]}, keys_by_table)
+
+    send_command   Commands::CONFIRM_CHANGES, ["ks_test_slot", upto_lsn]
+    expect_command Commands::CONFIRM_CHANGES
+    assert_equal [], query("SELECT data FROM pg_logical_slot_peek_changes('ks_test_slot', NULL, NULL)")
+  end
+end
@@ -0,0 +1,62 @@
+require File.expand_path(File.join(File.dirname(__FILE__), 'test_helper'))
+
+class ChangesFromTest < KitchenSync::EndpointTestCase
+  include TestTableSchemas
+
+  def from_or_to
+    :from
+  end
+
+  test_each "returns zero and an empty string if the table is empty" do
+    create_some_tables
+    send_handshake_commands
+
+    send_command   Commands::CHANGES, ["footbl", "another_col", ""]
+    expect_command Commands::CHANGES,
+                   ["footbl", "another_col", 0, ""]
+  end
+
+  test_each "returns the row count and the greatest value of the given column" do
+    create_some_tables
+    execute "INSERT INTO footbl VALUES (2, 10, 'test'), (4, NULL, 'foo'), (5, NULL, NULL), (8, -1, 'longer str')"
+    send_handshake_commands
+
+    send_command   Commands::CHANGES, ["footbl", "another_col", ""]
+    expect_command Commands::CHANGES,
+                   ["footbl", "another_col", 4, "10"]
+
+    send_command   Commands::CHANGES, ["footbl", "col3", ""]
+    expect_command Commands::CHANGES,
+                   ["footbl", "col3", 4, "test"]
+  end
+
+  test_each "counts only the rows that match the filter conditions" do
+    create_some_tables
+    execute "INSERT INTO footbl VALUES (2, 10, 'test'), (4, NULL, 'foo'), (5, NULL, NULL), (8, -1, 'longer str')"
+    send_handshake_commands(filters: {"footbl" => {"where_conditions" => "col1 BETWEEN 4 AND 8"}})
+
+    send_command   Commands::CHANGES, ["footbl", "another_col", ""]
+    expect_command Commands::CHANGES,
+                   ["footbl", "another_col", 3, "-1"]
+  end
+
+  test_each "returns a watermark for xmin, and returns the watermark given if no rows were written by later transactions", only: :postgresql do
+    create_some_tables
+    execute "INSERT INTO footbl VALUES (2, 10, 'test'), (4, NULL, 'foo')"
+    send_handshake_commands
+
+    send_command Commands::CHANGES, ["footbl", "xmin", ""]
+    verb, (table_name, column_name, row_count, watermark) = read_command
+    assert_equal [Commands::CHANGES, "footbl", "xmin", 2], [verb, table_name, column_name, row_count]
+    assert_match /\A\d+\z/, watermark
+
+    send_command   Commands::CHANGES, ["footbl", "xmin", watermark]
+    expect_command Commands::CHANGES,
+                   ["footbl", "xmin", 2, watermark]
+
+    # transaction ID 1 is treated as older than any rows, so rows have been written since it
+    send_command   Commands::CHANGES, ["footbl", "xmin", "1"]
+    expect_command Commands::CHANGES,
+                   ["footbl", "xmin", 2, watermark]
+  end
+end
@@ -0,0 +1,79 @@
+#include "../../catch2/catch.hpp"
+
+#include "../src/diff_report.h"
+
+static RowDifferences differences_of(size_t inserted, size_t updated, size_t deleted) {
+	RowDifferences differences;
+	differences.inserted = inserted;
+	differences.updated = updated;
+	differences.deleted = deleted;
+	return differences;
+}
+
+TEST_CASE("quoting strings for the diff report", "[diff_report]") {
+	REQUIRE(json_string("footbl") == "\"footbl\"");
+	REQUIRE(json_string("(1,'a \"b\"')") == "\"(1,'a \\\"b\\\"')\"");
+	REQUIRE(json_string("back\\slash") == "\"back\\\\slash\"");
+	REQUIRE(json_string("new\nline\ttab") == "\"new\\nline\\ttab\"");
+	REQUIRE(json_string(string("nul\0", 4)) == "\"nul\\u0000\"");
+	REQUIRE(json_string("\x1f") == "\"\\u001f\"");
+	REQUIRE(json_string("caf\xc3\xa9") == "\"caf\xc3\xa9\"");
+}
+
+TEST_CASE("diff report lines", "[diff_report]") {
+	SECTION("ranges of keys") {
+		REQUIRE(diff_report_range_line("footbl", "(2)", "(4)", differences_of(1, 2, 3)) ==
+			"{\"table\":\"footbl\",\"prev_key\":\"(2)\",\"last_key\":\"(4)\",\"inserted\":1,\"updated\":2,\"deleted\":3}");
+	}
+
+	SECTION("the start and end of the table are given as null") {
+		REQUIRE(diff_report_range_line("footbl", "", "", differences_of(0, 0, 7)) ==
+			"{\"table\":\"footbl\",\"prev_key\":null,\"last_key\":null,\"inserted\":0,\"updated\":0,\"deleted\":7}");
+	}
+
+	SECTION("table totals") {
+		REQUIRE(diff_report_table_line("public.footbl", RowDifferences()) ==
+			"{\"table\":\"public.footbl\",\"inserted\":0,\"updated\":0,\"deleted\":0}");
+	}
+}
+
+TEST_CASE("estimating divergence from samples", "[diff_report]") {
+	SECTION("the upper bound is above the estimate, and narrows as the number of samples grows") {
+		REQUIRE(wilson_upper_bound(0, 10, 1.96) == Approx(0.2775).epsilon(0.001));
+		REQUIRE(wilson_upper_bound(0, 1000, 1.96) == Approx(0.003827).epsilon(0.001));
+		REQUIRE(wilson_upper_bound(5, 100, 1.96) == Approx(0.1118).epsilon(0.001));
+		REQUIRE(wilson_upper_bound(10, 10, 1.96) == 1);
+	}
+
+	SECTION("with no samples we know nothing") {
+		REQUIRE(wilson_upper_bound(0, 0, 1.96) == 1);
+		REQUIRE(SampleResults().estimated_divergence() == 0);
+	}
+
+	SECTION("report lines") {
+		SampleResults sample_results;
+		sample_results.samples = 100;
+		sample_results.rows_sampled = 10000;
+		sample_results.samples_differing = 5;
+		REQUIRE(sample_results.estimated_divergence() == Approx(0.05));
+		REQUIRE(diff_report_sample_line("footbl", differences_of(0, 0, 2), sample_results, 1.96) ==
+			"{\"table\":\"footbl\",\"inserted\":0,\"updated\":0,\"deleted\":2,\"samples\":100,\"rows_sampled\":10000,\"samples_differing\":5,\"estimated_divergence\":0.05,\"divergence_upper_bound\":0.111752}");
+	}
+}
+
+TEST_CASE("adding up row differences", "[diff_report]") {
+	RowDifferences before(differences_of(1, 2, 3));
+	RowDifferences after(differences_of(5, 2, 4));
+	REQUIRE((after - before).inserted == 4);
+	REQUIRE((after - before).updated == 0);
+	REQUIRE((after - before).deleted == 1);
+	REQUIRE(!(after - before).empty());
+	REQUIRE((before - before).empty());
+
+	RowDifferences total;
+	total += before;
+	total += after;
+	REQUIRE(total.inserted == 6);
+	REQUIRE(total.updated == 4);
+	REQUIRE(total.deleted == 7);
+}
@@ -0,0 +1,44 @@
+require File.expand_path(File.join(File.dirname(__FILE__), 'test_helper'))
+
+class DigestsFromTest < KitchenSync::EndpointTestCase
+  include TestTableSchemas
+
+  def from_or_to
+    :from
+  end
+
+  def setup_with_some_tables(**handshake_args)
+    create_some_tables
+    execute "INSERT INTO footbl VALUES (2, 10, 'test'), (4, NULL, 'foo'), (5, NULL, NULL), (8, -1, 'longer str')"
+    @rows = [[2,    10,       "test"],
+             [4,   nil,        "foo"],
+             [5,   nil,          nil],
+             [8,    -1, "longer str"]]
+    send_handshake_commands(**handshake_args)
+  end
+
+  test_each "returns the row count and hash of all the rows in each of the tables" do
+    setup_with_some_tables
+
+    send_command   Commands::DIGESTS, [["footbl", "secondtbl"], 1024*1024]
+    expect_command Commands::DIGESTS,
+                   [{"footbl" => [4, hash_of(@rows)], "secondtbl" => [0, hash_of([])]}]
+  end
+
+  test_each "hashes the whole rows with XXH3 if asked to use XXH3_ROWS" do
+    setup_with_some_tables(hash_algorithm: HashAlgorithm::XXH3_128_ROWS)
+
+    send_command   Commands::DIGESTS, [["footbl"], 1024*1024]
+    expect_command Commands::DIGESTS,
+                   [{"footbl" => [4, hash_of(@rows, HashAlgorithm::XXH3_128)]}]
+  end
+
+  test_each "leaves out the tables that are larger than the given size at its end" do
+    setup_with_some_tables
+
+    send_command Commands::DIGESTS, [["footbl", "secondtbl"], 0]
+    verb, (digests, _) = read_command
+    assert_equal Commands::DIGESTS, verb
+    assert !digests.has_key?("footbl")
+  end
+end
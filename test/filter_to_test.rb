@@ -1,6 +1,7 @@
 require File.expand_path(File.join(File.dirname(__FILE__), 'test_helper'))
 
 require 'tempfile'
+require 'yaml'
 
 class FilterToTest < KitchenSync::EndpointTestCase
   include TestTableSchemas
@@ -88,4 +89,199 @@ class FilterToTest < KitchenSync::EndpointTestCase
       send_command   Commands::FILTERS
     end
   end
+
+  test_each "clears and reloads tables given the reload strategy, without comparing their rows" do
+    clear_schema
+    create_footbl
+    execute "INSERT INTO footbl VALUES (2, 10, 'test'), (4, NULL, 'foo')"
+    @rows = [[2, 10, "changed"],
+             [4,  3, "changed"]]
+
+    with_filter_file("footbl:\n  strategy: reload") do
+      expect_handshake_commands(
+        schema: {"tables" => [footbl_def]},
+        filters: {"footbl" => {}})
+    end
+    expect_command Commands::RANGE, ["footbl"]
+    send_command   Commands::RANGE, ["footbl", [2], [4]]
+    expect_command Commands::ROWS,
+                   ["footbl", [], [4]]
+    send_results   Commands::ROWS,
+                   ["footbl", [], [4]],
+                   *@rows
+    expect_quit_and_close
+
+    assert_equal @rows,
+                 query("SELECT * FROM footbl ORDER BY col1")
+  end
+
+  test_each "samples rows at both ends for tables given the auto strategy, and reloads them if most are different" do
+    clear_schema
+    create_footbl
+    execute "INSERT INTO footbl VALUES (2, 10, 'test'), (4, NULL, 'foo')"
+    @rows = [[2, 10, "changed"],
+             [4,  3, "changed"]]
+
+    with_filter_file("footbl:\n  strategy: auto") do
+      expect_handshake_commands(
+        schema: {"tables" => [footbl_def]},
+        filters: {"footbl" => {}})
+    end
+    expect_command Commands::RANGE, ["footbl"]
+    send_command   Commands::RANGE, ["footbl", [2], [4]]
+
+    # one row from the start, and one from after the midpoint of the key range; there's no room for more
+    expect_command Commands::HASH, ["footbl", [], [4], 1]
+    expect_command Commands::HASH, ["footbl", [3], [4], 1]
+    send_command   Commands::HASH, ["footbl", [], [4], 1, 1, hash_of(@rows[0..0])]
+    send_command   Commands::HASH, ["footbl", [3], [4], 1, 1, hash_of(@rows[1..1])]
+
+    expect_command Commands::ROWS,
+                   ["footbl", [], [4]]
+    send_results   Commands::ROWS,
+                   ["footbl", [], [4]],
+                   *@rows
+    expect_quit_and_close
+
+    assert_equal @rows,
+                 query("SELECT * FROM footbl ORDER BY col1")
+  end
+
+  test_each "loads tables given the rebuild strategy into a new table, and swaps it in for the original table" do
+    clear_schema
+    create_footbl
+    execute "INSERT INTO footbl VALUES (2, 10, 'test'), (4, NULL, 'foo')"
+    @rows = [[2, 10, "changed"],
+             [4,  3, "changed"]]
+    program_env['ENDPOINT_COMMIT_LEVEL'] = '4'
+
+    with_filter_file("footbl:\n  strategy: rebuild") do
+      expect_handshake_commands(
+        schema: {"tables" => [footbl_def]},
+        filters: {"footbl" => {}})
+    end
+    expect_command Commands::RANGE, ["footbl"]
+    send_command   Commands::RANGE, ["footbl", [2], [4]]
+    expect_command Commands::ROWS,
+                   ["footbl", [], [4]]
+    send_results   Commands::ROWS,
+                   ["footbl", [], [4]],
+                   *@rows
+    expect_quit_and_close
+
+    assert_equal @rows,
+                 query("SELECT * FROM footbl ORDER BY col1")
+    assert_equal ["footbl"],
+                 connection.tables.select {|table_name| table_name.start_with?("footbl")}
+  end
+
+  test_each "keeps the original name of the primary key when rebuilding tables", only: :postgresql do
+    clear_schema
+    create_footbl
+    execute "ALTER TABLE footbl RENAME CONSTRAINT footbl_pkey TO footbl_renamed_pkey"
+    execute "INSERT INTO footbl VALUES (2, 10, 'test'), (4, NULL, 'foo')"
+    @rows = [[2, 10, "changed"],
+             [4,  3, "changed"]]
+    program_env['ENDPOINT_COMMIT_LEVEL'] = '4'
+
+    with_filter_file("footbl:\n  strategy: rebuild") do
+      expect_handshake_commands(
+        schema: {"tables" => [footbl_def]},
+        filters: {"footbl" => {}})
+    end
+    expect_command Commands::RANGE, ["footbl"]
+    send_command   Commands::RANGE, ["footbl", [2], [4]]
+    expect_command Commands::ROWS,
+                   ["footbl", [], [4]]
+    send_results   Commands::ROWS,
+                   ["footbl", [], [4]],
+                   *@rows
+    expect_quit_and_close
+
+    assert_equal @rows,
+                 query("SELECT * FROM footbl ORDER BY col1")
+    assert_equal [["footbl_renamed_pkey"]],
+                 query("SELECT conname FROM pg_constraint WHERE conrelid = 'footbl'::regclass AND contype = 'p'")
+  end
+
+  test_each "compares tables given the rebuild strategy as usual if another table already has the name it would use for the new table" do
+    clear_schema
+    create_footbl
+    execute "INSERT INTO footbl VALUES (2, 10, 'test'), (4, NULL, 'foo')"
+    execute "CREATE TABLE footbl_ks_shadow (col1 INT)"
+    execute "INSERT INTO footbl_ks_shadow VALUES (1)"
+    @rows = [[2,  10, "test"],
+             [4, nil,  "foo"]]
+    program_env['ENDPOINT_COMMIT_LEVEL'] = '4'
+    program_env['ENDPOINT_IGNORE_TABLES'] = 'footbl_ks_shadow'
+
+    with_filter_file("footbl:\n  strategy: rebuild") do
+      expect_handshake_commands(
+        schema: {"tables" => [footbl_def]},
+        filters: {"footbl" => {}})
+    end
+    expect_command Commands::RANGE, ["footbl"]
+    send_command   Commands::RANGE, ["footbl", [2], [4]]
+    expect_command Commands::HASH, ["footbl", [], [4], 1]
+    send_command   Commands::HASH, ["footbl", [], [4], 1, 1, hash_of(@rows[0..0])]
+    expect_command Commands::HASH, ["footbl", [2], [4], 2]
+    send_command   Commands::HASH, ["footbl", [2], [4], 2, 1, hash_of(@rows[1..1])]
+    expect_quit_and_close
+
+    assert_equal @rows,
+                 query("SELECT * FROM footbl ORDER BY col1")
+    assert_equal [[1]],
+                 query("SELECT * FROM footbl_ks_shadow")
+  end
+
+  test_each "records the change-tracking column values in the state file, and skips the table next time if neither end has changed" do
+    clear_schema
+    create_footbl
+    execute "INSERT INTO footbl VALUES (2, 10, 'test'), (4, NULL, 'foo')"
+    @rows = [[2,  10, "test"],
+             [4, nil,  "foo"]]
+
+    state_file = Tempfile.new('state')
+    state_file.close
+    File.unlink(state_file.path) # there's no state the first time we run
+    program_env['ENDPOINT_STATE_FILE'] = state_file.path
+
+    begin
+      with_filter_file("footbl:\n  changes_tracked_by: another_col") do
+        expect_handshake_commands(
+          schema: {"tables" => [footbl_def]},
+          filters: {"footbl" => {}})
+        expect_command Commands::CHANGES, ["footbl", "another_col", ""]
+        send_command   Commands::CHANGES, ["footbl", "another_col", 2, "10"]
+        expect_command Commands::RANGE, ["footbl"]
+        send_command   Commands::RANGE, ["footbl", [2], [4]]
+        expect_command Commands::HASH, ["footbl", [], [4], 1]
+        send_command   Commands::HASH, ["footbl", [], [4], 1, 1, hash_of(@rows[0..0])]
+        expect_command Commands::HASH, ["footbl", [2], [4], 2]
+        send_command   Commands::HASH, ["footbl", [2], [4], 2, 1, hash_of(@rows[1..1])]
+        expect_quit_and_close
+        spawner.wait # the state file is written after the connection is closed
+
+        assert_equal({"footbl" => {"changes_tracked_by" => "another_col",
+                                   "from" => {"row_count" => 2, "last_change" => "10"},
+                                   "to"   => {"row_count" => 2, "last_change" => "10"}}},
+                     YAML.load_file(state_file.path))
+
+        # run again; we send back the value recorded for our end, and since neither end has changed, the table is skipped
+        @spawner.stop_binary
+        @spawner = nil
+        expect_handshake_commands(
+          schema: {"tables" => [footbl_def]},
+          filters: {"footbl" => {}})
+        expect_command Commands::CHANGES, ["footbl", "another_col", "10"]
+        send_command   Commands::CHANGES, ["footbl", "another_col", 2, "10"]
+        expect_quit_and_close
+      end
+    ensure
+      File.unlink(state_file.path) if File.exist?(state_file.path)
+    end
+
+    assert_equal @rows,
+                 query("SELECT * FROM footbl ORDER BY col1")
+  end
 end
@@ -30,6 +30,16 @@ class HashFromTest < KitchenSync::EndpointTestCase
     expect_command Commands::HASH, ["footbl", @keys[1], @keys[3], 1000, 2, hash_of(@rows[2..3])]
   end
 
+  test_each "calculates the hash of just the primary key values of the rows in the range if asked to hash keys" do
+    setup_with_footbl
+
+    send_command   Commands::HASH_KEYS, ["footbl", @keys[1], @keys[3], 1000]
+    expect_command Commands::HASH_KEYS, ["footbl", @keys[1], @keys[3], 1000, 2, hash_of(@keys[2..3])]
+
+    send_command   Commands::HASH_KEYS, ["footbl", [], @keys[4], 2]
+    expect_command Commands::HASH_KEYS, ["footbl", [], @keys[4], 2, 2, hash_of(@keys[0..1])]
+  end
+
   test_each "limits the number of rows within that range hashed to the given row count" do
     setup_with_footbl
 
@@ -162,6 +172,35 @@ class HashFromTest < KitchenSync::EndpointTestCase
     expect_command Commands::HASH, ["footbl", [], @keys[1], 1, 1, hash_of(@rows[0..0], HashAlgorithm::XXH64)]
   end
 
+  test_each "optionally supports XXH3 128-bit hashes" do
+    setup_with_footbl(target_minimum_block_size: 1, hash_algorithm: HashAlgorithm::XXH3_128)
+
+    send_command   Commands::HASH, ["footbl", @keys[1], @keys[3], 1000]
+    expect_command Commands::HASH, ["footbl", @keys[1], @keys[3], 1000, 2, hash_of(@rows[2..3], HashAlgorithm::XXH3_128)]
+
+    send_command   Commands::HASH, ["footbl", [], @keys[1], 1000]
+    expect_command Commands::HASH, ["footbl", [], @keys[1], 1000, 2, hash_of(@rows[0..1], HashAlgorithm::XXH3_128)]
+
+    send_command   Commands::HASH, ["footbl", [], @keys[1], 1]
+    expect_command Commands::HASH, ["footbl", [], @keys[1], 1, 1, hash_of(@rows[0..0], HashAlgorithm::XXH3_128)]
+  end
+
+  test_each "optionally supports hashes of XXH3 row hashes, and works out the hashes of parts of ranges it has hashed before" do
+    setup_with_footbl(target_minimum_block_size: 1, hash_algorithm: HashAlgorithm::XXH3_128_ROWS)
+
+    send_command   Commands::HASH, ["footbl", [], @keys[3], 1000]
+    expect_command Commands::HASH, ["footbl", [], @keys[3], 1000, 4, hash_of(@rows[0..3], HashAlgorithm::XXH3_128_ROWS)]
+
+    send_command   Commands::HASH, ["footbl", [], @keys[3], 2]
+    expect_command Commands::HASH, ["footbl", [], @keys[3], 2, 2, hash_of(@rows[0..1], HashAlgorithm::XXH3_128_ROWS)]
+
+    send_command   Commands::HASH, ["footbl", @keys[1], @keys[3], 1000]
+    expect_command Commands::HASH, ["footbl", @keys[1], @keys[3], 1000, 2, hash_of(@rows[2..3], HashAlgorithm::XXH3_128_ROWS)]
+
+    send_command   Commands::HASH, ["footbl", @keys[3], @keys[4], 1000]
+    expect_command Commands::HASH, ["footbl", @keys[3], @keys[4], 1000, 1, hash_of(@rows[4..4], HashAlgorithm::XXH3_128_ROWS)]
+  end
+
   test_each "optionally supports MD5 hashes" do
     setup_with_footbl(target_minimum_block_size: 1, hash_algorithm: HashAlgorithm::MD5)
 
@@ -0,0 +1,194 @@
+#include "../../catch2/catch.hpp"
+
+#include <string>
+#include <random>
+
+#include "../src/kernels/kernels.h"
+#include "../src/kernels/parse_decimal.h"
+
+#define XXH_STATIC_LINKING_ONLY
+#include "../src/xxHash/xxhash.h"
+
+using namespace std;
+
+static const char *kernel_names[] = { "portable", "sse42", "avx2" };
+
+string reference_quote_escape(const string &value, bool escape_backslashes) {
+	string result;
+	for (char c : value) {
+		if (c == '\'' || (c == '\\' && escape_backslashes)) result += c;
+		result += c;
+	}
+	return result;
+}
+
+string reference_backslash_escape(const string &value) {
+	string result;
+	for (char c : value) {
+		switch (c) {
+			case '\0':   result += "\\0";  break;
+			case '\n':   result += "\\n";  break;
+			case '\r':   result += "\\r";  break;
+			case '\\':   result += "\\\\"; break;
+			case '\'':   result += "\\'";  break;
+			case '"':    result += "\\\""; break;
+			case '\032': result += "\\Z";  break;
+			default:     result += c;
+		}
+	}
+	return result;
+}
+
+string reference_hex_encode(const string &value) {
+	static const char digits[] = "0123456789abcdef";
+	string result;
+	for (unsigned char c : value) {
+		result += digits[c >> 4];
+		result += digits[c & 15];
+	}
+	return result;
+}
+
+bool hex_decoded(const string &hex, string &result) {
+	result.resize(hex.size()/2);
+	return ks_hex_decode(hex.data(), hex.size(), (uint8_t *)&result[0]);
+}
+
+string quote_escaped(const string &value, bool escape_backslashes) {
+	string result(value.size()*2, '\0');
+	result.resize(ks_quote_escape(value.data(), value.size(), &result[0], escape_backslashes));
+	return result;
+}
+
+string backslash_escaped(const string &value) {
+	string result(value.size()*2, '\0');
+	result.resize(ks_backslash_escape(value.data(), value.size(), &result[0]));
+	return result;
+}
+
+string hex_encoded(const string &value) {
+	string result(value.size()*2, '\0');
+	result.resize(ks_hex_encode((const uint8_t *)value.data(), value.size(), &result[0]));
+	return result;
+}
+
+TEST_CASE("SQL encoding kernels", "[kernels]") {
+	mt19937 generator(42);
+	uniform_int_distribution<int> bytes(0, 255);
+	const string specials("\0\n\r\\'\"\032a", 8);
+	uniform_int_distribution<size_t> special(0, specials.size() - 1);
+	uniform_int_distribution<int> percent(0, 99);
+
+	vector<string> values{"", "plain", "it's", "back\\slash", string(100, '\''), string("\0", 1)};
+	for (size_t length : {1, 15, 16, 17, 31, 32, 33, 63, 64, 65, 100, 1000}) {
+		for (int special_percent : {0, 2, 50}) {
+			string value;
+			for (size_t n = 0; n < length; n++) {
+				value += (percent(generator) < special_percent) ? specials[special(generator)] : (char)bytes(generator);
+			}
+			values.push_back(value);
+		}
+	}
+
+	string original_selection(ks_kernels_selected());
+
+	for (const char *name : kernel_names) {
+		if (!ks_kernels_select(name)) continue;
+		INFO(name);
+		for (const string &value : values) {
+			REQUIRE(quote_escaped(value, false) == reference_quote_escape(value, false));
+			REQUIRE(quote_escaped(value, true) == reference_quote_escape(value, true));
+			REQUIRE(backslash_escaped(value) == reference_backslash_escape(value));
+			REQUIRE(hex_encoded(value) == reference_hex_encode(value));
+
+			string decoded, hex(reference_hex_encode(value));
+			REQUIRE(hex_decoded(hex, decoded));
+			REQUIRE(decoded == value);
+			for (char &c : hex) c = toupper(c);
+			REQUIRE(hex_decoded(hex, decoded));
+			REQUIRE(decoded == value);
+			if (!hex.empty()) {
+				for (char invalid : {'g', 'G', '/', ':', '@', '`', ' ', '\0', '\xb0', '\xc1'}) {
+					string invalid_hex(hex);
+					invalid_hex[invalid_hex.size()*3/4] = invalid;
+					REQUIRE(!hex_decoded(invalid_hex, decoded));
+				}
+			}
+		}
+	}
+
+	REQUIRE(ks_kernels_select("portable"));
+	REQUIRE(!ks_kernels_select("nonexistent"));
+	REQUIRE(ks_kernels_select(original_selection.c_str()));
+}
+
+string xxh3_128_in_pieces(const string &value, size_t piece_size) {
+	XXH3_state_t *state = XXH3_createState();
+	XXH3_128bits_reset(state);
+	for (size_t offset = 0; offset < value.size(); offset += piece_size) {
+		ks_xxh3_128_update(state, value.data() + offset, min(piece_size, value.size() - offset));
+	}
+	string result(16, '\0');
+	ks_xxh3_128_digest(state, (uint8_t *)&result[0]);
+	XXH3_freeState(state);
+	return result;
+}
+
+string reference_xxh3_128(const string &value) {
+	XXH128_canonical_t canonical;
+	XXH128_canonicalFromHash(&canonical, XXH3_128bits(value.data(), value.size()));
+	return string((const char *)canonical.digest, sizeof(canonical.digest));
+}
+
+TEST_CASE("XXH3-128 hashing", "[kernels]") {
+	mt19937 generator(42);
+	uniform_int_distribution<int> bytes(0, 255);
+
+	string original_selection(ks_kernels_selected());
+
+	for (const char *name : kernel_names) {
+		if (!ks_kernels_select(name)) continue;
+		INFO(name);
+
+		REQUIRE(reference_hex_encode(xxh3_128_in_pieces("", 1)) == "99aa06d3014798d86001c324468d497f");
+
+		// lengths either side of the short input cutoffs, the stripe and block sizes, and the internal buffer size
+		for (size_t length : {1, 16, 17, 128, 129, 240, 241, 256, 1024, 1025, 10000, 100000}) {
+			string value;
+			for (size_t n = 0; n < length; n++) value += (char)bytes(generator);
+			INFO(length);
+			for (size_t piece_size : {(size_t)1, (size_t)7, (size_t)64, (size_t)1000, length}) {
+				REQUIRE(xxh3_128_in_pieces(value, piece_size) == reference_xxh3_128(value));
+			}
+		}
+	}
+
+	REQUIRE(ks_kernels_select(original_selection.c_str()));
+}
+
+TEST_CASE("parsing decimal integers", "[kernels]") {
+	int64_t sint;
+	uint64_t uint;
+
+	for (const char *str : {"0", "1", "-1", "+7", "12345678", "-12345678", "123456789", "999999999999999999", "-999999999999999999", "-000000000000000001"}) {
+		INFO(str);
+		REQUIRE(ks_parse_int64(str, strlen(str), &sint));
+		REQUIRE(sint == strtoll(str, nullptr, 10));
+	}
+
+	for (const char *str : {"0", "1", "+7", "12345678", "123456789", "9999999999999999999", "0000000000000000001"}) {
+		INFO(str);
+		REQUIRE(ks_parse_uint64(str, strlen(str), &uint));
+		REQUIRE(uint == strtoull(str, nullptr, 10));
+	}
+
+	// values we leave to strtoll/strtoull
+	for (const char *str : {"", "-", "1a", "a1", "1234567a", "12345678 ", " 1", "1.5", "9223372036854775807", "-9223372036854775808"}) {
+		INFO(str);
+		REQUIRE(!ks_parse_int64(str, strlen(str), &sint));
+	}
+	for (const char *str : {"", "-1", "1234567/", "12345678:", "18446744073709551615"}) {
+		INFO(str);
+		REQUIRE(!ks_parse_uint64(str, strlen(str), &uint));
+	}
+}
@@ -3,13 +3,18 @@
 #include "../src/row_serialization.h"
 #include "../src/hash_algorithm.h"
 #include "../src/timestamp.h"
+#include "../src/message_pack/packed_row.h"
+#include "../src/message_pack/packed_row_view.h"
+#include "../src/kernels/kernels.h"
+#include "../src/kernels/parse_decimal.h"
+#include "../src/ewkb.h"
 
 template <typename T>
-double benchmark_one(const T &value, size_t columns, size_t rows, size_t reps, HashAlgorithm hash_algorithm) {
+double benchmark_one(const T &value, size_t columns, size_t rows, size_t reps, HashAlgorithm hash_algorithm, HashThreadPool *thread_pool = nullptr) {
 	size_t total_bytes_hashed(0);
 	double start_time = timestamp();
 	for (size_t rep = 0; rep < reps; rep++) {
-		RowHasher hasher(hash_algorithm);
+		RowHasher hasher(hash_algorithm, thread_pool);
 		for (size_t row = 0; row < rows; row++) {
 			pack_array_length(hasher.packer, columns);
 			for (size_t column = 0; column < columns; column++) {
@@ -24,11 +29,126 @@ double benchmark_one(const T &value, size_t columns, size_t rows, size_t reps, H
 	return total_bytes_hashed/(end_time - start_time)/1024.0/1024.0;
 }
 
+HashThreadPool hash_thread_pool(thread::hardware_concurrency());
+
 template <typename T>
 void benchmark(T value, size_t columns, size_t rows, size_t reps = 1000) {
 	cout << "MD5:      " << benchmark_one(value, columns, rows, reps, HashAlgorithm::md5)    << "MB/s" << endl;
 	cout << "BLAKE3:   " << benchmark_one(value, columns, rows, reps, HashAlgorithm::blake3) << "MB/s" << endl;
+	cout << "BLAKE3 x" << hash_thread_pool.size() << ": " << benchmark_one(value, columns, rows, reps, HashAlgorithm::blake3, &hash_thread_pool) << "MB/s" << endl;
 	cout << "XXHASH64: " << benchmark_one(value, columns, rows, reps, HashAlgorithm::xxh64)  << "MB/s" << endl;
+	cout << "XXH3-128: " << benchmark_one(value, columns, rows, reps, HashAlgorithm::xxh3_128) << "MB/s" << endl;
+	cout << endl;
+}
+
+template <typename Row, typename T>
+void benchmark_decode_one(const char *description, const T &value, size_t columns, size_t rows, size_t reps, bool buffer_rows) {
+	// build up the stream of rows the way the other end would send them
+	PackedValue stream;
+	Packer<PackedValue> packer(stream);
+	for (size_t row = 0; row < rows; row++) {
+		pack_array_length(packer, columns);
+		for (size_t column = 0; column < columns; column++) {
+			packer << value;
+		}
+	}
+	pack_array_length(packer, 0);
+
+	// then decode it the way RowInserter and RowRangeApplier do
+	size_t allocations_before = packed_allocations();
+	double start_time = timestamp();
+	PackedArena arena;
+	vector<PackedRow> buffered_rows(buffer_rows ? rows : 0);
+	for (size_t rep = 0; rep < reps; rep++) {
+		PackedValueReadStream read_stream(stream);
+		Unpacker<PackedValueReadStream> unpacker(read_stream);
+		Row row;
+		for (size_t row_number = 0; true; row_number++) {
+			unpacker >> row;
+			if (row.size() == 0) break;
+			if (buffer_rows) copy_row_using_arena(buffered_rows[row_number], row, arena);
+		}
+		if (buffer_rows) {
+			for (PackedRow &buffered_row : buffered_rows) buffered_row.clear();
+			arena.reset();
+		}
+	}
+	double end_time = timestamp();
+	size_t allocations = packed_allocations() - allocations_before;
+
+	cout << description << stream.encoded_size()*reps/(end_time - start_time)/1024.0/1024.0 << "MB/s, " << (double)allocations/(rows*reps) << " allocations per row" << endl;
+}
+
+template <typename T>
+void benchmark_decode(T value, size_t columns, size_t rows, size_t reps = 100) {
+	benchmark_decode_one<PackedRow>    ("streamed: ", value, columns, rows, reps, false);
+	benchmark_decode_one<PackedRowView>("viewed:   ", value, columns, rows, reps, false);
+	benchmark_decode_one<PackedRowView>("buffered: ", value, columns, rows, reps, true);
+	cout << endl;
+}
+
+template <typename Kernel>
+double benchmark_kernel_one(const string &value, size_t reps, Kernel kernel) {
+	string result(value.size()*2, '\0');
+	double start_time = timestamp();
+	for (size_t rep = 0; rep < reps; rep++) {
+		kernel(value, &result[0]);
+	}
+	double end_time = timestamp();
+	return value.size()*reps/(end_time - start_time)/1024.0/1024.0;
+}
+
+void benchmark_kernels(const string &value, size_t reps) {
+	for (const char *name : {"portable", "sse42", "avx2"}) {
+		if (!ks_kernels_select(name)) continue;
+		cout << name << ":" << string(10 - strlen(name), ' ') <<
+			"quote escape " << benchmark_kernel_one(value, reps, [](const string &value, char *dest) { ks_quote_escape(value.data(), value.size(), dest, false); }) << "MB/s, " <<
+			"backslash escape " << benchmark_kernel_one(value, reps, [](const string &value, char *dest) { ks_backslash_escape(value.data(), value.size(), dest); }) << "MB/s, " <<
+			"hex encode " << benchmark_kernel_one(value, reps, [](const string &value, char *dest) { ks_hex_encode((const uint8_t *)value.data(), value.size(), dest); }) << "MB/s" << endl;
+	}
+	cout << endl;
+}
+
+void benchmark_integer_parsing(const vector<string> &values, size_t reps) {
+	int64_t total = 0;
+	double start_time = timestamp();
+	for (size_t rep = 0; rep < reps; rep++) {
+		for (const string &value : values) total += strtoll(value.c_str(), nullptr, 10);
+	}
+	double middle_time = timestamp();
+	for (size_t rep = 0; rep < reps; rep++) {
+		for (const string &value : values) {
+			int64_t result;
+			total -= ks_parse_int64(value.data(), value.size(), &result) ? result : strtoll(value.c_str(), nullptr, 10);
+		}
+	}
+	double end_time = timestamp();
+	if (total) cerr << "mismatch!" << endl;
+
+	size_t count = values.size()*reps;
+	cout << "strtoll:   " << count/(middle_time - start_time)/1000000.0 << "M values/s" << endl;
+	cout << "ks_parse:  " << count/(end_time - middle_time)/1000000.0 << "M values/s" << endl;
+	cout << endl;
+}
+
+void benchmark_hex_decoding(const string &hex, size_t reps) {
+	double start_time = timestamp();
+	for (size_t rep = 0; rep < reps; rep++) {
+		string result(hex_to_bin_string(hex.data(), hex.size()));
+	}
+	double end_time = timestamp();
+	cout << "hex_to_bin_string: " << hex.size()*reps/(end_time - start_time)/1024.0/1024.0 << "MB/s" << endl;
+
+	string result(hex.size()/2, '\0');
+	for (const char *name : {"portable", "sse42", "avx2"}) {
+		if (!ks_kernels_select(name)) continue;
+		start_time = timestamp();
+		for (size_t rep = 0; rep < reps; rep++) {
+			ks_hex_decode(hex.data(), hex.size(), (uint8_t *)&result[0]);
+		}
+		end_time = timestamp();
+		cout << name << ":" << string(18 - strlen(name), ' ') << hex.size()*reps/(end_time - start_time)/1024.0/1024.0 << "MB/s" << endl;
+	}
 	cout << endl;
 }
 
@@ -64,6 +184,33 @@ int main(int argc, char *argv[]) {
 
 		cout << "multiple long rows (~1 GB):" << endl;
 		benchmark<string>(s, 1, 1024, 1);
+
+		cout << endl;
+
+		cout << "decoding many narrow rows (~100 KB):" << endl;
+		benchmark_decode<int32_t>(2147483647, 2, 10000);
+
+		cout << "decoding many wide rows (~2.4 MB):" << endl;
+		benchmark_decode<string>("b104829e-3f9f-11e9-b6f7-f2189827a7e0", 60, 1000);
+
+		cout << "escaping and encoding short values (~36 B):" << endl;
+		benchmark_kernels("b104829e-3f9f-11e9-b6f7-f2189827a7e0", 1000000);
+
+		cout << "escaping and encoding long text values (~1 MB):" << endl;
+		string text;
+		while (text.size() < 1024*1024) text += "The quick brown fox jumps over the lazy dog, and it's not sorry. ";
+		benchmark_kernels(text, 100);
+
+		cout << "parsing integers:" << endl;
+		vector<string> integers;
+		for (int64_t n = 1; n < 1000000000000000000LL; n = n*7 + 3) integers.push_back(to_string(n % 2 ? n : -n));
+		benchmark_integer_parsing(integers, 100000);
+
+		cout << "decoding hex values (~1 MB):" << endl;
+		string hex;
+		while (hex.size() < 1024*1024) hex += "0123456789abcdefABCDEF";
+		hex.resize(1024*1024);
+		benchmark_hex_decoding(hex, 100);
 	} catch (const exception &e) {
 		cerr << e.what() << endl;
 	}
@@ -0,0 +1,166 @@
+#include "../../catch2/catch.hpp"
+
+#include "../src/local_row_cache.h"
+#include "../src/row_serialization.h"
+
+struct DatabaseTestRow {
+	DatabaseTestRow(int64_t id, const string &value): id(id), value(value) {}
+
+	inline size_t n_columns() const { return 2; }
+
+	template <typename Packer>
+	inline void pack_column_into(Packer &packer, size_t column_number) const {
+		if (column_number == 0) {
+			packer << id;
+		} else {
+			packer << value;
+		}
+	}
+
+	int64_t id;
+	string value;
+};
+
+static vector<size_t> primary_key_columns{0};
+
+static ColumnValues local_key_of(int64_t id) {
+	ColumnValues key;
+	Packer<ColumnValues> packer(key);
+	pack_array_length(packer, 1);
+	packer << id;
+	return key;
+}
+
+// reads rows first_id to last_id (inclusive) as if from the database, hashing them and keeping them
+static shared_ptr<LocalRows> local_rows_of(int64_t first_id, int64_t last_id, string *hash = nullptr, size_t max_bytes = DEFAULT_LOCAL_ROW_CACHE_BYTES) {
+	RowHasher hasher(HashAlgorithm::xxh64);
+	LocalRowCollector<RowHasher> collector(hasher, primary_key_columns, max_bytes);
+	for (int64_t id = first_id; id <= last_id; id++) {
+		collector(DatabaseTestRow(id, "row " + to_string(id)));
+	}
+	if (hash) *hash = hasher.finish().to_string();
+	return collector.local_rows;
+}
+
+static string hash_of_local_rows(const LocalRowsRange &range) {
+	RowHasher hasher(HashAlgorithm::xxh64);
+	for (size_t n = 0; n < range.row_count; n++) {
+		hasher(range[n]);
+	}
+	return hasher.finish().to_string();
+}
+
+TEST_CASE("local rows", "[hashing]") {
+	string hash;
+	shared_ptr<LocalRows> rows(local_rows_of(1, 10, &hash));
+	REQUIRE(rows->size() == 10);
+	REQUIRE(rows->keys[3] == local_key_of(4));
+
+	// the kept rows give the same hash as the rows they were read from
+	REQUIRE(hash_of_local_rows(LocalRowsRange(rows, 0, 10)) == hash);
+
+	string part_hash;
+	local_rows_of(3, 7, &part_hash);
+	REQUIRE(hash_of_local_rows(LocalRowsRange(rows, 2, 5)) == part_hash);
+
+	PackedRow row;
+	rows->copy_row_to(row, 4);
+	REQUIRE(row.size() == 2);
+	PackedRow expected;
+	DatabaseTestRow database_row(5, "row 5");
+	pack_row_into(expected, database_row);
+	REQUIRE(row == expected);
+
+	// rows aren't kept once they add up to more than the limit
+	REQUIRE(local_rows_of(1, 10, nullptr, rows->memory_used() - 1)->size() == 0);
+	REQUIRE(local_rows_of(1, 10, nullptr, rows->memory_used())->size() == 10);
+}
+
+TEST_CASE("local row cache lookups", "[hashing]") {
+	LocalRowCache cache;
+	LocalRowsRange range;
+	cache.add(local_key_of(0), local_key_of(100), 1000, local_rows_of(1, 10));
+
+	// ranges ending on one of the rows
+	REQUIRE(cache.find(local_key_of(0), local_key_of(5), 1000, range));
+	REQUIRE(range.first_row == 0);
+	REQUIRE(range.row_count == 5);
+
+	REQUIRE(cache.find(local_key_of(5), local_key_of(100), 1000, range));
+	REQUIRE(range.first_row == 5);
+	REQUIRE(range.row_count == 5);
+
+	// ranges starting or ending between rows we don't have can't be found
+	REQUIRE(!cache.find(local_key_of(50), local_key_of(100), 1000, range));
+	REQUIRE(!cache.find(local_key_of(0), local_key_of(50), 1000, range));
+	REQUIRE(cache.stats.hash_hits == 2);
+	REQUIRE(cache.stats.hash_misses == 2);
+
+	// incomplete ranges only have the rows up to where we stopped reading
+	cache.add(local_key_of(100), local_key_of(200), 5, local_rows_of(101, 105));
+	REQUIRE(cache.find(local_key_of(100), local_key_of(200), 3, range));
+	REQUIRE(range.row_count == 3);
+	REQUIRE(!cache.find(local_key_of(102), local_key_of(200), 5, range));
+}
+
+TEST_CASE("local row cache takes", "[hashing]") {
+	LocalRowCache cache;
+	LocalRowsRange range;
+	cache.add(local_key_of(0), local_key_of(100), 1000, local_rows_of(1, 10));
+	cache.add(local_key_of(100), local_key_of(200), 1000, local_rows_of(101, 110));
+
+	REQUIRE(cache.take(local_key_of(3), local_key_of(6), range));
+	REQUIRE(range.first_row == 3);
+	REQUIRE(range.row_count == 3);
+	REQUIRE(cache.stats.apply_hits == 1);
+
+	// the rows taken are gone, as are the other ranges, but we keep the rest of the range they were in
+	REQUIRE(!cache.find(local_key_of(3), local_key_of(6), 1000, range));
+	REQUIRE(!cache.find(local_key_of(100), local_key_of(200), 1000, range));
+	REQUIRE(cache.find(local_key_of(0), local_key_of(3), 1000, range));
+	REQUIRE(range.first_row == 0);
+	REQUIRE(range.row_count == 3);
+	REQUIRE(cache.find(local_key_of(6), local_key_of(100), 1000, range));
+	REQUIRE(range.first_row == 6);
+	REQUIRE(range.row_count == 4);
+
+	// if we don't have the rows, we can't tell which ranges overlap, so we keep nothing
+	REQUIRE(!cache.take(local_key_of(50), local_key_of(60), range));
+	REQUIRE(cache.stats.apply_misses == 1);
+	REQUIRE(!cache.find(local_key_of(0), local_key_of(3), 1000, range));
+}
+
+TEST_CASE("local row cache takes only the given worker's rows", "[hashing]") {
+	LocalRowCache cache;
+	LocalRowsRange range;
+	shared_ptr<LocalRows> rows(local_rows_of(1, 10));
+	rows->read_by_worker = 1;
+	cache.add(local_key_of(0), local_key_of(100), 1000, rows);
+
+	// another worker's rows may not show the changes we've made, so we don't use them, and they're discarded
+	REQUIRE(!cache.take(local_key_of(3), local_key_of(6), range, 2));
+	REQUIRE(cache.stats.apply_misses == 1);
+	REQUIRE(!cache.find(local_key_of(0), local_key_of(3), 1000, range));
+
+	cache.add(local_key_of(0), local_key_of(100), 1000, rows);
+	REQUIRE(cache.take(local_key_of(3), local_key_of(6), range, 1));
+	REQUIRE(range.row_count == 3);
+
+	cache.add(local_key_of(0), local_key_of(100), 1000, rows);
+	REQUIRE(cache.take(local_key_of(3), local_key_of(6), range, ANY_WORKER));
+	REQUIRE(cache.stats.apply_hits == 2);
+}
+
+TEST_CASE("local row cache eviction", "[hashing]") {
+	LocalRowCache cache(local_rows_of(1, 10)->memory_used() + local_rows_of(101, 110)->memory_used() + local_rows_of(201, 210)->memory_used() - 1);
+	LocalRowsRange range;
+
+	cache.add(local_key_of(0), local_key_of(100), 1000, local_rows_of(1, 10));
+	cache.add(local_key_of(100), local_key_of(200), 1000, local_rows_of(101, 110));
+	REQUIRE(cache.find(local_key_of(0), local_key_of(100), 1000, range)); // makes it the most recently used
+
+	cache.add(local_key_of(200), local_key_of(300), 1000, local_rows_of(201, 210));
+	REQUIRE(cache.find(local_key_of(0), local_key_of(100), 1000, range));
+	REQUIRE(!cache.find(local_key_of(100), local_key_of(200), 1000, range));
+	REQUIRE(cache.find(local_key_of(200), local_key_of(300), 1000, range));
+}
@@ -0,0 +1,128 @@
+#include "../../catch2/catch.hpp"
+
+#include "../src/logical_decoding.h"
+
+static DecodedChange parse(const string &data) {
+	DecodedChange change;
+	parse_test_decoding_change(data, change);
+	return change;
+}
+
+TEST_CASE("parsing decoded transactions", "[logical_decoding]") {
+	REQUIRE(parse("BEGIN 529").action == DecodedChangeAction::begin_transaction);
+	REQUIRE(parse("COMMIT 529").action == DecodedChangeAction::commit_transaction);
+	REQUIRE(parse("message: transactional: 1 prefix: test, sz: 4 content:test").action == DecodedChangeAction::other);
+}
+
+TEST_CASE("parsing decoded inserts", "[logical_decoding]") {
+	DecodedChange change(parse("table public.footbl: INSERT: col1[integer]:2 another_col[smallint]:null col3[character varying]:'it''s a test'"));
+	REQUIRE(change.action == DecodedChangeAction::insert_row);
+	REQUIRE(change.tables.size() == 1);
+	REQUIRE(change.tables[0] == DecodedTableName("public", "footbl"));
+	REQUIRE(change.new_tuple.size() == 3);
+	REQUIRE(change.new_tuple[0].name == "col1");
+	REQUIRE(change.new_tuple[0].type == "integer");
+	REQUIRE(change.new_tuple[0].literal == "2");
+	REQUIRE(change.new_tuple[1].null);
+	REQUIRE(change.new_tuple[2].type == "character varying");
+	REQUIRE(change.new_tuple[2].literal == "'it''s a test'");
+	REQUIRE(!change.new_tuple[2].null);
+
+	change = parse("table \"Some Schema\".\"Mixed\"\"Case\": INSERT: \"Id\"[integer[]]:'{1,2}' flags[bit(4)]:B'0101' text[text]:'spaces '' and ]: chars'");
+	REQUIRE(change.tables[0] == DecodedTableName("Some Schema", "Mixed\"Case"));
+	REQUIRE(change.new_tuple.size() == 3);
+	REQUIRE(change.new_tuple[0].name == "Id");
+	REQUIRE(change.new_tuple[0].type == "integer[]");
+	REQUIRE(change.new_tuple[0].literal == "'{1,2}'");
+	REQUIRE(change.new_tuple[1].literal == "B'0101'");
+	REQUIRE(change.new_tuple[2].literal == "'spaces '' and ]: chars'");
+
+	change = parse("table public.footbl: INSERT: (no-tuple-data)");
+	REQUIRE(change.no_tuple_data);
+}
+
+TEST_CASE("parsing decoded updates and deletes", "[logical_decoding]") {
+	DecodedChange change(parse("table public.footbl: UPDATE: col1[integer]:2 col3[text]:unchanged-toast-datum"));
+	REQUIRE(change.action == DecodedChangeAction::update_row);
+	REQUIRE(change.old_key.empty());
+	REQUIRE(change.new_tuple.size() == 2);
+	REQUIRE(change.new_tuple[1].unchanged_toast);
+
+	change = parse("table public.footbl: UPDATE: old-key: col1[integer]:2 new-tuple: col1[integer]:3 col3[text]:'x'");
+	REQUIRE(change.old_key.size() == 1);
+	REQUIRE(change.old_key[0].literal == "2");
+	REQUIRE(change.new_tuple.size() == 2);
+	REQUIRE(change.new_tuple[0].literal == "3");
+
+	change = parse("table public.footbl: DELETE: col1[integer]:3");
+	REQUIRE(change.action == DecodedChangeAction::delete_row);
+	REQUIRE(change.old_key.size() == 1);
+	REQUIRE(change.new_tuple.empty());
+
+	change = parse("table public.footbl: DELETE: (no-tuple-data)");
+	REQUIRE(change.no_tuple_data);
+
+	change = parse("table public.footbl, other.secondtbl: TRUNCATE: restart_seqs cascade");
+	REQUIRE(change.action == DecodedChangeAction::truncate_tables);
+	REQUIRE(change.tables.size() == 2);
+	REQUIRE(change.tables[1] == DecodedTableName("other", "secondtbl"));
+
+	REQUIRE_THROWS_AS(parse("table public.footbl: UPSERT: col1[integer]:3"), logical_decoding_error);
+}
+
+TEST_CASE("transaction snapshot visibility", "[logical_decoding]") {
+	TxidSnapshot snapshot("100:105:100,103");
+	REQUIRE(snapshot.visible(99));
+	REQUIRE(!snapshot.visible(100));
+	REQUIRE(snapshot.visible(101));
+	REQUIRE(!snapshot.visible(103));
+	REQUIRE(snapshot.visible(104));
+	REQUIRE(!snapshot.visible(105));
+	REQUIRE(!snapshot.visible(200));
+
+	// the 32-bit IDs given in the changes wrap around
+	TxidSnapshot wrapped_snapshot(to_string((1ULL << 32) + 10) + ":" + to_string((1ULL << 32) + 10) + ":");
+	REQUIRE(wrapped_snapshot.in_progress.empty());
+	REQUIRE(wrapped_snapshot.visible(9));
+	REQUIRE(wrapped_snapshot.visible(4294967295U));
+	REQUIRE(!wrapped_snapshot.visible(10));
+}
+
+TEST_CASE("collecting changed keys", "[logical_decoding]") {
+	Table table("", "footbl");
+	table.columns.resize(2);
+	table.columns[0].name = "col1";
+	table.columns[1].name = "col3";
+	table.primary_key_columns.push_back(0);
+	table.primary_key_type = PrimaryKeyType::explicit_primary_key;
+	Table unkeyed_table("", "misctbl");
+	unkeyed_table.primary_key_type = PrimaryKeyType::entire_row_as_key;
+
+	map<DecodedTableName, const Table *> tables_by_name;
+	tables_by_name[DecodedTableName("public", "footbl")] = &table;
+	tables_by_name[DecodedTableName("public", "misctbl")] = &unkeyed_table;
+	TxidSnapshot snapshot("100:105:103");
+	LogicalChangesCollector collector(tables_by_name, snapshot);
+
+	collector.add("0/1", 101, "BEGIN 101");
+	collector.add("0/2", 101, "table public.footbl: INSERT: col1[integer]:2 col3[text]:'a'");
+	collector.add("0/3", 101, "table public.footbl: UPDATE: old-key: col1[integer]:4 new-tuple: col1[integer]:5 col3[text]:'b'");
+	collector.add("0/4", 101, "table public.othertbl: DELETE: id[integer]:1");
+	collector.add("0/5", 101, "table public.misctbl: INSERT: x[integer]:1");
+	collector.add("0/6", 101, "COMMIT 101");
+	collector.add("0/7", 102, "BEGIN 102");
+	collector.add("0/8", 102, "table public.footbl: DELETE: col1[integer]:2");
+	collector.add("0/9", 102, "COMMIT 102");
+	collector.add("0/A", 103, "BEGIN 103"); // still in progress as far as our snapshot is concerned
+	collector.add("0/B", 103, "table public.footbl: DELETE: col1[integer]:9");
+	collector.add("0/C", 103, "COMMIT 103");
+
+	REQUIRE(collector.stopped);
+	REQUIRE(collector.changes_read == 12);
+	REQUIRE(collector.upto_lsn == "0/9");
+	REQUIRE(collector.keys_by_table.size() == 1);
+	REQUIRE(collector.keys_by_table["footbl"] == set<vector<string>>{{"'2'::integer"}, {"'4'::integer"}, {"'5'::integer"}});
+	REQUIRE(collector.tables_to_reload == set<string>{"misctbl"});
+
+	REQUIRE(changed_keys_sql(collector.keys_by_table["footbl"]) == "SELECT DISTINCT * FROM (VALUES ('2'::integer), ('4'::integer), ('5'::integer)) AS changed_keys ORDER BY 1");
+}
@@ -0,0 +1,132 @@
+#include "../../catch2/catch.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+#include "../src/fdstream.h"
+#include "../src/message_pack/pack.h"
+#include "../src/message_pack/packed_row.h"
+#include "../src/message_pack/packed_row_view.h"
+
+PackedValue packed_string(const string &str) {
+	PackedValue value;
+	Packer<PackedValue> packer(value);
+	packer << str;
+	return value;
+}
+
+TEST_CASE("values longer than the inline buffer", "[packed_buffer]") {
+	string str(1000, 'x');
+	PackedValue value(packed_string(str));
+	REQUIRE(value.encoded_size() == str.size() + 3);
+
+	PackedValue copy(value);
+	REQUIRE(copy == value);
+
+	PackedValue moved(std::move(copy));
+	REQUIRE(moved == value);
+	REQUIRE(copy.encoded_size() == 0);
+}
+
+TEST_CASE("clearing and reusing values", "[packed_buffer]") {
+	PackedValue value(packed_string(string(100, 'a')));
+	value.clear();
+	REQUIRE(value.encoded_size() == 0);
+
+	Packer<PackedValue> packer(value);
+	packer << string("short");
+	REQUIRE(value == packed_string("short"));
+
+	value.clear();
+	packer << string(200, 'b');
+	REQUIRE(value == packed_string(string(200, 'b')));
+}
+
+TEST_CASE("rows using an arena", "[packed_buffer]") {
+	PackedArena arena;
+	PackedRow row{packed_string("short"), packed_string(string(100, 'a')), packed_string(string(PackedArena::MAX_SIZE_TO_BUMP_ALLOCATE + 1, 'b'))};
+
+	PackedRow arena_row;
+	copy_row_using_arena(arena_row, row, arena);
+	REQUIRE(arena_row == row);
+
+	// moving out to a value that doesn't use the arena must copy rather than take the arena's memory
+	PackedValue heap_value;
+	heap_value = std::move(arena_row[1]);
+	REQUIRE(heap_value == row[1]);
+
+	arena_row.clear();
+	arena.reset();
+	REQUIRE(heap_value == row[1]);
+
+	copy_row_using_arena(arena_row, row, arena);
+	REQUIRE(arena_row == row);
+}
+
+TEST_CASE("reading rows into the same row object", "[packed_buffer]") {
+	PackedValue stream;
+	Packer<PackedValue> packer(stream);
+	pack_array_length(packer, 2);
+	packer << string(50, 'a') << 1;
+	pack_array_length(packer, 2);
+	packer << string("b") << string(60, 'c');
+	pack_array_length(packer, 0);
+
+	PackedValueReadStream read_stream(stream);
+	Unpacker<PackedValueReadStream> unpacker(read_stream);
+	PackedRow row;
+
+	unpacker >> row;
+	REQUIRE(row.size() == 2);
+	REQUIRE(row[0] == packed_string(string(50, 'a')));
+
+	unpacker >> row;
+	REQUIRE(row.size() == 2);
+	REQUIRE(row[0] == packed_string("b"));
+	REQUIRE(row[1] == packed_string(string(60, 'c')));
+
+	unpacker >> row;
+	REQUIRE(row.size() == 0);
+}
+
+TEST_CASE("reading row views that span and outgrow the stream buffer", "[packed_buffer]") {
+	// the first row leaves the second straddling the end of the initial buffer, and the second is too big to fit in it anyway
+	string filler(FDReadStream::INITIAL_BUFFER_SIZE - 100, 'f');
+	string big(FDReadStream::INITIAL_BUFFER_SIZE*3, 'b');
+
+	PackedValue stream;
+	Packer<PackedValue> packer(stream);
+	pack_array_length(packer, 1);
+	packer << filler;
+	pack_array_length(packer, 3);
+	packer << 42 << big << string("after");
+	pack_array_length(packer, 0);
+
+	FILE *file = tmpfile();
+	REQUIRE(fwrite(stream.data(), 1, stream.encoded_size(), file) == stream.encoded_size());
+	fflush(file);
+	rewind(file);
+
+	FDReadStream read_stream(dup(fileno(file)));
+	Unpacker<FDReadStream> unpacker(read_stream);
+	PackedRowView row;
+
+	unpacker >> row;
+	REQUIRE(row.size() == 1);
+	REQUIRE(row[0].encoded_size() == packed_string(filler).encoded_size());
+	REQUIRE(memcmp(row[0].data(), packed_string(filler).data(), row[0].encoded_size()) == 0);
+
+	unpacker >> row;
+	REQUIRE(row.size() == 3);
+	PackedArena arena;
+	PackedRow copy;
+	copy_row_using_arena(copy, row, arena);
+	REQUIRE(copy[1] == packed_string(big));
+	REQUIRE(copy[2] == packed_string("after"));
+
+	unpacker >> row;
+	REQUIRE(row.size() == 0);
+	fclose(file);
+}
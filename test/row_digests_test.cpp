@@ -0,0 +1,122 @@
+#include "../../catch2/catch.hpp"
+
+#include "../src/row_digests.h"
+
+struct FakeRow {
+	FakeRow(int64_t id, const string &value): id(id), value(value) {}
+
+	inline size_t n_columns() const { return 2; }
+
+	template <typename Packer>
+	inline void pack_column_into(Packer &packer, size_t column_number) const {
+		if (column_number == 0) {
+			packer << id;
+		} else {
+			packer << value;
+		}
+	}
+
+	int64_t id;
+	string value;
+};
+
+ColumnValues key_of(int64_t id) {
+	ColumnValues key;
+	Packer<ColumnValues> packer(key);
+	pack_array_length(packer, 1);
+	packer << id;
+	return key;
+}
+
+// digests rows first_id to last_id (inclusive), as if they'd been read from the database
+RowDigests digests_of(int64_t first_id, int64_t last_id) {
+	vector<size_t> primary_key_columns{0};
+	RowDigester digester(primary_key_columns);
+	for (int64_t id = first_id; id <= last_id; id++) {
+		digester(FakeRow(id, "row " + to_string(id)));
+	}
+	return std::move(digester.row_digests);
+}
+
+string hash_of_rows(int64_t first_id, int64_t last_id) {
+	RowDigests row_digests(digests_of(first_id, last_id));
+	return row_digests.hash_of(0, row_digests.rows()).to_string();
+}
+
+TEST_CASE("row digests", "[hashing]") {
+	RowDigests row_digests(digests_of(1, 10));
+	REQUIRE(row_digests.rows() == 10);
+	REQUIRE(row_digests.digests.size() == 10*ROW_DIGEST_LENGTH);
+
+	// the range hash is the hash of the row digests, so any run of rows can be hashed again from the digests
+	REQUIRE(row_digests.hash_of(2, 5).to_string() == hash_of_rows(3, 7));
+	REQUIRE(row_digests.hash_of(2, 5).to_string() != hash_of_rows(3, 8));
+
+	RowDigestsRange range(row_digests, 2, 5);
+	REQUIRE(range.row_count == 5);
+	REQUIRE(range.last_key == key_of(7));
+	REQUIRE(range.size == row_digests.size_of(0, 7) - row_digests.size_of(0, 2));
+}
+
+TEST_CASE("row digest cache", "[hashing]") {
+	RowDigestCache cache(25);
+	RowDigestsRange range;
+
+	// a range of 10 rows from the start of the table, where the row count limit was hit, so there could be more rows
+	cache.add("footbl", ColumnValues(), key_of(100), 10, digests_of(1, 10));
+
+	SECTION("finds the first part of the range") {
+		REQUIRE(cache.find("footbl", ColumnValues(), key_of(10), 5, range));
+		REQUIRE(range.row_count == 5);
+		REQUIRE(range.last_key == key_of(5));
+		REQUIRE(range.hash.to_string() == hash_of_rows(1, 5));
+	}
+
+	SECTION("finds the remaining part of the range") {
+		REQUIRE(cache.find("footbl", key_of(5), key_of(10), 5, range));
+		REQUIRE(range.row_count == 5);
+		REQUIRE(range.last_key == key_of(10));
+		REQUIRE(range.hash.to_string() == hash_of_rows(6, 10));
+
+		REQUIRE(cache.find("footbl", key_of(5), key_of(10), 1000, range));
+		REQUIRE(range.row_count == 5);
+	}
+
+	SECTION("finds runs in the middle of the range") {
+		REQUIRE(cache.find("footbl", key_of(3), key_of(8), 2, range));
+		REQUIRE(range.row_count == 2);
+		REQUIRE(range.last_key == key_of(5));
+		REQUIRE(range.hash.to_string() == hash_of_rows(4, 5));
+	}
+
+	SECTION("doesn't find ranges that could include rows that weren't read") {
+		REQUIRE(!cache.find("footbl", key_of(5), key_of(100), 10, range));
+		REQUIRE(!cache.find("footbl", key_of(10), key_of(100), 10, range));
+		REQUIRE(cache.find("footbl", key_of(5), key_of(100), 5, range));
+		REQUIRE(range.hash.to_string() == hash_of_rows(6, 10));
+	}
+
+	SECTION("doesn't find ranges for other tables or with keys it doesn't have") {
+		REQUIRE(!cache.find("bartbl", ColumnValues(), key_of(5), 5, range));
+		REQUIRE(!cache.find("footbl", key_of(0), key_of(5), 5, range));
+		REQUIRE(!cache.find("footbl", ColumnValues(), key_of(11), 5, range));
+		REQUIRE(!cache.find("footbl", key_of(8), key_of(3), 5, range));
+	}
+
+	SECTION("finds the whole range if all the rows were read") {
+		cache.add("bartbl", key_of(10), key_of(20), 100, digests_of(11, 15));
+		REQUIRE(cache.find("bartbl", key_of(12), key_of(20), 100, range));
+		REQUIRE(range.row_count == 3);
+		REQUIRE(range.last_key == key_of(15));
+		REQUIRE(range.hash.to_string() == hash_of_rows(13, 15));
+	}
+
+	SECTION("discards the least recently used ranges when full") {
+		cache.add("bartbl", key_of(10), key_of(20), 100, digests_of(11, 20));
+		REQUIRE(cache.find("footbl", ColumnValues(), key_of(10), 5, range));
+		cache.add("baztbl", key_of(10), key_of(20), 100, digests_of(11, 20));
+		REQUIRE(cache.find("footbl", ColumnValues(), key_of(10), 5, range));
+		REQUIRE(!cache.find("bartbl", key_of(10), key_of(20), 100, range));
+		REQUIRE(cache.find("baztbl", key_of(10), key_of(20), 100, range));
+	}
+}
@@ -0,0 +1,59 @@
+#include "../../catch2/catch.hpp"
+
+#include <climits>
+
+#include "../src/row_encoder.h"
+#include "../src/message_pack/pack.h"
+
+struct FakeQuotingClient {
+	string &append_quoted_column_value_to(string &result, const Column &column, const char *value, size_t length) {
+		if (!column.values_need_quoting()) return result.append(value, length);
+		return result.append("'").append(value, length).append("'");
+	}
+
+	string &append_quoted_column_value_to(string &result, const Column &column, const string &value) {
+		return append_quoted_column_value_to(result, column, value.data(), value.size());
+	}
+};
+
+template <typename T>
+PackedValue packed(const T &obj) {
+	PackedValue value;
+	Packer<PackedValue> packer(value);
+	packer << obj;
+	return value;
+}
+
+template <typename T>
+string encoded(RowEncoder<FakeQuotingClient> &encoder, size_t column_number, const T &obj) {
+	string result;
+	encoder.append_value_to(result, column_number, packed(obj));
+	return result;
+}
+
+TEST_CASE("encoding values using the column encoders", "[row_encoder]") {
+	FakeQuotingClient client;
+	Columns columns(4);
+	columns[0].column_type = ColumnType::sint_64bit;
+	columns[1].column_type = ColumnType::text;
+	columns[2].column_type = ColumnType::decimal;
+	columns[3].column_type = ColumnType::boolean;
+	RowEncoder<FakeQuotingClient> encoder(client, columns);
+
+	REQUIRE(encoded(encoder, 0, 0) == "0");
+	REQUIRE(encoded(encoder, 0, 127) == "127");
+	REQUIRE(encoded(encoder, 0, -1) == "-1");
+	REQUIRE(encoded(encoder, 0, 255) == "255");
+	REQUIRE(encoded(encoder, 0, -32768) == "-32768");
+	REQUIRE(encoded(encoder, 0, (int64_t)LLONG_MIN) == "-9223372036854775808");
+	REQUIRE(encoded(encoder, 0, (uint64_t)ULLONG_MAX) == "18446744073709551615");
+	REQUIRE(encoded(encoder, 0, nullptr) == "NULL");
+
+	REQUIRE(encoded(encoder, 1, string("short")) == "'short'");
+	REQUIRE(encoded(encoder, 1, string(300, 'x')) == "'" + string(300, 'x') + "'");
+	REQUIRE(encoded(encoder, 1, string()) == "''");
+	REQUIRE(encoded(encoder, 1, nullptr) == "NULL");
+
+	REQUIRE(encoded(encoder, 2, string("12.34")) == "12.34");
+	REQUIRE(encoded(encoder, 3, true) == "true");
+}
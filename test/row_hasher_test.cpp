@@ -0,0 +1,72 @@
+#include "../../catch2/catch.hpp"
+
+#include <random>
+
+#include "../src/row_serialization.h"
+
+string blake3_of(const string &data) {
+	blake3_hasher hasher;
+	blake3_hasher_init(&hasher);
+	blake3_hasher_update(&hasher, data.data(), data.size());
+	string result(BLAKE3_OUT_LEN, '\0');
+	blake3_hasher_finalize(&hasher, (uint8_t *)&result[0], BLAKE3_OUT_LEN);
+	return result;
+}
+
+string hashed_in_pieces(const string &data, size_t piece_size, HashThreadPool *thread_pool) {
+	RowHasher hasher(HashAlgorithm::blake3, thread_pool);
+	for (size_t offset = 0; offset < data.size(); offset += piece_size) {
+		hasher.write((const uint8_t *)data.data() + offset, min(piece_size, data.size() - offset));
+	}
+	const Hash &hash(hasher.finish());
+	return string((const char *)hash.md_value, hash.md_len);
+}
+
+TEST_CASE("hashing with BLAKE3 using multiple threads", "[hashing]") {
+	mt19937 generator(42);
+	uniform_int_distribution<int> bytes(0, 255);
+
+	HashThreadPool single_thread(1), two_threads(2), four_threads(4);
+
+	// sizes around the buffer size used without threads and the subtree size, and around batches of subtrees for each
+	// of the thread pools, which are the points where the hasher starts handing off work
+	for (size_t length : {
+			(size_t)0, (size_t)1, (size_t)BLAKE3_CHUNK_LEN, (size_t)BLAKE3_PENDING_SIZE, (size_t)BLAKE3_PENDING_SIZE + 1,
+			(size_t)BLAKE3_SUBTREE_SIZE, (size_t)2*BLAKE3_SUBTREE_SIZE, (size_t)2*BLAKE3_SUBTREE_SIZE + 1,
+			(size_t)4*BLAKE3_SUBTREE_SIZE, (size_t)4*BLAKE3_SUBTREE_SIZE + 1, (size_t)13*BLAKE3_SUBTREE_SIZE + 12345}) {
+		string data;
+		data.reserve(length);
+		for (size_t n = 0; n < length; n++) data += (char)bytes(generator);
+		string expected(blake3_of(data));
+
+		INFO(length);
+		for (size_t piece_size : {(size_t)7, (size_t)4096, (size_t)3*BLAKE3_SUBTREE_SIZE}) {
+			INFO(piece_size);
+			REQUIRE(hashed_in_pieces(data, piece_size, nullptr) == expected);
+			REQUIRE(hashed_in_pieces(data, piece_size, &single_thread) == expected);
+			REQUIRE(hashed_in_pieces(data, piece_size, &two_threads) == expected);
+			REQUIRE(hashed_in_pieces(data, piece_size, &four_threads) == expected);
+		}
+	}
+}
+
+TEST_CASE("running tasks on a hash thread pool", "[hashing]") {
+	HashThreadPool thread_pool(3);
+	REQUIRE(thread_pool.size() == 3);
+
+	// several callers at once, as when there are multiple workers
+	vector<thread> callers;
+	vector<vector<int>> results(4);
+	for (size_t caller = 0; caller < results.size(); caller++) {
+		callers.emplace_back([&, caller]() {
+			for (int round = 0; round < 100; round++) {
+				results[caller].assign(17, 0);
+				thread_pool.run(results[caller].size(), [&](size_t task) { results[caller][task] += task + 1; });
+				for (size_t task = 0; task < results[caller].size(); task++) {
+					if (results[caller][task] != (int)task + 1) throw logic_error("task not run exactly once");
+				}
+			}
+		});
+	}
+	for (thread &caller : callers) caller.join();
+}
@@ -0,0 +1,35 @@
+#include "../../catch2/catch.hpp"
+
+#include "../src/sample_budget.h"
+
+TEST_CASE("parsing sample budgets", "[sample_budget]") {
+	SECTION("percentages of the table") {
+		REQUIRE(parse_sample_budget("1%") == SampleBudget(SampleBudget::fraction, 0.01));
+		REQUIRE(parse_sample_budget("100%") == SampleBudget(SampleBudget::fraction, 1));
+		REQUIRE_THROWS_AS(parse_sample_budget("101%"), invalid_argument);
+	}
+
+	SECTION("seconds") {
+		REQUIRE(parse_sample_budget("30s") == SampleBudget(SampleBudget::seconds, 30));
+		REQUIRE(parse_sample_budget("0.5s") == SampleBudget(SampleBudget::seconds, 0.5));
+	}
+
+	SECTION("bytes") {
+		REQUIRE(parse_sample_budget("512B") == SampleBudget(SampleBudget::bytes, 512));
+		REQUIRE(parse_sample_budget("64KB") == SampleBudget(SampleBudget::bytes, 64*1024));
+		REQUIRE(parse_sample_budget("100MB") == SampleBudget(SampleBudget::bytes, 100*1024*1024));
+		REQUIRE(parse_sample_budget("2GB") == SampleBudget(SampleBudget::bytes, 2.0*1024*1024*1024));
+	}
+
+	SECTION("no budget") {
+		REQUIRE(!parse_sample_budget("").given());
+	}
+
+	SECTION("invalid budgets") {
+		REQUIRE_THROWS_AS(parse_sample_budget("10"), invalid_argument);
+		REQUIRE_THROWS_AS(parse_sample_budget("10 minutes"), invalid_argument);
+		REQUIRE_THROWS_AS(parse_sample_budget("0s"), invalid_argument);
+		REQUIRE_THROWS_AS(parse_sample_budget("-5%"), invalid_argument);
+		REQUIRE_THROWS_AS(parse_sample_budget("MB"), invalid_argument);
+	}
+}
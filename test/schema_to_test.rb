@@ -116,6 +116,21 @@ class SchemaToTest < KitchenSync::EndpointTestCase
     assert_equal %w(footbl middletbl secondtbl), connection.tables
   end
 
+  test_each "creates non-unique keys on new tables after loading their data if requested" do
+    clear_schema
+    program_env['ENDPOINT_DEFER_INDEXES'] = '1'
+    program_env['ENDPOINT_COMMIT_LEVEL'] = '4'
+
+    expect_handshake_commands(schema: {"tables" => [secondtbl_def]})
+    expect_command Commands::RANGE, ["secondtbl"]
+    assert_equal %w(secondtbl), connection.tables
+    assert_equal [], connection.table_keys("secondtbl")
+
+    send_command   Commands::RANGE, ["secondtbl", [], []]
+    expect_quit_and_close
+    assert_same_keys(secondtbl_def)
+  end
+
   test_each "drops extra tables before other tables" do
     clear_schema
     create_footbl
@@ -0,0 +1,52 @@
+require File.expand_path(File.join(File.dirname(__FILE__), 'test_helper'))
+
+class SplitFromTest < KitchenSync::EndpointTestCase
+  include TestTableSchemas
+
+  def from_or_to
+    :from
+  end
+
+  test_each "returns no split keys if the table is empty" do
+    create_some_tables
+    send_handshake_commands
+
+    send_command   Commands::SPLIT, ["footbl", [], [], 4, 1]
+    expect_command Commands::SPLIT,
+                   ["footbl", [], [], []]
+  end
+
+  test_each "returns no split keys if there are no more rows than the minimum chunk size" do
+    create_some_tables
+    execute "INSERT INTO footbl VALUES (2, 10, 'test'), (4, NULL, 'foo'), (5, NULL, NULL), (8, -1, 'longer str')"
+    send_handshake_commands
+
+    send_command   Commands::SPLIT, ["footbl", [], [8], 4, 4]
+    expect_command Commands::SPLIT,
+                   ["footbl", [], [8], []]
+  end
+
+  test_each "returns the keys that divide the range into the requested number of chunks" do
+    create_some_tables
+    execute "INSERT INTO footbl VALUES (2, 10, 'test'), (4, NULL, 'foo'), (5, NULL, NULL), (8, -1, 'longer str'), (100, 0, 'a'), (101, 0, 'b')"
+    send_handshake_commands
+
+    send_command   Commands::SPLIT, ["footbl", [], [101], 3, 1]
+    expect_command Commands::SPLIT,
+                   ["footbl", [], [101], [[4], [8]]]
+
+    send_command   Commands::SPLIT, ["footbl", [2], [100], 2, 1]
+    expect_command Commands::SPLIT,
+                   ["footbl", [2], [100], [[5]]]
+  end
+
+  test_each "supports composite keys" do
+    create_some_tables
+    execute "INSERT INTO secondtbl VALUES (2, 2349174, 'xy', 1), (9, 968116383, 'aa', 9), (100, 100, 'aa', 100), (340, 363401169, 'ab', 20)"
+    send_handshake_commands
+
+    send_command   Commands::SPLIT, ["secondtbl", [], ["xy", 2349174], 2, 1]
+    expect_command Commands::SPLIT,
+                   ["secondtbl", [], ["xy", 2349174], [["aa", 968116383]]]
+  end
+end
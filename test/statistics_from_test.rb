@@ -0,0 +1,43 @@
+require File.expand_path(File.join(File.dirname(__FILE__), 'test_helper'))
+
+class StatisticsFromTest < KitchenSync::EndpointTestCase
+  include TestTableSchemas
+
+  def from_or_to
+    :from
+  end
+
+  def send_commands_before_snapshot
+    send_protocol_command(LATEST_PROTOCOL_VERSION_SUPPORTED)
+    send_hash_algorithm_command(HashAlgorithm::BLAKE3)
+  end
+
+  def read_statistics
+    send_command Commands::STATISTICS
+    verb, (table_statistics, _) = read_command
+    assert_equal Commands::STATISTICS, verb
+    table_statistics
+  end
+
+  test_each "returns a string for each table from its write counters", only: :postgresql do
+    create_some_tables
+    execute "INSERT INTO footbl VALUES (2, 10, 'test'), (4, NULL, 'foo')"
+    send_commands_before_snapshot
+
+    table_statistics = read_statistics
+    assert_equal %w(footbl secondtbl), table_statistics.keys.sort
+    assert table_statistics.values.none?(&:empty?)
+  end
+
+  test_each "returns different statistics for tables that have been truncated", only: :postgresql do
+    create_some_tables
+    execute "INSERT INTO footbl VALUES (2, 10, 'test'), (4, NULL, 'foo')"
+    send_commands_before_snapshot
+
+    before = read_statistics
+    execute "TRUNCATE footbl"
+    after = read_statistics
+    refute_equal before["footbl"], after["footbl"]
+    assert_equal before["secondtbl"], after["secondtbl"]
+  end
+end
@@ -0,0 +1,78 @@
+#include "../../catch2/catch.hpp"
+
+#include "../src/sync_journal.h"
+
+static ColumnValues journal_key_of(int64_t id) {
+	ColumnValues key;
+	Packer<ColumnValues> packer(key);
+	pack_array_length(packer, 1);
+	packer << id;
+	return key;
+}
+
+static KeyRange journal_range_of(int64_t prev_id, int64_t last_id) {
+	return KeyRange(prev_id ? journal_key_of(prev_id) : ColumnValues(), journal_key_of(last_id));
+}
+
+TEST_CASE("joining journaled key ranges", "[sync_journal]") {
+	SECTION("ranges that carry on from each other are joined, in any order") {
+		vector<KeyRange> joined(join_key_ranges({journal_range_of(10, 20), journal_range_of(0, 10), journal_range_of(20, 30)}));
+		REQUIRE(joined.size() == 1);
+		REQUIRE(joined[0] == journal_range_of(0, 30));
+	}
+
+	SECTION("ranges with gaps between them are kept separate") {
+		vector<KeyRange> joined(join_key_ranges({journal_range_of(0, 10), journal_range_of(20, 30), journal_range_of(30, 40)}));
+		sort(joined.begin(), joined.end());
+		REQUIRE(joined.size() == 2);
+		REQUIRE(find(joined.begin(), joined.end(), journal_range_of(0, 10)) != joined.end());
+		REQUIRE(find(joined.begin(), joined.end(), journal_range_of(20, 40)) != joined.end());
+	}
+
+	SECTION("no ranges") {
+		REQUIRE(join_key_ranges({}).empty());
+	}
+}
+
+TEST_CASE("resuming from a journal", "[sync_journal]") {
+	string journal_file("/tmp/ks_sync_journal_test." + to_string(getpid()));
+
+	{
+		SyncJournal journal;
+		journal.open(journal_file, false);
+		REQUIRE(journal.enabled());
+		journal.record_range("footbl", journal_range_of(0, 10), false);
+		journal.record_range("footbl", journal_range_of(10, 20), true);
+		journal.record_table_finished("secondtbl");
+	}
+
+	{
+		// simulate being killed partway through writing a line
+		ofstream out(journal_file, ios::app);
+		out << "range\tfootbl\t9101";
+	}
+
+	SECTION("the finished ranges and tables are read back") {
+		SyncJournal journal;
+		journal.open(journal_file, true);
+		REQUIRE(journal.table_finished("secondtbl"));
+		REQUIRE(!journal.table_finished("footbl"));
+		REQUIRE(journal.ranges_finished("footbl") == vector<KeyRange>{journal_range_of(0, 10), journal_range_of(10, 20)});
+		REQUIRE(journal.ranges_finished("secondtbl").empty());
+		journal.remove();
+	}
+
+	SECTION("the journal is started afresh if not resuming") {
+		SyncJournal journal;
+		journal.open(journal_file, false);
+		REQUIRE(!journal.table_finished("secondtbl"));
+		REQUIRE(journal.ranges_finished("footbl").empty());
+		journal.remove();
+	}
+
+	SECTION("journaling is disabled if no file is given") {
+		SyncJournal journal;
+		REQUIRE(!journal.enabled());
+		::remove(journal_file.c_str());
+	}
+}
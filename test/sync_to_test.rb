@@ -1,5 +1,8 @@
 require File.expand_path(File.join(File.dirname(__FILE__), 'test_helper'))
 
+require 'json'
+require 'tempfile'
+
 class SyncToTest < KitchenSync::EndpointTestCase
   include TestTableSchemas
 
@@ -23,6 +26,20 @@ class SyncToTest < KitchenSync::EndpointTestCase
     @keys = @rows.collect {|row| [row[0]]}
   end
 
+  def with_report_file
+    report_file = Tempfile.new('report')
+    report_file.close
+    program_env['ENDPOINT_REPORT_FILE'] = report_file.path
+    yield report_file.path
+  ensure
+    report_file.unlink
+  end
+
+  def read_report(path)
+    spawner.wait # the report file is closed after the connection is closed
+    File.readlines(path).collect {|line| JSON.parse(line)}
+  end
+
   test_each "it immediately requests the key range, and finishes without needing to make any changes if the table is empty at both ends" do
     clear_schema
     create_footbl
@@ -49,6 +66,43 @@ class SyncToTest < KitchenSync::EndpointTestCase
                  query("SELECT * FROM footbl ORDER BY col1")
   end
 
+  test_each "truncates the table if it is empty at the 'from' end and we're committing as we go" do
+    clear_schema
+    setup_with_footbl
+    program_env['ENDPOINT_COMMIT_LEVEL'] = '4'
+
+    expect_handshake_commands(schema: {"tables" => [footbl_def]})
+    expect_command Commands::RANGE, ["footbl"]
+    send_command   Commands::RANGE, ["footbl", [], []]
+    expect_quit_and_close
+
+    assert_equal [],
+                 query("SELECT * FROM footbl ORDER BY col1")
+  end
+
+  test_each "clears rows outside the key range at the 'from' end in chunks if we're committing as we go" do
+    clear_schema
+    create_footbl
+    execute "INSERT INTO footbl VALUES #{(1..25000).collect {|n| "(#{n}, NULL, NULL)"}.join(", ")}" # more than one chunk's worth
+    program_env['ENDPOINT_COMMIT_LEVEL'] = '4'
+
+    @rows = [[25001, 10, "test"],
+             [25002,  0, "last"]]
+
+    expect_handshake_commands(schema: {"tables" => [footbl_def]})
+    expect_command Commands::RANGE, ["footbl"]
+    send_command   Commands::RANGE, ["footbl", [25001], [25002]]
+    expect_command Commands::ROWS,
+                   ["footbl", [], [25002]]
+    send_results   Commands::ROWS,
+                   ["footbl", [], [25002]],
+                   *@rows
+    expect_quit_and_close
+
+    assert_equal @rows,
+                 query("SELECT * FROM footbl ORDER BY col1")
+  end
+
   test_each "it immediately requests the key range, and immediately asks for the rows if it is empty at the 'to' end but not the 'from' end" do
     clear_schema
     create_footbl
@@ -147,6 +201,46 @@ class SyncToTest < KitchenSync::EndpointTestCase
                  query("SELECT * FROM footbl ORDER BY col1")
   end
 
+  test_each "updates only the changed columns of rows, whichever columns have changed" do
+    setup_with_footbl
+    execute "UPDATE footbl SET col2 = 99 WHERE col1 = 2"
+    execute "UPDATE footbl SET col2 = 5, col3 = NULL WHERE col1 = 4"
+
+    expect_handshake_commands(schema: {"tables" => [footbl_def]})
+    expect_command Commands::RANGE, ["footbl"]
+    send_command   Commands::RANGE, ["footbl", @keys[0], @keys[-1]]
+    expect_command Commands::HASH, ["footbl", [], @keys[6], 1]
+    send_command   Commands::HASH, ["footbl", [], @keys[6], 1, 1, hash_of(@rows[0..0])]
+    expect_command Commands::HASH, ["footbl", @keys[6], @keys[8], 1]
+    send_command   Commands::HASH, ["footbl", @keys[6], @keys[8], 1, 1, hash_of(@rows[7..7])]
+    expect_command Commands::ROWS,
+                   ["footbl", [], @keys[0]]
+    send_results   Commands::ROWS,
+                   ["footbl", [], @keys[0]],
+                   @rows[0]
+    expect_command Commands::HASH, ["footbl", @keys[0], @keys[4], 1]
+    send_command   Commands::HASH, ["footbl", @keys[0], @keys[4], 1, 1, hash_of(@rows[1..1])]
+    expect_command Commands::HASH, ["footbl", @keys[4], @keys[6], 1]
+    send_command   Commands::HASH, ["footbl", @keys[4], @keys[6], 1, 1, hash_of(@rows[5..5])]
+    expect_command Commands::ROWS,
+                   ["footbl", @keys[0], @keys[1]]
+    send_results   Commands::ROWS,
+                   ["footbl", @keys[0], @keys[1]],
+                   @rows[1]
+    expect_command Commands::HASH, ["footbl", @keys[1], @keys[4], 1]
+    send_command   Commands::HASH, ["footbl", @keys[1], @keys[4], 1, 1, hash_of(@rows[2..2])]
+    expect_command Commands::HASH, ["footbl", @keys[5], @keys[6], 2]
+    send_command   Commands::HASH, ["footbl", @keys[5], @keys[6], 2, 1, hash_of(@rows[6..6])]
+    expect_command Commands::HASH, ["footbl", @keys[2], @keys[4], 2]
+    send_command   Commands::HASH, ["footbl", @keys[2], @keys[4], 2, 2, hash_of(@rows[3..4])]
+    expect_command Commands::HASH, ["footbl", @keys[7], @keys[8], 2]
+    send_command   Commands::HASH, ["footbl", @keys[7], @keys[8], 2, 1, hash_of(@rows[8..8])]
+    expect_quit_and_close
+
+    assert_equal @rows,
+                 query("SELECT * FROM footbl ORDER BY col1")
+  end
+
   test_each "reduces the search range and tries again if we send a different hash for multiple rows" do
     setup_with_footbl
     execute "UPDATE footbl SET col3 = 'different' WHERE col1 = 301"
@@ -429,6 +523,587 @@ class SyncToTest < KitchenSync::EndpointTestCase
                  query("SELECT * FROM secondtbl ORDER BY pri2, pri1")
   end
 
+  test_each "removes runs of consecutive rows that the 'from' end doesn't have using key ranges" do
+    clear_schema
+    create_secondtbl
+    execute "INSERT INTO secondtbl VALUES (100, 1, 'aa', 1), (200, 2, 'aa', 2), (300, 3, 'aa', 3)"
+    program_env['ENDPOINT_TARGET_MINIMUM_BLOCK_SIZE'] = '1000' # so that we retrieve the mismatching range without narrowing it down row by row
+
+    @rows = [[100, 1, "aa", 1],
+             [400, 4, "aa", 4]]
+    @keys = [["aa", 1], ["aa", 2], ["aa", 3], ["aa", 4]]
+
+    expect_handshake_commands(schema: {"tables" => [secondtbl_def]})
+    expect_command Commands::RANGE, ["secondtbl"]
+    send_command   Commands::RANGE, ["secondtbl", @keys[0], @keys[3]]
+    expect_command Commands::ROWS, ["secondtbl", @keys[2], @keys[3]]
+    send_results   Commands::ROWS,
+                   ["secondtbl", @keys[2], @keys[3]],
+                   @rows[1]
+    # the key isn't subdividable, so we scan forward from the start
+    expect_command Commands::HASH, ["secondtbl", [], @keys[2], 1]
+    send_command   Commands::HASH, ["secondtbl", [], @keys[2], 1, 1, hash_of(@rows[0..0])]
+    expect_command Commands::HASH, ["secondtbl", @keys[0], @keys[2], 2]
+    send_command   Commands::HASH, ["secondtbl", @keys[0], @keys[2], 2, 0, hash_of([])]
+    # both of our rows in the range are missing at the 'from' end, so they're removed as one run
+    expect_command Commands::ROWS, ["secondtbl", @keys[0], @keys[2]]
+    send_results   Commands::ROWS,
+                   ["secondtbl", @keys[0], @keys[2]]
+    expect_quit_and_close
+
+    assert_equal @rows,
+                 query("SELECT * FROM secondtbl ORDER BY pri2, pri1")
+  end
+
+  test_each "compares the rows it kept from hashing a range against the rows sent for it" do
+    clear_schema
+    create_secondtbl
+    execute "INSERT INTO secondtbl VALUES (10, 1, 'aa', 1), (20, 2, 'aa', 2), (40, 4, 'aa', 4)"
+    program_env['ENDPOINT_TARGET_MINIMUM_BLOCK_SIZE'] = '1000'
+
+    @rows = [[10, 1, "aa", 1],
+             [21, 2, "aa", 2], # updated
+             [30, 3, "aa", 3], # inserted, and the row with key 4 deleted
+             [50, 5, "aa", 5]]
+    @keys = [["aa", 1], ["aa", 2], ["aa", 3], ["aa", 4], ["aa", 5]]
+
+    expect_handshake_commands(schema: {"tables" => [secondtbl_def]})
+    expect_command Commands::RANGE, ["secondtbl"]
+    send_command   Commands::RANGE, ["secondtbl", @keys[0], @keys[4]]
+    expect_command Commands::ROWS, ["secondtbl", @keys[3], @keys[4]]
+    send_results   Commands::ROWS,
+                   ["secondtbl", @keys[3], @keys[4]],
+                   @rows[3]
+    expect_command Commands::HASH, ["secondtbl", [], @keys[3], 1]
+    send_command   Commands::HASH, ["secondtbl", [], @keys[3], 1, 1, hash_of(@rows[0..0])]
+    # we read our rows with keys 2 and 4 to hash this range, and keep them to apply the rows sent for it
+    expect_command Commands::HASH, ["secondtbl", @keys[0], @keys[3], 2]
+    send_command   Commands::HASH, ["secondtbl", @keys[0], @keys[3], 2, 2, hash_of(@rows[1..2])]
+    expect_command Commands::ROWS, ["secondtbl", @keys[0], @keys[3]]
+    send_results   Commands::ROWS,
+                   ["secondtbl", @keys[0], @keys[3]],
+                   *@rows[1..2]
+    expect_quit_and_close
+
+    assert_equal @rows,
+                 query("SELECT * FROM secondtbl ORDER BY pri2, pri1")
+  end
+
+  test_each "compares the rows it kept from hashing a range against the rows sent for it after clearing a row in the range with a conflicting unique key" do
+    clear_schema
+    create_uniquetbl
+    execute "INSERT INTO uniquetbl VALUES (1, 10, 'a'), (2, 20, 'b'), (4, 40, 'd')"
+    program_env['ENDPOINT_TARGET_MINIMUM_BLOCK_SIZE'] = '1000'
+
+    @rows = [[1, 10, "a"],
+             [2, 21, "b"], # updated, giving up its unique value to the row with key 5
+             [3, 30, "c"], # inserted, and the row with key 4 deleted
+             [5, 20, "e"]]
+    @keys = [[1], [2], [3], [4], [5]]
+
+    expect_handshake_commands(schema: {"tables" => [uniquetbl_def]})
+    expect_command Commands::RANGE, ["uniquetbl"]
+    send_command   Commands::RANGE, ["uniquetbl", @keys[0], @keys[4]]
+    # inserting the row with key 5 clears our row with key 2, which has the same unique value
+    expect_command Commands::ROWS, ["uniquetbl", @keys[3], @keys[4]]
+    send_results   Commands::ROWS,
+                   ["uniquetbl", @keys[3], @keys[4]],
+                   @rows[3]
+    expect_command Commands::HASH, ["uniquetbl", [], @keys[3], 1]
+    send_command   Commands::HASH, ["uniquetbl", [], @keys[3], 1, 1, hash_of(@rows[0..0])]
+    expect_command Commands::HASH, ["uniquetbl", @keys[0], @keys[3], 2]
+    send_command   Commands::HASH, ["uniquetbl", @keys[0], @keys[3], 2, 2, hash_of(@rows[1..2])]
+    expect_command Commands::ROWS, ["uniquetbl", @keys[0], @keys[3]]
+    send_results   Commands::ROWS,
+                   ["uniquetbl", @keys[0], @keys[3]],
+                   *@rows[1..2]
+    expect_quit_and_close
+
+    assert_equal @rows,
+                 query("SELECT * FROM uniquetbl ORDER BY pri")
+  end
+
+  test_each "clears rows with conflicting values for single-column unique keys before inserting or replacing rows" do
+    clear_schema
+    create_secondtbl
+    execute "CREATE UNIQUE INDEX unique_tri ON secondtbl (tri)"
+    execute "INSERT INTO secondtbl VALUES (100, 1, 'aa', 1), (200, 2, 'aa', 2), (300, 3, 'aa', 3)"
+    program_env['ENDPOINT_TARGET_MINIMUM_BLOCK_SIZE'] = '1000'
+
+    # the new rows take the unique values that the existing rows had, which have changed to new values
+    @rows = [[100, 1, "aa", 1],
+             [201, 2, "aa", 2],
+             [301, 3, "aa", 3],
+             [200, 4, "aa", 4],
+             [300, 5, "aa", 5]]
+    @keys = @rows.collect {|row| [row[2], row[1]]}
+
+    expect_handshake_commands(schema: {"tables" => [secondtbl_def.merge("keys" => secondtbl_def["keys"] + [{"name" => "unique_tri", "unique" => true, "columns" => [0]}])]})
+    expect_command Commands::RANGE, ["secondtbl"]
+    send_command   Commands::RANGE, ["secondtbl", @keys[0], @keys[4]]
+    expect_command Commands::ROWS, ["secondtbl", @keys[2], @keys[4]]
+    send_results   Commands::ROWS,
+                   ["secondtbl", @keys[2], @keys[4]],
+                   *@rows[3..4]
+    expect_command Commands::HASH, ["secondtbl", [], @keys[2], 1]
+    send_command   Commands::HASH, ["secondtbl", [], @keys[2], 1, 1, hash_of(@rows[0..0])]
+    expect_command Commands::HASH, ["secondtbl", @keys[0], @keys[2], 2]
+    send_command   Commands::HASH, ["secondtbl", @keys[0], @keys[2], 2, 2, hash_of(@rows[1..2])]
+    expect_command Commands::ROWS, ["secondtbl", @keys[0], @keys[2]]
+    send_results   Commands::ROWS,
+                   ["secondtbl", @keys[0], @keys[2]],
+                   *@rows[1..2]
+    expect_quit_and_close
+
+    assert_equal @rows,
+                 query("SELECT * FROM secondtbl ORDER BY pri2, pri1")
+  end
+
+  test_each "clears rows with conflicting values for multi-column unique keys before inserting or replacing rows" do
+    clear_schema
+    create_secondtbl
+    execute "CREATE UNIQUE INDEX unique_sec_tri ON secondtbl (sec, tri)"
+    execute "INSERT INTO secondtbl VALUES (100, 1, 'aa', 10), (200, 2, 'aa', 20), (300, 3, 'aa', 30)"
+    program_env['ENDPOINT_TARGET_MINIMUM_BLOCK_SIZE'] = '1000'
+
+    @rows = [[100, 1, "aa", 10],
+             [200, 2, "aa", 21],
+             [300, 3, "aa", 31],
+             [200, 4, "aa", 20],
+             [300, 5, "aa", 30]]
+    @keys = @rows.collect {|row| [row[2], row[1]]}
+
+    expect_handshake_commands(schema: {"tables" => [secondtbl_def.merge("keys" => secondtbl_def["keys"] + [{"name" => "unique_sec_tri", "unique" => true, "columns" => [3, 0]}])]})
+    expect_command Commands::RANGE, ["secondtbl"]
+    send_command   Commands::RANGE, ["secondtbl", @keys[0], @keys[4]]
+    expect_command Commands::ROWS, ["secondtbl", @keys[2], @keys[4]]
+    send_results   Commands::ROWS,
+                   ["secondtbl", @keys[2], @keys[4]],
+                   *@rows[3..4]
+    expect_command Commands::HASH, ["secondtbl", [], @keys[2], 1]
+    send_command   Commands::HASH, ["secondtbl", [], @keys[2], 1, 1, hash_of(@rows[0..0])]
+    expect_command Commands::HASH, ["secondtbl", @keys[0], @keys[2], 2]
+    send_command   Commands::HASH, ["secondtbl", @keys[0], @keys[2], 2, 2, hash_of(@rows[1..2])]
+    expect_command Commands::ROWS, ["secondtbl", @keys[0], @keys[2]]
+    send_results   Commands::ROWS,
+                   ["secondtbl", @keys[0], @keys[2]],
+                   *@rows[1..2]
+    expect_quit_and_close
+
+    assert_equal @rows,
+                 query("SELECT * FROM secondtbl ORDER BY pri2, pri1")
+  end
+
+  test_each "compares the keys first when asked to, narrowing down ranges whose keys don't match" do
+    clear_schema
+    create_secondtbl
+    execute "INSERT INTO secondtbl VALUES (10, 1, 'aa', 1), (20, 2, 'aa', 2), (30, 3, 'aa', 3)"
+    program_env['ENDPOINT_HASH_KEYS_FIRST'] = '1'
+
+    @rows = [[10, 1, "aa", 1],
+             [30, 3, "aa", 3]]
+    @keys = [["aa", 1], ["aa", 2], ["aa", 3]]
+
+    expect_handshake_commands(schema: {"tables" => [secondtbl_def]})
+    expect_command Commands::RANGE, ["secondtbl"]
+    send_command   Commands::RANGE, ["secondtbl", @keys[0], @keys[2]]
+    expect_command Commands::HASH_KEYS, ["secondtbl", [], @keys[2], 1]
+    send_command   Commands::HASH_KEYS, ["secondtbl", [], @keys[2], 1, 1, hash_of(@keys[0..0])]
+    # the keys match, so we check the whole rows, and carry on checking the keys of the rest of the table
+    expect_command Commands::HASH, ["secondtbl", [], @keys[0], 1]
+    send_command   Commands::HASH, ["secondtbl", [], @keys[0], 1, 1, hash_of(@rows[0..0])]
+    expect_command Commands::HASH_KEYS, ["secondtbl", @keys[0], @keys[2], 2]
+    send_command   Commands::HASH_KEYS, ["secondtbl", @keys[0], @keys[2], 2, 1, hash_of(@keys[2..2])]
+    # the keys don't match, so we bisect the range
+    expect_command Commands::HASH_KEYS, ["secondtbl", @keys[0], @keys[2], 1]
+    send_command   Commands::HASH_KEYS, ["secondtbl", @keys[0], @keys[2], 1, 1, hash_of(@keys[2..2])]
+    expect_command Commands::ROWS, ["secondtbl", @keys[0], @keys[1]]
+    send_results   Commands::ROWS,
+                   ["secondtbl", @keys[0], @keys[1]]
+    expect_command Commands::HASH_KEYS, ["secondtbl", @keys[1], @keys[2], 1]
+    send_command   Commands::HASH_KEYS, ["secondtbl", @keys[1], @keys[2], 1, 1, hash_of(@keys[2..2])]
+    expect_command Commands::HASH, ["secondtbl", @keys[1], @keys[2], 1]
+    send_command   Commands::HASH, ["secondtbl", @keys[1], @keys[2], 1, 1, hash_of(@rows[1..1])]
+    expect_quit_and_close
+
+    assert_equal @rows,
+                 query("SELECT * FROM secondtbl ORDER BY pri2, pri1")
+  end
+
+  test_each "compares the whole rows of ranges whose keys match when comparing the keys first" do
+    clear_schema
+    create_secondtbl
+    execute "INSERT INTO secondtbl VALUES (10, 1, 'aa', 1), (20, 2, 'aa', 2), (30, 3, 'aa', 3)"
+    program_env['ENDPOINT_HASH_KEYS_FIRST'] = '1'
+
+    @rows = [[10, 1, "aa", 1],
+             [21, 2, "aa", 2],
+             [30, 3, "aa", 3]]
+    @keys = @rows.collect {|row| [row[2], row[1]]}
+
+    expect_handshake_commands(schema: {"tables" => [secondtbl_def]})
+    expect_command Commands::RANGE, ["secondtbl"]
+    send_command   Commands::RANGE, ["secondtbl", @keys[0], @keys[2]]
+    expect_command Commands::HASH_KEYS, ["secondtbl", [], @keys[2], 1]
+    send_command   Commands::HASH_KEYS, ["secondtbl", [], @keys[2], 1, 1, hash_of(@keys[0..0])]
+    expect_command Commands::HASH, ["secondtbl", [], @keys[0], 1]
+    send_command   Commands::HASH, ["secondtbl", [], @keys[0], 1, 1, hash_of(@rows[0..0])]
+    expect_command Commands::HASH_KEYS, ["secondtbl", @keys[0], @keys[2], 2]
+    send_command   Commands::HASH_KEYS, ["secondtbl", @keys[0], @keys[2], 2, 2, hash_of(@keys[1..2])]
+    # the keys match, so we check all the rows they cover at once
+    expect_command Commands::HASH, ["secondtbl", @keys[0], @keys[2], 2]
+    send_command   Commands::HASH, ["secondtbl", @keys[0], @keys[2], 2, 2, hash_of(@rows[1..2])]
+    # which don't match, so we narrow those down as usual
+    expect_command Commands::HASH, ["secondtbl", @keys[0], @keys[2], 1]
+    send_command   Commands::HASH, ["secondtbl", @keys[0], @keys[2], 1, 1, hash_of(@rows[1..1])]
+    expect_command Commands::ROWS, ["secondtbl", @keys[0], @keys[1]]
+    send_results   Commands::ROWS,
+                   ["secondtbl", @keys[0], @keys[1]],
+                   @rows[1]
+    expect_command Commands::HASH, ["secondtbl", @keys[1], @keys[2], 1]
+    send_command   Commands::HASH, ["secondtbl", @keys[1], @keys[2], 1, 1, hash_of(@rows[2..2])]
+    expect_quit_and_close
+
+    assert_equal @rows,
+                 query("SELECT * FROM secondtbl ORDER BY pri2, pri1")
+  end
+
+  test_each "compares only the keys of tables listed as keys-only" do
+    clear_schema
+    create_secondtbl
+    execute "INSERT INTO secondtbl VALUES (10, 1, 'aa', 1), (20, 2, 'aa', 2), (30, 3, 'aa', 3)"
+    program_env['ENDPOINT_KEYS_ONLY_TABLES'] = 'secondtbl'
+
+    @rows = [[10, 1, "aa", 1],
+             [31, 3, "aa", 3]] # the row with key 2 is deleted, and this row is updated, which we won't see
+    @keys = [["aa", 1], ["aa", 2], ["aa", 3]]
+
+    expect_handshake_commands(schema: {"tables" => [secondtbl_def]})
+    expect_command Commands::RANGE, ["secondtbl"]
+    send_command   Commands::RANGE, ["secondtbl", @keys[0], @keys[2]]
+    expect_command Commands::HASH_KEYS, ["secondtbl", [], @keys[2], 1]
+    send_command   Commands::HASH_KEYS, ["secondtbl", [], @keys[2], 1, 1, hash_of(@keys[0..0])]
+    expect_command Commands::HASH_KEYS, ["secondtbl", @keys[0], @keys[2], 2]
+    send_command   Commands::HASH_KEYS, ["secondtbl", @keys[0], @keys[2], 2, 1, hash_of(@keys[2..2])]
+    expect_command Commands::HASH_KEYS, ["secondtbl", @keys[0], @keys[2], 1]
+    send_command   Commands::HASH_KEYS, ["secondtbl", @keys[0], @keys[2], 1, 1, hash_of(@keys[2..2])]
+    expect_command Commands::ROWS, ["secondtbl", @keys[0], @keys[1]]
+    send_results   Commands::ROWS,
+                   ["secondtbl", @keys[0], @keys[1]]
+    expect_command Commands::HASH_KEYS, ["secondtbl", @keys[1], @keys[2], 1]
+    send_command   Commands::HASH_KEYS, ["secondtbl", @keys[1], @keys[2], 1, 1, hash_of(@keys[2..2])]
+    expect_quit_and_close
+
+    assert_equal [[10, 1, "aa", 1],
+                  [30, 3, "aa", 3]],
+                 query("SELECT * FROM secondtbl ORDER BY pri2, pri1")
+  end
+
+  test_each "when catching up, retrieves only the ranges around the changed keys, and confirms the changes once they're committed" do
+    clear_schema
+    setup_with_footbl
+    create_secondtbl
+    execute "INSERT INTO secondtbl VALUES (100, 1, 'aa', 1)"
+    program_env['ENDPOINT_CATCH_UP_SLOT'] = 'ks_test_slot'
+
+    expect_handshake_commands(schema: {"tables" => [footbl_def, secondtbl_def]})
+    expect_command Commands::CHANGED_KEYS, ["ks_test_slot", 100000]
+    send_command   Commands::CHANGED_KEYS, ["ks_test_slot", "0/16B3748", false, {"footbl" => [[4], [5], [9]]}, []]
+    # we have no rows between 4 and 5, so they go in one range starting from the row we have before 4; 9 gets its
+    # own range starting from the row we have before it.  secondtbl has no changes so isn't looked at at all.
+    expect_command Commands::ROWS, ["footbl", [2], [5]]
+    expect_command Commands::ROWS, ["footbl", [8], [9]]
+    send_results   Commands::ROWS,
+                   ["footbl", [2], [5]],
+                   [4, nil, "changed"]
+    send_results   Commands::ROWS,
+                   ["footbl", [8], [9]],
+                   [9, 0, "new"]
+    expect_command Commands::CONFIRM_CHANGES, ["ks_test_slot", "0/16B3748"]
+
+    # the changes must only be dropped from the slot once we've committed the rows
+    assert_equal [@rows[0], [4, nil, "changed"], @rows[3], [9, 0, "new"]] + @rows[4..-1],
+                 query("SELECT * FROM footbl ORDER BY col1")
+    send_command   Commands::CONFIRM_CHANGES
+    expect_quit_and_close
+
+    assert_equal [[100, 1, "aa", 1]],
+                 query("SELECT * FROM secondtbl ORDER BY pri2, pri1")
+  end
+
+  test_each "when catching up, reloads the tables the 'from' end couldn't list the changed keys for, and doesn't confirm if there's no position" do
+    clear_schema
+    setup_with_footbl
+    program_env['ENDPOINT_CATCH_UP_SLOT'] = 'ks_test_slot'
+
+    expect_handshake_commands(schema: {"tables" => [footbl_def]})
+    expect_command Commands::CHANGED_KEYS, ["ks_test_slot", 100000]
+    send_command   Commands::CHANGED_KEYS, ["ks_test_slot", "", false, {}, ["footbl"]]
+    expect_command Commands::RANGE, ["footbl"]
+    send_command   Commands::RANGE, ["footbl", [], []]
+    expect_quit_and_close
+
+    assert_equal [],
+                 query("SELECT * FROM footbl ORDER BY col1")
+  end
+
+  test_each "when digesting small tables, skips those whose digests match" do
+    clear_schema
+    setup_with_footbl
+    create_secondtbl
+    execute "INSERT INTO secondtbl VALUES (100, 1, 'aa', 1)"
+    program_env['ENDPOINT_DIGEST_SMALL_TABLES'] = '1'
+
+    expect_handshake_commands(schema: {"tables" => [footbl_def, secondtbl_def]})
+    expect_command Commands::DIGESTS, [["footbl", "secondtbl"], 1024*1024]
+    send_command   Commands::DIGESTS, [{"footbl" => [@rows.size, hash_of(@rows)], "secondtbl" => [1, hash_of([[100, 1, "aa", 1]])]}]
+    expect_quit_and_close
+
+    assert_equal @rows,
+                 query("SELECT * FROM footbl ORDER BY col1")
+    assert_equal [[100, 1, "aa", 1]],
+                 query("SELECT * FROM secondtbl ORDER BY pri2, pri1")
+  end
+
+  test_each "when digesting small tables, still resets the sequences of those whose digests match", only: :postgresql do
+    clear_schema
+    execute "CREATE TABLE autotbl (inc SERIAL, payload INT NOT NULL, PRIMARY KEY(inc))"
+    execute "INSERT INTO autotbl VALUES (5, 10), (6, 11)" # doesn't advance the sequence
+    @rows = [[5, 10], [6, 11]]
+    table_def = autotbl_def
+    table_def["columns"][0] = {"name" => "inc", "column_type" => ColumnType::SINT_32BIT, "nullable" => false, "generated_by_sequence" => "autotbl_inc_seq"}
+    program_env['ENDPOINT_DIGEST_SMALL_TABLES'] = '1'
+
+    expect_handshake_commands(schema: {"tables" => [table_def]})
+    expect_command Commands::DIGESTS, [["autotbl"], 1024*1024]
+    send_command   Commands::DIGESTS, [{"autotbl" => [@rows.size, hash_of(@rows)]}]
+    expect_quit_and_close
+
+    execute "INSERT INTO autotbl (payload) VALUES (12)"
+    assert_equal @rows + [[7, 12]],
+                 query("SELECT * FROM autotbl ORDER BY inc")
+  end
+
+  test_each "when digesting small tables, compares those whose digests don't match, or which the 'from' end left out, as usual" do
+    clear_schema
+    setup_with_footbl
+    create_secondtbl
+    execute "INSERT INTO secondtbl VALUES (100, 1, 'aa', 1)"
+    program_env['ENDPOINT_DIGEST_SMALL_TABLES'] = '1'
+
+    expect_handshake_commands(schema: {"tables" => [footbl_def, secondtbl_def]})
+    expect_command Commands::DIGESTS, [["footbl", "secondtbl"], 1024*1024]
+    send_command   Commands::DIGESTS, [{"footbl" => [0, hash_of([])]}] # secondtbl is too large at the 'from' end
+    expect_command Commands::RANGE, ["footbl"]
+    send_command   Commands::RANGE, ["footbl", [], []]
+    expect_command Commands::RANGE, ["secondtbl"]
+    send_command   Commands::RANGE, ["secondtbl", [], []]
+    expect_quit_and_close
+
+    assert_equal [],
+                 query("SELECT * FROM footbl ORDER BY col1")
+    assert_equal [],
+                 query("SELECT * FROM secondtbl ORDER BY pri2, pri1")
+  end
+
+  test_each "when skipping unchanged tables, skips tables whose statistics haven't changed, but not tables it had to create" do
+    clear_schema
+    setup_with_footbl
+    program_env['ENDPOINT_SKIP_UNCHANGED_TABLES'] = '1'
+
+    # secondtbl doesn't exist at our end, so the statistics recorded for it are no longer any use
+    state_file = Tempfile.new('state')
+    state_file.write("footbl:\n  statistics:\n    from: \"1/0/0\"\n    verified_at: #{Time.now.to_i}\n" \
+                     "secondtbl:\n  statistics:\n    from: \"2/0/0\"\n    verified_at: #{Time.now.to_i}\n")
+    state_file.close
+    program_env['ENDPOINT_STATE_FILE'] = state_file.path
+
+    begin
+      expect_handshake_commands(
+        schema: {"tables" => [footbl_def, secondtbl_def]},
+        statistics: {"footbl" => "1/0/0", "secondtbl" => "2/0/0"})
+      expect_command Commands::RANGE, ["secondtbl"]
+      send_command   Commands::RANGE, ["secondtbl", ["aa", 1], ["aa", 1]]
+      expect_command Commands::ROWS, ["secondtbl", [], ["aa", 1]]
+      send_results   Commands::ROWS,
+                     ["secondtbl", [], ["aa", 1]],
+                     [100, 1, "aa", 1]
+      expect_quit_and_close
+    ensure
+      File.unlink(state_file.path) if File.exist?(state_file.path)
+    end
+
+    assert_equal @rows,
+                 query("SELECT * FROM footbl ORDER BY col1")
+    assert_equal [[100, 1, "aa", 1]],
+                 query("SELECT * FROM secondtbl ORDER BY pri2, pri1")
+  end
+
+  test_each "when resuming, checks only the gaps between the ranges the interrupted run finished, in key order" do
+    clear_schema
+    create_secondtbl
+    execute "INSERT INTO secondtbl VALUES (10, 1, 'aa', 1), (20, 2, 'aa', 2), (30, 3, 'aa', 3), (40, 4, 'aa', 4), (50, 5, 'bb', 5)"
+    @rows = [[10, 1, "aa", 1],
+             [20, 2, "aa", 2],
+             [30, 3, "aa", 3],
+             [40, 4, "aa", 4],
+             [50, 5, "bb", 5]]
+    @keys = @rows.collect {|row| [row[2], row[1]]}
+
+    # the journal records the keys as packed by the endpoint; the ranges don't have to be in order
+    key_hex = lambda {|key| MessagePack.pack(key, compatibility_mode: true).unpack1("H*")}
+    journal_file = Tempfile.new('journal')
+    journal_file.write("range\tsecondtbl\t#{key_hex[@keys[2]]}\t#{key_hex[@keys[3]]}\tmatched\n")
+    journal_file.write("range\tsecondtbl\t#{key_hex[[]]}\t#{key_hex[@keys[1]]}\tapplied\n")
+    journal_file.close
+    program_env['ENDPOINT_JOURNAL_FILE'] = journal_file.path
+    program_env['ENDPOINT_RESUME'] = '1'
+    program_env['ENDPOINT_COMMIT_LEVEL'] = '4'
+
+    begin
+      expect_handshake_commands(schema: {"tables" => [secondtbl_def]})
+      expect_command Commands::RANGE, ["secondtbl"]
+      send_command   Commands::RANGE, ["secondtbl", @keys[0], @keys[4]]
+      expect_command Commands::HASH, ["secondtbl", @keys[1], @keys[2], 1]
+      expect_command Commands::HASH, ["secondtbl", @keys[3], @keys[4], 1]
+      send_command   Commands::HASH, ["secondtbl", @keys[1], @keys[2], 1, 1, hash_of(@rows[2..2])]
+      send_command   Commands::HASH, ["secondtbl", @keys[3], @keys[4], 1, 1, hash_of(@rows[4..4])]
+      expect_quit_and_close
+      spawner.wait # the journal is removed after the connection is closed
+
+      assert !File.exist?(journal_file.path)
+    ensure
+      File.unlink(journal_file.path) if File.exist?(journal_file.path)
+    end
+
+    assert_equal @rows,
+                 query("SELECT * FROM secondtbl ORDER BY pri2, pri1")
+  end
+
+  test_each "when verifying, counts the rows after their last key without removing them" do
+    clear_schema
+    create_secondtbl
+    execute "INSERT INTO secondtbl VALUES (10, 1, 'aa', 1), (20, 2, 'aa', 2), (30, 3, 'aa', 3)"
+    program_env['ENDPOINT_VERIFY'] = '1'
+    @rows = [[10, 1, "aa", 1],
+             [20, 2, "aa", 2],
+             [30, 3, "aa", 3]]
+    @keys = @rows.collect {|row| [row[2], row[1]]}
+
+    with_report_file do |report_file|
+      expect_handshake_commands(schema: {"tables" => [secondtbl_def]})
+      expect_command Commands::RANGE, ["secondtbl"]
+      send_command   Commands::RANGE, ["secondtbl", @keys[0], @keys[1]]
+      expect_command Commands::HASH, ["secondtbl", [], @keys[1], 1]
+      send_command   Commands::HASH, ["secondtbl", [], @keys[1], 1, 1, hash_of(@rows[0..0])]
+      expect_command Commands::HASH, ["secondtbl", @keys[0], @keys[1], 2]
+      send_command   Commands::HASH, ["secondtbl", @keys[0], @keys[1], 2, 1, hash_of(@rows[1..1])]
+      expect_quit_and_close
+
+      assert_equal [{"table" => "secondtbl", "prev_key" => "('aa',2)", "last_key" => nil, "inserted" => 0, "updated" => 0, "deleted" => 1},
+                    {"table" => "secondtbl", "inserted" => 0, "updated" => 0, "deleted" => 1}],
+                   read_report(report_file)
+    end
+
+    assert_equal @rows,
+                 query("SELECT * FROM secondtbl ORDER BY pri2, pri1")
+  end
+
+  test_each "when verifying, counts the rows that differ in the ranges it retrieves without changing them" do
+    clear_schema
+    create_secondtbl
+    execute "INSERT INTO secondtbl VALUES (10, 1, 'aa', 1), (20, 2, 'aa', 2), (30, 3, 'aa', 3)"
+    program_env['ENDPOINT_VERIFY'] = '1'
+    program_env['ENDPOINT_TARGET_MINIMUM_BLOCK_SIZE'] = '1000' # so that we retrieve the mismatching range without narrowing it down row by row
+    @rows = [[10, 1, "aa", 1],
+             [20, 2, "aa", 2],
+             [30, 3, "aa", 3]]
+    @keys = @rows.collect {|row| [row[2], row[1]]}
+    changed_row = [21, 2, "aa", 2]
+
+    with_report_file do |report_file|
+      expect_handshake_commands(schema: {"tables" => [secondtbl_def]})
+      expect_command Commands::RANGE, ["secondtbl"]
+      send_command   Commands::RANGE, ["secondtbl", @keys[0], @keys[2]]
+      expect_command Commands::HASH, ["secondtbl", [], @keys[2], 1]
+      send_command   Commands::HASH, ["secondtbl", [], @keys[2], 1, 1, hash_of(@rows[0..0])]
+      expect_command Commands::HASH, ["secondtbl", @keys[0], @keys[2], 2]
+      send_command   Commands::HASH, ["secondtbl", @keys[0], @keys[2], 2, 2, hash_of([changed_row, @rows[2]])]
+      expect_command Commands::ROWS, ["secondtbl", @keys[0], @keys[2]]
+      send_results   Commands::ROWS,
+                     ["secondtbl", @keys[0], @keys[2]],
+                     changed_row,
+                     @rows[2]
+      expect_quit_and_close
+
+      assert_equal [{"table" => "secondtbl", "prev_key" => "('aa',1)", "last_key" => "('aa',3)", "inserted" => 0, "updated" => 1, "deleted" => 0},
+                    {"table" => "secondtbl", "inserted" => 0, "updated" => 1, "deleted" => 0}],
+                   read_report(report_file)
+    end
+
+    assert_equal @rows,
+                 query("SELECT * FROM secondtbl ORDER BY pri2, pri1")
+  end
+
+  test_each "when verifying, counts all their rows as missing if the table is empty at our end" do
+    clear_schema
+    create_secondtbl
+    program_env['ENDPOINT_VERIFY'] = '1'
+    @rows = [[10, 1, "aa", 1],
+             [20, 2, "aa", 2]]
+    @keys = @rows.collect {|row| [row[2], row[1]]}
+
+    with_report_file do |report_file|
+      expect_handshake_commands(schema: {"tables" => [secondtbl_def]})
+      expect_command Commands::RANGE, ["secondtbl"]
+      send_command   Commands::RANGE, ["secondtbl", @keys[0], @keys[1]]
+      expect_command Commands::ROWS, ["secondtbl", [], @keys[1]]
+      send_results   Commands::ROWS,
+                     ["secondtbl", [], @keys[1]],
+                     *@rows
+      expect_quit_and_close
+
+      assert_equal [{"table" => "secondtbl", "prev_key" => nil, "last_key" => "('aa',2)", "inserted" => 2, "updated" => 0, "deleted" => 0},
+                    {"table" => "secondtbl", "inserted" => 2, "updated" => 0, "deleted" => 0}],
+                   read_report(report_file)
+    end
+
+    assert_equal [],
+                 query("SELECT * FROM secondtbl ORDER BY pri2, pri1")
+  end
+
+  test_each "when verifying a sample, hashes blocks of rows after random keys, and counts the rows outside their key range" do
+    clear_schema
+    setup_with_footbl
+    program_env['ENDPOINT_VERIFY_SAMPLE'] = '200B'
+    their_rows = @rows[1..6] # they don't have our first row or our last two
+
+    with_report_file do |report_file|
+      expect_handshake_commands(schema: {"tables" => [footbl_def]})
+      expect_command Commands::RANGE, ["footbl"]
+      send_command   Commands::RANGE, ["footbl", [4], [555]]
+
+      # the keys are picked at random, so answer whatever we're asked to hash
+      while (command = read_command).first == Commands::HASH
+        table, prev_key, last_key, rows_to_hash = command.last
+        rows = their_rows.select {|row| row[0] > prev_key[0] && row[0] <= last_key[0]}.first(rows_to_hash)
+        send_command Commands::HASH, [table, prev_key, last_key, rows_to_hash, rows.size, hash_of(rows)]
+      end
+      assert_equal [Commands::QUIT], command
+      assert_equal "", spawner.read_from_program
+
+      ranges_after, ranges_before, totals = read_report(report_file)
+      assert_equal({"table" => "footbl", "prev_key" => "(555)", "last_key" => nil, "inserted" => 0, "updated" => 0, "deleted" => 2}, ranges_after)
+      assert_equal({"table" => "footbl", "prev_key" => nil, "last_key" => "(4)", "inserted" => 0, "updated" => 0, "deleted" => 1}, ranges_before)
+      assert_equal({"table" => "footbl", "inserted" => 0, "updated" => 0, "deleted" => 3, "samples_differing" => 0},
+                   totals.slice("table", "inserted", "updated", "deleted", "samples_differing"))
+      assert totals["samples"] > 0
+    end
+
+    assert_equal @rows,
+                 query("SELECT * FROM footbl ORDER BY col1")
+  end
+
   test_each "retrieves and reloads the whole table if there's no unique key with only non-nullable columns" do
     clear_schema
     create_noprimarytbl(create_suitable_keys: false)
@@ -7,6 +7,7 @@ require 'time'
 require 'msgpack'
 require 'ruby-xxhash'
 require 'digest/blake3'
+require 'digest/xxhash'
 
 ENDPOINT_ADAPTERS = {}
 require File.expand_path(File.join(File.dirname(__FILE__), 'postgresql_adapter')) if ENV['ENDPOINT_DATABASES'].nil? || ENV['ENDPOINT_DATABASES'].include?('postgresql')
@@ -89,6 +90,13 @@ module Commands
   ROWS = 2
   HASH = 7
   RANGE = 8
+  SPLIT = 9
+  HASH_KEYS = 10
+  CHANGES = 11
+  CHANGED_KEYS = 12
+  CONFIRM_CHANGES = 13
+  DIGESTS = 14
+  STATISTICS = 15
   IDLE = 31;
 
   PROTOCOL = 32
@@ -108,6 +116,8 @@ module HashAlgorithm
   MD5 = 0
   XXH64 = 1
   BLAKE3 = 2
+  XXH3_128 = 3
+  XXH3_128_ROWS = 4
 end
 
 module PrimaryKeyType
@@ -120,8 +130,8 @@ end
 module KitchenSync
   class TestCase < Test::Unit::TestCase
     EARLIEST_PROTOCOL_VERSION_SUPPORTED = 7
-    CURRENT_PROTOCOL_VERSION_USED = 9
-    LATEST_PROTOCOL_VERSION_SUPPORTED = 9
+    CURRENT_PROTOCOL_VERSION_USED = 11
+    LATEST_PROTOCOL_VERSION_SUPPORTED = 11
 
     undef_method :default_test if instance_methods.include? 'default_test' or
                                   instance_methods.include? :default_test
@@ -200,7 +210,7 @@ module KitchenSync
       expect_command Commands::TYPES
     end
 
-    def expect_handshake_commands(protocol_version_expected: CURRENT_PROTOCOL_VERSION_USED, protocol_version_supported: LATEST_PROTOCOL_VERSION_SUPPORTED, hash_algorithm: HashAlgorithm::BLAKE3, filters: nil, schema:)
+    def expect_handshake_commands(protocol_version_expected: CURRENT_PROTOCOL_VERSION_USED, protocol_version_supported: LATEST_PROTOCOL_VERSION_SUPPORTED, hash_algorithm: HashAlgorithm::BLAKE3, filters: nil, statistics: nil, schema:)
       # checking how protocol versions are handled is covered in protocol_versions_test; here we just need to get past that to get on to the commands we want to test
       expect_command Commands::PROTOCOL, [protocol_version_expected]
       @protocol_version = [protocol_version_expected, protocol_version_supported].min
@@ -219,6 +229,11 @@ module KitchenSync
         send_command   Commands::TYPES
       end
 
+      if statistics
+        expect_command Commands::STATISTICS
+        send_command   Commands::STATISTICS, [statistics]
+      end
+
       # since we haven't asked for multiple workers, we'll always get sent the snapshot-less start command
       expect_command Commands::WITHOUT_SNAPSHOT
       send_command   Commands::WITHOUT_SNAPSHOT
@@ -292,6 +307,12 @@ module KitchenSync
 
       when HashAlgorithm::BLAKE3
         Digest::BLAKE3.digest(data)
+
+      when HashAlgorithm::XXH3_128
+        Digest::XXH3_128bits.digest(data)
+
+      when HashAlgorithm::XXH3_128_ROWS
+        Digest::XXH3_128bits.digest(rows.collect {|row| Digest::XXH3_128bits.digest(MessagePack.pack(row, compatibility_mode: true))}.join)
       end
     end
 